@@ -279,10 +279,7 @@ int send_thread(SceSize args_size, SendArguments *args) {
     snprintf(path, MAX_PATH_LENGTH, "%s%s", args->file_list->path, mark_entry->name);
 
     FileProcessParam param;
-    param.value = &value;
-    param.max = folders + files;
-    param.SetProgress = SetProgress;
-    param.cancelHandler = cancelHandler;
+    initFileProcessParam(&param, &value, folders + files);
     res = sendPath(path, &param);
     if (res <= 0) {
       goto CANCELED;
@@ -23,6 +23,12 @@
 #include "file.h"
 #include "utils.h"
 #include "elf.h"
+#include "zipindex.h"
+#include "zipextract.h"
+#include "gzindex.h"
+#include "readahead.h"
+#include "makezip.h"
+#include "strnatcmp.h"
 
 static int is_psarc = 0;
 static char archive_file[MAX_PATH_LENGTH];
@@ -31,9 +37,44 @@ struct archive *archive_fd = NULL;
 static int need_password = 0;
 static char password[128];
 
-int checkForUnsafeImports(void *buffer);
-char *uncompressBuffer(const Elf32_Ehdr *ehdr, const Elf32_Phdr *phdr, const segment_info *segment,
-                       const char *buffer);
+// Central directory of zip based archives, to open single entries directly
+static ZipIndex zip_index;
+static ZipIndexFile zip_index_file = { .fd = -1 };
+
+// gzip is inflated here instead of by libarchive, so that decompression
+// can later resume at a checkpoint close to an entry
+static int is_gzip = 0;
+static GzIndex gz_index;
+
+// Modules are checked for unsafe imports while they are extracted
+static ArchiveUnsafeHandler unsafe_handler = NULL;
+static int unsafe_accepted = 0;
+static FselfScanner unsafe_scanner;
+
+static uint32_t *skip_identical = NULL;
+
+// Archives that have an archive open inside of them, outermost first. The
+// open archive reads its data from an entry of the last one, and going
+// back to a parent needs no new walk over its headers
+typedef struct {
+  char file[MAX_PATH_LENGTH];
+  int path_start;
+  int need_password;
+  char password[128];
+  int is_gzip;
+  int implicit; // Opened only to reach the archive inside of it
+  int64_t child_offset; // Header position of that archive in the inflated data
+  ZipIndex zip_index;
+  GzIndex gz_index;
+  struct ArchiveFileNode *root;
+  struct ArchiveArenaBlock *arena;
+  struct ArchiveFileNode **buckets;
+  uint32_t n_buckets;
+  uint32_t n_nodes;
+} ArchiveParent;
+
+static ArchiveParent archive_parents[ARCHIVE_MAX_NESTING];
+static int archive_depth = 0;
 
 void waitpid() {}
 void __archive_create_child() {}
@@ -41,50 +82,261 @@ void __archive_check_child() {}
 
 struct archive_data {
   char *filename;
-  SceUID fd;
+  ReadAhead *ra;
   void *buffer;
   int block_size;
+  GzReader *gz;
+  uint64_t gz_offset;
+  int gz_build;
+  GzIndex *gz_index; // Set if the data is inflated by GzReader
+  int parent; // Level of the archive the file is an entry of, -1 if none
+  struct ArchiveStream *stream;
+  struct archive_data *next; // Next volume of a multi volume archive
 };
 
+static struct archive *open_archive_at(int level, uint64_t gz_offset, int gz_build);
+
+// An entry of a parent archive, read as the file of the archive nested in it
+typedef struct ArchiveStream {
+  int level;
+  const char *name; // Path of the entry in the parent archive
+  uint64_t size;
+  uint64_t position;
+  ZipIndexFile zip_file; // Open if the entry is in the central directory
+  struct archive *archive; // Otherwise libarchive is at the entry
+  void *buffer;
+} ArchiveStream;
+
+// Position the stream at the start of the entry
+static int archiveStreamStart(ArchiveStream *stream) {
+  ArchiveParent *parent = &archive_parents[stream->level];
+
+  stream->position = 0;
+
+  if (stream->zip_file.fd >= 0) {
+    int64_t res = zipIndexFileSeek(&stream->zip_file, 0);
+    return res < 0 ? (int)res : 0;
+  }
+
+  ZipIndexEntry *entry = zipIndexFind(&parent->zip_index, stream->name);
+  if (entry && zipIndexEntrySupported(entry)) {
+    stream->size = entry->uncompressed_size;
+    return zipIndexFileOpen(&parent->zip_index, &stream->zip_file, entry);
+  }
+
+  if (stream->archive)
+    archive_read_free(stream->archive);
+
+  // Inflate from the checkpoint closest to the entry
+  uint64_t gz_offset = 0;
+  if (parent->is_gzip && parent->gz_index.count > 0 && parent->child_offset > 0)
+    gz_offset = parent->child_offset;
+
+  stream->archive = open_archive_at(stream->level, gz_offset, 0);
+  if (!stream->archive)
+    return -1;
+
+  while (1) {
+    struct archive_entry *archive_entry;
+    if (archive_read_next_header(stream->archive, &archive_entry) != ARCHIVE_OK)
+      break;
+
+    if (strcasecmp(archive_entry_pathname(archive_entry), stream->name) == 0) {
+      stream->size = archive_entry_size(archive_entry);
+      return 0;
+    }
+  }
+
+  archive_read_free(stream->archive);
+  stream->archive = NULL;
+
+  return VITASHELL_ERROR_NOT_FOUND;
+}
+
+static void archiveStreamClose(ArchiveStream *stream) {
+  if (stream->zip_file.fd >= 0)
+    zipIndexFileClose(&stream->zip_file);
+
+  if (stream->archive)
+    archive_read_free(stream->archive);
+
+  free(stream->buffer);
+
+  stream->archive = NULL;
+  stream->buffer = NULL;
+}
+
+static int archiveStreamOpen(ArchiveStream *stream, int level, const char *file) {
+  memset(stream, 0, sizeof(ArchiveStream));
+  stream->zip_file.fd = -1;
+  stream->level = level;
+  stream->name = file + archive_parents[level].path_start;
+
+  stream->buffer = memalign(4096, TRANSFER_SIZE);
+  if (!stream->buffer)
+    return VITASHELL_ERROR_NO_MEMORY;
+
+  int res = archiveStreamStart(stream);
+  if (res < 0)
+    archiveStreamClose(stream);
+
+  return res;
+}
+
+static int archiveStreamRead(ArchiveStream *stream, const void **data) {
+  int read;
+
+  if (stream->zip_file.fd >= 0)
+    read = zipIndexFileRead(&stream->zip_file, stream->buffer, TRANSFER_SIZE);
+  else
+    read = archive_read_data(stream->archive, stream->buffer, TRANSFER_SIZE);
+
+  if (read > 0)
+    stream->position += read;
+
+  *data = stream->buffer;
+  return read;
+}
+
+// libarchive can only read forward, going back starts at the entry again
+static int64_t archiveStreamSeek(ArchiveStream *stream, int64_t offset, int whence) {
+  if (whence == SCE_SEEK_CUR)
+    offset += stream->position;
+  else if (whence == SCE_SEEK_END)
+    offset += stream->size;
+
+  if (offset < 0)
+    return -1;
+
+  if (offset > stream->size)
+    offset = stream->size;
+
+  if (stream->zip_file.fd >= 0) {
+    int64_t res = zipIndexFileSeek(&stream->zip_file, offset);
+    if (res >= 0)
+      stream->position = res;
+
+    return res;
+  }
+
+  if (offset < stream->position) {
+    int res = archiveStreamStart(stream);
+    if (res < 0)
+      return res;
+  }
+
+  while (stream->position < offset) {
+    int size = offset - stream->position < TRANSFER_SIZE ? (int)(offset - stream->position) : TRANSFER_SIZE;
+
+    int read = archive_read_data(stream->archive, stream->buffer, size);
+    if (read <= 0)
+      return read < 0 ? read : -1;
+
+    stream->position += read;
+  }
+
+  return stream->position;
+}
+
 static const char *file_passphrase(struct archive *a, void *client_data) {
-  return password;
+  return client_data;
 }
 
 static int file_open(struct archive *a, void *client_data) {
   struct archive_data *archive_data = client_data;
+
+  // The next volume may already be reading ahead
+  if (archive_data->ra || archive_data->stream)
+    return ARCHIVE_OK;
   
-  archive_data->fd = sceIoOpen(archive_data->filename, SCE_O_RDONLY, 0);
-  if (archive_data->fd < 0)
-    return ARCHIVE_FATAL;
-  
-  archive_data->buffer = memalign(4096, TRANSFER_SIZE);
-  archive_data->block_size = TRANSFER_SIZE;
+  if (archive_data->parent >= 0) {
+    archive_data->stream = malloc(sizeof(ArchiveStream));
+    if (!archive_data->stream)
+      return ARCHIVE_FATAL;
+
+    if (archiveStreamOpen(archive_data->stream, archive_data->parent, archive_data->filename) < 0) {
+      free(archive_data->stream);
+      archive_data->stream = NULL;
+      return ARCHIVE_FATAL;
+    }
+  } else if (archive_data->gz_index) {
+    archive_data->gz = malloc(sizeof(GzReader));
+    if (!archive_data->gz)
+      return ARCHIVE_FATAL;
+
+    if (gzReaderOpen(archive_data->gz, archive_data->filename, archive_data->gz_index,
+                     archive_data->gz_offset, archive_data->gz_build) < 0) {
+      free(archive_data->gz);
+      archive_data->gz = NULL;
+      return ARCHIVE_FATAL;
+    }
+
+    archive_data->buffer = memalign(4096, TRANSFER_SIZE);
+    archive_data->block_size = TRANSFER_SIZE;
+  } else {
+    archive_data->ra = malloc(sizeof(ReadAhead));
+    if (!archive_data->ra)
+      return ARCHIVE_FATAL;
+
+    if (readAheadOpen(archive_data->ra, archive_data->filename) < 0) {
+      free(archive_data->ra);
+      archive_data->ra = NULL;
+      return ARCHIVE_FATAL;
+    }
+  }
   
   return ARCHIVE_OK;
 }
 
 static ssize_t file_read(struct archive *a, void *client_data, const void **buff) {
   struct archive_data *archive_data = client_data;
-  *buff = archive_data->buffer;
-  return sceIoRead(archive_data->fd, archive_data->buffer, archive_data->block_size);
+
+  if (archive_data->gz) {
+    *buff = archive_data->buffer;
+    return gzReaderRead(archive_data->gz, archive_data->buffer, archive_data->block_size);
+  }
+
+  if (archive_data->stream)
+    return archiveStreamRead(archive_data->stream, buff);
+
+  int read = readAheadRead(archive_data->ra, buff);
+
+  // Once this volume is read to its end, start on the next one so that
+  // switching to it does not wait for the first read
+  if (archive_data->ra->finished && archive_data->next && !archive_data->next->ra)
+    file_open(a, archive_data->next);
+
+  return read;
 }
 
 static int64_t file_skip(struct archive *a, void *client_data, int64_t request) {
   struct archive_data *archive_data = client_data;
-  int64_t old_offset, new_offset;
 
-  if ((old_offset = sceIoLseek(archive_data->fd, 0, SCE_SEEK_CUR)) >= 0 &&
-      (new_offset = sceIoLseek(archive_data->fd, request, SCE_SEEK_CUR)) >= 0)
-    return new_offset - old_offset;
+  // Inflated data can not be skipped, libarchive reads it instead
+  if (archive_data->gz)
+    return 0;
+
+  if (archive_data->stream) {
+    uint64_t position = archive_data->stream->position;
+    int64_t res = archiveStreamSeek(archive_data->stream, request, SCE_SEEK_CUR);
+    return res >= 0 ? res - position : -1;
+  }
 
-  return -1;
+  int64_t skipped = readAheadSkip(archive_data->ra, request);
+  return skipped >= 0 ? skipped : -1;
 }
 
 static int64_t file_seek(struct archive *a, void *client_data, int64_t request, int whence) {
   struct archive_data *archive_data = client_data;
   int64_t r;
 
-  r = sceIoLseek(archive_data->fd, request, whence);
+  if (archive_data->gz)
+    return ARCHIVE_FATAL;
+
+  if (archive_data->stream)
+    r = archiveStreamSeek(archive_data->stream, request, whence);
+  else
+    r = readAheadSeek(archive_data->ra, request, whence);
   if (r >= 0)
     return r;
 
@@ -94,13 +346,28 @@ static int64_t file_seek(struct archive *a, void *client_data, int64_t request,
 static int file_close2(struct archive *a, void *client_data) {
   struct archive_data *archive_data = client_data;
 
-  if (archive_data->fd >= 0) {
-    sceIoClose(archive_data->fd);
-    archive_data->fd = -1;
+  if (archive_data->ra) {
+    readAheadClose(archive_data->ra);
+    free(archive_data->ra);
+    archive_data->ra = NULL;
+  }
+
+  if (archive_data->stream) {
+    archiveStreamClose(archive_data->stream);
+    free(archive_data->stream);
+    archive_data->stream = NULL;
+  }
+
+  if (archive_data->gz) {
+    gzReaderClose(archive_data->gz);
+    free(archive_data->gz);
+    archive_data->gz = NULL;
   }
 
-  free(archive_data->buffer);
-  archive_data->buffer = NULL;
+  if (archive_data->buffer) {
+    free(archive_data->buffer);
+    archive_data->buffer = NULL;
+  }
 
   return ARCHIVE_OK;
 }
@@ -108,19 +375,35 @@ static int file_close2(struct archive *a, void *client_data) {
 static int file_close(struct archive *a, void *client_data) {
   struct archive_data *archive_data = client_data;
   file_close2(a, client_data);
+
+  // Stop the read ahead of the next volume if it was started
+  if (archive_data->next)
+    file_close2(a, archive_data->next);
+
   free(archive_data->filename);
   free(archive_data);
   return ARCHIVE_OK;
 }
 
 static int file_switch(struct archive *a, void *client_data1, void *client_data2) {
+  struct archive_data *archive_data = client_data1;
   file_close2(a, client_data1);
+
+  if (archive_data->next && archive_data->next != client_data2)
+    file_close2(a, archive_data->next);
+
   return file_open(a, client_data2);
 }
 
-int append_archive(struct archive *a, const char *filename) {
+int append_archive(struct archive *a, const char *filename, int parent, GzIndex *gz_index,
+                   uint64_t gz_offset, int gz_build, struct archive_data **last) {
   struct archive_data *archive_data = malloc(sizeof(struct archive_data));
   if (archive_data) {
+    memset(archive_data, 0, sizeof(struct archive_data));
+    archive_data->parent = parent;
+    archive_data->gz_index = gz_index;
+    archive_data->gz_offset = gz_offset;
+    archive_data->gz_build = gz_build;
     archive_data->filename = malloc(strlen(filename) + 1);
     strcpy(archive_data->filename, filename);
     if (archive_read_append_callback_data(a, archive_data) != ARCHIVE_OK) {
@@ -128,12 +411,31 @@ int append_archive(struct archive *a, const char *filename) {
       free(archive_data);
       return ARCHIVE_FATAL;
     }
+
+    // Link the volumes in order
+    if (*last)
+      (*last)->next = archive_data;
+    *last = archive_data;
   }
   
   return ARCHIVE_OK;
 }
 
-struct archive *open_archive(const char *filename) {
+// level is the open archive or one of its parents. gz_offset is a position
+// in the inflated data to start reading at, gz_build takes seek checkpoints
+// into gz_index while reading
+static struct archive *open_archive_at(int level, uint64_t gz_offset, int gz_build) {
+  const char *filename = archive_file;
+  GzIndex *gz = is_gzip ? &gz_index : NULL;
+  char *passphrase = password;
+
+  if (level < archive_depth) {
+    ArchiveParent *parent = &archive_parents[level];
+    filename = parent->file;
+    gz = parent->is_gzip ? &parent->gz_index : NULL;
+    passphrase = parent->password;
+  }
+
   struct archive *a = archive_read_new();
   if (!a)
     return NULL;
@@ -141,7 +443,7 @@ struct archive *open_archive(const char *filename) {
   archive_read_support_filter_all(a);
   archive_read_support_format_all(a);
   
-  archive_read_set_passphrase_callback(a, NULL, file_passphrase);
+  archive_read_set_passphrase_callback(a, passphrase, file_passphrase);
   archive_read_set_open_callback(a, file_open);
   archive_read_set_read_callback(a, file_read);
   archive_read_set_skip_callback(a, file_skip);
@@ -151,11 +453,14 @@ struct archive *open_archive(const char *filename) {
   
   // Get path and name of filename
   int type = 0;
+  struct archive_data *last = NULL;
   
   char *p = strrchr(filename, '/');
   if (!p)
     p = strrchr(filename, ':');
-  if (p) {
+
+  // A nested archive is a single entry of its parent
+  if (p && level == 0) {
     char *q = strrchr(p + 1, '.');
     if (q) {
       char path[MAX_PATH_LENGTH];
@@ -206,7 +511,7 @@ struct archive *open_archive(const char *filename) {
             num = 0; // this type begins with .r00
             
             // Append .rar as first archive
-            if (append_archive(a, filename) != ARCHIVE_OK) {
+            if (append_archive(a, filename, -1, NULL, 0, 0, &last) != ARCHIVE_OK) {
               archive_read_free(a);
               return NULL;
             }
@@ -218,7 +523,7 @@ struct archive *open_archive(const char *filename) {
             if (!checkFileExist(new_path))
               break;
             
-            if (append_archive(a, new_path) != ARCHIVE_OK) {
+            if (append_archive(a, new_path, -1, NULL, 0, 0, &last) != ARCHIVE_OK) {
               archive_read_free(a);
               return NULL;
             }
@@ -232,7 +537,7 @@ struct archive *open_archive(const char *filename) {
   
   // Single volume
   if (type == 0) {
-    if (append_archive(a, filename) != ARCHIVE_OK) {
+    if (append_archive(a, filename, level - 1, gz, gz_offset, gz_build, &last) != ARCHIVE_OK) {
       archive_read_free(a);
       return NULL;
     }
@@ -247,272 +552,699 @@ struct archive *open_archive(const char *filename) {
   return a;
 }
 
+SceMode convert_stat_mode(mode_t mode) {
+  SceMode sce_mode = 0;
+  if (mode & S_IFDIR)
+    sce_mode |= SCE_S_IFDIR;
+  if (mode & S_IFREG)
+    sce_mode |= SCE_S_IFREG;
+  return sce_mode;
+}
+
+#define ARCHIVE_ARENA_BLOCK_SIZE (64 * 1024)
+#define ARCHIVE_MIN_BUCKETS 1024
+
+// Children of a folder are looked up in a hash table shared by all nodes
+// and kept in the order of SORT_BY_NAME once the tree is complete
 typedef struct ArchiveFileNode {
+  struct ArchiveFileNode *parent;
   struct ArchiveFileNode *child;
   struct ArchiveFileNode *next;
+  struct ArchiveFileNode *hash_next;
   char *name;
-  SceIoStat stat;
+  uint32_t hash;
+  uint32_t mode;
+  int64_t size;
+  uint64_t ctime; // UTC ticks
+  uint64_t mtime;
+  uint64_t atime;
+  int64_t offset; // Header position in the inflated data, -1 if unknown
 } ArchiveFileNode;
 
+// Nodes and names are allocated from blocks that are freed all at once
+typedef struct ArchiveArenaBlock {
+  struct ArchiveArenaBlock *next;
+  uint32_t used;
+  uint32_t size;
+} ArchiveArenaBlock;
+
+#define ARCHIVE_ARENA_HEADER_SIZE ((sizeof(ArchiveArenaBlock) + 7) & ~7)
+
 static ArchiveFileNode *archive_root = NULL;
+static ArchiveArenaBlock *archive_arena = NULL;
+static ArchiveFileNode **archive_buckets = NULL;
+static uint32_t archive_n_buckets = 0;
+static uint32_t archive_n_nodes = 0;
 
-char *serializePathName(char *name, char **p) {
-  if (!p)
-    return name;
-  
-  if (*p) {
-    **p = '/'; // restore
-    name = *p + 1;
+static void *archiveArenaAlloc(uint32_t size, uint32_t align) {
+  uint32_t used = archive_arena ? (archive_arena->used + align - 1) & ~(align - 1) : 0;
+
+  if (!archive_arena || used + size > archive_arena->size) {
+    uint32_t block_size = ARCHIVE_ARENA_BLOCK_SIZE;
+    if (size > block_size)
+      block_size = size;
+
+    ArchiveArenaBlock *block = malloc(ARCHIVE_ARENA_HEADER_SIZE + block_size);
+    if (!block)
+      return NULL;
+
+    block->next = archive_arena;
+    block->used = 0;
+    block->size = block_size;
+    archive_arena = block;
+    used = 0;
   }
-  
-  *p = strchr(name, '/');
-  if (*p)
-    **p = '\0';
-  
-  return name;
+
+  archive_arena->used = used + size;
+  return (uint8_t *)archive_arena + ARCHIVE_ARENA_HEADER_SIZE + used;
+}
+
+static uint32_t hashArchiveName(ArchiveFileNode *parent, const char *name) {
+  uint32_t hash = 2166136261U ^ (uint32_t)(uintptr_t)parent;
+
+  while (*name) {
+    hash = (hash ^ (uint8_t)tolower(*name++)) * 16777619U;
+  }
+
+  return hash;
+}
+
+static int growArchiveBuckets() {
+  uint32_t n_buckets = archive_n_buckets ? archive_n_buckets * 2 : ARCHIVE_MIN_BUCKETS;
+
+  ArchiveFileNode **buckets = malloc(n_buckets * sizeof(ArchiveFileNode *));
+  if (!buckets)
+    return VITASHELL_ERROR_NO_MEMORY;
+
+  memset(buckets, 0, n_buckets * sizeof(ArchiveFileNode *));
+
+  uint32_t i;
+  for (i = 0; i < archive_n_buckets; i++) {
+    ArchiveFileNode *node = archive_buckets[i];
+    while (node) {
+      ArchiveFileNode *hash_next = node->hash_next;
+      uint32_t bucket = node->hash & (n_buckets - 1);
+      node->hash_next = buckets[bucket];
+      buckets[bucket] = node;
+      node = hash_next;
+    }
+  }
+
+  free(archive_buckets);
+  archive_buckets = buckets;
+  archive_n_buckets = n_buckets;
+
+  return 0;
+}
+
+static void setArchiveNodeStat(ArchiveFileNode *node, SceIoStat *stat) {
+  SceRtcTick tick;
+
+  node->mode = stat->st_mode;
+  node->size = stat->st_size;
+
+  sceRtcGetTick(&stat->st_ctime, &tick);
+  node->ctime = tick.tick;
+  sceRtcGetTick(&stat->st_mtime, &tick);
+  node->mtime = tick.tick;
+  sceRtcGetTick(&stat->st_atime, &tick);
+  node->atime = tick.tick;
+}
+
+static void getArchiveNodeStat(ArchiveFileNode *node, SceIoStat *stat) {
+  SceRtcTick tick;
+
+  memset(stat, 0, sizeof(SceIoStat));
+  stat->st_mode = node->mode;
+  stat->st_size = node->size;
+
+  tick.tick = node->ctime;
+  sceRtcSetTick(&stat->st_ctime, &tick);
+  tick.tick = node->mtime;
+  sceRtcSetTick(&stat->st_mtime, &tick);
+  tick.tick = node->atime;
+  sceRtcSetTick(&stat->st_atime, &tick);
 }
 
-ArchiveFileNode *createArchiveNode(const char *name, SceIoStat *stat) {
-  ArchiveFileNode *node = malloc(sizeof(ArchiveFileNode));
+// Children are prepended, sortArchiveNodes restores their order
+ArchiveFileNode *createArchiveNode(ArchiveFileNode *parent, const char *name, int name_length) {
+  if (archive_n_nodes >= archive_n_buckets && growArchiveBuckets() < 0)
+    return NULL;
+
+  ArchiveFileNode *node = archiveArenaAlloc(sizeof(ArchiveFileNode), 8);
   if (!node)
     return NULL;
-  
+
   memset(node, 0, sizeof(ArchiveFileNode));
 
-  node->name = malloc(strlen(name) + 1);
-  if (!node->name) {
-    free(node);
+  node->name = archiveArenaAlloc(name_length + 1, 1);
+  if (!node->name)
     return NULL;
+
+  memcpy(node->name, name, name_length);
+  node->name[name_length] = '\0';
+
+  node->parent = parent;
+  node->hash = hashArchiveName(parent, node->name);
+  node->offset = -1;
+
+  uint32_t bucket = node->hash & (archive_n_buckets - 1);
+  node->hash_next = archive_buckets[bucket];
+  archive_buckets[bucket] = node;
+  archive_n_nodes++;
+
+  if (parent) {
+    node->next = parent->child;
+    parent->child = node;
   }
-  
-  strcpy(node->name, name);
-  
-  node->child = NULL;
-  node->next = NULL;
-  
-  memcpy(&node->stat, stat, sizeof(SceIoStat));
-  
+
   return node;
 }
 
-ArchiveFileNode *_findArchiveNode(ArchiveFileNode *parent, char *name, ArchiveFileNode **parent_out,
-                                  ArchiveFileNode **prev_out, char **name_out, char **p_out) {
-  char *p = NULL;
-  ArchiveFileNode *prev = NULL;
+// If the path goes on, only a folder of that name is taken
+static ArchiveFileNode *findArchiveChild(ArchiveFileNode *parent, const char *name, int folder) {
+  if (!archive_buckets)
+    return NULL;
 
-  // Remove trailing slash
-  removeEndSlash(name);
-  
-  // Serialize path name
-  name = serializePathName(name, &p);
-  
-  // Root
-  if (name[0] == '\0')
-    return parent;
-  
-  // Traverse
-  ArchiveFileNode *curr = parent->child;
-  while (curr) {
-    // Found name
-    if (strcasecmp(curr->name, name) == 0) {
-      // Found node
-      if (!p)
-        return curr;
-      
-      // Is folder
-      if (SCE_S_ISDIR(curr->stat.st_mode)) {
-        // Serialize path name
-        name = serializePathName(name, &p);
-        
-        // Get child entry of this directory
-        parent = curr;
-        curr = curr->child;
-        continue;
-      }
-    }
-    
-    // Get next entry in this directory
-    prev = curr;
-    curr = curr->next;
+  uint32_t hash = hashArchiveName(parent, name);
+
+  ArchiveFileNode *node = archive_buckets[hash & (archive_n_buckets - 1)];
+  while (node) {
+    if (node->hash == hash && node->parent == parent && strcasecmp(node->name, name) == 0 &&
+        (!folder || SCE_S_ISDIR(node->mode)))
+      return node;
+
+    node = node->hash_next;
   }
-  
-  // Out
-  if (parent_out)
-    *parent_out = parent;
-  if (prev_out)
-    *prev_out = prev;
-  if (name_out)
-    *name_out = name;
-  if (p_out)
-    *p_out = p;
-  
+
   return NULL;
 }
 
 ArchiveFileNode *findArchiveNode(const char *path) {
   char name[MAX_PATH_LENGTH];
   strcpy(name, path);
-  return _findArchiveNode(archive_root, name, NULL, NULL, NULL, NULL);
-}
+  removeEndSlash(name);
 
-int addArchiveNodeRecursive(ArchiveFileNode *parent, char *name, SceIoStat *stat) {  
-  char *p = NULL;
-  ArchiveFileNode *prev = NULL;
-  
-  if (!parent)
-    return VITASHELL_ERROR_ILLEGAL_ADDR;
-  
-  ArchiveFileNode *res = _findArchiveNode(parent, name, &parent, &prev, &name, &p);
-  
-  // Already exist
-  if (res) {
-    memcpy(&res->stat, stat, sizeof(SceIoStat));
-    return 0;
-  }
-  
-  // Create new node
-  SceIoStat node_stat;
-  memcpy(&node_stat, stat, sizeof(SceIoStat));
-  node_stat.st_mode = SCE_S_IFDIR;
-  node_stat.st_size = 0;
-  
-  ArchiveFileNode *node = createArchiveNode(name, p ? &node_stat : stat);  
-  if (!parent->child) { // First child
-    parent->child = node;
-  } else {              // Neighbour
-    prev->next = node;
+  ArchiveFileNode *node = archive_root;
+  char *p = name;
+
+  while (node && *p) {
+    char *slash = strchr(p, '/');
+    if (slash)
+      *slash = '\0';
+
+    node = findArchiveChild(node, p, slash != NULL);
+
+    if (!slash)
+      break;
+
+    p = slash + 1;
   }
-  
-  // Recursion
-  if (p)
-    addArchiveNodeRecursive(node, p + 1, stat);
-  
-  return 0;
+
+  return node;
 }
 
-void addArchiveNode(const char *path, SceIoStat *stat) {  
+void addArchiveNode(const char *path, SceIoStat *stat, int64_t offset) {
   char name[MAX_PATH_LENGTH];
   strcpy(name, path);
-  addArchiveNodeRecursive(archive_root, name, stat);
-}
+  removeEndSlash(name);
 
-void freeArchiveNodes(ArchiveFileNode *curr) {
-  // Traverse
-  while (curr) {
-    // Enter directory
-    if (SCE_S_ISDIR(curr->stat.st_mode)) {
-      // Traverse child entry of this directory
-      freeArchiveNodes(curr->child);
-    }
-    
-    // Get next entry in this directory
-    ArchiveFileNode *next = curr->next;
-    free(curr->name);
-    free(curr);
-    curr = next;
-  }
-}
+  ArchiveFileNode *parent = archive_root;
+  char *p = name;
 
-int archiveCheckFilesForUnsafeFself() {  
-  // Open archive file
-  struct archive *archive = open_archive(archive_file);
-  if (!archive)
-    return 0;
-  
-  // Traverse
-  while (1) {
-    struct archive_entry *archive_entry;
-    int res = archive_read_next_header(archive, &archive_entry);
-    if (res == ARCHIVE_EOF)
-      break;
-    
-    if (res != ARCHIVE_OK) {
-      archive_read_free(archive);
-      return 0;
-    }
-    
-    // Get entry information
-    const char *name = archive_entry_pathname(archive_entry);
-    const struct stat *stat = archive_entry_stat(archive_entry);
-        
-    // Read magic
-    uint32_t magic = 0;
-    archive_read_data(archive, &magic, sizeof(uint32_t));
-    
-    // SCE magic
-    if (magic == 0x00454353) {
-      char sce_header[0x84];
-      archive_read_data(archive, sce_header, sizeof(sce_header));
-
-      uint64_t elf1_offset = *(uint64_t *)(sce_header + 0x3C);
-      uint64_t phdr_offset = *(uint64_t *)(sce_header + 0x44);
-      uint64_t section_info_offset = *(uint64_t *)(sce_header + 0x54);
-
-      // jump to elf1
-      // Until here we have read 0x88 bytes
-      int i;
-      for (i = 0; i < elf1_offset - 0x88; i += sizeof(uint32_t)) {
-        uint32_t dummy = 0;
-        archive_read_data(archive, &dummy, sizeof(uint32_t));
-      }
+  while (parent && *p) {
+    char *slash = strchr(p, '/');
+    if (slash)
+      *slash = '\0';
 
-      // Check imports
-      char *buffer = malloc(stat->st_size);
-      if (buffer) {
-        archive_read_data(archive, buffer, stat->st_size);
-
-        Elf32_Ehdr *elf1 = (Elf32_Ehdr*)buffer;
-        Elf32_Phdr *phdr = (Elf32_Phdr*)(buffer + phdr_offset - elf1_offset);
-        segment_info *info = (segment_info*)(buffer + section_info_offset - elf1_offset);
-
-        // segment is elf2 section
-        char *segment = buffer + info->offset - elf1_offset;
-
-        // zlib compress magic
-        char *uncompressed_buffer = NULL;
-        if (segment[0] == 0x78) {
-          // uncompressedBuffer will return elf2 section
-          uncompressed_buffer = uncompressBuffer(elf1, phdr, info, segment);
-          if (uncompressed_buffer) {
-            segment = uncompressed_buffer;
-          }
-        }
+    ArchiveFileNode *node = findArchiveChild(parent, p, slash != NULL);
 
-        int unsafe = checkForUnsafeImports(segment);
+    if (!node) {
+      node = createArchiveNode(parent, p, strlen(p));
+      if (!node)
+        return;
 
-        if (uncompressed_buffer)
-          free(uncompressed_buffer);
-        free(buffer);
+      setArchiveNodeStat(node, stat);
 
-        if (unsafe) {
-          archive_read_free(archive);
-          return unsafe;
-        }
+      // Folders that only appear in the path of an entry
+      if (slash) {
+        node->mode = SCE_S_IFDIR;
+        node->size = 0;
       }
+    }
 
-      // Check authid flag
-      uint64_t authid = *(uint64_t *)(sce_header + 0x7C);
-      if (authid != 0x2F00000000000002) {
-        archive_read_free(archive);
-        return 1; // Unsafe
-      }
+    if (!slash) {
+      setArchiveNodeStat(node, stat);
+      node->offset = offset;
+      return;
     }
+
+    parent = node;
+    p = slash + 1;
   }
+}
 
-  archive_read_free(archive);
-  return 0;
+// The order of fileListAddEntry with SORT_BY_NAME: folders first, then by
+// natural name order, and equal names in the order they were added
+static int compareArchiveNodes(ArchiveFileNode *a, ArchiveFileNode *b) {
+  int a_folder = SCE_S_ISDIR(a->mode) ? 1 : 0;
+  int b_folder = SCE_S_ISDIR(b->mode) ? 1 : 0;
+
+  if (a_folder != b_folder)
+    return b_folder - a_folder;
+
+  return strnatcasecmp(a->name, b->name);
 }
 
-int fileListGetArchiveEntries(FileList *list, const char *path, int sort) {
-  if (is_psarc)
-    return fileListGetPsarcEntries(list, path, sort);
-  
-  int res;
+static ArchiveFileNode *mergeArchiveNodes(ArchiveFileNode *list, int length) {
+  if (length <= 1) {
+    if (list)
+      list->next = NULL;
+    return list;
+  }
 
-  if (!list)
-    return VITASHELL_ERROR_ILLEGAL_ADDR;
+  int half = length / 2;
 
-  FileListEntry *entry = malloc(sizeof(FileListEntry));
+  ArchiveFileNode *right = list;
+  int i;
+  for (i = 0; i < half; i++)
+    right = right->next;
+
+  list = mergeArchiveNodes(list, half);
+  right = mergeArchiveNodes(right, length - half);
+
+  ArchiveFileNode *head = NULL, **tail = &head;
+
+  while (list && right) {
+    if (compareArchiveNodes(list, right) <= 0) {
+      *tail = list;
+      list = list->next;
+    } else {
+      *tail = right;
+      right = right->next;
+    }
+
+    tail = &(*tail)->next;
+  }
+
+  *tail = list ? list : right;
+
+  return head;
+}
+
+static void sortArchiveNodes(ArchiveFileNode *node) {
+  // Restore the order the children were added in
+  ArchiveFileNode *list = NULL;
+  int length = 0;
+
+  ArchiveFileNode *curr = node->child;
+  while (curr) {
+    ArchiveFileNode *next = curr->next;
+    curr->next = list;
+    list = curr;
+    length++;
+    curr = next;
+  }
+
+  node->child = mergeArchiveNodes(list, length);
+
+  curr = node->child;
+  while (curr) {
+    if (SCE_S_ISDIR(curr->mode))
+      sortArchiveNodes(curr);
+
+    curr = curr->next;
+  }
+}
+
+void freeArchiveNodes() {
+  while (archive_arena) {
+    ArchiveArenaBlock *next = archive_arena->next;
+    free(archive_arena);
+    archive_arena = next;
+  }
+
+  free(archive_buckets);
+  archive_buckets = NULL;
+  archive_n_buckets = 0;
+  archive_n_nodes = 0;
+
+  archive_root = NULL;
+}
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t archive_size;
+  SceDateTime archive_mtime;
+  uint32_t need_password;
+  uint32_t path_length;
+} ArchiveCacheHeader;
+
+typedef struct {
+  uint32_t mode;
+  uint32_t n_children;
+  int64_t size;
+  uint64_t ctime;
+  uint64_t mtime;
+  uint64_t atime;
+  int64_t offset;
+  uint16_t name_length;
+} __attribute__((packed)) ArchiveCacheNode;
+
+typedef struct {
+  uint8_t *data;
+  int size;
+  int capacity;
+} ArchiveCacheBuffer;
+
+typedef struct {
+  char name[32];
+  SceOff size;
+  uint64_t used;
+} ArchiveCacheFile;
+
+static void getArchiveCachePath(char *cache_path, const char *file, const char *ext) {
+  uint64_t hash = 14695981039346656037ULL;
+
+  while (*file) {
+    hash = (hash ^ (uint8_t)tolower(*file++)) * 1099511628211ULL;
+  }
+
+  snprintf(cache_path, MAX_PATH_LENGTH, "%s/%016llX.%s", ARCHIVE_CACHE_PATH, hash, ext);
+}
+
+static int archiveCacheAppend(ArchiveCacheBuffer *buffer, const void *data, int size) {
+  if (buffer->size + size > buffer->capacity) {
+    int capacity = buffer->capacity ? buffer->capacity * 2 : 64 * 1024;
+    while (capacity < buffer->size + size)
+      capacity *= 2;
+
+    uint8_t *new_data = realloc(buffer->data, capacity);
+    if (!new_data)
+      return VITASHELL_ERROR_NO_MEMORY;
+
+    buffer->data = new_data;
+    buffer->capacity = capacity;
+  }
+
+  memcpy(buffer->data + buffer->size, data, size);
+  buffer->size += size;
+
+  return 0;
+}
+
+// Nodes are stored in pre-order, each followed by its children
+static int archiveCacheWriteNode(ArchiveCacheBuffer *buffer, ArchiveFileNode *node) {
+  ArchiveCacheNode cache_node;
+  memset(&cache_node, 0, sizeof(ArchiveCacheNode));
+
+  ArchiveFileNode *curr = node->child;
+  while (curr) {
+    cache_node.n_children++;
+    curr = curr->next;
+  }
+
+  cache_node.mode = node->mode;
+  cache_node.size = node->size;
+  cache_node.ctime = node->ctime;
+  cache_node.mtime = node->mtime;
+  cache_node.atime = node->atime;
+  cache_node.offset = node->offset;
+  cache_node.name_length = strlen(node->name);
+
+  if (archiveCacheAppend(buffer, &cache_node, sizeof(ArchiveCacheNode)) < 0 ||
+      archiveCacheAppend(buffer, node->name, cache_node.name_length) < 0)
+    return VITASHELL_ERROR_NO_MEMORY;
+
+  curr = node->child;
+  while (curr) {
+    int res = archiveCacheWriteNode(buffer, curr);
+    if (res < 0)
+      return res;
+
+    curr = curr->next;
+  }
+
+  return 0;
+}
+
+// Children are stored sorted and are read back in the same order
+static ArchiveFileNode *archiveCacheReadNode(ArchiveFileNode *parent, uint8_t **p, uint8_t *end) {
+  if (*p + sizeof(ArchiveCacheNode) > end)
+    return NULL;
+
+  ArchiveCacheNode *cache_node = (ArchiveCacheNode *)*p;
+  *p += sizeof(ArchiveCacheNode);
+
+  if (*p + cache_node->name_length > end || cache_node->name_length >= MAX_NAME_LENGTH)
+    return NULL;
+
+  ArchiveFileNode *node = createArchiveNode(parent, (char *)*p, cache_node->name_length);
+  if (!node)
+    return NULL;
+
+  *p += cache_node->name_length;
+
+  node->mode = cache_node->mode;
+  node->size = cache_node->size;
+  node->ctime = cache_node->ctime;
+  node->mtime = cache_node->mtime;
+  node->atime = cache_node->atime;
+  node->offset = cache_node->offset;
+
+  uint32_t i;
+  for (i = 0; i < cache_node->n_children; i++) {
+    if (!archiveCacheReadNode(node, p, end))
+      return NULL;
+  }
+
+  // Undo the prepending of createArchiveNode
+  ArchiveFileNode *list = NULL;
+  ArchiveFileNode *curr = node->child;
+  while (curr) {
+    ArchiveFileNode *next = curr->next;
+    curr->next = list;
+    list = curr;
+    curr = next;
+  }
+
+  node->child = list;
+
+  return node;
+}
+
+// The modification time tells when a cache file was used last
+static void archiveCacheTouch(const char *cache_path) {
+  SceIoStat stat;
+  memset(&stat, 0, sizeof(SceIoStat));
+  sceRtcGetCurrentClock(&stat.st_mtime, 0);
+  sceIoChstat(cache_path, &stat, SCE_CST_MT);
+}
+
+static int archiveCacheLoad(const char *file, SceIoStat *archive_stat) {
+  char cache_path[MAX_PATH_LENGTH];
+  getArchiveCachePath(cache_path, file, "bin");
+
+  void *buffer = NULL;
+  int size = allocateReadFile(cache_path, &buffer);
+  if (size < 0)
+    return size;
+
+  uint8_t *p = buffer;
+  uint8_t *end = p + size;
+
+  // The cache is only valid for the same archive in the same state
+  ArchiveCacheHeader *header = buffer;
+  if (size < sizeof(ArchiveCacheHeader) ||
+      header->magic != ARCHIVE_CACHE_MAGIC ||
+      header->version != ARCHIVE_CACHE_VERSION ||
+      header->archive_size != archive_stat->st_size ||
+      memcmp(&header->archive_mtime, &archive_stat->st_mtime, sizeof(SceDateTime)) != 0 ||
+      header->path_length != strlen(file) ||
+      size < sizeof(ArchiveCacheHeader) + header->path_length ||
+      strncmp((char *)p + sizeof(ArchiveCacheHeader), file, header->path_length) != 0) {
+    free(buffer);
+    return VITASHELL_ERROR_NOT_FOUND;
+  }
+
+  p += sizeof(ArchiveCacheHeader) + header->path_length;
+
+  ArchiveFileNode *root = archiveCacheReadNode(NULL, &p, end);
+  if (!root) {
+    freeArchiveNodes();
+    free(buffer);
+    sceIoRemove(cache_path);
+    return VITASHELL_ERROR_INVALID_MAGIC;
+  }
+
+  archive_root = root;
+  need_password = header->need_password;
+
+  free(buffer);
+
+  archiveCacheTouch(cache_path);
+
+  return 0;
+}
+
+// The header identifies the archive state a cache file was built for
+static int archiveCacheAppendHeader(ArchiveCacheBuffer *buffer, const char *file, SceIoStat *archive_stat) {
+  ArchiveCacheHeader header;
+  memset(&header, 0, sizeof(ArchiveCacheHeader));
+  header.magic = ARCHIVE_CACHE_MAGIC;
+  header.version = ARCHIVE_CACHE_VERSION;
+  header.archive_size = archive_stat->st_size;
+  memcpy(&header.archive_mtime, &archive_stat->st_mtime, sizeof(SceDateTime));
+  header.path_length = strlen(file);
+
+  int res = archiveCacheAppend(buffer, &header, sizeof(ArchiveCacheHeader));
+  if (res < 0)
+    return res;
+
+  return archiveCacheAppend(buffer, file, header.path_length);
+}
+
+static int archiveCacheSave(const char *file, SceIoStat *archive_stat) {
+  char cache_path[MAX_PATH_LENGTH];
+  getArchiveCachePath(cache_path, file, "bin");
+
+  ArchiveCacheBuffer buffer;
+  memset(&buffer, 0, sizeof(ArchiveCacheBuffer));
+
+  int res;
+  if ((res = archiveCacheAppendHeader(&buffer, file, archive_stat)) < 0 ||
+      (res = archiveCacheWriteNode(&buffer, archive_root)) < 0) {
+    free(buffer.data);
+    return res;
+  }
+
+  ((ArchiveCacheHeader *)buffer.data)->need_password = need_password;
+
+  res = WriteFile(cache_path, buffer.data, buffer.size);
+  if (res >= 0 && res != buffer.size)
+    res = VITASHELL_ERROR_NO_SPACE;
+
+  if (res < 0)
+    sceIoRemove(cache_path);
+
+  free(buffer.data);
+  return res < 0 ? res : 0;
+}
+
+// Removes the least recently used cache files until the cache fits into
+// ARCHIVE_CACHE_MAX_FILES and ARCHIVE_CACHE_MAX_SIZE. This also gets rid
+// of the caches of archives that were deleted or changed
+static void pruneArchiveCache() {
+  SceUID dfd = sceIoDopen(ARCHIVE_CACHE_PATH);
+  if (dfd < 0)
+    return;
+
+  ArchiveCacheFile *files = NULL;
+  int count = 0, max = 0;
+  uint64_t size = 0;
+  int res = 0;
+
+  do {
+    SceIoDirent dir;
+    memset(&dir, 0, sizeof(SceIoDirent));
+
+    res = sceIoDread(dfd, &dir);
+    if (res > 0 && !SCE_S_ISDIR(dir.d_stat.st_mode) && strlen(dir.d_name) < sizeof(files->name)) {
+      if (count == max) {
+        int new_max = max ? max * 2 : ARCHIVE_CACHE_MAX_FILES;
+        ArchiveCacheFile *new_files = realloc(files, new_max * sizeof(ArchiveCacheFile));
+        if (!new_files)
+          break;
+
+        files = new_files;
+        max = new_max;
+      }
+
+      ArchiveCacheFile *file = &files[count++];
+      strcpy(file->name, dir.d_name);
+      file->size = dir.d_stat.st_size;
+
+      SceRtcTick tick;
+      sceRtcGetTick(&dir.d_stat.st_mtime, &tick);
+      file->used = tick.tick;
+
+      size += file->size;
+    }
+  } while (res > 0);
+
+  sceIoDclose(dfd);
+
+  while (count > ARCHIVE_CACHE_MAX_FILES || (count > 0 && size > ARCHIVE_CACHE_MAX_SIZE)) {
+    int i, oldest = 0;
+    for (i = 1; i < count; i++) {
+      if (files[i].used < files[oldest].used)
+        oldest = i;
+    }
+
+    char path[MAX_PATH_LENGTH];
+    snprintf(path, MAX_PATH_LENGTH, "%s/%s", ARCHIVE_CACHE_PATH, files[oldest].name);
+    sceIoRemove(path);
+
+    size -= files[oldest].size;
+    files[oldest] = files[--count];
+  }
+
+  free(files);
+}
+
+// Seek checkpoints of gzip archives are stored next to the listing
+static int archiveGzIndexLoadSave(const char *file, SceIoStat *archive_stat, int save) {
+  char cache_path[MAX_PATH_LENGTH];
+  getArchiveCachePath(cache_path, file, "gzi");
+
+  ArchiveCacheBuffer key;
+  memset(&key, 0, sizeof(ArchiveCacheBuffer));
+
+  int res = archiveCacheAppendHeader(&key, file, archive_stat);
+  if (res >= 0) {
+    if (save)
+      res = gzIndexSave(&gz_index, cache_path, key.data, key.size);
+    else if ((res = gzIndexLoad(&gz_index, cache_path, key.data, key.size)) >= 0)
+      archiveCacheTouch(cache_path);
+  }
+
+  free(key.data);
+  return res;
+}
+
+void archiveSetUnsafeHandler(ArchiveUnsafeHandler handler) {
+  unsafe_handler = handler;
+  unsafe_accepted = 0;
+  fselfScannerFree(&unsafe_scanner);
+}
+
+void archiveSetSkipIdentical(uint32_t *skipped) {
+  skip_identical = skipped;
+}
+
+// Ask again only if a module is worse than the ones accepted so far
+static int checkArchiveUnsafe(int unsafe) {
+  if (unsafe <= unsafe_accepted)
+    return 1;
+
+  if (!unsafe_handler(unsafe))
+    return 0;
+
+  unsafe_accepted = unsafe;
+  return 1;
+}
+
+int fileListGetArchiveEntries(FileList *list, const char *path, int sort) {
+  if (is_psarc)
+    return fileListGetPsarcEntries(list, path, sort);
+  
+  int res;
+
+  if (!list)
+    return VITASHELL_ERROR_ILLEGAL_ADDR;
+
+  FileListEntry *entry = malloc(sizeof(FileListEntry));
   if (entry) {
     entry->name_length = strlen(DIR_UP);
     entry->name = malloc(entry->name_length + 1);
@@ -523,6 +1255,9 @@ int fileListGetArchiveEntries(FileList *list, const char *path, int sort) {
     fileListAddEntry(list, entry, sort);
   }
   
+  // The children are already in the order of SORT_BY_NAME
+  int add_sort = sort == SORT_BY_NAME ? SORT_NONE : sort;
+
   // Traverse
   ArchiveFileNode *curr = findArchiveNode(path + archive_path_start);
   if (curr)
@@ -530,8 +1265,10 @@ int fileListGetArchiveEntries(FileList *list, const char *path, int sort) {
   while (curr) {
     FileListEntry *entry = malloc(sizeof(FileListEntry));
     if (entry) {
+      SceRtcTick tick;
+
       entry->is_symlink = 0;
-      entry->is_folder = SCE_S_ISDIR(curr->stat.st_mode);
+      entry->is_folder = SCE_S_ISDIR(curr->mode);
       if (entry->is_folder) {
         entry->name_length = strlen(curr->name) + 1;
         entry->name = malloc(entry->name_length + 1);
@@ -547,13 +1284,16 @@ int fileListGetArchiveEntries(FileList *list, const char *path, int sort) {
         list->files++;
       }
 
-      entry->size = curr->stat.st_size;
-      
-      memcpy(&entry->ctime, (SceDateTime *)&curr->stat.st_ctime, sizeof(SceDateTime));
-      memcpy(&entry->mtime, (SceDateTime *)&curr->stat.st_mtime, sizeof(SceDateTime));
-      memcpy(&entry->atime, (SceDateTime *)&curr->stat.st_atime, sizeof(SceDateTime));
-      
-      fileListAddEntry(list, entry, sort);
+      entry->size = curr->size;
+
+      tick.tick = curr->ctime;
+      sceRtcSetTick(&entry->ctime, &tick);
+      tick.tick = curr->mtime;
+      sceRtcSetTick(&entry->mtime, &tick);
+      tick.tick = curr->atime;
+      sceRtcSetTick(&entry->atime, &tick);
+
+      fileListAddEntry(list, entry, add_sort);
     }
     
     // Get next entry in this directory
@@ -603,170 +1343,1026 @@ int getArchivePathInfo(const char *path, uint64_t *size, uint32_t *folders,
         if (size)
           (*size) += entry->size;
 
-        if (files)
-          (*files)++;
-      }
+        if (files)
+          (*files)++;
+      }
+
+      free(new_path);
+    }
+
+    if (folders)
+      (*folders)++;
+
+    fileListEmpty(&list);
+  } else {
+    if (handler && handler(path))
+      return 1;
+    
+    if (size)
+      (*size) += stat.st_size;
+
+    if (files)
+      (*files)++;
+  }
+
+  return 1;
+}
+
+typedef struct {
+  char src_path[MAX_PATH_LENGTH]; // Path inside the archive without end slash, empty for the root
+  int src_length;
+  char dst_path[MAX_PATH_LENGTH];
+  int is_folder;
+} ArchiveExtractTarget;
+
+static int extractArchiveFolders(ArchiveFileNode *node, const char *dst_path, FileProcessParam *param) {
+  int res = sceIoMkdir(dst_path, 0777);
+  if (res < 0 && res != SCE_ERROR_ERRNO_EEXIST)
+    return res;
+
+  if (param) {
+    if (param->value)
+      (*param->value) += DIRECTORY_SIZE;
+
+    if (param->SetProgress)
+      param->SetProgress(param->value ? *param->value : 0, param->max);
+
+    if (param->cancelHandler && param->cancelHandler())
+      return 0;
+  }
+
+  ArchiveFileNode *curr = node->child;
+  while (curr) {
+    if (SCE_S_ISDIR(curr->mode)) {
+      char *new_dst_path = malloc(strlen(dst_path) + strlen(curr->name) + 2);
+      snprintf(new_dst_path, MAX_PATH_LENGTH, "%s%s%s", dst_path, hasEndSlash(dst_path) ? "" : "/", curr->name);
+
+      int ret = extractArchiveFolders(curr, new_dst_path, param);
+
+      free(new_dst_path);
+
+      if (ret <= 0)
+        return ret;
+    }
+
+    curr = curr->next;
+  }
+
+  return 1;
+}
+
+static int getFileCrc32(const char *path, uint32_t *crc) {
+  SceUID fd = sceIoOpen(path, SCE_O_RDONLY, 0);
+  if (fd < 0)
+    return fd;
+
+  uint8_t *buf = memalign(4096, TRANSFER_SIZE);
+  if (!buf) {
+    sceIoClose(fd);
+    return VITASHELL_ERROR_NO_MEMORY;
+  }
+
+  uLong value = crc32(0L, Z_NULL, 0);
+  int read;
+
+  while ((read = sceIoRead(fd, buf, TRANSFER_SIZE)) > 0)
+    value = crc32(value, buf, read);
+
+  free(buf);
+  sceIoClose(fd);
+
+  if (read < 0)
+    return read;
+
+  *crc = (uint32_t)value;
+  return 0;
+}
+
+// ZIP entries are compared by their CRC32, which costs a read of the
+// existing file but no inflating. Other entries are compared by the
+// modification time that extraction gives to the files.
+static int isArchiveEntryIdentical(const char *name, const char *dst_path) {
+  SceIoStat stat;
+  memset(&stat, 0, sizeof(SceIoStat));
+
+  if (sceIoGetstat(dst_path, &stat) < 0 || SCE_S_ISDIR(stat.st_mode))
+    return 0;
+
+  ZipIndexEntry *entry = zipIndexFind(&zip_index, name);
+  if (entry) {
+    uint32_t crc = 0;
+    return stat.st_size == entry->uncompressed_size &&
+           getFileCrc32(dst_path, &crc) >= 0 && crc == entry->crc;
+  }
+
+  ArchiveFileNode *node = findArchiveNode(name);
+  if (!node || stat.st_size != node->size)
+    return 0;
+
+  SceRtcTick tick;
+  sceRtcGetTick(&stat.st_mtime, &tick);
+
+  int64_t diff = (int64_t)(tick.tick - node->mtime);
+  return diff > -ARCHIVE_MTIME_TOLERANCE && diff < ARCHIVE_MTIME_TOLERANCE;
+}
+
+static int skipArchiveEntry(uint64_t size, FileProcessParam *param) {
+  (*skip_identical)++;
+
+  if (param) {
+    if (param->value)
+      (*param->value) += size;
+
+    if (param->SetProgress)
+      param->SetProgress(param->value ? *param->value : 0, param->max);
+
+    if (param->cancelHandler && param->cancelHandler())
+      return 0;
+  }
+
+  return 1;
+}
+
+typedef struct {
+  SceUID fd;
+  uint8_t *buffer;
+  int buffered;
+  int64_t buffer_offset; // File offset of the buffer start
+} ArchiveExtractWriter;
+
+static int flushArchiveExtractWriter(ArchiveExtractWriter *writer) {
+  if (writer->buffered == 0)
+    return 0;
+
+  int written = sceIoWrite(writer->fd, writer->buffer, writer->buffered);
+  if (written < 0)
+    return written;
+
+  writer->buffer_offset += writer->buffered;
+  writer->buffered = 0;
+
+  return 0;
+}
+
+// Small blocks are gathered up to the next TRANSFER_SIZE boundary of the
+// file, blocks that start at a boundary are written without a copy
+static int writeArchiveExtractBlock(ArchiveExtractWriter *writer, const uint8_t *data, size_t size) {
+  while (size > 0) {
+    int64_t position = writer->buffer_offset + writer->buffered;
+
+    if (writer->buffered == 0 && (position % TRANSFER_SIZE) == 0 && size >= TRANSFER_SIZE) {
+      int length = size & ~(TRANSFER_SIZE - 1);
+      int written = sceIoWrite(writer->fd, data, length);
+      if (written < 0)
+        return written;
+
+      writer->buffer_offset += length;
+      data += length;
+      size -= length;
+      continue;
+    }
+
+    int length = TRANSFER_SIZE - (writer->buffer_offset % TRANSFER_SIZE) - writer->buffered;
+    if (length > size)
+      length = size;
+
+    memcpy(writer->buffer + writer->buffered, data, length);
+    writer->buffered += length;
+    data += length;
+    size -= length;
+
+    if (((writer->buffer_offset + writer->buffered) % TRANSFER_SIZE) == 0) {
+      int res = flushArchiveExtractWriter(writer);
+      if (res < 0)
+        return res;
+    }
+  }
+
+  return 0;
+}
+
+// Skip a sparse region, the file system fills it with zeros
+static int seekArchiveExtractWriter(ArchiveExtractWriter *writer, int64_t offset) {
+  int res = flushArchiveExtractWriter(writer);
+  if (res < 0)
+    return res;
+
+  if (sceIoLseek(writer->fd, offset, SCE_SEEK_SET) < 0)
+    return VITASHELL_ERROR_INTERNAL;
+
+  writer->buffer_offset = offset;
+
+  return 0;
+}
+
+static int extractArchiveEntry(struct archive *archive, struct archive_entry *archive_entry,
+                               const char *dst_path, FileProcessParam *param) {
+  ArchiveExtractWriter writer;
+  memset(&writer, 0, sizeof(ArchiveExtractWriter));
+
+  writer.fd = sceIoOpen(dst_path, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0777);
+  if (writer.fd < 0)
+    return writer.fd;
+
+  writer.buffer = memalign(4096, TRANSFER_SIZE);
+  if (!writer.buffer) {
+    sceIoClose(writer.fd);
+    sceIoRemove(dst_path);
+    return VITASHELL_ERROR_NO_MEMORY;
+  }
+
+  if (unsafe_handler) {
+    fselfScannerFree(&unsafe_scanner);
+    fselfScannerInit(&unsafe_scanner, archive_entry_size(archive_entry));
+  }
+
+  int res = 1;
+
+  while (1) {
+    const void *block;
+    size_t size;
+    la_int64_t offset;
+
+    int ret = archive_read_data_block(archive, &block, &size, &offset);
+    if (ret == ARCHIVE_EOF)
+      break;
+
+    if (ret < ARCHIVE_OK) {
+      res = ret;
+      break;
+    }
+
+    // The skipped bytes are part of the size given to the progress
+    uint64_t hole = 0;
+    int64_t position = writer.buffer_offset + writer.buffered;
+
+    if (offset > position) {
+      hole = offset - position;
+
+      ret = seekArchiveExtractWriter(&writer, offset);
+      if (ret < 0) {
+        res = ret;
+        break;
+      }
+    }
+
+    if (unsafe_handler)
+      fselfScannerUpdate(&unsafe_scanner, offset, block, size);
+
+    ret = writeArchiveExtractBlock(&writer, block, size);
+    if (ret < 0) {
+      res = ret;
+      break;
+    }
+
+    if (param) {
+      if (param->value)
+        (*param->value) += hole + size;
+
+      if (param->SetProgress)
+        param->SetProgress(param->value ? *param->value : 0, param->max);
+
+      if (param->cancelHandler && param->cancelHandler()) {
+        res = 0;
+        break;
+      }
+    }
+  }
+
+  if (res > 0) {
+    int ret = flushArchiveExtractWriter(&writer);
+
+    // A sparse region at the end has no block, write its last byte
+    int64_t size = archive_entry_size(archive_entry);
+    if (ret >= 0 && size > writer.buffer_offset) {
+      uint8_t zero = 0;
+
+      if (param && param->value)
+        (*param->value) += size - writer.buffer_offset;
+
+      ret = seekArchiveExtractWriter(&writer, size - 1);
+      if (ret >= 0)
+        ret = writeArchiveExtractBlock(&writer, &zero, 1);
+      if (ret >= 0)
+        ret = flushArchiveExtractWriter(&writer);
+    }
+
+    if (ret < 0)
+      res = ret;
+  }
+
+  // Keep the time of the entry, so that the file is known to be identical
+  if (res > 0) {
+    ArchiveFileNode *node = findArchiveNode(archive_entry_pathname(archive_entry));
+    if (node) {
+      SceIoStat stat;
+      memset(&stat, 0, sizeof(SceIoStat));
+      getArchiveNodeStat(node, &stat);
+      sceIoChstatByFd(writer.fd, &stat, SCE_CST_MT);
+    }
+  }
+
+  free(writer.buffer);
+  sceIoClose(writer.fd);
+
+  if (unsafe_handler) {
+    if (res > 0 && !checkArchiveUnsafe(fselfScannerFinish(&unsafe_scanner)))
+      res = 0;
+
+    fselfScannerFree(&unsafe_scanner);
+  }
+
+  if (res <= 0) {
+    sceIoRemove(dst_path);
+    return res;
+  }
+
+  if (param && param->items)
+    (*param->items)++;
+
+  return 1;
+}
+
+// Find the target an entry belongs to and build its destination path
+static int getArchiveExtractPath(ArchiveExtractTarget *targets, int count, const char *name, char *dst_path) {
+  int i;
+  for (i = 0; i < count; i++) {
+    ArchiveExtractTarget *target = &targets[i];
+
+    if (!target->is_folder) {
+      if (strcasecmp(name, target->src_path) == 0) {
+        strcpy(dst_path, target->dst_path);
+        return 1;
+      }
+    } else if (target->src_length == 0) {
+      snprintf(dst_path, MAX_PATH_LENGTH, "%s%s%s", target->dst_path,
+               hasEndSlash(target->dst_path) ? "" : "/", name);
+      return 1;
+    } else if (strncasecmp(name, target->src_path, target->src_length) == 0 &&
+               name[target->src_length] == '/') {
+      snprintf(dst_path, MAX_PATH_LENGTH, "%s%s%s", target->dst_path,
+               hasEndSlash(target->dst_path) ? "" : "/", name + target->src_length + 1);
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+typedef struct {
+  ArchiveExtractTarget *targets;
+  int count;
+} ArchiveExtractTargets;
+
+static int getZipExtractPath(ZipIndexEntry *entry, char *dst_path, void *argp) {
+  ArchiveExtractTargets *list = (ArchiveExtractTargets *)argp;
+  return getArchiveExtractPath(list->targets, list->count, entry->name, dst_path) ? 0 : VITASHELL_ERROR_NOT_FOUND;
+}
+
+static int checkZipExtractData(ZipIndexEntry *entry, uint64_t offset, const void *data, int size, void *argp) {
+  if (offset == 0) {
+    fselfScannerFree(&unsafe_scanner);
+    fselfScannerInit(&unsafe_scanner, entry->uncompressed_size);
+  }
+
+  if (size > 0) {
+    fselfScannerUpdate(&unsafe_scanner, offset, data, size);
+    return 1;
+  }
+
+  return checkArchiveUnsafe(fselfScannerFinish(&unsafe_scanner));
+}
+
+// Entries of a ZIP are compressed independently, so they can be inflated
+// by several threads at once. Returns VITASHELL_ERROR_INVALID_TYPE if an
+// entry can only be read by libarchive.
+static int extractZipTargets(ArchiveExtractTarget *targets, int count, FileProcessParam *param) {
+  char dst_path[MAX_PATH_LENGTH];
+
+  ZipIndexEntry **entries = malloc(zip_index.count * sizeof(ZipIndexEntry *));
+  if (!entries)
+    return VITASHELL_ERROR_NO_MEMORY;
+
+  int n_entries = 0;
+
+  // Central directory order is the order of the data in most archives
+  int i;
+  for (i = 0; i < zip_index.count; i++) {
+    ZipIndexEntry *entry = &zip_index.entries[i];
+
+    if (!getArchiveExtractPath(targets, count, entry->name, dst_path))
+      continue;
+
+    if (!zipIndexEntrySupported(entry)) {
+      free(entries);
+      return VITASHELL_ERROR_INVALID_TYPE;
+    }
+
+    entries[n_entries++] = entry;
+  }
+
+  // Leave out the files that are already there
+  if (skip_identical) {
+    int n_changed = 0;
+
+    for (i = 0; i < n_entries; i++) {
+      ZipIndexEntry *entry = entries[i];
+      getArchiveExtractPath(targets, count, entry->name, dst_path);
+
+      if (!isArchiveEntryIdentical(entry->name, dst_path)) {
+        entries[n_changed++] = entry;
+        continue;
+      }
+
+      if (!skipArchiveEntry(entry->uncompressed_size, param)) {
+        free(entries);
+        return 0;
+      }
+    }
+
+    n_entries = n_changed;
+  }
+
+  ArchiveExtractTargets list = { targets, count };
+
+  ZipExtractHandler handler;
+  handler.getPath = getZipExtractPath;
+  handler.checkData = unsafe_handler ? checkZipExtractData : NULL;
+  handler.argp = &list;
+
+  int res = zipExtractEntries(&zip_index, entries, n_entries, ZIP_EXTRACT_WORKERS, &handler, param);
+
+  fselfScannerFree(&unsafe_scanner);
+
+  free(entries);
+  return res;
+}
+
+// Extract all targets in a single pass over the archive headers. Solid
+// archives are decompressed only once, no matter how many files are wanted.
+static int extractArchiveTargets(ArchiveExtractTarget *targets, int count, FileProcessParam *param) {
+  int i;
+
+  // Create the folders first, so that files can be written as they come
+  for (i = 0; i < count; i++) {
+    if (!targets[i].is_folder)
+      continue;
+
+    ArchiveFileNode *node = findArchiveNode(targets[i].src_path);
+    if (!node)
+      return VITASHELL_ERROR_NOT_FOUND;
+
+    int ret = extractArchiveFolders(node, targets[i].dst_path, param);
+    if (ret <= 0)
+      return ret;
+  }
+
+  if (zip_index.count > 0) {
+    int res = extractZipTargets(targets, count, param);
+    if (res != VITASHELL_ERROR_INVALID_TYPE)
+      return res;
+  }
+
+  struct archive *archive = open_archive_at(archive_depth, 0, 0);
+  if (!archive)
+    return -1;
+
+  char dst_path[MAX_PATH_LENGTH];
+
+  while (1) {
+    struct archive_entry *archive_entry;
+    int res = archive_read_next_header(archive, &archive_entry);
+    if (res == ARCHIVE_EOF)
+      break;
+
+    if (res != ARCHIVE_OK) {
+      archive_read_free(archive);
+      return -1;
+    }
+
+    if (convert_stat_mode(archive_entry_mode(archive_entry)) & SCE_S_IFDIR)
+      continue;
+
+    const char *name = archive_entry_pathname(archive_entry);
+    if (!getArchiveExtractPath(targets, count, name, dst_path))
+      continue;
+
+    // The data of a skipped entry is passed over by the next header
+    if (skip_identical && isArchiveEntryIdentical(name, dst_path)) {
+      if (!skipArchiveEntry(archive_entry_size(archive_entry), param)) {
+        archive_read_free(archive);
+        return 0;
+      }
+
+      continue;
+    }
+
+    int ret = extractArchiveEntry(archive, archive_entry, dst_path, param);
+    if (ret <= 0) {
+      archive_read_free(archive);
+      return ret;
+    }
+  }
+
+  archive_read_free(archive);
+  return 1;
+}
+
+static int setArchiveExtractTarget(ArchiveExtractTarget *target, const char *src_path, const char *dst_path) {
+  SceIoStat stat;
+  memset(&stat, 0, sizeof(SceIoStat));
+
+  int res = archiveFileGetstat(src_path, &stat);
+  if (res < 0)
+    return res;
+
+  strcpy(target->src_path, src_path + archive_path_start);
+  removeEndSlash(target->src_path);
+  target->src_length = strlen(target->src_path);
+  strcpy(target->dst_path, dst_path);
+  target->is_folder = SCE_S_ISDIR(stat.st_mode);
+
+  return 0;
+}
+
+int extractArchivePath(const char *src_path, const char *dst_path, FileProcessParam *param) {
+  if (is_psarc)
+    return extractPsarcPath(src_path, dst_path, param);
+
+  ArchiveExtractTarget target;
+  int res = setArchiveExtractTarget(&target, src_path, dst_path);
+  if (res < 0)
+    return res;
+
+  return extractArchiveTargets(&target, 1, param);
+}
+
+int extractArchiveEntries(FileList *list, const char *dst_path, FileProcessParam *param) {
+  char src_path[MAX_PATH_LENGTH], new_dst_path[MAX_PATH_LENGTH];
+
+  FileListEntry *entry = list->head;
+
+  if (is_psarc) {
+    while (entry) {
+      snprintf(src_path, MAX_PATH_LENGTH, "%s%s", list->path, entry->name);
+      snprintf(new_dst_path, MAX_PATH_LENGTH, "%s%s", dst_path, entry->name);
+
+      int res = extractPsarcPath(src_path, new_dst_path, param);
+      if (res <= 0)
+        return res;
+
+      entry = entry->next;
+    }
+
+    return 1;
+  }
+
+  ArchiveExtractTarget *targets = malloc(list->length * sizeof(ArchiveExtractTarget));
+  if (!targets)
+    return VITASHELL_ERROR_NO_MEMORY;
+
+  int count = 0;
+
+  while (entry) {
+    snprintf(src_path, MAX_PATH_LENGTH, "%s%s", list->path, entry->name);
+    snprintf(new_dst_path, MAX_PATH_LENGTH, "%s%s", dst_path, entry->name);
+
+    int res = setArchiveExtractTarget(&targets[count], src_path, new_dst_path);
+    if (res < 0) {
+      free(targets);
+      return res;
+    }
+
+    count++;
+    entry = entry->next;
+  }
+
+  int res = extractArchiveTargets(targets, count, param);
+
+  free(targets);
+  return res;
+}
+
+static uint64_t getArchiveNodeSize(ArchiveFileNode *node) {
+  uint64_t size = 0;
+
+  for (node = node->child; node; node = node->next) {
+    if (SCE_S_ISDIR(node->mode))
+      size += getArchiveNodeSize(node);
+    else
+      size += node->size;
+  }
+
+  return size;
+}
+
+uint64_t getArchiveSize() {
+  if (is_psarc)
+    return getPsarcSize();
+
+  return archive_root ? getArchiveNodeSize(archive_root) : 0;
+}
+
+static int getZipTestPath(ZipIndexEntry *entry, char *dst_path, void *argp) {
+  snprintf((char *)argp, MAX_PATH_LENGTH, "%s", entry->name);
+  dst_path[0] = '\0';
+  return 0;
+}
+
+// The CRCs of ZIP entries are checked as they are inflated by the workers
+static int testZipEntries(char *failed, FileProcessParam *param) {
+  ZipIndexEntry **entries = malloc(zip_index.count * sizeof(ZipIndexEntry *));
+  if (!entries)
+    return VITASHELL_ERROR_NO_MEMORY;
+
+  int i;
+  for (i = 0; i < zip_index.count; i++) {
+    if (!zipIndexEntrySupported(&zip_index.entries[i])) {
+      free(entries);
+      return VITASHELL_ERROR_INVALID_TYPE;
+    }
+
+    entries[i] = &zip_index.entries[i];
+  }
+
+  ZipExtractHandler handler;
+  handler.getPath = getZipTestPath;
+  handler.checkData = NULL;
+  handler.argp = failed;
+
+  int res = zipExtractEntries(&zip_index, entries, zip_index.count, ZIP_EXTRACT_WORKERS, &handler, param);
+
+  free(entries);
+  return res;
+}
+
+// libarchive checks the CRCs the format has while the data is read, the
+// size is compared here. A sparse file may end without a block.
+static int testArchiveEntry(struct archive *archive, struct archive_entry *archive_entry, FileProcessParam *param) {
+  int64_t end = 0;
+
+  while (1) {
+    const void *block;
+    size_t size;
+    la_int64_t offset;
+
+    int ret = archive_read_data_block(archive, &block, &size, &offset);
+    if (ret == ARCHIVE_EOF)
+      break;
 
-      free(new_path);
-    }
+    if (ret < ARCHIVE_OK)
+      return ret;
 
-    if (folders)
-      (*folders)++;
+    if (offset + (int64_t)size > end)
+      end = offset + size;
 
-    fileListEmpty(&list);
-  } else {
-    if (handler && handler(path))
-      return 1;
-    
-    if (size)
-      (*size) += stat.st_size;
+    if (param) {
+      if (param->value)
+        (*param->value) += size;
 
-    if (files)
-      (*files)++;
+      if (param->SetProgress)
+        param->SetProgress(param->value ? *param->value : 0, param->max);
+
+      if (param->cancelHandler && param->cancelHandler())
+        return 0;
+    }
+  }
+
+  if (archive_entry_size_is_set(archive_entry)) {
+    int64_t size = archive_entry_size(archive_entry);
+    if (end > size || (end < size && archive_entry_sparse_count(archive_entry) == 0))
+      return VITASHELL_ERROR_INVALID_MAGIC;
   }
 
+  if (param && param->items)
+    (*param->items)++;
+
   return 1;
 }
 
-int extractArchiveFile(const char *src_path, const char *dst_path, FileProcessParam *param) {
-  SceUID fdsrc = archiveFileOpen(src_path, SCE_O_RDONLY, 0);
-  if (fdsrc < 0)
-    return fdsrc;
+int testArchive(char *failed, FileProcessParam *param) {
+  failed[0] = '\0';
 
-  SceUID fddst = sceIoOpen(dst_path, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0777);
-  if (fddst < 0) {
-    psarcFileClose(fdsrc);
-    return fddst;
+  if (is_psarc)
+    return testPsarc(failed, param);
+
+  if (zip_index.count > 0) {
+    int res = testZipEntries(failed, param);
+    if (res != VITASHELL_ERROR_INVALID_TYPE)
+      return res;
   }
 
-  void *buf = memalign(4096, TRANSFER_SIZE);
+  struct archive *archive = open_archive_at(archive_depth, 0, 0);
+  if (!archive)
+    return -1;
+
+  int res = 1;
 
   while (1) {
-    int read = archiveFileRead(fdsrc, buf, TRANSFER_SIZE);
+    struct archive_entry *archive_entry;
+    int ret = archive_read_next_header(archive, &archive_entry);
+    if (ret == ARCHIVE_EOF)
+      break;
 
-    if (read < 0) {
-      free(buf);
+    if (ret != ARCHIVE_OK) {
+      failed[0] = '\0';
+      res = ret < 0 ? ret : -1;
+      break;
+    }
 
-      sceIoClose(fddst);
-      archiveFileClose(fdsrc);
+    if (convert_stat_mode(archive_entry_mode(archive_entry)) & SCE_S_IFDIR)
+      continue;
 
-      sceIoRemove(dst_path);
+    const char *name = archive_entry_pathname(archive_entry);
+    snprintf(failed, MAX_PATH_LENGTH, "%s", name ? name : "");
 
-      return read;
+    res = testArchiveEntry(archive, archive_entry, param);
+    if (res <= 0)
+      break;
+  }
+
+  archive_read_free(archive);
+  return res;
+}
+
+// The entries are decoded by a thread and handed to the ZIP writer through
+// a ring of slots, so decompression and recompression overlap. The reader
+// stops at the first error, which ends the stream.
+
+enum ArchiveConvertSlotTypes {
+  ARCHIVE_CONVERT_HEADER,
+  ARCHIVE_CONVERT_DATA,
+  ARCHIVE_CONVERT_END,  // End of the entry
+  ARCHIVE_CONVERT_DONE, // End of the archive
+};
+
+typedef struct {
+  int type;
+  int size; // Size of the data, < 0 on error
+  int is_folder;
+  int64_t entry_size; // < 0 if unknown
+  SceDateTime mtime;
+  uint8_t *buffer; // Name of the entry for headers
+} ArchiveConvertSlot;
+
+typedef struct {
+  struct archive *archive;
+  volatile int stop;
+
+  ArchiveConvertSlot slots[ARCHIVE_CONVERT_SLOTS];
+  int n_write;
+  int n_read;
+  SceUID free_sema;
+  SceUID full_sema;
+} ArchiveConvertReader;
+
+static ArchiveConvertSlot *getArchiveConvertSlot(ArchiveConvertReader *reader) {
+  sceKernelWaitSema(reader->free_sema, 1, NULL);
+  if (reader->stop)
+    return NULL;
+
+  ArchiveConvertSlot *slot = &reader->slots[reader->n_write];
+  reader->n_write = (reader->n_write + 1) % ARCHIVE_CONVERT_SLOTS;
+  slot->size = 0;
+
+  return slot;
+}
+
+static int archiveConvertReaderThread(SceSize args, void *argp) {
+  ArchiveConvertReader *reader = *(ArchiveConvertReader **)argp;
+  ArchiveConvertSlot *slot;
+
+  while (1) {
+    struct archive_entry *archive_entry;
+    int res = archive_read_next_header(reader->archive, &archive_entry);
+
+    if (!(slot = getArchiveConvertSlot(reader)))
+      break;
+
+    if (res == ARCHIVE_EOF) {
+      slot->type = ARCHIVE_CONVERT_DONE;
+      sceKernelSignalSema(reader->full_sema, 1);
+      break;
     }
 
-    if (read == 0)
+    if (res != ARCHIVE_OK) {
+      slot->type = ARCHIVE_CONVERT_DONE;
+      slot->size = res < 0 ? res : -1;
+      sceKernelSignalSema(reader->full_sema, 1);
       break;
+    }
+
+    // Same times as in the listing
+    SceDateTime time;
+    sceRtcSetTime_t(&time, archive_entry_mtime(archive_entry));
+    convertLocalTimeToUtc(&slot->mtime, &time);
 
-    int written = sceIoWrite(fddst, buf, read);
+    const char *name = archive_entry_pathname(archive_entry);
+    snprintf((char *)slot->buffer, MAX_PATH_LENGTH, "%s", name ? name : "");
 
-    if (written < 0) {
-      free(buf);
+    slot->type = ARCHIVE_CONVERT_HEADER;
+    slot->is_folder = (convert_stat_mode(archive_entry_mode(archive_entry)) & SCE_S_IFDIR) != 0;
+    slot->entry_size = archive_entry_size_is_set(archive_entry) ? archive_entry_size(archive_entry) : -1;
+    sceKernelSignalSema(reader->full_sema, 1);
 
-      sceIoClose(fddst);
-      archiveFileClose(fdsrc);
+    if (slot->is_folder)
+      continue;
 
-      sceIoRemove(dst_path);
+    // Sparse regions are given as zeros
+    while (1) {
+      if (!(slot = getArchiveConvertSlot(reader)))
+        goto exit;
 
-      return written;
-    }
+      int read = archive_read_data(reader->archive, slot->buffer, TRANSFER_SIZE);
+      slot->type = read > 0 ? ARCHIVE_CONVERT_DATA : ARCHIVE_CONVERT_END;
+      slot->size = read;
+      sceKernelSignalSema(reader->full_sema, 1);
 
-    if (param) {
-      if (param->value)
-        (*param->value) += read;
+      if (read < 0)
+        goto exit;
 
-      if (param->SetProgress)
-        param->SetProgress(param->value ? *param->value : 0, param->max);
+      if (read == 0)
+        break;
+    }
+  }
 
-      if (param->cancelHandler && param->cancelHandler()) {
-        free(buf);
+exit:
+  return sceKernelExitThread(0);
+}
 
-        sceIoClose(fddst);
-        archiveFileClose(fdsrc);
+// Entries without a name are left out together with their data,
+// *skip is set until their end slot
+static int writeArchiveConvertSlot(zipFile zf, ArchiveConvertSlot *slot, int level, int *skip, FileProcessParam *param) {
+  if (slot->size < 0)
+    return slot->size;
 
-        sceIoRemove(dst_path);
+  switch (slot->type) {
+    case ARCHIVE_CONVERT_HEADER:
+    {
+      char *name = (char *)slot->buffer;
 
-        return 0;
+      // Paths are stored relative
+      while (*name == '/' || (name[0] == '.' && name[1] == '/'))
+        name += name[0] == '/' ? 1 : 2;
+
+      if (*name == '\0') {
+        *skip = !slot->is_folder;
+        return 1;
       }
+
+      zip_fileinfo zi;
+      memset(&zi, 0, sizeof(zip_fileinfo));
+      convertToZipTime(&slot->mtime, &zi.tmz_date);
+
+      if (slot->is_folder)
+        addEndSlash(name);
+
+      int res = zipOpenNewFileInZip3_64(zf, name, &zi,
+                                        NULL, 0, NULL, 0, NULL,
+                                        (level != 0) ? Z_DEFLATED : 0,
+                                        level, 0,
+                                        -MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY,
+                                        NULL, 0, slot->entry_size < 0 || slot->entry_size >= 0xFFFFFFFF);
+      if (res < 0)
+        return res;
+
+      if (slot->is_folder)
+        zipCloseFileInZip(zf);
+
+      break;
+    }
+
+    case ARCHIVE_CONVERT_DATA:
+    {
+      // The listing has no node for skipped entries either
+      if (*skip)
+        break;
+
+      int written = zipWriteInFileInZip(zf, slot->buffer, slot->size);
+      if (written < 0)
+        return written;
+
+      if (param && param->value)
+        (*param->value) += slot->size;
+
+      break;
     }
+
+    case ARCHIVE_CONVERT_END:
+      if (*skip) {
+        *skip = 0;
+        break;
+      }
+
+      zipCloseFileInZip(zf);
+
+      if (param && param->items)
+        (*param->items)++;
+
+      break;
   }
 
-  free(buf);
+  if (param) {
+    if (param->SetProgress)
+      param->SetProgress(param->value ? *param->value : 0, param->max);
 
-  sceIoClose(fddst);
-  archiveFileClose(fdsrc);
+    if (param->cancelHandler && param->cancelHandler())
+      return 0;
+  }
 
   return 1;
 }
 
-int extractArchivePath(const char *src_path, const char *dst_path, FileProcessParam *param) {
+// Writes the entries of the open archive into a new ZIP without
+// extracting them to a temporary folder
+int convertArchiveToZip(const char *zip_file, int level, FileProcessParam *param) {
   if (is_psarc)
-    return extractPsarcPath(src_path, dst_path, param);
-  
-  SceIoStat stat;
-  memset(&stat, 0, sizeof(SceIoStat));
+    return VITASHELL_ERROR_INVALID_TYPE;
 
-  int res = archiveFileGetstat(src_path, &stat);
-  if (res < 0)
-    return res;
-  
-  if (SCE_S_ISDIR(stat.st_mode)) {
-    FileList list;
-    memset(&list, 0, sizeof(FileList));
-    fileListGetArchiveEntries(&list, src_path, SORT_NONE);
+  if (strcasecmp(zip_file, archive_file) == 0)
+    return VITASHELL_ERROR_SRC_AND_DST_IDENTICAL;
 
-    int ret = sceIoMkdir(dst_path, 0777);
-    if (ret < 0 && ret != SCE_ERROR_ERRNO_EEXIST) {
-      fileListEmpty(&list);
-      return ret;
-    }
+  ArchiveConvertReader reader;
+  memset(&reader, 0, sizeof(ArchiveConvertReader));
 
-    if (param) {
-      if (param->value)
-        (*param->value) += DIRECTORY_SIZE;
+  uint8_t *buffers = memalign(4096, ARCHIVE_CONVERT_SLOTS * TRANSFER_SIZE);
+  if (!buffers)
+    return VITASHELL_ERROR_NO_MEMORY;
 
-      if (param->SetProgress)
-        param->SetProgress(param->value ? *param->value : 0, param->max);
-      
-      if (param->cancelHandler && param->cancelHandler()) {
-        fileListEmpty(&list);
-        return 0;
-      }
-    }
+  int i;
+  for (i = 0; i < ARCHIVE_CONVERT_SLOTS; i++)
+    reader.slots[i].buffer = buffers + i * TRANSFER_SIZE;
 
-    FileListEntry *entry = list.head->next; // Ignore ..
+  reader.archive = open_archive_at(archive_depth, 0, 0);
+  if (!reader.archive) {
+    free(buffers);
+    return -1;
+  }
 
-    int i;
-    for (i = 0; i < list.length - 1; i++, entry = entry->next) {
-      char *new_src_path = malloc(strlen(src_path) + strlen(entry->name) + 2);
-      snprintf(new_src_path, MAX_PATH_LENGTH, "%s%s", src_path, entry->name);
+  zipFile zf = zipOpenBuffered(zip_file, APPEND_STATUS_CREATE);
+  if (!zf) {
+    archive_read_free(reader.archive);
+    free(buffers);
+    return VITASHELL_ERROR_NO_MEMORY;
+  }
 
-      char *new_dst_path = malloc(strlen(dst_path) + strlen(entry->name) + 2);
-      snprintf(new_dst_path, MAX_PATH_LENGTH, "%s%s", dst_path, entry->name);
+  // The free semaphore gets extra signals to wake up the reader on abort
+  reader.free_sema = sceKernelCreateSema("archive_convert_free", 0, ARCHIVE_CONVERT_SLOTS, 2 * ARCHIVE_CONVERT_SLOTS, NULL);
+  reader.full_sema = sceKernelCreateSema("archive_convert_full", 0, 0, ARCHIVE_CONVERT_SLOTS, NULL);
 
-      int ret = 0;
-      
-      if (entry->is_folder) {
-        ret = extractArchivePath(new_src_path, new_dst_path, param);
-      } else {
-        ret = extractArchiveFile(new_src_path, new_dst_path, param);
-      }
-        
-      free(new_dst_path);
-      free(new_src_path);
+  SceUID thid = -1;
+  int skip = 0;
+  int res = 1;
 
-      if (ret <= 0) {
-        fileListEmpty(&list);
-        return ret;
-      }
+  if (reader.free_sema < 0 || reader.full_sema < 0) {
+    res = reader.free_sema < 0 ? reader.free_sema : reader.full_sema;
+  } else {
+    thid = sceKernelCreateThread("archive_convert_thread", (SceKernelThreadEntry)archiveConvertReaderThread,
+                                 0x10000100, 0x10000, 0, 0, NULL);
+    if (thid < 0)
+      res = thid;
+  }
+
+  if (thid >= 0) {
+    ArchiveConvertReader *argp = &reader;
+    sceKernelStartThread(thid, sizeof(ArchiveConvertReader *), &argp);
+
+    while (1) {
+      sceKernelWaitSema(reader.full_sema, 1, NULL);
+
+      ArchiveConvertSlot *slot = &reader.slots[reader.n_read];
+      reader.n_read = (reader.n_read + 1) % ARCHIVE_CONVERT_SLOTS;
+
+      int done = slot->type == ARCHIVE_CONVERT_DONE;
+      res = done ? (slot->size < 0 ? slot->size : 1) : writeArchiveConvertSlot(zf, slot, level, &skip, param);
+
+      sceKernelSignalSema(reader.free_sema, 1);
+
+      if (done || res <= 0)
+        break;
     }
 
-    fileListEmpty(&list);
-  } else {
-    return extractArchiveFile(src_path, dst_path, param);
+    // Stop the reader, it may be waiting for a free slot
+    reader.stop = 1;
+    sceKernelSignalSema(reader.free_sema, ARCHIVE_CONVERT_SLOTS);
+    sceKernelWaitThreadEnd(thid, NULL, NULL);
+    sceKernelDeleteThread(thid);
   }
 
-  return 1;
+  if (reader.free_sema >= 0)
+    sceKernelDeleteSema(reader.free_sema);
+  if (reader.full_sema >= 0)
+    sceKernelDeleteSema(reader.full_sema);
+
+  zipClose(zf, NULL);
+  archive_read_free(reader.archive);
+  free(buffers);
+
+  // Nothing is left of an incomplete conversion
+  if (res <= 0)
+    sceIoRemove(zip_file);
+
+  return res;
 }
 
 int archiveFileGetstat(const char *file, SceIoStat *stat) {
@@ -778,21 +2374,50 @@ int archiveFileGetstat(const char *file, SceIoStat *stat) {
     return VITASHELL_ERROR_ILLEGAL_ADDR;
   
   if (stat)
-    memcpy(stat, &node->stat, sizeof(SceIoStat));
+    getArchiveNodeStat(node, stat);
   
   return 0;
 }
 
+// ZIP files store the CRC32 of every entry in the central directory
+int archiveFileGetCrc32(const char *file, uint32_t *crc) {
+  if (is_psarc)
+    return VITASHELL_ERROR_INVALID_TYPE;
+
+  ZipIndexEntry *entry = zipIndexFind(&zip_index, file + archive_path_start);
+  if (!entry)
+    return VITASHELL_ERROR_NOT_FOUND;
+
+  *crc = entry->crc;
+  return 0;
+}
+
 int archiveFileOpen(const char *file, int flags, SceMode mode) {
   if (is_psarc)
     return psarcFileOpen(file, flags, mode);
     
   // A file is already open
-  if (archive_fd)
+  if (archive_fd || zip_index_file.fd >= 0)
     return -1;
 
+  // Seek straight to the entry if it is in the zip index
+  ZipIndexEntry *entry = zipIndexFind(&zip_index, file + archive_path_start);
+  if (entry && zipIndexEntrySupported(entry)) {
+    if (zipIndexFileOpen(&zip_index, &zip_index_file, entry) >= 0)
+      return ARCHIVE_FD;
+  }
+
+  // Inflate from the checkpoint closest to the entry
+  ArchiveFileNode *node = NULL;
+  if (is_gzip && gz_index.count > 0)
+    node = findArchiveNode(file + archive_path_start);
+
+  if (node && node->offset > 0)
+    archive_fd = open_archive_at(archive_depth, node->offset, 0);
+
   // Open archive file
-  archive_fd = open_archive(archive_file);
+  if (!archive_fd)
+    archive_fd = open_archive_at(archive_depth, 0, 0);
   if (!archive_fd)
     return -1;
 
@@ -825,6 +2450,9 @@ int archiveFileRead(SceUID fd, void *data, SceSize size) {
   if (is_psarc)
     return psarcFileRead(fd, data, size);
   
+  if (zip_index_file.fd >= 0 && fd == ARCHIVE_FD)
+    return zipIndexFileRead(&zip_index_file, data, size);
+
   if (!archive_fd || fd != ARCHIVE_FD)
     return -1;
 
@@ -835,6 +2463,9 @@ int archiveFileClose(SceUID fd) {
   if (is_psarc)
     return psarcFileClose(fd);
   
+  if (zip_index_file.fd >= 0 && fd == ARCHIVE_FD)
+    return zipIndexFileClose(&zip_index_file);
+
   if (!archive_fd || fd != ARCHIVE_FD)
     return -1;
 
@@ -867,43 +2498,133 @@ void archiveSetPassword(char *string) {
   password[sizeof(password) - 1] = '\0';
 }
 
+// Make the open archive the parent of the next one
+static void pushArchive(ArchiveFileNode *child, int implicit) {
+  ArchiveParent *parent = &archive_parents[archive_depth++];
+
+  strcpy(parent->file, archive_file);
+  parent->path_start = archive_path_start;
+  parent->need_password = need_password;
+  memcpy(parent->password, password, sizeof(password));
+  parent->is_gzip = is_gzip;
+  parent->implicit = implicit;
+  parent->child_offset = child->offset;
+  parent->zip_index = zip_index;
+  parent->gz_index = gz_index;
+  parent->root = archive_root;
+  parent->arena = archive_arena;
+  parent->buckets = archive_buckets;
+  parent->n_buckets = archive_n_buckets;
+  parent->n_nodes = archive_n_nodes;
+
+  // The parent owns these now
+  memset(&zip_index, 0, sizeof(ZipIndex));
+  memset(&gz_index, 0, sizeof(GzIndex));
+  archive_root = NULL;
+  archive_arena = NULL;
+  archive_buckets = NULL;
+  archive_n_buckets = 0;
+  archive_n_nodes = 0;
+}
+
+// Go back to the parent after the open archive was closed. Returns 1 if the
+// parent was only opened to reach it
+static int popArchive() {
+  ArchiveParent *parent = &archive_parents[--archive_depth];
+
+  strcpy(archive_file, parent->file);
+  archive_path_start = parent->path_start;
+  need_password = parent->need_password;
+  memcpy(password, parent->password, sizeof(password));
+  is_psarc = 0;
+  is_gzip = parent->is_gzip;
+  zip_index = parent->zip_index;
+  gz_index = parent->gz_index;
+  archive_root = parent->root;
+  archive_arena = parent->arena;
+  archive_buckets = parent->buckets;
+  archive_n_buckets = parent->n_buckets;
+  archive_n_nodes = parent->n_nodes;
+
+  int implicit = parent->implicit;
+  memset(parent, 0, sizeof(ArchiveParent));
+
+  return implicit;
+}
+
+// Closes the open archive and goes back to its parent, if it has one
 int archiveClose() {
-  if (is_psarc)
+  if (is_psarc) {
+    is_psarc = 0;
     return psarcClose();
+  }
   
-  freeArchiveNodes(archive_root);
+  zipIndexClose(&zip_index);
+  gzIndexFree(&gz_index);
+
+  freeArchiveNodes();
+
+  if (archive_depth > 0 && popArchive())
+    return archiveClose();
+
   return 0;
 }
 
-SceMode convert_stat_mode(mode_t mode) {
-  SceMode sce_mode = 0;
-  if (mode & S_IFDIR)
-    sce_mode |= SCE_S_IFDIR;
-  if (mode & S_IFREG)
-    sce_mode |= SCE_S_IFREG;
-  return sce_mode;
-}
+static int archiveOpenLevel(const char *file) {
+  uint32_t magic = 0;
 
-int archiveOpen(const char *file) {
-  // Read magic
-  uint32_t magic;
-  int read = ReadFile(file, &magic, sizeof(uint32_t));
-  if (read < 0)
-    return read;
-  
-  // PSARC file
   is_psarc = 0;
-  if (magic == 0x52415350) {
-    is_psarc = 1;
-    return psarcOpen(file);
-  }
-  
+  is_gzip = 0;
+
   // Start position of the archive path
   archive_path_start = strlen(file) + 1;
   strcpy(archive_file, file);
 
-  // Open archive file
-  struct archive *archive = open_archive(file);
+  // The type of a nested archive is left to libarchive
+  if (archive_depth == 0) {
+    // Read magic
+    int read = ReadFile(file, &magic, sizeof(uint32_t));
+    if (read < 0)
+      return read;
+
+    // PSARC file
+    if (magic == 0x52415350) {
+      int res = psarcOpen(file);
+      is_psarc = res >= 0;
+      return res;
+    }
+  }
+
+  // Index the central directory of zip files. If that fails, entries are
+  // found by scanning the headers instead
+  zipIndexClose(&zip_index);
+  if (magic == ZIP_LOCAL_HEADER_MAGIC)
+    zipIndexOpen(&zip_index, file);
+
+  // Reuse the listing of an archive that has been opened before
+  SceIoStat archive_stat;
+  memset(&archive_stat, 0, sizeof(SceIoStat));
+  if (archive_depth == 0) {
+    int res = sceIoGetstat(file, &archive_stat);
+    if (res < 0)
+      return res;
+  }
+
+  is_gzip = (magic & 0xFFFF) == GZ_MAGIC;
+  gzIndexFree(&gz_index);
+
+  // Nested archives have no stat of their own to validate a cache
+  int use_cache = archive_depth == 0 && archive_stat.st_size >= ARCHIVE_CACHE_MIN_SIZE;
+
+  if (use_cache && archiveCacheLoad(file, &archive_stat) >= 0) {
+    if (is_gzip)
+      archiveGzIndexLoadSave(file, &archive_stat, 0);
+
+    return 0;
+  }
+
+  // Open archive file, gzip checkpoints are taken during this walk
+  struct archive *archive = open_archive_at(archive_depth, 0, is_gzip && use_cache);
   if (!archive)
     return -1;
   
@@ -913,10 +2634,13 @@ int archiveOpen(const char *file) {
     need_password = 1;
   
   // Create archive root
-  SceIoStat root_stat;
-  memset(&root_stat, 0, sizeof(SceIoStat));
-  root_stat.st_mode = SCE_S_IFDIR;
-  archive_root = createArchiveNode("/", &root_stat);
+  archive_root = createArchiveNode(NULL, "/", 1);
+  if (!archive_root) {
+    archive_read_free(archive);
+    return VITASHELL_ERROR_NO_MEMORY;
+  }
+
+  archive_root->mode = SCE_S_IFDIR;
   
   // Traverse
   while (1) {
@@ -956,9 +2680,120 @@ int archiveOpen(const char *file) {
     convertLocalTimeToUtc(&stat.st_atime, &time);  
     
     // Add node
-    addArchiveNode(name, &stat);
+    addArchiveNode(name, &stat, is_gzip ? archive_read_header_position(archive) : -1);
   }
 
   archive_read_free(archive);
+
+  // Sort once, so that listings need not
+  sortArchiveNodes(archive_root);
+
+  // Walking the headers of big archives is slow, remember the result
+  if (use_cache) {
+    archiveCacheSave(file, &archive_stat);
+
+    if (is_gzip)
+      archiveGzIndexLoadSave(file, &archive_stat, 1);
+
+    pruneArchiveCache();
+  }
+
   return 0;
 }
+
+// Open an archive that is an entry of the open archive
+static int archiveOpenNested(const char *file, int implicit) {
+  if (is_psarc || archive_depth >= ARCHIVE_MAX_NESTING)
+    return VITASHELL_ERROR_INVALID_TYPE;
+
+  ArchiveFileNode *node = findArchiveNode(file + archive_path_start);
+  if (!node || SCE_S_ISDIR(node->mode))
+    return VITASHELL_ERROR_NOT_FOUND;
+
+  pushArchive(node, implicit);
+
+  int res = archiveOpenLevel(file);
+  if (res < 0) {
+    freeArchiveNodes();
+    popArchive();
+  }
+
+  return res;
+}
+
+// Open the archives a nested archive is in, from the file on the device
+// inward. They are closed together with it
+static int archiveOpenPath(const char *file) {
+  char path[MAX_PATH_LENGTH];
+  strcpy(path, file);
+
+  // The outermost archive is a file on the device
+  char *p = path;
+  while ((p = strchr(p + 1, '/'))) {
+    SceIoStat stat;
+    memset(&stat, 0, sizeof(SceIoStat));
+
+    *p = '\0';
+    int res = sceIoGetstat(path, &stat);
+    *p = '/';
+
+    if (res >= 0 && SCE_S_ISREG(stat.st_mode))
+      break;
+  }
+
+  if (!p)
+    return VITASHELL_ERROR_NOT_FOUND;
+
+  *p = '\0';
+  int res = archiveOpenLevel(path);
+  *p = '/';
+
+  if (res < 0)
+    return res;
+
+  // Every other file on the way is an archive inside the one before
+  while (res >= 0 && (p = strchr(p + 1, '/'))) {
+    *p = '\0';
+
+    ArchiveFileNode *node = findArchiveNode(path + archive_path_start);
+    if (!node)
+      res = VITASHELL_ERROR_NOT_FOUND;
+    else if (!SCE_S_ISDIR(node->mode))
+      res = archiveOpenNested(path, 1);
+
+    *p = '/';
+  }
+
+  if (res >= 0)
+    res = archiveOpenNested(file, 1);
+
+  if (res < 0)
+    archiveClose();
+
+  return res;
+}
+
+int archiveCanOpenNested() {
+  return !is_psarc && archive_root && archive_depth < ARCHIVE_MAX_NESTING;
+}
+
+// Whether the file is a path inside the open archive
+int archiveHasPath(const char *file) {
+  if (!archive_root && !is_psarc)
+    return 0;
+
+  return strncasecmp(file, archive_file, archive_path_start - 1) == 0 &&
+         file[archive_path_start - 1] == '/';
+}
+
+// An archive inside the open archive is opened on top of it, archiveClose
+// goes back to the open one
+int archiveOpen(const char *file) {
+  if (archive_root && archiveHasPath(file))
+    return archiveOpenNested(file, 0);
+
+  if (!checkFileExist(file))
+    return archiveOpenPath(file);
+
+  return archiveOpenLevel(file);
+}
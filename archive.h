@@ -23,12 +23,42 @@
 
 #define ARCHIVE_FD 0x12345678
 
+// Listings of archives bigger than this are cached
+#define ARCHIVE_CACHE_PATH "ux0:VitaShell/internal/archive_cache"
+#define ARCHIVE_CACHE_MIN_SIZE (16 * 1024 * 1024)
+#define ARCHIVE_CACHE_MAGIC 0x43415356 // VSAC
+#define ARCHIVE_CACHE_VERSION 3
+
+// The least recently used cache files are removed beyond these limits
+#define ARCHIVE_CACHE_MAX_FILES 64
+#define ARCHIVE_CACHE_MAX_SIZE (64 * 1024 * 1024)
+
+// Archives inside of archives are opened up to this many levels deep
+#define ARCHIVE_MAX_NESTING 4
+
+// Slots of decoded data between the reader and the writer of a conversion
+#define ARCHIVE_CONVERT_SLOTS 4
+
+// Times of extracted files may be rounded to 2 seconds by the file system
+#define ARCHIVE_MTIME_TOLERANCE (2 * 1000 * 1000)
+
 int fileListGetArchiveEntries(FileList *list, const char *path, int sort);
 
 int getArchivePathInfo(const char *path, uint64_t *size, uint32_t *folders, uint32_t *files, int (* handler)(const char *path));
 int extractArchivePath(const char *src_path, const char *dst_path, FileProcessParam *param);
+int extractArchiveEntries(FileList *list, const char *dst_path, FileProcessParam *param);
+
+// Sum of the sizes of all files of the open archive
+uint64_t getArchiveSize();
+
+// Decodes every file of the open archive without writing it. On failure
+// failed holds the name of the first broken file, or is empty if the
+// archive itself could not be read
+int testArchive(char *failed, FileProcessParam *param);
+int convertArchiveToZip(const char *zip_file, int level, FileProcessParam *param);
 
 int archiveFileGetstat(const char *file, SceIoStat *stat);
+int archiveFileGetCrc32(const char *file, uint32_t *crc);
 int archiveFileOpen(const char *file, int flags, SceMode mode);
 int archiveFileRead(SceUID fd, void *data, SceSize size);
 int archiveFileClose(SceUID fd);
@@ -37,10 +67,20 @@ int ReadArchiveFile(const char *file, void *buf, int size);
 
 int archiveClose();
 int archiveOpen(const char *file);
+int archiveHasPath(const char *file);
+int archiveCanOpenNested();
 int archiveNeedPassword();
 void archiveClearPassword();
 void archiveSetPassword(char *string);
 
-int archiveCheckFilesForUnsafeFself();
+// Called during extraction after a module with unsafe imports was written.
+// unsafe is 1 for unsafe and 2 for dangerous, returns 0 to cancel.
+typedef int (* ArchiveUnsafeHandler)(int unsafe);
+
+void archiveSetUnsafeHandler(ArchiveUnsafeHandler handler);
+
+// Files that are identical to the existing ones are not extracted and
+// counted in skipped instead. NULL extracts all files.
+void archiveSetSkipIdentical(uint32_t *skipped);
 
 #endif
@@ -0,0 +1,346 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "main.h"
+#include "benchmark.h"
+#include "io_process.h"
+#include "file.h"
+#include "message_dialog.h"
+#include "language.h"
+#include "utils.h"
+
+static int block_sizes[N_BENCHMARK_BLOCK_SIZES] = { 4 * 1024, 64 * 1024, 1024 * 1024 };
+
+static uint64_t benchmark_value = 0;
+static uint64_t benchmark_max = 0;
+
+static uint32_t benchmark_seed = 0;
+
+static uint32_t benchmarkRandom() {
+  benchmark_seed = benchmark_seed * 1103515245 + 12345;
+  return benchmark_seed >> 8;
+}
+
+static double getRate(uint64_t amount, uint64_t micros) {
+  if (micros == 0)
+    micros = 1;
+
+  return (double)amount * 1000000.0 / (double)micros;
+}
+
+static int benchmarkProgress(uint64_t amount) {
+  benchmark_value += amount;
+  SetProgress(benchmark_value, benchmark_max);
+  return cancelHandler();
+}
+
+// Writes BENCHMARK_FILE_SIZE bytes in blocks of block_size and stores the
+// bytes per second in *rate. Returns 1 on success, 0 if canceled, < 0 on error
+static int benchmarkWrite(const char *path, void *buf, int block_size, double *rate) {
+  uint64_t start = sceKernelGetProcessTimeWide();
+
+  SceUID fd = sceIoOpen(path, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0777);
+  if (fd < 0)
+    return fd;
+
+  int i;
+  for (i = 0; i < BENCHMARK_FILE_SIZE / block_size; i++) {
+    int written = sceIoWrite(fd, buf, block_size);
+    if (written < 0) {
+      sceIoClose(fd);
+      return written;
+    }
+
+    // Only check every megabyte, 4 KB blocks are too small to ask each time
+    if (((i + 1) * block_size) % BENCHMARK_MAX_BLOCK_SIZE == 0) {
+      if (benchmarkProgress(BENCHMARK_MAX_BLOCK_SIZE)) {
+        sceIoClose(fd);
+        return 0;
+      }
+    }
+  }
+
+  // The data is only guaranteed to be on the device after closing
+  sceIoClose(fd);
+
+  *rate = getRate(BENCHMARK_FILE_SIZE, sceKernelGetProcessTimeWide() - start);
+  return 1;
+}
+
+// Reads the file back in blocks of block_size, *rate and the return value
+// are the same as for benchmarkWrite
+static int benchmarkRead(const char *path, void *buf, int block_size, double *rate) {
+  uint64_t start = sceKernelGetProcessTimeWide();
+
+  SceUID fd = sceIoOpen(path, SCE_O_RDONLY, 0);
+  if (fd < 0)
+    return fd;
+
+  int i;
+  for (i = 0; i < BENCHMARK_FILE_SIZE / block_size; i++) {
+    int read = sceIoRead(fd, buf, block_size);
+    if (read < 0) {
+      sceIoClose(fd);
+      return read;
+    }
+
+    if (((i + 1) * block_size) % BENCHMARK_MAX_BLOCK_SIZE == 0) {
+      if (benchmarkProgress(BENCHMARK_MAX_BLOCK_SIZE)) {
+        sceIoClose(fd);
+        return 0;
+      }
+    }
+  }
+
+  sceIoClose(fd);
+
+  *rate = getRate(BENCHMARK_FILE_SIZE, sceKernelGetProcessTimeWide() - start);
+  return 1;
+}
+
+static int benchmarkRandomRead(const char *path, void *buf, double *iops) {
+  SceUID fd = sceIoOpen(path, SCE_O_RDONLY, 0);
+  if (fd < 0)
+    return fd;
+
+  uint64_t start = sceKernelGetProcessTimeWide();
+
+  int i;
+  for (i = 0; i < BENCHMARK_RANDOM_READS; i++) {
+    SceOff offset = (SceOff)(benchmarkRandom() % (BENCHMARK_FILE_SIZE / BENCHMARK_RANDOM_BLOCK_SIZE)) * BENCHMARK_RANDOM_BLOCK_SIZE;
+
+    int read = sceIoPread(fd, buf, BENCHMARK_RANDOM_BLOCK_SIZE, offset);
+    if (read < 0) {
+      sceIoClose(fd);
+      return read;
+    }
+
+    if (benchmarkProgress(BENCHMARK_RANDOM_BLOCK_SIZE)) {
+      sceIoClose(fd);
+      return 0;
+    }
+  }
+
+  *iops = getRate(BENCHMARK_RANDOM_READS, sceKernelGetProcessTimeWide() - start);
+
+  sceIoClose(fd);
+
+  return 1;
+}
+
+static int benchmarkSmallFiles(const char *folder, void *buf, double *create_rate, double *delete_rate) {
+  char path[MAX_PATH_LENGTH];
+  int i;
+
+  uint64_t start = sceKernelGetProcessTimeWide();
+
+  for (i = 0; i < BENCHMARK_SMALL_FILES; i++) {
+    snprintf(path, MAX_PATH_LENGTH, "%s/%04d.bin", folder, i);
+
+    SceUID fd = sceIoOpen(path, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0777);
+    if (fd < 0)
+      return fd;
+
+    int written = sceIoWrite(fd, buf, BENCHMARK_SMALL_FILE_SIZE);
+    sceIoClose(fd);
+
+    if (written < 0)
+      return written;
+
+    if (benchmarkProgress(BENCHMARK_SMALL_FILE_SIZE))
+      return 0;
+  }
+
+  *create_rate = getRate(BENCHMARK_SMALL_FILES, sceKernelGetProcessTimeWide() - start);
+
+  start = sceKernelGetProcessTimeWide();
+
+  for (i = 0; i < BENCHMARK_SMALL_FILES; i++) {
+    snprintf(path, MAX_PATH_LENGTH, "%s/%04d.bin", folder, i);
+
+    int res = sceIoRemove(path);
+    if (res < 0)
+      return res;
+
+    if (benchmarkProgress(BENCHMARK_SMALL_FILE_SIZE))
+      return 0;
+  }
+
+  *delete_rate = getRate(BENCHMARK_SMALL_FILES, sceKernelGetProcessTimeWide() - start);
+
+  return 1;
+}
+
+static int benchmarkDevice(const char *folder, BenchmarkResult *result) {
+  char path[MAX_PATH_LENGTH];
+  int i, res;
+
+  void *buf = memalign(4096, BENCHMARK_MAX_BLOCK_SIZE);
+  if (!buf)
+    return VITASHELL_ERROR_NO_MEMORY;
+
+  // Incompressible data
+  for (i = 0; i < BENCHMARK_MAX_BLOCK_SIZE / sizeof(uint32_t); i++) {
+    ((uint32_t *)buf)[i] = benchmarkRandom();
+  }
+
+  snprintf(path, MAX_PATH_LENGTH, "%s/data.bin", folder);
+
+  for (i = 0; i < N_BENCHMARK_BLOCK_SIZES; i++) {
+    res = benchmarkWrite(path, buf, block_sizes[i], &result->write_rates[i]);
+    if (res <= 0)
+      goto EXIT;
+
+    res = benchmarkRead(path, buf, block_sizes[i], &result->read_rates[i]);
+    if (res <= 0)
+      goto EXIT;
+  }
+
+  res = benchmarkRandomRead(path, buf, &result->random_iops);
+  if (res <= 0)
+    goto EXIT;
+
+  res = benchmarkSmallFiles(folder, buf, &result->create_rate, &result->delete_rate);
+
+EXIT:
+  free(buf);
+  return res;
+}
+
+static void benchmarkSaveHistory(const char *device, BenchmarkResult *result) {
+  SceIoStat stat;
+  int new_file = (sceIoGetstat(BENCHMARK_HISTORY_PATH, &stat) < 0);
+
+  SceUID fd = sceIoOpen(BENCHMARK_HISTORY_PATH, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_APPEND, 0777);
+  if (fd < 0)
+    return;
+
+  char line[512];
+
+  if (new_file) {
+    snprintf(line, sizeof(line), "date,device,write_4k,write_64k,write_1m,read_4k,read_64k,read_1m,"
+                                 "random_read_iops,create_per_s,delete_per_s\n");
+    sceIoWrite(fd, line, strlen(line));
+  }
+
+  SceDateTime time;
+  sceRtcGetCurrentClock(&time, 0);
+
+  double mib = 1024.0 * 1024.0;
+
+  snprintf(line, sizeof(line), "%04d-%02d-%02d %02d:%02d:%02d,%s,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.0f,%.0f,%.0f\n",
+           time.year, time.month, time.day, time.hour, time.minute, time.second, device,
+           result->write_rates[0] / mib, result->write_rates[1] / mib, result->write_rates[2] / mib,
+           result->read_rates[0] / mib, result->read_rates[1] / mib, result->read_rates[2] / mib,
+           result->random_iops, result->create_rate, result->delete_rate);
+  sceIoWrite(fd, line, strlen(line));
+
+  sceIoClose(fd);
+}
+
+int benchmark_thread(SceSize args_size, BenchmarkArguments *args) {
+  SceUID thid = -1;
+  char folder[MAX_PATH_LENGTH];
+  int res;
+
+  // Lock power timers
+  powerLock();
+
+  // Set progress to 0%
+  sceMsgDialogProgressBarSetValue(SCE_MSG_DIALOG_PROGRESSBAR_TARGET_BAR_DEFAULT, 0);
+  sceKernelDelayThread(DIALOG_WAIT); // Needed to see the percentage
+
+  // Check free space
+  uint64_t free_size = 0, max_size = 0;
+  res = getPartitionFreeSpace(args->device, &free_size, &max_size);
+  if (res < 0) {
+    closeWaitDialog();
+    errorDialog(res);
+    goto EXIT;
+  }
+
+  if (free_size < BENCHMARK_NEEDED_SPACE) {
+    closeWaitDialog();
+
+    char size_string[16];
+    getSizeString(size_string, BENCHMARK_NEEDED_SPACE - free_size);
+    infoDialog(language_container[NO_SPACE_ERROR], size_string);
+
+    goto EXIT;
+  }
+
+  snprintf(folder, MAX_PATH_LENGTH, "%s" BENCHMARK_FOLDER, args->device);
+
+  // Start from a clean folder
+  removePath(folder, NULL);
+
+  res = sceIoMkdir(folder, 0777);
+  if (res < 0) {
+    closeWaitDialog();
+    errorDialog(res);
+    goto EXIT;
+  }
+
+  benchmark_seed = 0x12345678;
+  benchmark_value = 0;
+  benchmark_max = (uint64_t)BENCHMARK_FILE_SIZE * N_BENCHMARK_BLOCK_SIZES * 2 +
+                  BENCHMARK_RANDOM_READS * BENCHMARK_RANDOM_BLOCK_SIZE +
+                  BENCHMARK_SMALL_FILES * BENCHMARK_SMALL_FILE_SIZE * 2;
+
+  // Update thread
+  thid = createStartUpdateThread(benchmark_max, 1);
+
+  BenchmarkResult result;
+  memset(&result, 0, sizeof(BenchmarkResult));
+
+  res = benchmarkDevice(folder, &result);
+
+  // Clean up in any case
+  removePath(folder, NULL);
+
+  if (res <= 0) {
+    closeWaitDialog();
+    setDialogStep(DIALOG_STEP_CANCELED);
+    errorDialog(res);
+    goto EXIT;
+  }
+
+  benchmarkSaveHistory(args->device, &result);
+
+  // Set progress to 100%
+  sceMsgDialogProgressBarSetValue(SCE_MSG_DIALOG_PROGRESSBAR_TARGET_BAR_DEFAULT, 100);
+  sceKernelDelayThread(COUNTUP_WAIT);
+
+  // Close
+  closeWaitDialog();
+
+  double mib = 1024.0 * 1024.0;
+  infoDialog(language_container[BENCHMARK_RESULT], args->device,
+             result.read_rates[0] / mib, result.read_rates[1] / mib, result.read_rates[2] / mib,
+             result.write_rates[0] / mib, result.write_rates[1] / mib, result.write_rates[2] / mib,
+             (int)result.random_iops, (int)result.create_rate, (int)result.delete_rate);
+
+EXIT:
+  if (thid >= 0)
+    sceKernelWaitThreadEnd(thid, NULL, NULL);
+
+  // Unlock power timers
+  powerUnlock();
+
+  return sceKernelExitDeleteThread(0);
+}
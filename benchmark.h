@@ -0,0 +1,51 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __BENCHMARK_H__
+#define __BENCHMARK_H__
+
+#define BENCHMARK_FOLDER "VitaShell_benchmark"
+#define BENCHMARK_HISTORY_PATH "ux0:VitaShell/benchmark.csv"
+
+#define BENCHMARK_FILE_SIZE (32 * 1024 * 1024)
+#define BENCHMARK_MAX_BLOCK_SIZE (1 * 1024 * 1024)
+#define BENCHMARK_RANDOM_BLOCK_SIZE (4 * 1024)
+#define BENCHMARK_RANDOM_READS 1024
+#define BENCHMARK_SMALL_FILES 256
+#define BENCHMARK_SMALL_FILE_SIZE (4 * 1024)
+
+// Space needed on the device, including some headroom for the file system
+#define BENCHMARK_NEEDED_SPACE (BENCHMARK_FILE_SIZE + BENCHMARK_SMALL_FILES * 32 * 1024)
+
+#define N_BENCHMARK_BLOCK_SIZES 3
+
+typedef struct {
+  char device[16];
+} BenchmarkArguments;
+
+typedef struct {
+  double write_rates[N_BENCHMARK_BLOCK_SIZES];
+  double read_rates[N_BENCHMARK_BLOCK_SIZES];
+  double random_iops;
+  double create_rate;
+  double delete_rate;
+} BenchmarkResult;
+
+int benchmark_thread(SceSize args_size, BenchmarkArguments *args);
+
+#endif
@@ -21,6 +21,7 @@
 #include "browser.h"
 #include "init.h"
 #include "io_process.h"
+#include "jobs.h"
 #include "refresh.h"
 #include "makezip.h"
 #include "package_installer.h"
@@ -68,9 +69,12 @@ int last_set_sort_mode = SORT_BY_NAME;
 int copy_mode = COPY_MODE_NORMAL;
 int file_type = FILE_TYPE_UNKNOWN;
 
-// Archive
+// Archive. The directory level and path of every open archive, the
+// outermost first
 static int is_in_archive = 0;
-static char dir_level_archive = -1;
+static char dir_level_archive[ARCHIVE_MAX_NESTING + 1];
+static char archive_paths[ARCHIVE_MAX_NESTING + 1][MAX_PATH_LENGTH];
+static int n_archive_levels = 0;
 
 // Scrolling filename
 static int scroll_count = 0;
@@ -121,8 +125,13 @@ void dirLevelUp() {
   rel_pos = 0;
 }
 
+// archive_path must be set to the archive that was opened
 void setDirArchiveLevel() {
-  dir_level_archive = dir_level;
+  if (n_archive_levels < ARCHIVE_MAX_NESTING + 1) {
+    dir_level_archive[n_archive_levels] = dir_level;
+    strcpy(archive_paths[n_archive_levels], archive_path);
+    n_archive_levels++;
+  }
 }
 
 void setInArchive() {
@@ -133,11 +142,16 @@ int isInArchive() {
   return is_in_archive;
 }
 
+// Nested archives are closed first, going back to the one they are in
 void dirUpCloseArchive() {
-  if (isInArchive() && dir_level_archive >= dir_level) {
-    is_in_archive = 0;
+  while (isInArchive() && dir_level_archive[n_archive_levels - 1] >= dir_level) {
     archiveClose();
-    dir_level_archive = -1;
+    n_archive_levels--;
+
+    if (n_archive_levels == 0)
+      is_in_archive = 0;
+    else
+      strcpy(archive_path, archive_paths[n_archive_levels - 1]);
   }
 }
 
@@ -376,11 +390,17 @@ static int handleFile(const char *file, FileListEntry *entry) {
     case FILE_TYPE_MP3:
     case FILE_TYPE_OGG:
     case FILE_TYPE_VPK:
-    case FILE_TYPE_ARCHIVE:
       if (isInArchive())
         type = FILE_TYPE_UNKNOWN;
 
       break;
+
+    // Archives inside of archives are read from the entry
+    case FILE_TYPE_ARCHIVE:
+      if (isInArchive() && !archiveCanOpenNested())
+        type = FILE_TYPE_UNKNOWN;
+
+      break;
   }
 
   switch (type) {
@@ -416,7 +436,9 @@ static int handleFile(const char *file, FileListEntry *entry) {
       break;
       
     case FILE_TYPE_ARCHIVE:
-      archiveClearPassword();
+      // A nested archive is tried with the password of its parent first
+      if (!isInArchive())
+        archiveClearPassword();
       res = archiveOpen(file);
       if (res >= 0 && archiveNeedPassword()) {
         initImeDialog(language_container[ENTER_PASSWORD], "", 128, SCE_IME_TYPE_BASIC_LATIN, 0, 1);
@@ -669,11 +691,11 @@ static void fileBrowserHandleFile(FileListEntry *file_entry) {
 
   // Archive mode
   if (type == FILE_TYPE_ARCHIVE && getDialogStep() != DIALOG_STEP_ENTER_PASSWORD) {
-    is_in_archive = 1;
-    dir_level_archive = dir_level;
-
     snprintf(archive_path, MAX_PATH_LENGTH, "%s%s", file_list.path, file_entry->name);
 
+    setInArchive();
+    setDirArchiveLevel();
+
     strcat(file_list.path, file_entry->name);
     addEndSlash(file_list.path);
 
@@ -833,6 +855,10 @@ int browserMain() {
       refresh = fileBrowserMenuCtrl();
     }
 
+    // Refresh when background jobs have finished
+    if (refresh == REFRESH_MODE_NONE && getDialogStep() == DIALOG_STEP_NONE && jobsCheckFinished())
+      refresh = REFRESH_MODE_NORMAL;
+
     // Receive system event
     SceAppMgrSystemEvent event;
     sceAppMgrReceiveSystemEvent(&event);
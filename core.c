@@ -0,0 +1,148 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "core.h"
+
+int allocateReadFile(const char *file, void **buffer) {
+  SceUID fd = sceIoOpen(file, SCE_O_RDONLY, 0);
+  if (fd < 0)
+    return fd;
+
+  int size = sceIoLseek32(fd, 0, SCE_SEEK_END);
+  sceIoLseek32(fd, 0, SCE_SEEK_SET);
+
+  *buffer = malloc(size);
+  if (!*buffer) {
+    sceIoClose(fd);
+    return VITASHELL_ERROR_NO_MEMORY;
+  }
+
+  int read = sceIoRead(fd, *buffer, size);
+  sceIoClose(fd);
+
+  return read;
+}
+
+int ReadFile(const char *file, void *buf, int size) {
+  SceUID fd = sceIoOpen(file, SCE_O_RDONLY, 0);
+  if (fd < 0)
+    return fd;
+
+  int read = sceIoRead(fd, buf, size);
+
+  sceIoClose(fd);
+  return read;
+}
+
+int WriteFile(const char *file, const void *buf, int size) {
+  SceUID fd = sceIoOpen(file, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0777);
+  if (fd < 0)
+    return fd;
+
+  int written = sceIoWrite(fd, buf, size);
+
+  sceIoClose(fd);
+  return written;
+}
+
+int getFileSize(const char *file) {
+  SceUID fd = sceIoOpen(file, SCE_O_RDONLY, 0);
+  if (fd < 0)
+    return fd;
+
+  int fileSize = sceIoLseek(fd, 0, SCE_SEEK_END);
+
+  sceIoClose(fd);
+  return fileSize;
+}
+
+int checkFileExist(const char *file) {
+  SceUID fd = sceIoOpen(file, SCE_O_RDONLY, 0);
+  if (fd < 0)
+    return 0;
+
+  sceIoClose(fd);
+  return 1;
+}
+
+int checkFolderExist(const char *folder) {
+  SceUID dfd = sceIoDopen(folder);
+  if (dfd < 0)
+    return 0;
+
+  sceIoDclose(dfd);
+  return 1;
+}
+
+int hasEndSlash(const char *path) {
+  return path[strlen(path) - 1] == '/';
+}
+
+int removeEndSlash(char *path) {
+  int len = strlen(path);
+
+  if (path[len - 1] == '/') {
+    path[len - 1] = '\0';
+    return 1;
+  }
+
+  return 0;
+}
+
+int addEndSlash(char *path) {
+  int len = strlen(path);
+  if (len < MAX_PATH_LENGTH - 2) {
+    if (path[len - 1] != '/') {
+      path[len] = '/';
+      path[len + 1] = '\0';
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+void convertUtcToLocalTime(SceDateTime *time_local, SceDateTime *time_utc) {
+  // sceRtcGetTick and other sceRtc functions fails with year > 9999
+  int year_utc = time_utc->year;
+  int year_delta = year_utc < 9999 ? 0 : year_utc - 9998;
+  time_utc->year -= year_delta;
+
+  SceRtcTick tick;
+  sceRtcGetTick(time_utc, &tick);
+  time_utc->year = year_utc;
+
+  sceRtcConvertUtcToLocalTime(&tick, &tick);
+  sceRtcSetTick(time_local, &tick);  
+  time_local->year += year_delta;
+}
+
+void convertLocalTimeToUtc(SceDateTime *time_utc, SceDateTime *time_local) {
+  // sceRtcGetTick and other sceRtc functions fails with year > 9999
+  int year_local = time_local->year;
+  int year_delta = year_local < 9999 ? 0 : year_local - 9998;
+  time_local->year -= year_delta;
+
+  SceRtcTick tick;
+  sceRtcGetTick(time_local, &tick);
+  time_local->year = year_local;
+
+  sceRtcConvertLocalTimeToUtc(&tick, &tick);
+  sceRtcSetTick(time_utc, &tick);  
+  time_utc->year += year_delta;
+}
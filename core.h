@@ -0,0 +1,48 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __CORE_H__
+#define __CORE_H__
+
+// Platform independent part of VitaShell. Everything included from here
+// only depends on sceIo and sceRtc, so it also builds on a PC against the
+// POSIX shim in host/shim.
+
+#include <psp2/types.h>
+#include <psp2/io/fcntl.h>
+#include <psp2/io/stat.h>
+#include <psp2/io/dirent.h>
+#include <psp2/rtc.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <malloc.h>
+
+#include "file.h"
+#include "vitashell_error.h"
+
+int hasEndSlash(const char *path);
+int removeEndSlash(char *path);
+int addEndSlash(char *path);
+
+void convertUtcToLocalTime(SceDateTime *time_local, SceDateTime *time_utc);
+void convertLocalTimeToUtc(SceDateTime *time_utc, SceDateTime *time_local);
+
+#endif
@@ -94,9 +94,13 @@ void convertToImportsTable3xx(SceImportsTable2xx *import_2xx, SceImportsTable3xx
   }
 }
 
-int checkForUnsafeImports(void *buffer) {
+// Every table and name is checked against size, so that a malformed module
+// is reported as invalid instead of read past the buffer
+int checkForUnsafeImports(void *buffer, uint32_t size) {
   Elf32_Ehdr *ehdr = (Elf32_Ehdr *)buffer;
-  Elf32_Phdr *phdr = (Elf32_Phdr *)((uint32_t)buffer + ehdr->e_phoff);
+
+  if (size < sizeof(Elf32_Ehdr))
+    return VITASHELL_ERROR_INVALID_MAGIC;
 
   if (ehdr->e_ident[EI_MAG0] != ELFMAG0 ||
       ehdr->e_ident[EI_MAG1] != ELFMAG1 ||
@@ -108,22 +112,58 @@ int checkForUnsafeImports(void *buffer) {
   uint32_t segment = ehdr->e_entry >> 30;
   uint32_t offset = ehdr->e_entry & 0x3FFFFFFF;
 
+  if (segment >= ehdr->e_phnum || ehdr->e_phoff > size ||
+      (uint64_t)ehdr->e_phnum * sizeof(Elf32_Phdr) > size - ehdr->e_phoff)
+    return VITASHELL_ERROR_INVALID_MAGIC;
+
+  Elf32_Phdr *phdr = (Elf32_Phdr *)((uint32_t)buffer + ehdr->e_phoff);
+
+  if (phdr[segment].p_offset > size)
+    return VITASHELL_ERROR_INVALID_MAGIC;
+
   uint32_t text_addr = (uint32_t)buffer + phdr[segment].p_offset;
+  uint32_t text_size = size - phdr[segment].p_offset;
+
+  if (offset > text_size || sizeof(SceModuleInfo) > text_size - offset)
+    return VITASHELL_ERROR_INVALID_MAGIC;
 
   SceModuleInfo *mod_info = (SceModuleInfo *)(text_addr + offset);
 
+  if (mod_info->impTop > mod_info->impBtm || mod_info->impBtm > text_size)
+    return VITASHELL_ERROR_INVALID_MAGIC;
+
   int has_dangerous_nids = 0;
   int has_unsafe_libraries = 0;
 
   uint32_t i = mod_info->impTop;
   while (i < mod_info->impBtm) {
+    // The size field says which table layout follows
+    uint16_t import_size = 0;
+    if (mod_info->impBtm - i >= sizeof(uint16_t))
+      import_size = *(uint16_t *)(text_addr + i);
+
+    if ((import_size != sizeof(SceImportsTable2xx) && import_size != sizeof(SceImportsTable3xx)) ||
+        import_size > mod_info->impBtm - i)
+      return VITASHELL_ERROR_INVALID_MAGIC;
+
     SceImportsTable3xx import;
     convertToImportsTable3xx((void *)text_addr + i, &import);
 
-    char *libname = (char *)(text_addr + import.lib_name - phdr[segment].p_vaddr);
-    uint32_t *func_nid_table = (uint32_t *)(text_addr + import.func_nid_table - phdr[segment].p_vaddr);
+    uint32_t libname_offset = (uint32_t)import.lib_name - phdr[segment].p_vaddr;
+    if (libname_offset >= text_size)
+      return VITASHELL_ERROR_INVALID_MAGIC;
+
+    char *libname = (char *)(text_addr + libname_offset);
+    if (strnlen(libname, text_size - libname_offset) == text_size - libname_offset)
+      return VITASHELL_ERROR_INVALID_MAGIC;
 
     if (strcmp(libname, "SceVshBridge") == 0) {
+      uint32_t nid_offset = import.func_nid_table - phdr[segment].p_vaddr;
+      if (nid_offset > text_size || import.num_functions * sizeof(uint32_t) > text_size - nid_offset)
+        return VITASHELL_ERROR_INVALID_MAGIC;
+
+      uint32_t *func_nid_table = (uint32_t *)(text_addr + nid_offset);
+
       int j;
       for (j = 0; j < import.num_functions; j++) {
         // Check for dangerous _vshIoMount/vshIoUmount
@@ -190,3 +230,166 @@ char *uncompressBuffer(const Elf32_Ehdr *ehdr, const Elf32_Phdr *phdr, const seg
   }
   return out;
 }
+
+static int checkFselfImports(FselfScanner *scanner) {
+  uint64_t phdr_offset = *(uint64_t *)(scanner->header + 0x48);
+  uint64_t section_info_offset = *(uint64_t *)(scanner->header + 0x58);
+  uint64_t length = scanner->size - scanner->elf1_offset;
+
+  if (length < sizeof(Elf32_Ehdr) || length > 0xFFFFFFFF ||
+      phdr_offset < scanner->elf1_offset || phdr_offset - scanner->elf1_offset >= length ||
+      section_info_offset < scanner->elf1_offset || section_info_offset - scanner->elf1_offset >= length)
+    return 1;
+
+  char *buffer = (char *)scanner->buffer;
+
+  Elf32_Ehdr *elf1 = (Elf32_Ehdr *)buffer;
+  uint64_t n_segments = elf1->e_phnum;
+
+  // uncompressBuffer walks all program headers and segment infos
+  if (n_segments == 0 ||
+      n_segments * sizeof(Elf32_Phdr) > length - (phdr_offset - scanner->elf1_offset) ||
+      n_segments * sizeof(segment_info) > length - (section_info_offset - scanner->elf1_offset))
+    return 1;
+
+  Elf32_Phdr *phdr = (Elf32_Phdr *)(buffer + phdr_offset - scanner->elf1_offset);
+  segment_info *info = (segment_info *)(buffer + section_info_offset - scanner->elf1_offset);
+
+  // Segments are read relative to the first one, a stored segment is
+  // copied into the p_filesz bytes of its program header
+  uint64_t total_size = 0;
+
+  int i;
+  for (i = 0; i < n_segments; i++) {
+    if (info[i].offset < info[0].offset || info[i].offset - scanner->elf1_offset >= length ||
+        info[i].length > length - (info[i].offset - scanner->elf1_offset))
+      return 1;
+
+    if (info[i].compression == 1 && info[i].length > phdr[i].p_filesz)
+      return 1;
+
+    total_size += phdr[i].p_filesz;
+  }
+
+  if (total_size > 0xFFFFFFFF)
+    return 1;
+
+  // segment is elf2 section
+  char *segment = buffer + info->offset - scanner->elf1_offset;
+  uint32_t segment_size = length - (info->offset - scanner->elf1_offset);
+
+  // zlib compress magic
+  char *uncompressed_buffer = NULL;
+  if (segment[0] == 0x78) {
+    // uncompressedBuffer will return elf2 section
+    uncompressed_buffer = uncompressBuffer(elf1, phdr, info, segment);
+    if (uncompressed_buffer) {
+      segment = uncompressed_buffer;
+      segment_size = total_size;
+    }
+  }
+
+  int unsafe = checkForUnsafeImports(segment, segment_size);
+
+  if (uncompressed_buffer)
+    free(uncompressed_buffer);
+
+  // A module that can not be parsed is not trusted
+  return unsafe < 0 ? 1 : unsafe;
+}
+
+void fselfScannerInit(FselfScanner *scanner, uint64_t size) {
+  memset(scanner, 0, sizeof(FselfScanner));
+  scanner->size = size;
+}
+
+// Feed the file in order. Returns 1 while more data is needed.
+int fselfScannerUpdate(FselfScanner *scanner, uint64_t offset, const void *data, uint64_t size) {
+  if (scanner->done)
+    return 0;
+
+  // Holes in a module are not expected
+  if (offset != scanner->position) {
+    scanner->done = 1;
+    scanner->result = 1;
+    return 0;
+  }
+
+  const uint8_t *p = data;
+
+  if (offset < FSELF_HEADER_SIZE) {
+    uint64_t length = FSELF_HEADER_SIZE - offset;
+    if (length > size)
+      length = size;
+
+    memcpy(scanner->header + offset, p, length);
+
+    if (offset + length >= sizeof(uint32_t) && *(uint32_t *)scanner->header != SCE_MAGIC) {
+      scanner->done = 1;
+      return 0;
+    }
+
+    if (offset + length == FSELF_HEADER_SIZE) {
+      scanner->elf1_offset = *(uint64_t *)(scanner->header + 0x40);
+
+      if (scanner->elf1_offset < FSELF_HEADER_SIZE || scanner->elf1_offset >= scanner->size) {
+        scanner->done = 1;
+        scanner->result = 1;
+        return 0;
+      }
+
+      // Without memory only the authid can be checked
+      scanner->buffer = malloc(scanner->size - scanner->elf1_offset);
+    }
+  }
+
+  // A module must have the size it was announced with
+  if (offset + size > scanner->size) {
+    fselfScannerFree(scanner);
+    scanner->done = 1;
+    scanner->result = 1;
+    return 0;
+  }
+
+  if (scanner->buffer && offset + size > scanner->elf1_offset) {
+    uint64_t start = offset > scanner->elf1_offset ? offset : scanner->elf1_offset;
+    memcpy(scanner->buffer + start - scanner->elf1_offset, p + start - offset, offset + size - start);
+  }
+
+  scanner->position += size;
+
+  return 1;
+}
+
+// Returns 0 if safe, 1 if unsafe and 2 if dangerous
+int fselfScannerFinish(FselfScanner *scanner) {
+  if (!scanner->done) {
+    scanner->done = 1;
+
+    // Too small to be a module
+    if (scanner->position < FSELF_HEADER_SIZE)
+      scanner->result = 0;
+    else if (scanner->position != scanner->size)
+      scanner->result = 1;
+    else {
+      if (scanner->buffer)
+        scanner->result = checkFselfImports(scanner);
+
+      // Check authid flag
+      uint64_t authid = *(uint64_t *)(scanner->header + 0x80);
+      if (scanner->result == 0 && authid != FSELF_SAFE_AUTHID)
+        scanner->result = 1;
+    }
+  }
+
+  fselfScannerFree(scanner);
+
+  return scanner->result;
+}
+
+void fselfScannerFree(FselfScanner *scanner) {
+  if (scanner->buffer) {
+    free(scanner->buffer);
+    scanner->buffer = NULL;
+  }
+}
@@ -418,10 +418,35 @@ typedef struct {
   uint64_t encryption; // 1 = encrypted, 2 = plain
 } segment_info;
 
+#define SCE_MAGIC 0x00454353
+#define FSELF_HEADER_SIZE 0x88
+#define FSELF_SAFE_AUTHID 0x2F00000000000002
+
+/* Streaming check of SELF files for unsafe imports */
+
+typedef struct {
+  uint64_t size;     /* Size of the file */
+  uint64_t position; /* Bytes seen so far */
+  uint8_t header[FSELF_HEADER_SIZE];
+  uint64_t elf1_offset;
+  uint8_t *buffer;   /* Data from elf1_offset to the end of the file */
+  int done;
+  int result;
+} FselfScanner;
+
 /* Functions */
 
 #include <stdio.h>
 
+int checkForUnsafeImports(void *buffer, uint32_t size);
+char *uncompressBuffer(const Elf32_Ehdr *ehdr, const Elf32_Phdr *phdr, const segment_info *segment,
+                       const char *buffer);
+
+void fselfScannerInit(FselfScanner *scanner, uint64_t size);
+int fselfScannerUpdate(FselfScanner *scanner, uint64_t offset, const void *data, uint64_t size);
+int fselfScannerFinish(FselfScanner *scanner);
+void fselfScannerFree(FselfScanner *scanner);
+
 int elf_read_ehdr(FILE *fp, Elf32_Ehdr *ehdr);
 
 // Precondition: ehdr is valid!
@@ -25,7 +25,6 @@
 #include "sha1.h"
 #include "sha256.h"
 #include "md5.h"
-#include "strnatcmp.h"
 #include "io_process.h"
 
 static char *devices[] = {
@@ -51,78 +50,29 @@ static char *devices[] = {
 
 const char symlink_header_bytes[SYMLINK_HEADER_SIZE] = {0xF1, 0x1E, 0x00, 0x00};
 
-int allocateReadFile(const char *file, void **buffer) {
-  SceUID fd = sceIoOpen(file, SCE_O_RDONLY, 0);
-  if (fd < 0)
-    return fd;
-
-  int size = sceIoLseek32(fd, 0, SCE_SEEK_END);
-  sceIoLseek32(fd, 0, SCE_SEEK_SET);
+// Files inside the open archive are hashed as they are read out of it
+static SceUID openHashFile(const char *file, int in_archive) {
+  if (in_archive)
+    return archiveFileOpen(file, SCE_O_RDONLY, 0);
 
-  *buffer = malloc(size);
-  if (!*buffer) {
-    sceIoClose(fd);
-    return VITASHELL_ERROR_NO_MEMORY;
-  }
-
-  int read = sceIoRead(fd, *buffer, size);
-  sceIoClose(fd);
-
-  return read;
+  return sceIoOpen(file, SCE_O_RDONLY, 0);
 }
 
-int ReadFile(const char *file, void *buf, int size) {
-  SceUID fd = sceIoOpen(file, SCE_O_RDONLY, 0);
-  if (fd < 0)
-    return fd;
-
-  int read = sceIoRead(fd, buf, size);
+static int readHashFile(SceUID fd, void *buf, int in_archive) {
+  if (in_archive)
+    return archiveFileRead(fd, buf, TRANSFER_SIZE);
 
-  sceIoClose(fd);
-  return read;
+  return sceIoRead(fd, buf, TRANSFER_SIZE);
 }
 
-int WriteFile(const char *file, const void *buf, int size) {
-  SceUID fd = sceIoOpen(file, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0777);
-  if (fd < 0)
-    return fd;
-
-  int written = sceIoWrite(fd, buf, size);
-
-  sceIoClose(fd);
-  return written;
-}
-
-int getFileSize(const char *file) {
-  SceUID fd = sceIoOpen(file, SCE_O_RDONLY, 0);
-  if (fd < 0)
-    return fd;
-
-  int fileSize = sceIoLseek(fd, 0, SCE_SEEK_END);
-
-  sceIoClose(fd);
-  return fileSize;
-}
-
-int checkFileExist(const char *file) {
-  SceUID fd = sceIoOpen(file, SCE_O_RDONLY, 0);
-  if (fd < 0)
-    return 0;
-
-  sceIoClose(fd);
-  return 1;
-}
-
-int checkFolderExist(const char *folder) {
-  SceUID dfd = sceIoDopen(folder);
-  if (dfd < 0)
-    return 0;
-
-  sceIoDclose(dfd);
-  return 1;
+static void closeHashFile(SceUID fd, int in_archive) {
+  if (in_archive)
+    archiveFileClose(fd);
+  else
+    sceIoClose(fd);
 }
 
-int getFileSha1(const char *file, uint8_t *pSha1Out, FileProcessParam *param) {
+int getFileSha1(const char *file, uint8_t *pSha1Out, int in_archive, FileProcessParam *param) {
   // Update current file being hashed
   SetCurrentFile(file);
   
@@ -131,7 +81,7 @@ int getFileSha1(const char *file, uint8_t *pSha1Out, FileProcessParam *param) {
   sha1_init(&ctx);
 
   // Open the file to read, else return the error
-  SceUID fd = sceIoOpen(file, SCE_O_RDONLY, 0);
+  SceUID fd = openHashFile(file, in_archive);
   if (fd < 0)
     return fd;
 
@@ -140,11 +90,11 @@ int getFileSha1(const char *file, uint8_t *pSha1Out, FileProcessParam *param) {
 
   // Actually take the SHA1 sum
   while (1) {
-    int read = sceIoRead(fd, buf, TRANSFER_SIZE);
+    int read = readHashFile(fd, buf, in_archive);
 
     if (read < 0) {
       free(buf);
-      sceIoClose(fd);
+      closeHashFile(fd, in_archive);
       return read;
     }
 
@@ -164,7 +114,7 @@ int getFileSha1(const char *file, uint8_t *pSha1Out, FileProcessParam *param) {
       // Check to see if param->cancelHandler exists, if so call it and free memory if canceled
       if (param->cancelHandler && param->cancelHandler()) {
         free(buf);
-        sceIoClose(fd);
+        closeHashFile(fd, in_archive);
         return 0;
       }
 
@@ -183,11 +133,11 @@ int getFileSha1(const char *file, uint8_t *pSha1Out, FileProcessParam *param) {
   free(buf);
 
   // Close file proper
-  sceIoClose(fd);
+  closeHashFile(fd, in_archive);
   return 1;
 }
 
-int getFileMd5(const char *file, uint8_t *pMd5Out, FileProcessParam *param) {
+int getFileMd5(const char *file, uint8_t *pMd5Out, int in_archive, FileProcessParam *param) {
   // Update current file being hashed
   SetCurrentFile(file);
   
@@ -196,7 +146,7 @@ int getFileMd5(const char *file, uint8_t *pMd5Out, FileProcessParam *param) {
   md5_init(&ctx);
 
   // Open the file to read, else return the error
-  SceUID fd = sceIoOpen(file, SCE_O_RDONLY, 0);
+  SceUID fd = openHashFile(file, in_archive);
   if (fd < 0)
     return fd;
 
@@ -205,11 +155,11 @@ int getFileMd5(const char *file, uint8_t *pMd5Out, FileProcessParam *param) {
 
   // Actually take the MD5 sum
   while (1) {
-    int read = sceIoRead(fd, buf, TRANSFER_SIZE);
+    int read = readHashFile(fd, buf, in_archive);
 
     if (read < 0) {
       free(buf);
-      sceIoClose(fd);
+      closeHashFile(fd, in_archive);
       return read;
     }
 
@@ -227,7 +177,7 @@ int getFileMd5(const char *file, uint8_t *pMd5Out, FileProcessParam *param) {
 
       if (param->cancelHandler && param->cancelHandler()) {
         free(buf);
-        sceIoClose(fd);
+        closeHashFile(fd, in_archive);
         return 0;
       }
 
@@ -243,11 +193,11 @@ int getFileMd5(const char *file, uint8_t *pMd5Out, FileProcessParam *param) {
   free(buf);
 
   // Close file proper
-  sceIoClose(fd);
+  closeHashFile(fd, in_archive);
   return 1;
 }
 
-int getFileSha256(const char *file, uint8_t *pSha256Out, FileProcessParam *param) {
+int getFileSha256(const char *file, uint8_t *pSha256Out, int in_archive, FileProcessParam *param) {
   // Update current file being hashed
   SetCurrentFile(file);
   
@@ -256,7 +206,7 @@ int getFileSha256(const char *file, uint8_t *pSha256Out, FileProcessParam *param
   sha256_init(&ctx);
 
   // Open the file to read, else return the error
-  SceUID fd = sceIoOpen(file, SCE_O_RDONLY, 0);
+  SceUID fd = openHashFile(file, in_archive);
   if (fd < 0)
     return fd;
 
@@ -265,11 +215,11 @@ int getFileSha256(const char *file, uint8_t *pSha256Out, FileProcessParam *param
 
   // Actually take the SHA256 sum
   while (1) {
-    int read = sceIoRead(fd, buf, TRANSFER_SIZE);
+    int read = readHashFile(fd, buf, in_archive);
 
     if (read < 0) {
       free(buf);
-      sceIoClose(fd);
+      closeHashFile(fd, in_archive);
       return read;
     }
 
@@ -287,7 +237,7 @@ int getFileSha256(const char *file, uint8_t *pSha256Out, FileProcessParam *param
 
       if (param->cancelHandler && param->cancelHandler()) {
         free(buf);
-        sceIoClose(fd);
+        closeHashFile(fd, in_archive);
         return 0;
       }
 
@@ -303,7 +253,7 @@ int getFileSha256(const char *file, uint8_t *pSha256Out, FileProcessParam *param
   free(buf);
 
   // Close file proper
-  sceIoClose(fd);
+  closeHashFile(fd, in_archive);
   return 1;
 }
 
@@ -408,6 +358,9 @@ int removePath(const char *path, FileProcessParam *param) {
             if (param->value)
               (*param->value)++;
 
+            if (param->items)
+              (*param->items)++;
+
             if (param->SetProgress)
               param->SetProgress(param->value ? *param->value : 0, param->max);
 
@@ -449,6 +402,9 @@ int removePath(const char *path, FileProcessParam *param) {
       if (param->value)
         (*param->value)++;
 
+      if (param->items)
+        (*param->items)++;
+
       if (param->SetProgress)
         param->SetProgress(param->value ? *param->value : 0, param->max);
 
@@ -549,6 +505,9 @@ int copyFile(const char *src_path, const char *dst_path, FileProcessParam *param
   sceIoClose(fddst);
   sceIoClose(fdsrc);
 
+  if (param && param->items)
+    (*param->items)++;
+
   return 1;
 }
 
@@ -812,280 +771,6 @@ char **getDevices() {
   return devices;
 }
 
-FileListEntry *fileListCopyEntry(FileListEntry *src) {
-  FileListEntry *dst = malloc(sizeof(FileListEntry));
-  if (!dst)
-    return NULL;
-
-  memcpy(dst, src, sizeof(FileListEntry));
-  dst->name = malloc(src->name_length + 1);
-  strcpy(dst->name, src->name);
-  return dst;
-}
-
-FileListEntry *fileListFindEntry(FileList *list, const char *name) {
-  if (!list)
-    return NULL;
-
-  FileListEntry *entry = list->head;
-
-  int name_length = strlen(name);
-
-  while (entry) {
-    if (entry->name_length == name_length && strcasecmp(entry->name, name) == 0)
-      return entry;
-
-    entry = entry->next;
-  }
-
-  return NULL;
-}
-
-FileListEntry *fileListGetNthEntry(FileList *list, int n) {
-  if (!list)
-    return NULL;
-
-  FileListEntry *entry = list->head;
-
-  while (n > 0 && entry) {
-    n--;
-    entry = entry->next;
-  }
-
-  if (n != 0)
-    return NULL;
-
-  return entry;
-}
-
-int fileListGetNumberByName(FileList *list, const char *name) {
-  if (!list)
-    return VITASHELL_ERROR_ILLEGAL_ADDR;
-
-  FileListEntry *entry = list->head;
-
-  int name_length = strlen(name);
-
-  int n = 0;
-
-  while (entry) {
-    if (entry->name_length == name_length && strcasecmp(entry->name, name) == 0)
-      return n;
-
-    n++;
-    entry = entry->next;
-  }
-
-  return VITASHELL_ERROR_NOT_FOUND;
-}
-
-void fileListAddEntry(FileList *list, FileListEntry *entry, int sort) {
-  if (!list || !entry)
-    return;
-
-  entry->next = NULL;
-  entry->previous = NULL;
-
-  if (list->head == NULL) {
-    list->head = entry;
-    list->tail = entry;
-  } else {
-    if (sort != SORT_NONE) {
-      FileListEntry *p = list->head;
-      FileListEntry *previous = NULL;
-
-      char entry_name[MAX_NAME_LENGTH];
-      strcpy(entry_name, entry->name);
-      removeEndSlash(entry_name);
-
-      while (p) {
-        char p_name[MAX_NAME_LENGTH];
-        strcpy(p_name, p->name);
-        removeEndSlash(p_name);
-
-        // '..' is always at first
-        if (strcmp(entry_name, "..") == 0)
-          break;
-
-        if (strcmp(p_name, "..") == 0) {
-          previous = p;
-          p = p->next;
-          continue;
-        }
-
-        // Sort by type
-        if (sort == SORT_BY_NAME) {
-          // First folders then files
-          if (entry->is_folder > p->is_folder)
-            break;
-        } else if (sort == SORT_BY_SIZE || sort == SORT_BY_DATE) {
-          // First files then folders
-          if (entry->is_folder < p->is_folder)
-            break;
-        }
-
-        if (sort == SORT_BY_NAME) {
-          // Sort by name within the same type
-          if (entry->is_folder == p->is_folder) {
-            if (strnatcasecmp(entry_name, p_name) < 0) {
-              break;
-            }
-          }
-        } else if (sort == SORT_BY_SIZE) {
-          // Sort by name for folders
-          if (entry->is_folder && p->is_folder) {
-            if (strnatcasecmp(entry_name, p_name) < 0) {
-              break;
-            }
-          } else if (!entry->is_folder && !p->is_folder) {
-            // Sort by size for files
-            if (entry->size > p->size)
-              break;
-
-            // Sort by name for files with the same size
-            if (entry->size == p->size) {
-              if (strnatcasecmp(entry_name, p_name) < 0) {
-                break;
-              }
-            }
-          }
-        } else if (sort == SORT_BY_DATE) {
-          if (entry->is_folder == p->is_folder) {
-            SceRtcTick entry_tick, p_tick;
-            sceRtcGetTick(&entry->mtime, &entry_tick);
-            sceRtcGetTick(&p->mtime, &p_tick);
-
-            // Sort by date within the same type
-            if (entry_tick.tick > p_tick.tick)
-              break;
-
-            // Sort by name for files and folders with the same date
-            if (entry_tick.tick == p_tick.tick) {
-              if (strnatcasecmp(entry_name, p_name) < 0) {
-                break;
-              }
-            }
-          }
-        }
-
-        previous = p;
-        p = p->next;
-      }
-
-      if (previous == NULL) { // Order: entry (new head) -> p (old head)
-        entry->next = p;
-        p->previous = entry;
-        list->head = entry;
-      } else if (previous->next == NULL) { // Order: p (old tail) -> entry (new tail)
-        FileListEntry *tail = list->tail;
-        tail->next = entry;
-        entry->previous = tail;
-        list->tail = entry;
-      } else { // Order: previous -> entry -> p
-        previous->next = entry;
-        entry->previous = previous;
-        entry->next = p;
-        p->previous = entry;
-      }
-    } else {
-      FileListEntry *tail = list->tail;
-      tail->next = entry;
-      entry->previous = tail;
-      list->tail = entry;
-    }
-  }
-
-  list->length++;
-}
-
-int fileListRemoveEntry(FileList *list, FileListEntry *entry) {
-  if (!list || !entry)
-    return 0;
-
-  if (entry->previous) {
-    entry->previous->next = entry->next;
-  } else {
-    list->head = entry->next;
-  }
-
-  if (entry->next) {
-    entry->next->previous = entry->previous;
-  } else {
-    list->tail = entry->previous;
-  }
-
-  list->length--;
-  free(entry->name);
-  free(entry);
-
-  if (list->length == 0) {
-    list->head = NULL;
-    list->tail = NULL;
-  }
-
-  return 1;
-}
-
-int fileListRemoveEntryByName(FileList *list, const char *name) {
-  if (!list)
-    return 0;
-
-  FileListEntry *entry = list->head;
-  FileListEntry *previous = NULL;
-
-  int name_length = strlen(name);
-
-  while (entry) {
-    if (entry->name_length == name_length && strcasecmp(entry->name, name) == 0) {
-      if (previous) {
-        previous->next = entry->next;
-      } else {
-        list->head = entry->next;
-      }
-
-      if (list->tail == entry) {
-        list->tail = previous;
-      }
-
-      list->length--;
-      free(entry->name);
-      free(entry);
-
-      if (list->length == 0) {
-        list->head = NULL;
-        list->tail = NULL;
-      }
-
-      return 1;
-    }
-
-    previous = entry;
-    entry = entry->next;
-  }
-
-  return 0;
-}
-
-void fileListEmpty(FileList *list) {
-  if (!list)
-    return;
-
-  FileListEntry *entry = list->head;
-
-  while (entry) {
-    FileListEntry *next = entry->next;
-    free(entry->name);
-    free(entry);
-    entry = next;
-  }
-
-  list->head = NULL;
-  list->tail = NULL;
-  list->length = 0;
-  list->files = 0;
-  list->folders = 0;
-}
-
 int fileListGetDeviceEntries(FileList *list) {
   if (!list)
     return VITASHELL_ERROR_ILLEGAL_ADDR;
@@ -73,6 +73,7 @@ typedef struct {
 
 typedef struct {
   uint64_t *value;
+  uint32_t *items; // Number of files processed, optional
   uint64_t max;
   void (* SetProgress)(uint64_t value, uint64_t max);
   int (* cancelHandler)();
@@ -117,9 +118,9 @@ char * getBaseDirectory(const char *path);
 char * getFilename(const char *path);
 
 int getFileSize(const char *file);
-int getFileSha1(const char *file, uint8_t *pSha1Out, FileProcessParam *param);
-int getFileMd5(const char *file, uint8_t *pMd5Out, FileProcessParam *param);
-int getFileSha256(const char *file, uint8_t *pSha256Out, FileProcessParam *param);
+int getFileSha1(const char *file, uint8_t *pSha1Out, int in_archive, FileProcessParam *param);
+int getFileMd5(const char *file, uint8_t *pMd5Out, int in_archive, FileProcessParam *param);
+int getFileSha256(const char *file, uint8_t *pSha256Out, int in_archive, FileProcessParam *param);
 int getPathInfo(const char *path, uint64_t *size, uint32_t *folders, uint32_t *files, int (* handler)(const char *path));
 int removePath(const char *path, FileProcessParam *param);
 int copyFile(const char *src_path, const char *dst_path, FileProcessParam *param);
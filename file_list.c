@@ -0,0 +1,294 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "core.h"
+#include "strnatcmp.h"
+
+FileListEntry *fileListCopyEntry(FileListEntry *src) {
+  FileListEntry *dst = malloc(sizeof(FileListEntry));
+  if (!dst)
+    return NULL;
+
+  memcpy(dst, src, sizeof(FileListEntry));
+  dst->name = malloc(src->name_length + 1);
+  strcpy(dst->name, src->name);
+  return dst;
+}
+
+FileListEntry *fileListFindEntry(FileList *list, const char *name) {
+  if (!list)
+    return NULL;
+
+  FileListEntry *entry = list->head;
+
+  int name_length = strlen(name);
+
+  while (entry) {
+    if (entry->name_length == name_length && strcasecmp(entry->name, name) == 0)
+      return entry;
+
+    entry = entry->next;
+  }
+
+  return NULL;
+}
+
+FileListEntry *fileListGetNthEntry(FileList *list, int n) {
+  if (!list)
+    return NULL;
+
+  FileListEntry *entry = list->head;
+
+  while (n > 0 && entry) {
+    n--;
+    entry = entry->next;
+  }
+
+  if (n != 0)
+    return NULL;
+
+  return entry;
+}
+
+int fileListGetNumberByName(FileList *list, const char *name) {
+  if (!list)
+    return VITASHELL_ERROR_ILLEGAL_ADDR;
+
+  FileListEntry *entry = list->head;
+
+  int name_length = strlen(name);
+
+  int n = 0;
+
+  while (entry) {
+    if (entry->name_length == name_length && strcasecmp(entry->name, name) == 0)
+      return n;
+
+    n++;
+    entry = entry->next;
+  }
+
+  return VITASHELL_ERROR_NOT_FOUND;
+}
+
+void fileListAddEntry(FileList *list, FileListEntry *entry, int sort) {
+  if (!list || !entry)
+    return;
+
+  entry->next = NULL;
+  entry->previous = NULL;
+
+  if (list->head == NULL) {
+    list->head = entry;
+    list->tail = entry;
+  } else {
+    if (sort != SORT_NONE) {
+      FileListEntry *p = list->head;
+      FileListEntry *previous = NULL;
+
+      char entry_name[MAX_NAME_LENGTH];
+      strcpy(entry_name, entry->name);
+      removeEndSlash(entry_name);
+
+      while (p) {
+        char p_name[MAX_NAME_LENGTH];
+        strcpy(p_name, p->name);
+        removeEndSlash(p_name);
+
+        // '..' is always at first
+        if (strcmp(entry_name, "..") == 0)
+          break;
+
+        if (strcmp(p_name, "..") == 0) {
+          previous = p;
+          p = p->next;
+          continue;
+        }
+
+        // Sort by type
+        if (sort == SORT_BY_NAME) {
+          // First folders then files
+          if (entry->is_folder > p->is_folder)
+            break;
+        } else if (sort == SORT_BY_SIZE || sort == SORT_BY_DATE) {
+          // First files then folders
+          if (entry->is_folder < p->is_folder)
+            break;
+        }
+
+        if (sort == SORT_BY_NAME) {
+          // Sort by name within the same type
+          if (entry->is_folder == p->is_folder) {
+            if (strnatcasecmp(entry_name, p_name) < 0) {
+              break;
+            }
+          }
+        } else if (sort == SORT_BY_SIZE) {
+          // Sort by name for folders
+          if (entry->is_folder && p->is_folder) {
+            if (strnatcasecmp(entry_name, p_name) < 0) {
+              break;
+            }
+          } else if (!entry->is_folder && !p->is_folder) {
+            // Sort by size for files
+            if (entry->size > p->size)
+              break;
+
+            // Sort by name for files with the same size
+            if (entry->size == p->size) {
+              if (strnatcasecmp(entry_name, p_name) < 0) {
+                break;
+              }
+            }
+          }
+        } else if (sort == SORT_BY_DATE) {
+          if (entry->is_folder == p->is_folder) {
+            SceRtcTick entry_tick, p_tick;
+            sceRtcGetTick(&entry->mtime, &entry_tick);
+            sceRtcGetTick(&p->mtime, &p_tick);
+
+            // Sort by date within the same type
+            if (entry_tick.tick > p_tick.tick)
+              break;
+
+            // Sort by name for files and folders with the same date
+            if (entry_tick.tick == p_tick.tick) {
+              if (strnatcasecmp(entry_name, p_name) < 0) {
+                break;
+              }
+            }
+          }
+        }
+
+        previous = p;
+        p = p->next;
+      }
+
+      if (previous == NULL) { // Order: entry (new head) -> p (old head)
+        entry->next = p;
+        p->previous = entry;
+        list->head = entry;
+      } else if (previous->next == NULL) { // Order: p (old tail) -> entry (new tail)
+        FileListEntry *tail = list->tail;
+        tail->next = entry;
+        entry->previous = tail;
+        list->tail = entry;
+      } else { // Order: previous -> entry -> p
+        previous->next = entry;
+        entry->previous = previous;
+        entry->next = p;
+        p->previous = entry;
+      }
+    } else {
+      FileListEntry *tail = list->tail;
+      tail->next = entry;
+      entry->previous = tail;
+      list->tail = entry;
+    }
+  }
+
+  list->length++;
+}
+
+int fileListRemoveEntry(FileList *list, FileListEntry *entry) {
+  if (!list || !entry)
+    return 0;
+
+  if (entry->previous) {
+    entry->previous->next = entry->next;
+  } else {
+    list->head = entry->next;
+  }
+
+  if (entry->next) {
+    entry->next->previous = entry->previous;
+  } else {
+    list->tail = entry->previous;
+  }
+
+  list->length--;
+  free(entry->name);
+  free(entry);
+
+  if (list->length == 0) {
+    list->head = NULL;
+    list->tail = NULL;
+  }
+
+  return 1;
+}
+
+int fileListRemoveEntryByName(FileList *list, const char *name) {
+  if (!list)
+    return 0;
+
+  FileListEntry *entry = list->head;
+  FileListEntry *previous = NULL;
+
+  int name_length = strlen(name);
+
+  while (entry) {
+    if (entry->name_length == name_length && strcasecmp(entry->name, name) == 0) {
+      if (previous) {
+        previous->next = entry->next;
+      } else {
+        list->head = entry->next;
+      }
+
+      if (list->tail == entry) {
+        list->tail = previous;
+      }
+
+      list->length--;
+      free(entry->name);
+      free(entry);
+
+      if (list->length == 0) {
+        list->head = NULL;
+        list->tail = NULL;
+      }
+
+      return 1;
+    }
+
+    previous = entry;
+    entry = entry->next;
+  }
+
+  return 0;
+}
+
+void fileListEmpty(FileList *list) {
+  if (!list)
+    return;
+
+  FileListEntry *entry = list->head;
+
+  while (entry) {
+    FileListEntry *next = entry->next;
+    free(entry->name);
+    free(entry);
+    entry = next;
+  }
+
+  list->head = NULL;
+  list->tail = NULL;
+  list->length = 0;
+  list->files = 0;
+  list->folders = 0;
+}
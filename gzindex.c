@@ -0,0 +1,361 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "core.h"
+#include "gzindex.h"
+
+#define GZ_TRAILER_SIZE 8
+
+typedef struct {
+  uint32_t magic;
+  uint32_t count;
+  uint64_t span;
+  uint32_t key_size;
+} GzIndexHeader;
+
+// The compressed data comes from a read-ahead thread, so the next buffer
+// is read while inflate works on the current one
+static int gzReaderFill(GzReader *reader) {
+  const void *data;
+  int read = readAheadRead(&reader->input, &data);
+  if (read < 0)
+    return read;
+
+  reader->stream.next_in = (Bytef *)data;
+  reader->stream.avail_in = read;
+
+  return read;
+}
+
+static int gzIndexAdd(GzReader *reader) {
+  GzIndex *index = reader->index;
+
+  // Keep the index small, drop every other checkpoint and double the span
+  if (index->count == GZ_INDEX_MAX_CHECKPOINTS) {
+    int i;
+    for (i = 0; i < index->count / 2; i++) {
+      memcpy(&index->checkpoints[i], &index->checkpoints[i * 2 + 1], sizeof(GzCheckpoint));
+    }
+
+    index->count /= 2;
+    index->span *= 2;
+
+    if (reader->out_position - index->checkpoints[index->count - 1].out_offset < index->span)
+      return 0;
+  }
+
+  // Each checkpoint holds a whole window, so grow as they are added
+  if (index->count == index->max) {
+    int max = index->max ? index->max * 2 : 4;
+    if (max > GZ_INDEX_MAX_CHECKPOINTS)
+      max = GZ_INDEX_MAX_CHECKPOINTS;
+
+    GzCheckpoint *checkpoints = realloc(index->checkpoints, max * sizeof(GzCheckpoint));
+    if (!checkpoints)
+      return VITASHELL_ERROR_NO_MEMORY;
+
+    index->checkpoints = checkpoints;
+    index->max = max;
+  }
+
+  GzCheckpoint *checkpoint = &index->checkpoints[index->count];
+  checkpoint->out_offset = reader->out_position;
+  checkpoint->in_offset = reader->input.position - reader->stream.avail_in;
+  checkpoint->bits = reader->stream.data_type & 7;
+  checkpoint->window_size = GZ_WINDOW_SIZE;
+  inflateGetDictionary(&reader->stream, checkpoint->window, &checkpoint->window_size);
+
+  index->count++;
+  reader->last_checkpoint = reader->out_position;
+
+  return 0;
+}
+
+// Continue from a checkpoint with a raw inflate stream
+static int gzReaderResume(GzReader *reader, GzCheckpoint *checkpoint) {
+  if (inflateInit2(&reader->stream, -MAX_WBITS) != Z_OK)
+    return VITASHELL_ERROR_NO_MEMORY;
+
+  reader->raw = 1;
+
+  int partial = checkpoint->bits ? 1 : 0;
+  if (readAheadSeek(&reader->input, checkpoint->in_offset - partial, SCE_SEEK_SET) < 0)
+    return VITASHELL_ERROR_INTERNAL;
+
+  int res = gzReaderFill(reader);
+  if (res < 0)
+    return res;
+
+  if (checkpoint->bits) {
+    if (reader->stream.avail_in == 0)
+      return VITASHELL_ERROR_INVALID_MAGIC;
+
+    int byte = *reader->stream.next_in;
+    reader->stream.next_in++;
+    reader->stream.avail_in--;
+    inflatePrime(&reader->stream, checkpoint->bits, byte >> (8 - checkpoint->bits));
+  }
+
+  inflateSetDictionary(&reader->stream, checkpoint->window, checkpoint->window_size);
+  reader->out_position = checkpoint->out_offset;
+
+  return 0;
+}
+
+int gzReaderOpen(GzReader *reader, const char *file, GzIndex *index, uint64_t offset, int build) {
+  memset(reader, 0, sizeof(GzReader));
+
+  int res = readAheadOpen(&reader->input, file);
+  if (res < 0) {
+    reader->input.fd = -1;
+    return res;
+  }
+
+  // Nearest checkpoint before the offset
+  GzCheckpoint *checkpoint = NULL;
+
+  if (index && !build) {
+    int i;
+    for (i = 0; i < index->count && index->checkpoints[i].out_offset <= offset; i++) {
+      checkpoint = &index->checkpoints[i];
+    }
+  }
+
+  if (checkpoint) {
+    res = gzReaderResume(reader, checkpoint);
+  } else {
+    res = inflateInit2(&reader->stream, MAX_WBITS + 16) == Z_OK ? 0 : VITASHELL_ERROR_NO_MEMORY;
+    if (res >= 0 && build) {
+      reader->index = index;
+      gzIndexFree(index);
+      index->span = GZ_INDEX_SPAN;
+    }
+  }
+
+  if (res < 0) {
+    gzReaderClose(reader);
+    return res;
+  }
+
+  // Inflate and drop the data up to the offset
+  if (reader->out_position < offset) {
+    void *skip = malloc(TRANSFER_SIZE);
+    if (!skip) {
+      gzReaderClose(reader);
+      return VITASHELL_ERROR_NO_MEMORY;
+    }
+
+    while (reader->out_position < offset) {
+      uint64_t remaining = offset - reader->out_position;
+
+      int read = gzReaderRead(reader, skip, remaining < TRANSFER_SIZE ? (int)remaining : TRANSFER_SIZE);
+      if (read <= 0) {
+        free(skip);
+        gzReaderClose(reader);
+        return read < 0 ? read : VITASHELL_ERROR_INVALID_ARGUMENT;
+      }
+    }
+
+    free(skip);
+  }
+
+  return 0;
+}
+
+int gzReaderRead(GzReader *reader, void *data, int size) {
+  if (reader->input.fd < 0)
+    return VITASHELL_ERROR_NOT_RUNNING;
+
+  reader->stream.next_out = data;
+  reader->stream.avail_out = size;
+
+  while (reader->stream.avail_out > 0 && !reader->end) {
+    if (reader->stream.avail_in == 0) {
+      int res = gzReaderFill(reader);
+      if (res < 0)
+        return res;
+
+      if (res == 0) {
+        reader->end = 1;
+        break;
+      }
+    }
+
+    uInt avail_out = reader->stream.avail_out;
+    int res = inflate(&reader->stream, reader->index ? Z_BLOCK : Z_NO_FLUSH);
+    reader->out_position += avail_out - reader->stream.avail_out;
+
+    if (res == Z_STREAM_END) {
+      // Checkpoints are only taken in the first member
+      reader->index = NULL;
+
+      // A raw stream leaves the gzip trailer behind
+      if (reader->raw) {
+        int trailer = GZ_TRAILER_SIZE;
+        while (trailer > 0) {
+          if (reader->stream.avail_in == 0) {
+            int res = gzReaderFill(reader);
+            if (res <= 0) {
+              reader->end = 1;
+              break;
+            }
+          }
+
+          int n = trailer < reader->stream.avail_in ? trailer : (int)reader->stream.avail_in;
+          reader->stream.next_in += n;
+          reader->stream.avail_in -= n;
+          trailer -= n;
+        }
+
+        reader->raw = 0;
+      }
+
+      // Another gzip member may follow
+      reader->members++;
+      inflateReset2(&reader->stream, MAX_WBITS + 16);
+      continue;
+    }
+
+    if (res == Z_BUF_ERROR)
+      continue;
+
+    if (res != Z_OK) {
+      // Padding after the last member
+      if (reader->members > 0 && reader->stream.total_out == 0) {
+        reader->end = 1;
+        break;
+      }
+
+      return VITASHELL_ERROR_INVALID_MAGIC;
+    }
+
+    // At a block boundary that is not the last block
+    if (reader->index && (reader->stream.data_type & 128) && !(reader->stream.data_type & 64) &&
+        reader->out_position - reader->last_checkpoint >= reader->index->span) {
+      int res = gzIndexAdd(reader);
+      if (res < 0)
+        return res;
+    }
+  }
+
+  return size - reader->stream.avail_out;
+}
+
+void gzReaderClose(GzReader *reader) {
+  if (reader->input.fd < 0)
+    return;
+
+  inflateEnd(&reader->stream);
+  readAheadClose(&reader->input);
+
+  memset(reader, 0, sizeof(GzReader));
+  reader->input.fd = -1;
+}
+
+void gzIndexFree(GzIndex *index) {
+  if (index->checkpoints)
+    free(index->checkpoints);
+
+  memset(index, 0, sizeof(GzIndex));
+}
+
+int gzIndexSave(GzIndex *index, const char *path, const void *key, int key_size) {
+  SceUID fd = sceIoOpen(path, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0777);
+  if (fd < 0)
+    return fd;
+
+  GzIndexHeader header;
+  memset(&header, 0, sizeof(GzIndexHeader));
+  header.magic = GZ_INDEX_MAGIC;
+  header.count = index->count;
+  header.span = index->span;
+  header.key_size = key_size;
+
+  int size = sizeof(GzIndexHeader) + key_size + index->count * sizeof(GzCheckpoint);
+  int written = sceIoWrite(fd, &header, sizeof(GzIndexHeader));
+  if (written >= 0)
+    written += sceIoWrite(fd, key, key_size);
+  if (written >= 0 && index->count > 0)
+    written += sceIoWrite(fd, index->checkpoints, index->count * sizeof(GzCheckpoint));
+
+  sceIoClose(fd);
+
+  if (written != size) {
+    sceIoRemove(path);
+    return written < 0 ? written : VITASHELL_ERROR_NO_SPACE;
+  }
+
+  return 0;
+}
+
+int gzIndexLoad(GzIndex *index, const char *path, const void *key, int key_size) {
+  memset(index, 0, sizeof(GzIndex));
+
+  SceUID fd = sceIoOpen(path, SCE_O_RDONLY, 0);
+  if (fd < 0)
+    return fd;
+
+  GzIndexHeader header;
+  int read = sceIoRead(fd, &header, sizeof(GzIndexHeader));
+  if (read != sizeof(GzIndexHeader) || header.magic != GZ_INDEX_MAGIC ||
+      header.key_size != key_size || header.count > GZ_INDEX_MAX_CHECKPOINTS) {
+    sceIoClose(fd);
+    return VITASHELL_ERROR_INVALID_MAGIC;
+  }
+
+  // The key identifies the archive state the index was built for
+  void *file_key = malloc(key_size);
+  if (!file_key) {
+    sceIoClose(fd);
+    return VITASHELL_ERROR_NO_MEMORY;
+  }
+
+  read = sceIoRead(fd, file_key, key_size);
+  if (read != key_size || memcmp(file_key, key, key_size) != 0) {
+    free(file_key);
+    sceIoClose(fd);
+    return VITASHELL_ERROR_NOT_FOUND;
+  }
+
+  free(file_key);
+
+  if (header.count > 0) {
+    index->checkpoints = malloc(header.count * sizeof(GzCheckpoint));
+    if (!index->checkpoints) {
+      sceIoClose(fd);
+      return VITASHELL_ERROR_NO_MEMORY;
+    }
+
+    index->max = header.count;
+
+    int size = header.count * sizeof(GzCheckpoint);
+    read = sceIoRead(fd, index->checkpoints, size);
+    if (read != size) {
+      sceIoClose(fd);
+      gzIndexFree(index);
+      return VITASHELL_ERROR_INVALID_MAGIC;
+    }
+  }
+
+  sceIoClose(fd);
+
+  index->count = header.count;
+  index->span = header.span;
+
+  return 0;
+}
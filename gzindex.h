@@ -0,0 +1,69 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __GZINDEX_H__
+#define __GZINDEX_H__
+
+#include <zlib.h>
+
+#include "file.h"
+#include "readahead.h"
+
+#define GZ_MAGIC 0x8B1F
+
+#define GZ_WINDOW_SIZE (32 * 1024)
+#define GZ_INDEX_SPAN (16 * 1024 * 1024)
+#define GZ_INDEX_MAX_CHECKPOINTS 256
+#define GZ_INDEX_MAGIC 0x49475356 // VSGI
+
+// Inflate state at a deflate block boundary, like zlib's zran example
+typedef struct {
+  uint64_t out_offset;
+  uint64_t in_offset;
+  uint32_t bits;
+  uint32_t window_size;
+  uint8_t window[GZ_WINDOW_SIZE];
+} GzCheckpoint;
+
+typedef struct {
+  GzCheckpoint *checkpoints;
+  int count;
+  int max; // Allocated checkpoints
+  uint64_t span;
+} GzIndex;
+
+typedef struct {
+  ReadAhead input; // Compressed data, input.fd < 0 if not open
+  z_stream stream;
+  uint64_t out_position;
+  int raw;
+  int members;
+  int end;
+  GzIndex *index; // Checkpoints are added while reading, if not NULL
+  uint64_t last_checkpoint;
+} GzReader;
+
+int gzReaderOpen(GzReader *reader, const char *file, GzIndex *index, uint64_t offset, int build);
+int gzReaderRead(GzReader *reader, void *data, int size);
+void gzReaderClose(GzReader *reader);
+
+void gzIndexFree(GzIndex *index);
+int gzIndexSave(GzIndex *index, const char *path, const void *key, int key_size);
+int gzIndexLoad(GzIndex *index, const char *path, const void *key, int key_size);
+
+#endif
@@ -0,0 +1,1177 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Host benchmark for the core library. Every corpus is generated from a
+// fixed seed, so two runs on the same machine process identical data and
+// their timings can be compared directly.
+
+#include "core.h"
+#include "makezip.h"
+#include "zipindex.h"
+#include "zipextract.h"
+#include "gzindex.h"
+#include "readahead.h"
+#include "psarcindex.h"
+#include "psarcextract.h"
+#include "makepsarc.h"
+#include "workerpool.h"
+#include "sfo.h"
+#include "bm.h"
+#include "sha1.h"
+#include "sha256.h"
+#include "md5.h"
+#include "audio/lrcparse.h"
+#include "minizip/zip.h"
+
+#include <psp2/kernel/processmgr.h>
+
+#define BENCH_DEFAULT_PATH "vitashell_bench_corpus"
+#define BENCH_SEED 0x56495441
+
+#define BENCH_LIST_ENTRIES    4096
+#define BENCH_HUGE_DIR_FILES  4096
+#define BENCH_TREE_DEPTH      5
+#define BENCH_TREE_FANOUT     3
+#define BENCH_TREE_FILES      6
+#define BENCH_TEXT_SIZE       (4 * 1024 * 1024)
+#define BENCH_HASH_SIZE       (32 * 1024 * 1024)
+#define BENCH_SFO_KEYS        64
+#define BENCH_SFO_LOOKUPS     200000
+#define BENCH_LRC_LINES       (MAX_LYRICSLINE - 12)
+#define BENCH_LRC_PARSES      200
+#define BENCH_ZIP_READS       256
+#define BENCH_GZ_SIZE         (96 * 1024 * 1024)
+#define BENCH_GZ_SEEKS        16
+#define BENCH_READ_AHEAD_SKIPS 256
+#define BENCH_PSARC_FILES     512
+#define BENCH_PSARC_SIZE      (32 * 1024 * 1024)
+#define BENCH_PSARC_SEEKS     4096
+#define BENCH_ZIP_BLOCKS_SIZE (24 * 1024 * 1024)
+
+static uint32_t seed = BENCH_SEED;
+static int scale = 1;
+static FILE *csv = NULL;
+
+static const char *words[] = {
+  "vita", "shell", "file", "folder", "archive", "memory", "card", "copy",
+  "move", "delete", "zip", "extract", "theme", "music", "photo", "video",
+  "game", "savedata", "license", "update", "network", "usb", "device", "sort",
+};
+
+#define N_WORDS (sizeof(words) / sizeof(char *))
+
+static uint32_t benchRandom() {
+  seed = seed * 1664525 + 1013904223;
+  return seed >> 8;
+}
+
+static void benchReport(const char *name, int ops, SceInt64 usec, uint64_t bytes) {
+  double ms = (double)usec / 1000.0;
+  double per_op = ops ? (double)usec / ops : 0.0;
+  double mbs = (bytes && usec) ? ((double)bytes / (1024.0 * 1024.0)) / ((double)usec / 1000000.0) : 0.0;
+
+  if (bytes)
+    printf("%-28s %8d ops %10.2f ms %12.2f us/op %9.2f MB/s\n", name, ops, ms, per_op, mbs);
+  else
+    printf("%-28s %8d ops %10.2f ms %12.2f us/op\n", name, ops, ms, per_op);
+
+  if (csv)
+    fprintf(csv, "%s,%d,%lld,%llu\n", name, ops, (long long)usec, (unsigned long long)bytes);
+}
+
+static void randomName(char *name, int size) {
+  int n = 1 + benchRandom() % 4;
+  int len = 0;
+
+  int i;
+  for (i = 0; i < n && len < size - 16; i++) {
+    len += snprintf(name + len, size - len, "%s%s", i ? "_" : "", words[benchRandom() % N_WORDS]);
+  }
+
+  // Numbers exercise the natural sort
+  snprintf(name + len, size - len, "%u", benchRandom() % 1000);
+}
+
+static FileListEntry *randomEntry() {
+  FileListEntry *entry = malloc(sizeof(FileListEntry));
+  memset(entry, 0, sizeof(FileListEntry));
+
+  char name[MAX_NAME_LENGTH];
+  randomName(name, 64);
+
+  entry->is_folder = (benchRandom() % 8) == 0;
+  if (entry->is_folder)
+    strcat(name, "/");
+
+  entry->name_length = strlen(name);
+  entry->name = malloc(entry->name_length + 1);
+  strcpy(entry->name, name);
+
+  entry->size = entry->is_folder ? 0 : benchRandom() % (64 * 1024 * 1024);
+
+  SceRtcTick tick;
+  tick.tick = 63700000000000000ULL + (uint64_t)benchRandom() * 1000000ULL;
+  sceRtcSetTick(&entry->mtime, &tick);
+
+  return entry;
+}
+
+static void benchFileList() {
+  static const struct {
+    const char *name;
+    int sort;
+  } sorts[] = {
+    { "file list sort by name", SORT_BY_NAME },
+    { "file list sort by size", SORT_BY_SIZE },
+    { "file list sort by date", SORT_BY_DATE },
+  };
+
+  int n = BENCH_LIST_ENTRIES * scale;
+
+  int i;
+  for (i = 0; i < sizeof(sorts) / sizeof(sorts[0]); i++) {
+    FileList list;
+    memset(&list, 0, sizeof(FileList));
+
+    seed = BENCH_SEED;
+
+    SceInt64 time = 0;
+
+    int j;
+    for (j = 0; j < n; j++) {
+      FileListEntry *entry = randomEntry();
+
+      SceInt64 start = sceKernelGetProcessTimeWide();
+      fileListAddEntry(&list, entry, sorts[i].sort);
+      time += sceKernelGetProcessTimeWide() - start;
+    }
+
+    benchReport(sorts[i].name, n, time, 0);
+
+    if (i == 0) {
+      SceInt64 start = sceKernelGetProcessTimeWide();
+
+      FileListEntry *entry = list.head;
+      int found = 0;
+      while (entry) {
+        found += fileListFindEntry(&list, entry->name) != NULL;
+        entry = entry->next;
+        if (found >= 1024)
+          break;
+      }
+
+      benchReport("file list find", found, sceKernelGetProcessTimeWide() - start, 0);
+    }
+
+    fileListEmpty(&list);
+  }
+}
+
+static int createFile(const char *path, int size) {
+  char *buf = malloc(size ? size : 1);
+
+  int i;
+  for (i = 0; i < size; i++) {
+    // Half random, half repeated text, so compression has work to do
+    buf[i] = (i & 0x100) ? (char)benchRandom() : words[(i >> 4) % N_WORDS][i & 3];
+  }
+
+  int res = WriteFile(path, buf, size);
+  free(buf);
+
+  return res;
+}
+
+static int createTree(const char *path, int depth, uint64_t *size, int *files) {
+  int res = sceIoMkdir(path, 0777);
+  if (res < 0)
+    return res;
+
+  char new_path[MAX_PATH_LENGTH];
+
+  int i;
+  for (i = 0; i < BENCH_TREE_FILES; i++) {
+    int file_size = benchRandom() % (64 * 1024);
+    snprintf(new_path, MAX_PATH_LENGTH, "%s/file%d.bin", path, i);
+
+    res = createFile(new_path, file_size);
+    if (res < 0)
+      return res;
+
+    (*size) += file_size;
+    (*files)++;
+  }
+
+  if (depth > 0) {
+    for (i = 0; i < BENCH_TREE_FANOUT; i++) {
+      snprintf(new_path, MAX_PATH_LENGTH, "%s/dir%d", path, i);
+
+      res = createTree(new_path, depth - 1, size, files);
+      if (res < 0)
+        return res;
+    }
+  }
+
+  return 0;
+}
+
+static void removeTree(const char *path) {
+  SceUID dfd = sceIoDopen(path);
+  if (dfd < 0) {
+    sceIoRemove(path);
+    return;
+  }
+
+  SceIoDirent dir;
+  while (sceIoDread(dfd, &dir) > 0) {
+    char new_path[MAX_PATH_LENGTH];
+    snprintf(new_path, MAX_PATH_LENGTH, "%s/%s", path, dir.d_name);
+
+    if (SCE_S_ISDIR(dir.d_stat.st_mode))
+      removeTree(new_path);
+    else
+      sceIoRemove(new_path);
+  }
+
+  sceIoDclose(dfd);
+  sceIoRmdir(path);
+}
+
+static void benchHugeDir(const char *root) {
+  char path[MAX_PATH_LENGTH];
+  snprintf(path, MAX_PATH_LENGTH, "%s/huge_dir", root);
+  sceIoMkdir(path, 0777);
+
+  seed = BENCH_SEED;
+
+  int n = BENCH_HUGE_DIR_FILES * scale;
+
+  int i;
+  for (i = 0; i < n; i++) {
+    char name[MAX_NAME_LENGTH], file[MAX_PATH_LENGTH];
+    randomName(name, 64);
+    snprintf(file, MAX_PATH_LENGTH, "%s/%s_%d.txt", path, name, i);
+    WriteFile(file, name, strlen(name));
+  }
+
+  // Same steps as fileListGetDirectoryEntries
+  FileList list;
+  memset(&list, 0, sizeof(FileList));
+
+  SceInt64 start = sceKernelGetProcessTimeWide();
+
+  SceUID dfd = sceIoDopen(path);
+  if (dfd >= 0) {
+    SceIoDirent dir;
+    while (sceIoDread(dfd, &dir) > 0) {
+      FileListEntry *entry = malloc(sizeof(FileListEntry));
+      memset(entry, 0, sizeof(FileListEntry));
+
+      entry->name_length = strlen(dir.d_name);
+      entry->name = malloc(entry->name_length + 1);
+      strcpy(entry->name, dir.d_name);
+
+      entry->size = dir.d_stat.st_size;
+      memcpy(&entry->mtime, &dir.d_stat.st_mtime, sizeof(SceDateTime));
+
+      fileListAddEntry(&list, entry, SORT_BY_NAME);
+    }
+
+    sceIoDclose(dfd);
+  }
+
+  benchReport("huge dir read and sort", list.length, sceKernelGetProcessTimeWide() - start, 0);
+
+  fileListEmpty(&list);
+}
+
+static void benchZipIndex(const char *root) {
+  char zip_path[MAX_PATH_LENGTH];
+  snprintf(zip_path, MAX_PATH_LENGTH, "%s/deep_tree_6.zip", root);
+
+  ZipIndex index;
+
+  SceInt64 start = sceKernelGetProcessTimeWide();
+  int res = zipIndexOpen(&index, zip_path);
+  SceInt64 time = sceKernelGetProcessTimeWide() - start;
+
+  if (res < 0) {
+    printf("%-28s failed 0x%08X\n", "zip index open", res);
+    return;
+  }
+
+  benchReport("zip index open", index.count, time, 0);
+
+  // Open and read random single entries, like the text or image viewer does
+  seed = BENCH_SEED;
+
+  void *buf = malloc(TRANSFER_SIZE);
+  uint64_t bytes = 0;
+  int reads = 0;
+
+  start = sceKernelGetProcessTimeWide();
+
+  int i;
+  for (i = 0; i < BENCH_ZIP_READS * scale; i++) {
+    ZipIndexEntry *entry = zipIndexFind(&index, index.entries[benchRandom() % index.count].name);
+
+    ZipIndexFile file;
+    if (!entry || zipIndexFileOpen(&index, &file, entry) < 0)
+      break;
+
+    int read;
+    while ((read = zipIndexFileRead(&file, buf, TRANSFER_SIZE)) > 0)
+      bytes += read;
+
+    zipIndexFileClose(&file);
+
+    if (read < 0) {
+      printf("%-28s failed 0x%08X\n", "zip index read", read);
+      break;
+    }
+
+    reads++;
+  }
+
+  benchReport("zip index random read", reads, sceKernelGetProcessTimeWide() - start, bytes);
+
+  free(buf);
+  zipIndexClose(&index);
+}
+
+static int benchExtractPath(ZipIndexEntry *entry, char *dst_path, void *argp) {
+  // Flatten the tree, the folders are not part of the measurement
+  int len = snprintf(dst_path, MAX_PATH_LENGTH, "%s/", (const char *)argp);
+  char *p = dst_path + len;
+
+  snprintf(p, MAX_PATH_LENGTH - len, "%s", entry->name);
+  while ((p = strchr(p, '/')))
+    *p = '_';
+
+  return 0;
+}
+
+static void benchZipExtract(const char *root) {
+  char zip_path[MAX_PATH_LENGTH], dst_path[MAX_PATH_LENGTH];
+  snprintf(zip_path, MAX_PATH_LENGTH, "%s/deep_tree_6.zip", root);
+  snprintf(dst_path, MAX_PATH_LENGTH, "%s/extract", root);
+
+  ZipIndex index;
+  if (zipIndexOpen(&index, zip_path) < 0)
+    return;
+
+  sceIoMkdir(dst_path, 0777);
+
+  ZipIndexEntry **entries = malloc(index.count * sizeof(ZipIndexEntry *));
+
+  uint64_t size = 0;
+  int i;
+  for (i = 0; i < index.count; i++) {
+    entries[i] = &index.entries[i];
+    size += index.entries[i].uncompressed_size;
+  }
+
+  ZipExtractHandler handler;
+  memset(&handler, 0, sizeof(ZipExtractHandler));
+  handler.getPath = benchExtractPath;
+  handler.argp = dst_path;
+
+  // One worker inflates serially, like the libarchive extraction
+  static const int workers[] = { 1, 2, ZIP_EXTRACT_WORKERS };
+
+  for (i = 0; i < sizeof(workers) / sizeof(int); i++) {
+    char name[32];
+    snprintf(name, sizeof(name), "zip extract %d worker%s", workers[i], workers[i] > 1 ? "s" : "");
+
+    uint64_t value = 0;
+    uint32_t items = 0;
+
+    FileProcessParam param;
+    memset(&param, 0, sizeof(FileProcessParam));
+    param.value = &value;
+    param.items = &items;
+    param.max = size;
+
+    SceInt64 start = sceKernelGetProcessTimeWide();
+    int res = zipExtractEntries(&index, entries, index.count, workers[i], &handler, &param);
+    SceInt64 time = sceKernelGetProcessTimeWide() - start;
+
+    if (res <= 0 || value != size) {
+      printf("%-28s failed 0x%08X\n", name, res);
+      continue;
+    }
+
+    benchReport(name, items, time, size);
+  }
+
+  free(entries);
+  zipIndexClose(&index);
+}
+
+static char *createText(int size);
+
+static void benchGzIndex(const char *root) {
+  char gz_path[MAX_PATH_LENGTH];
+  snprintf(gz_path, MAX_PATH_LENGTH, "%s/stream.gz", root);
+
+  seed = BENCH_SEED;
+
+  // Text compresses like a typical tarball of source or save data
+  uint64_t size = (uint64_t)BENCH_GZ_SIZE * scale;
+  char *text = createText(1024 * 1024);
+  int text_length = strlen(text);
+
+  // Vary the start, so that the stream does not repeat exactly
+  gzFile gz = gzopen(gz_path, "wb6");
+  uint64_t written = 0;
+  while (written < size) {
+    int length = text_length - 1024;
+    if (length > size - written)
+      length = size - written;
+
+    gzwrite(gz, text + benchRandom() % 1024, length);
+    written += length;
+  }
+  gzclose(gz);
+  free(text);
+
+  void *buf = malloc(TRANSFER_SIZE);
+
+  // Full pass, taking checkpoints like archiveOpen does
+  GzIndex index;
+  memset(&index, 0, sizeof(GzIndex));
+
+  GzReader reader;
+  SceInt64 start = sceKernelGetProcessTimeWide();
+
+  int read = 0;
+  uint64_t total = 0;
+  if (gzReaderOpen(&reader, gz_path, &index, 0, 1) >= 0) {
+    while ((read = gzReaderRead(&reader, buf, TRANSFER_SIZE)) > 0)
+      total += read;
+
+    gzReaderClose(&reader);
+  }
+
+  benchReport("gzip index build", index.count, sceKernelGetProcessTimeWide() - start, total);
+
+  if (read < 0 || total != written) {
+    printf("gzip index build: read %llu of %llu bytes, res 0x%08X\n",
+           (unsigned long long)total, (unsigned long long)written, read);
+  }
+
+  // Read 64 KiB at random offsets, with and without checkpoints
+  int i, pass;
+  for (pass = 0; pass < 2; pass++) {
+    GzIndex empty;
+    memset(&empty, 0, sizeof(GzIndex));
+
+    seed = BENCH_SEED;
+    uint64_t bytes = 0;
+    int seeks = 0;
+
+    start = sceKernelGetProcessTimeWide();
+
+    for (i = 0; i < BENCH_GZ_SEEKS; i++) {
+      uint64_t offset = ((uint64_t)benchRandom() << 8) % (total - 64 * 1024);
+
+      if (gzReaderOpen(&reader, gz_path, pass ? &index : &empty, offset, 0) < 0)
+        break;
+
+      int res = gzReaderRead(&reader, buf, 64 * 1024);
+      gzReaderClose(&reader);
+
+      if (res <= 0)
+        break;
+
+      bytes += res;
+      seeks++;
+    }
+
+    benchReport(pass ? "gzip seek with index" : "gzip seek from start", seeks, sceKernelGetProcessTimeWide() - start, 0);
+  }
+
+  gzIndexFree(&index);
+  free(buf);
+}
+
+// Reads the gzip stream as plain data, the way archive.c feeds libarchive
+static void benchReadAhead(const char *root) {
+  char path[MAX_PATH_LENGTH];
+  snprintf(path, MAX_PATH_LENGTH, "%s/stream.gz", root);
+
+  void *buf = malloc(TRANSFER_SIZE);
+
+  // Plain reads, the checksum stands in for the decompressor
+  SceInt64 start = sceKernelGetProcessTimeWide();
+
+  uint64_t total = 0;
+  uLong crc = crc32(0, NULL, 0);
+  SceUID fd = sceIoOpen(path, SCE_O_RDONLY, 0);
+  if (fd >= 0) {
+    int read;
+    while ((read = sceIoRead(fd, buf, TRANSFER_SIZE)) > 0) {
+      crc = crc32(crc, buf, read);
+      total += read;
+    }
+
+    sceIoClose(fd);
+  }
+
+  benchReport("sequential sceIoRead", 1, sceKernelGetProcessTimeWide() - start, total);
+
+  ReadAhead ra;
+  start = sceKernelGetProcessTimeWide();
+
+  uint64_t ra_total = 0;
+  uLong ra_crc = crc32(0, NULL, 0);
+  if (readAheadOpen(&ra, path) >= 0) {
+    const void *data;
+    int read;
+    while ((read = readAheadRead(&ra, &data)) > 0) {
+      ra_crc = crc32(ra_crc, data, read);
+      ra_total += read;
+    }
+
+    readAheadClose(&ra);
+  }
+
+  benchReport("sequential read ahead", 1, sceKernelGetProcessTimeWide() - start, ra_total);
+
+  if (ra_total != total || ra_crc != crc)
+    printf("read ahead: read %llu of %llu bytes, crc mismatch %d\n",
+           (unsigned long long)ra_total, (unsigned long long)total, ra_crc != crc);
+
+  // Skip and seek like libarchive does between entries, and compare with
+  // the file contents at the same position
+  seed = BENCH_SEED;
+  int i = 0, errors = 0;
+
+  start = sceKernelGetProcessTimeWide();
+
+  fd = sceIoOpen(path, SCE_O_RDONLY, 0);
+  if (fd >= 0 && readAheadOpen(&ra, path) >= 0) {
+    for (i = 0; i < BENCH_READ_AHEAD_SKIPS; i++) {
+      uint32_t r = benchRandom();
+
+      if (r % 16 == 0)
+        readAheadSeek(&ra, ((uint64_t)benchRandom() << 8) % total, SCE_SEEK_SET);
+      else
+        readAheadSkip(&ra, benchRandom() % (2 * READ_AHEAD_BUFFER_SIZE));
+
+      uint64_t position = ra.position;
+
+      const void *data;
+      int read = readAheadRead(&ra, &data);
+      if (read < 0 || (read == 0 && position < total)) {
+        errors++;
+        break;
+      }
+
+      if (read > 0) {
+        if (read > TRANSFER_SIZE)
+          read = TRANSFER_SIZE;
+        if (sceIoPread(fd, buf, read, position) != read || memcmp(buf, data, read) != 0)
+          errors++;
+      } else {
+        readAheadSeek(&ra, 0, SCE_SEEK_SET);
+      }
+    }
+
+    readAheadClose(&ra);
+  }
+
+  if (fd >= 0)
+    sceIoClose(fd);
+
+  benchReport("read ahead skip and seek", i, sceKernelGetProcessTimeWide() - start, 0);
+
+  if (errors)
+    printf("read ahead skip and seek: %d errors\n", errors);
+
+  free(buf);
+}
+
+static int benchPsarcPath(PsarcIndexEntry *entry, char *dst_path, void *argp) {
+  int len = snprintf(dst_path, MAX_PATH_LENGTH, "%s/", (const char *)argp);
+  char *p = dst_path + len;
+
+  snprintf(p, MAX_PATH_LENGTH - len, "%s", entry->name);
+  while ((p = strchr(p, '/')))
+    *p = '_';
+
+  return 0;
+}
+
+static void benchPsarc(const char *root) {
+  char psarc_path[MAX_PATH_LENGTH], src_path[MAX_PATH_LENGTH], dst_path[MAX_PATH_LENGTH];
+  snprintf(psarc_path, MAX_PATH_LENGTH, "%s/data.psarc", root);
+  snprintf(src_path, MAX_PATH_LENGTH, "%s/data", root);
+  snprintf(dst_path, MAX_PATH_LENGTH, "%s/psarc", root);
+
+  seed = BENCH_SEED;
+
+  // Many small files and one big one, like the data of a game
+  char *text = createText(BENCH_PSARC_SIZE * scale);
+  int text_length = strlen(text);
+
+  sceIoMkdir(src_path, 0777);
+
+  char path[MAX_PATH_LENGTH];
+  uint64_t src_size = 0;
+  int i;
+  for (i = 0; i <= BENCH_PSARC_FILES; i++) {
+    int size = text_length;
+    int offset = 0;
+
+    if (i < BENCH_PSARC_FILES) {
+      snprintf(path, MAX_PATH_LENGTH, "%s/%02d", src_path, i % 16);
+      sceIoMkdir(path, 0777);
+      snprintf(path, MAX_PATH_LENGTH, "%s/%02d/file_%04d.txt", src_path, i % 16, i);
+
+      size = benchRandom() % (96 * 1024);
+      offset = benchRandom() % (text_length - size);
+    } else {
+      snprintf(path, MAX_PATH_LENGTH, "%s/big.txt", src_path);
+    }
+
+    SceUID fd = sceIoOpen(path, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0777);
+    if (fd >= 0) {
+      sceIoWrite(fd, text + offset, size);
+      sceIoClose(fd);
+    }
+
+    src_size += size;
+  }
+
+  static const int compress_workers[] = { 1, 2, PSARC_COMPRESS_WORKERS };
+
+  char *src_paths[] = { src_path };
+  int res = 0;
+
+  for (i = 0; i < sizeof(compress_workers) / sizeof(int); i++) {
+    char name[32];
+    snprintf(name, sizeof(name), "makePsarc %d worker%s", compress_workers[i], compress_workers[i] > 1 ? "s" : "");
+
+    uint64_t value = 0;
+    uint32_t items = 0;
+
+    FileProcessParam param;
+    memset(&param, 0, sizeof(FileProcessParam));
+    param.value = &value;
+    param.items = &items;
+    param.max = src_size;
+
+    SceInt64 start = sceKernelGetProcessTimeWide();
+    res = makePsarc(psarc_path, src_paths, 1, strlen(root) + 1, 6, compress_workers[i], &param);
+    SceInt64 time = sceKernelGetProcessTimeWide() - start;
+
+    if (res <= 0) {
+      printf("%-28s failed 0x%08X\n", name, res);
+      continue;
+    }
+
+    benchReport(name, items, time, src_size);
+  }
+
+  if (res <= 0) {
+    free(text);
+    return;
+  }
+
+  PsarcIndex index;
+
+  SceInt64 start = sceKernelGetProcessTimeWide();
+  res = psarcIndexOpen(&index, psarc_path);
+  SceInt64 time = sceKernelGetProcessTimeWide() - start;
+
+  if (res < 0) {
+    printf("%-28s failed 0x%08X\n", "psarc index open", res);
+    free(text);
+    return;
+  }
+
+  benchReport("psarc index open", index.count, time, 0);
+
+  // Random 4 KiB reads in the big file
+  PsarcIndexEntry *big = psarcIndexFind(&index, "data/big.txt");
+  PsarcIndexFile file;
+
+  if (big && psarcIndexFileOpen(&index, &file, big) >= 0) {
+    char buf[4096];
+    int seeks = 0;
+
+    start = sceKernelGetProcessTimeWide();
+
+    for (i = 0; i < BENCH_PSARC_SEEKS; i++) {
+      uint64_t offset = ((uint64_t)benchRandom() << 8) % (big->size - sizeof(buf));
+      psarcIndexFileSeek(&file, offset, SCE_SEEK_SET);
+
+      if (psarcIndexFileRead(&file, buf, sizeof(buf)) != sizeof(buf) ||
+          memcmp(buf, text + offset, sizeof(buf)) != 0) {
+        printf("%-28s failed at %llu\n", "psarc random read", (unsigned long long)offset);
+        break;
+      }
+
+      seeks++;
+    }
+
+    benchReport("psarc random read", seeks, sceKernelGetProcessTimeWide() - start, 0);
+    psarcIndexFileClose(&file);
+  }
+
+  free(text);
+
+  sceIoMkdir(dst_path, 0777);
+
+  PsarcIndexEntry **entries = malloc(index.count * sizeof(PsarcIndexEntry *));
+
+  uint64_t size = 0;
+  for (i = 0; i < index.count; i++) {
+    entries[i] = &index.entries[i];
+    size += index.entries[i].size;
+  }
+
+  PsarcExtractHandler handler;
+  handler.getPath = benchPsarcPath;
+  handler.argp = dst_path;
+
+  static const int workers[] = { 1, 2, PSARC_EXTRACT_WORKERS };
+
+  for (i = 0; i < sizeof(workers) / sizeof(int); i++) {
+    char name[32];
+    snprintf(name, sizeof(name), "psarc extract %d worker%s", workers[i], workers[i] > 1 ? "s" : "");
+
+    uint64_t value = 0;
+    uint32_t items = 0;
+
+    FileProcessParam param;
+    memset(&param, 0, sizeof(FileProcessParam));
+    param.value = &value;
+    param.items = &items;
+    param.max = size;
+
+    start = sceKernelGetProcessTimeWide();
+    res = psarcExtractEntries(&index, entries, index.count, workers[i], &handler, &param);
+    time = sceKernelGetProcessTimeWide() - start;
+
+    if (res <= 0 || value != size) {
+      printf("%-28s failed 0x%08X\n", name, res);
+      continue;
+    }
+
+    benchReport(name, items, time, size);
+  }
+
+  free(entries);
+  psarcIndexClose(&index);
+}
+
+// Reads the entry back through the zip index, which checks its CRC
+static int benchZipCompare(const char *zip_path, const char *name, const char *text, int length) {
+  ZipIndex index;
+  int res = zipIndexOpen(&index, zip_path);
+  if (res < 0)
+    return res;
+
+  ZipIndexFile file;
+  ZipIndexEntry *entry = zipIndexFind(&index, name);
+  if (!entry || (res = zipIndexFileOpen(&index, &file, entry)) < 0) {
+    zipIndexClose(&index);
+    return entry ? res : VITASHELL_ERROR_NOT_FOUND;
+  }
+
+  void *buf = malloc(TRANSFER_SIZE);
+  int offset = 0;
+
+  int read;
+  while ((read = zipIndexFileRead(&file, buf, TRANSFER_SIZE)) > 0) {
+    if (offset + read > length || memcmp(buf, text + offset, read) != 0)
+      break;
+    offset += read;
+  }
+
+  free(buf);
+  zipIndexFileClose(&file);
+  zipIndexClose(&index);
+
+  if (read < 0)
+    return read;
+
+  return offset == length ? 0 : VITASHELL_ERROR_INVALID_MAGIC;
+}
+
+// One big file deflated by minizip alone and in blocks by the workers
+static void benchZipBlocks(const char *root) {
+  char src_path[MAX_PATH_LENGTH];
+  snprintf(src_path, MAX_PATH_LENGTH, "%s/big.txt", root);
+
+  seed = BENCH_SEED;
+
+  char *text = createText(BENCH_ZIP_BLOCKS_SIZE * scale);
+  int text_length = strlen(text);
+
+  if (WriteFile(src_path, text, text_length) < 0) {
+    printf("Could not create %s\n", src_path);
+    free(text);
+    return;
+  }
+
+  static const int levels[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+  static const int compress_workers[] = { 1, 2, ZIP_COMPRESS_WORKERS };
+
+  // makeZip runs no more workers than there are cores
+  printf("makeZip blocks on %d core%s\n", workerPoolCores(), workerPoolCores() > 1 ? "s" : "");
+
+  int i, j;
+  for (i = 0; i < sizeof(levels) / sizeof(int); i++) {
+    for (j = 0; j < sizeof(compress_workers) / sizeof(int); j++) {
+      char zip_path[MAX_PATH_LENGTH], name[32];
+      snprintf(zip_path, MAX_PATH_LENGTH, "%s/big.zip", root);
+      snprintf(name, sizeof(name), "makeZip level %d %d worker%s", levels[i], compress_workers[j],
+               compress_workers[j] > 1 ? "s" : "");
+
+      uint64_t value = 0;
+      uint32_t items = 0;
+
+      FileProcessParam param;
+      memset(&param, 0, sizeof(FileProcessParam));
+      param.value = &value;
+      param.items = &items;
+      param.max = text_length;
+
+      SceInt64 start = sceKernelGetProcessTimeWide();
+      int res = makeZip(zip_path, src_path, strlen(root) + 1, levels[i], APPEND_STATUS_CREATE, compress_workers[j], &param);
+      SceInt64 time = sceKernelGetProcessTimeWide() - start;
+
+      if (res > 0)
+        res = benchZipCompare(zip_path, "big.txt", text, text_length);
+
+      if (res < 0) {
+        printf("%-28s failed 0x%08X\n", name, res);
+        continue;
+      }
+
+      benchReport(name, items, time, text_length);
+      printf("%-28s %8d bytes compressed\n", "", getFileSize(zip_path));
+    }
+  }
+
+  sceIoRemove(src_path);
+  free(text);
+}
+
+static void benchZip(const char *root) {
+  char path[MAX_PATH_LENGTH];
+  snprintf(path, MAX_PATH_LENGTH, "%s/deep_tree", root);
+
+  seed = BENCH_SEED;
+
+  uint64_t size = 0;
+  int files = 0;
+  if (createTree(path, BENCH_TREE_DEPTH + (scale > 1), &size, &files) < 0) {
+    printf("Could not create %s\n", path);
+    return;
+  }
+
+  static const int levels[] = { 0, 1, 6, 9 };
+
+  int i;
+  for (i = 0; i < sizeof(levels) / sizeof(int); i++) {
+    char zip_path[MAX_PATH_LENGTH], name[32];
+    snprintf(zip_path, MAX_PATH_LENGTH, "%s/deep_tree_%d.zip", root, levels[i]);
+    snprintf(name, sizeof(name), "makeZip level %d", levels[i]);
+
+    uint64_t value = 0;
+    uint32_t items = 0;
+
+    FileProcessParam param;
+    memset(&param, 0, sizeof(FileProcessParam));
+    param.value = &value;
+    param.items = &items;
+    param.max = size;
+
+    SceInt64 start = sceKernelGetProcessTimeWide();
+    int res = makeZip(zip_path, path, strlen(root) + 1, levels[i], APPEND_STATUS_CREATE, 1, &param);
+    SceInt64 time = sceKernelGetProcessTimeWide() - start;
+
+    if (res <= 0) {
+      printf("%-28s failed 0x%08X\n", name, res);
+      continue;
+    }
+
+    benchReport(name, items, time, size);
+  }
+
+  benchZipBlocks(root);
+  benchZipIndex(root);
+  benchZipExtract(root);
+  benchGzIndex(root);
+  benchReadAhead(root);
+
+  // Extraction goes through libarchive and archive.c, which are not part of
+  // the core library yet
+  printf("%-28s skipped, needs libarchive\n", "archive extraction");
+}
+
+static char *createText(int size) {
+  char *text = malloc(size + 1);
+
+  int len = 0;
+  while (len < size - 16) {
+    len += snprintf(text + len, size - len, "%s%c", words[benchRandom() % N_WORDS], (benchRandom() % 12) ? ' ' : '\n');
+  }
+
+  text[len] = '\0';
+  return text;
+}
+
+static void benchSearch() {
+  seed = BENCH_SEED;
+
+  int size = BENCH_TEXT_SIZE * scale;
+  char *text = createText(size);
+  int len = strlen(text);
+
+  static const struct {
+    const char *name;
+    const char *needle;
+  } needles[] = {
+    { "boyer_moore frequent", "network device" },
+    { "boyer_moore rare", "savedata license update" },
+    { "boyer_moore absent", "not in the text at all" },
+  };
+
+  int i;
+  for (i = 0; i < sizeof(needles) / sizeof(needles[0]); i++) {
+    // Count all hits, like a search through a text file does
+    int hits = 0;
+
+    SceInt64 start = sceKernelGetProcessTimeWide();
+
+    const char *p = text;
+    while ((p = boyer_moore(p, needles[i].needle)) != NULL) {
+      hits++;
+      p++;
+    }
+
+    benchReport(needles[i].name, hits, sceKernelGetProcessTimeWide() - start, len);
+  }
+
+  free(text);
+}
+
+static void benchHash() {
+  seed = BENCH_SEED;
+
+  int size = BENCH_HASH_SIZE;
+  uint8_t *buf = malloc(size);
+
+  int i;
+  for (i = 0; i < size; i++) {
+    buf[i] = benchRandom();
+  }
+
+  uint8_t hash[32];
+  SceInt64 start;
+
+  SHA1_CTX sha1;
+  start = sceKernelGetProcessTimeWide();
+  for (i = 0; i < scale; i++) {
+    sha1_init(&sha1);
+    sha1_update(&sha1, buf, size);
+    sha1_final(&sha1, hash);
+  }
+  benchReport("sha1", scale, sceKernelGetProcessTimeWide() - start, (uint64_t)size * scale);
+
+  MD5_CTX md5;
+  start = sceKernelGetProcessTimeWide();
+  for (i = 0; i < scale; i++) {
+    md5_init(&md5);
+    md5_update(&md5, buf, size);
+    md5_final(&md5, hash);
+  }
+  benchReport("md5", scale, sceKernelGetProcessTimeWide() - start, (uint64_t)size * scale);
+
+  SHA256_CTX sha256;
+  start = sceKernelGetProcessTimeWide();
+  for (i = 0; i < scale; i++) {
+    sha256_init(&sha256);
+    sha256_update(&sha256, buf, size);
+    sha256_final(&sha256, hash);
+  }
+  benchReport("sha256", scale, sceKernelGetProcessTimeWide() - start, (uint64_t)size * scale);
+
+  free(buf);
+}
+
+static void *createSfo(int *size) {
+  int keys_size = BENCH_SFO_KEYS * 16;
+  int values_size = BENCH_SFO_KEYS * 16;
+  int header_size = sizeof(SfoHeader) + BENCH_SFO_KEYS * sizeof(SfoEntry);
+
+  *size = header_size + keys_size + values_size;
+
+  uint8_t *buffer = malloc(*size);
+  memset(buffer, 0, *size);
+
+  SfoHeader *header = (SfoHeader *)buffer;
+  header->magic = SFO_MAGIC;
+  header->version = 0x101;
+  header->keyofs = header_size;
+  header->valofs = header_size + keys_size;
+  header->count = BENCH_SFO_KEYS;
+
+  SfoEntry *entries = (SfoEntry *)(buffer + sizeof(SfoHeader));
+
+  int i;
+  for (i = 0; i < BENCH_SFO_KEYS; i++) {
+    entries[i].nameofs = i * 16;
+    entries[i].alignment = 4;
+    entries[i].dataofs = i * 16;
+    entries[i].totalsize = 16;
+
+    snprintf((char *)buffer + header->keyofs + i * 16, 16, "KEY_%04d", i);
+
+    if (i & 1) {
+      entries[i].type = PSF_TYPE_VAL;
+      entries[i].valsize = 4;
+      *(uint32_t *)(buffer + header->valofs + i * 16) = i;
+    } else {
+      entries[i].type = PSF_TYPE_STR;
+      snprintf((char *)buffer + header->valofs + i * 16, 16, "VALUE_%04d", i);
+      entries[i].valsize = strlen((char *)buffer + header->valofs + i * 16) + 1;
+    }
+  }
+
+  return buffer;
+}
+
+static void benchSfo() {
+  int size;
+  void *buffer = createSfo(&size);
+
+  int n = BENCH_SFO_LOOKUPS * scale;
+
+  seed = BENCH_SEED;
+
+  SceInt64 start = sceKernelGetProcessTimeWide();
+
+  int i, found = 0;
+  for (i = 0; i < n; i++) {
+    char name[16];
+    int key = benchRandom() % BENCH_SFO_KEYS;
+    snprintf(name, sizeof(name), "KEY_%04d", key);
+
+    if (key & 1) {
+      uint32_t value;
+      found += getSfoValue(buffer, name, &value) == 0;
+    } else {
+      char string[16];
+      found += getSfoString(buffer, name, string, sizeof(string)) == 0;
+    }
+  }
+
+  benchReport("sfo lookup", found, sceKernelGetProcessTimeWide() - start, 0);
+
+  free(buffer);
+}
+
+static void benchLrc() {
+  seed = BENCH_SEED;
+
+  int size = BENCH_LRC_LINES * 96;
+  char *text = malloc(size);
+
+  int len = 0;
+
+  int i;
+  for (i = 0; i < BENCH_LRC_LINES; i++) {
+    int ms = i * 2370;
+    len += snprintf(text + len, size - len, "[%02d:%02d.%02d]%s %s %s\n",
+                    ms / 60000, (ms / 1000) % 60, (ms / 10) % 100,
+                    words[benchRandom() % N_WORDS], words[benchRandom() % N_WORDS], words[benchRandom() % N_WORDS]);
+  }
+
+  int n = BENCH_LRC_PARSES * scale;
+  int lines = 0;
+
+  SceInt64 start = sceKernelGetProcessTimeWide();
+
+  for (i = 0; i < n; i++) {
+    Lyrics *lyrics = lrcParseLoadWithBuffer(text);
+    if (lyrics) {
+      lines += lyrics->lyricscount;
+      lrcParseClose(lyrics);
+    }
+  }
+
+  benchReport("lrc parse", n, sceKernelGetProcessTimeWide() - start, (uint64_t)len * n);
+
+  if (lines != BENCH_LRC_LINES * n)
+    printf("lrc parse: expected %d lines, got %d\n", BENCH_LRC_LINES * n, lines);
+
+  free(text);
+}
+
+int main(int argc, char *argv[]) {
+  const char *root = BENCH_DEFAULT_PATH;
+
+  int i;
+  for (i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+      scale = atoi(argv[++i]);
+      if (scale < 1)
+        scale = 1;
+    } else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+      csv = fopen(argv[++i], "w");
+      if (csv)
+        fprintf(csv, "name,ops,usec,bytes\n");
+    } else if (argv[i][0] != '-') {
+      root = argv[i];
+    } else {
+      printf("usage: %s [--scale N] [--csv FILE] [corpus folder]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  // Start from an empty corpus folder every time
+  removeTree(root);
+  if (sceIoMkdir(root, 0777) < 0) {
+    printf("Could not create %s\n", root);
+    return 1;
+  }
+
+  printf("VitaShell core benchmark, seed 0x%08X, scale %d\n\n", BENCH_SEED, scale);
+
+  benchFileList();
+  benchHugeDir(root);
+  benchZip(root);
+  benchPsarc(root);
+  benchSearch();
+  benchHash();
+  benchSfo();
+  benchLrc();
+
+  removeTree(root);
+
+  if (csv)
+    fclose(csv);
+
+  return 0;
+}
@@ -0,0 +1,48 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __PSP2_IO_FCNTL_H__
+#define __PSP2_IO_FCNTL_H__
+
+#include <psp2/types.h>
+
+#define SCE_O_RDONLY  0x0001
+#define SCE_O_WRONLY  0x0002
+#define SCE_O_RDWR    (SCE_O_RDONLY | SCE_O_WRONLY)
+#define SCE_O_NBLOCK  0x0004
+#define SCE_O_APPEND  0x0100
+#define SCE_O_CREAT   0x0200
+#define SCE_O_TRUNC   0x0400
+#define SCE_O_EXCL    0x0800
+
+#define SCE_SEEK_SET 0
+#define SCE_SEEK_CUR 1
+#define SCE_SEEK_END 2
+
+SceUID sceIoOpen(const char *file, int flags, SceMode mode);
+int sceIoClose(SceUID fd);
+int sceIoRead(SceUID fd, void *data, SceSize size);
+int sceIoWrite(SceUID fd, const void *data, SceSize size);
+SceOff sceIoLseek(SceUID fd, SceOff offset, int whence);
+int sceIoLseek32(SceUID fd, int offset, int whence);
+int sceIoPread(SceUID fd, void *data, SceSize size, SceOff offset);
+int sceIoPwrite(SceUID fd, const void *data, SceSize size, SceOff offset);
+int sceIoRemove(const char *file);
+int sceIoRename(const char *oldname, const char *newname);
+
+#endif
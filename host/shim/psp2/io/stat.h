@@ -0,0 +1,55 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __PSP2_IO_STAT_H__
+#define __PSP2_IO_STAT_H__
+
+#include <psp2/types.h>
+
+#define SCE_S_IFMT  0xF000
+#define SCE_S_IFLNK 0x4000
+#define SCE_S_IFDIR 0x1000
+#define SCE_S_IFREG 0x2000
+
+#define SCE_S_ISLNK(m) (((m) & SCE_S_IFMT) == SCE_S_IFLNK)
+#define SCE_S_ISREG(m) (((m) & SCE_S_IFMT) == SCE_S_IFREG)
+#define SCE_S_ISDIR(m) (((m) & SCE_S_IFMT) == SCE_S_IFDIR)
+
+#define SCE_CST_MODE 0x0001
+#define SCE_CST_SIZE 0x0004
+#define SCE_CST_CT   0x0008
+#define SCE_CST_AT   0x0010
+#define SCE_CST_MT   0x0020
+
+typedef struct SceIoStat {
+  SceMode st_mode;
+  unsigned int st_attr;
+  SceOff st_size;
+  SceDateTime st_ctime;
+  SceDateTime st_atime;
+  SceDateTime st_mtime;
+  unsigned int st_private[6];
+} SceIoStat;
+
+int sceIoMkdir(const char *dir, SceMode mode);
+int sceIoRmdir(const char *path);
+int sceIoGetstat(const char *file, SceIoStat *stat);
+int sceIoChstat(const char *file, const SceIoStat *stat, unsigned int bits);
+int sceIoChstatByFd(SceUID fd, const SceIoStat *stat, unsigned int bits);
+
+#endif
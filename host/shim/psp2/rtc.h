@@ -0,0 +1,38 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __PSP2_RTC_H__
+#define __PSP2_RTC_H__
+
+#include <psp2/types.h>
+
+// Microseconds since 0001-01-01 00:00:00
+typedef struct SceRtcTick {
+  SceUInt64 tick;
+} SceRtcTick;
+
+int sceRtcGetTick(const SceDateTime *time, SceRtcTick *tick);
+int sceRtcSetTick(SceDateTime *time, const SceRtcTick *tick);
+int sceRtcGetCurrentClock(SceDateTime *time, int time_zone);
+int sceRtcGetCurrentTick(SceRtcTick *tick);
+
+// The host has no time zone setting, local time is UTC
+int sceRtcConvertUtcToLocalTime(const SceRtcTick *utc, SceRtcTick *local_time);
+int sceRtcConvertLocalTimeToUtc(const SceRtcTick *local_time, SceRtcTick *utc);
+
+#endif
@@ -0,0 +1,48 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __PSP2_TYPES_H__
+#define __PSP2_TYPES_H__
+
+// Host replacement for the VitaSDK types used by the core library
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef int SceUID;
+typedef int SceMode;
+typedef int64_t SceOff;
+typedef unsigned int SceSize;
+typedef int64_t SceInt64;
+typedef unsigned int SceUInt;
+typedef uint64_t SceUInt64;
+
+typedef struct SceDateTime {
+  unsigned short year;
+  unsigned short month;
+  unsigned short day;
+  unsigned short hour;
+  unsigned short minute;
+  unsigned short second;
+  unsigned int microsecond;
+} SceDateTime;
+
+// Errors are returned like on the Vita: 0x80010000 | errno
+#define SCE_ERROR_ERRNO(e) ((int)(0x80010000 | (e)))
+
+#endif
@@ -0,0 +1,549 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// POSIX implementation of the sceIo, sceRtc and sceKernel calls used by the
+// core library. Paths are passed through unchanged, threads and semaphores
+// map to pthreads.
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+// glibc maps st_[acm]time to struct timespec members, which would also
+// rename the SceIoStat fields
+#undef st_atime
+#undef st_ctime
+#undef st_mtime
+
+#include <psp2/types.h>
+#include <psp2/io/fcntl.h>
+#include <psp2/io/stat.h>
+#include <psp2/io/dirent.h>
+#include <psp2/rtc.h>
+#include <psp2/kernel/processmgr.h>
+#include <psp2/kernel/threadmgr.h>
+
+#define MAX_DIRS 64
+#define DIR_UID_BASE 0x10000
+
+#define MAX_THREADS 16
+#define THREAD_UID_BASE 0x20000
+#define MAX_ARGS_SIZE 256
+
+#define MAX_SEMAS 64
+#define SEMA_UID_BASE 0x30000
+
+#define TICKS_PER_SECOND 1000000ULL
+#define TICKS_PER_DAY (86400ULL * TICKS_PER_SECOND)
+
+// Days between 0001-01-01 and 1970-01-01
+#define UNIX_EPOCH_DAYS 719162LL
+
+typedef struct {
+  DIR *dir;
+  char path[1024];
+} ShimDir;
+
+static ShimDir dirs[MAX_DIRS];
+
+typedef struct {
+  int used;
+  pthread_t thread;
+  SceKernelThreadEntry entry;
+  SceSize arglen;
+  uint8_t args[MAX_ARGS_SIZE];
+} ShimThread;
+
+typedef struct {
+  int used;
+  int count;
+  int max;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+} ShimSema;
+
+static ShimThread threads[MAX_THREADS];
+static ShimSema semas[MAX_SEMAS];
+static pthread_mutex_t uid_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int errnoToSce() {
+  return SCE_ERROR_ERRNO(errno);
+}
+
+// Howard Hinnant's days_from_civil, counted from 0001-01-01
+static int64_t daysFromCivil(int64_t y, unsigned m, unsigned d) {
+  y -= m <= 2;
+  int64_t era = (y >= 0 ? y : y - 399) / 400;
+  unsigned yoe = (unsigned)(y - era * 400);
+  unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + (int64_t)doe - 719468 + UNIX_EPOCH_DAYS;
+}
+
+static void civilFromDays(int64_t z, SceDateTime *time) {
+  z -= UNIX_EPOCH_DAYS;
+  z += 719468;
+  int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+  unsigned doe = (unsigned)(z - era * 146097);
+  unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  unsigned mp = (5 * doy + 2) / 153;
+  unsigned m = mp + (mp < 10 ? 3 : -9);
+  time->year = (unsigned short)(yoe + era * 400 + (m <= 2));
+  time->month = m;
+  time->day = doy - (153 * mp + 2) / 5 + 1;
+}
+
+static void timeToDateTime(time_t t, long nsec, SceDateTime *time) {
+  SceRtcTick tick;
+  tick.tick = (uint64_t)(t + UNIX_EPOCH_DAYS * 86400LL) * TICKS_PER_SECOND + nsec / 1000;
+  sceRtcSetTick(time, &tick);
+}
+
+static void statToSce(const struct stat *st, SceIoStat *stat) {
+  memset(stat, 0, sizeof(SceIoStat));
+  stat->st_mode = S_ISDIR(st->st_mode) ? SCE_S_IFDIR : S_ISLNK(st->st_mode) ? SCE_S_IFLNK : SCE_S_IFREG;
+  stat->st_mode |= st->st_mode & 0777;
+  stat->st_size = S_ISDIR(st->st_mode) ? 0 : st->st_size;
+  timeToDateTime(st->st_ctim.tv_sec, st->st_ctim.tv_nsec, &stat->st_ctime);
+  timeToDateTime(st->st_atim.tv_sec, st->st_atim.tv_nsec, &stat->st_atime);
+  timeToDateTime(st->st_mtim.tv_sec, st->st_mtim.tv_nsec, &stat->st_mtime);
+}
+
+SceUID sceIoOpen(const char *file, int flags, SceMode mode) {
+  int oflags = 0;
+
+  if ((flags & SCE_O_RDWR) == SCE_O_RDWR)
+    oflags = O_RDWR;
+  else if (flags & SCE_O_WRONLY)
+    oflags = O_WRONLY;
+  else
+    oflags = O_RDONLY;
+
+  if (flags & SCE_O_APPEND)
+    oflags |= O_APPEND;
+  if (flags & SCE_O_CREAT)
+    oflags |= O_CREAT;
+  if (flags & SCE_O_TRUNC)
+    oflags |= O_TRUNC;
+  if (flags & SCE_O_EXCL)
+    oflags |= O_EXCL;
+
+  int fd = open(file, oflags, mode);
+  if (fd < 0)
+    return errnoToSce();
+
+  return fd;
+}
+
+int sceIoClose(SceUID fd) {
+  return close(fd) < 0 ? errnoToSce() : 0;
+}
+
+int sceIoRead(SceUID fd, void *data, SceSize size) {
+  ssize_t res = read(fd, data, size);
+  return res < 0 ? errnoToSce() : (int)res;
+}
+
+int sceIoWrite(SceUID fd, const void *data, SceSize size) {
+  ssize_t res = write(fd, data, size);
+  return res < 0 ? errnoToSce() : (int)res;
+}
+
+SceOff sceIoLseek(SceUID fd, SceOff offset, int whence) {
+  off_t res = lseek(fd, offset, whence);
+  return res < 0 ? errnoToSce() : (SceOff)res;
+}
+
+int sceIoLseek32(SceUID fd, int offset, int whence) {
+  return (int)sceIoLseek(fd, offset, whence);
+}
+
+int sceIoPread(SceUID fd, void *data, SceSize size, SceOff offset) {
+  ssize_t res = pread(fd, data, size, offset);
+  return res < 0 ? errnoToSce() : (int)res;
+}
+
+int sceIoPwrite(SceUID fd, const void *data, SceSize size, SceOff offset) {
+  ssize_t res = pwrite(fd, data, size, offset);
+  return res < 0 ? errnoToSce() : (int)res;
+}
+
+int sceIoRemove(const char *file) {
+  return unlink(file) < 0 ? errnoToSce() : 0;
+}
+
+int sceIoRename(const char *oldname, const char *newname) {
+  return rename(oldname, newname) < 0 ? errnoToSce() : 0;
+}
+
+int sceIoMkdir(const char *dir, SceMode mode) {
+  return mkdir(dir, mode) < 0 ? errnoToSce() : 0;
+}
+
+int sceIoRmdir(const char *path) {
+  return rmdir(path) < 0 ? errnoToSce() : 0;
+}
+
+static void dateTimeToTimespec(const SceDateTime *time, struct timespec *ts) {
+  SceRtcTick tick;
+  sceRtcGetTick(time, &tick);
+
+  uint64_t ticks = tick.tick - (uint64_t)UNIX_EPOCH_DAYS * 86400ULL * TICKS_PER_SECOND;
+  ts->tv_sec = ticks / TICKS_PER_SECOND;
+  ts->tv_nsec = (ticks % TICKS_PER_SECOND) * 1000;
+}
+
+// Only the times can be changed
+static void statToTimespecs(const SceIoStat *stat, unsigned int bits, struct timespec *times) {
+  times[0].tv_nsec = UTIME_OMIT;
+  times[1].tv_nsec = UTIME_OMIT;
+
+  if (bits & SCE_CST_AT)
+    dateTimeToTimespec(&stat->st_atime, &times[0]);
+  if (bits & SCE_CST_MT)
+    dateTimeToTimespec(&stat->st_mtime, &times[1]);
+}
+
+int sceIoChstat(const char *file, const SceIoStat *stat, unsigned int bits) {
+  struct timespec times[2];
+  statToTimespecs(stat, bits, times);
+
+  return utimensat(AT_FDCWD, file, times, 0) < 0 ? errnoToSce() : 0;
+}
+
+int sceIoChstatByFd(SceUID fd, const SceIoStat *stat, unsigned int bits) {
+  struct timespec times[2];
+  statToTimespecs(stat, bits, times);
+
+  return futimens(fd, times) < 0 ? errnoToSce() : 0;
+}
+
+int sceIoGetstat(const char *file, SceIoStat *stat) {
+  struct stat st;
+  if (lstat(file, &st) < 0)
+    return errnoToSce();
+
+  statToSce(&st, stat);
+  return 0;
+}
+
+SceUID sceIoDopen(const char *dirname) {
+  int i;
+  for (i = 0; i < MAX_DIRS; i++) {
+    if (!dirs[i].dir)
+      break;
+  }
+
+  if (i == MAX_DIRS)
+    return SCE_ERROR_ERRNO(EMFILE);
+
+  DIR *dir = opendir(dirname);
+  if (!dir)
+    return errnoToSce();
+
+  dirs[i].dir = dir;
+  snprintf(dirs[i].path, sizeof(dirs[i].path), "%s", dirname);
+
+  return DIR_UID_BASE + i;
+}
+
+int sceIoDread(SceUID fd, SceIoDirent *dir) {
+  int i = fd - DIR_UID_BASE;
+  if (i < 0 || i >= MAX_DIRS || !dirs[i].dir)
+    return SCE_ERROR_ERRNO(EBADF);
+
+  // Like on the Vita, '.' and '..' are not reported
+  struct dirent *ent;
+  do {
+    errno = 0;
+    ent = readdir(dirs[i].dir);
+    if (!ent)
+      return errno ? errnoToSce() : 0;
+  } while (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0);
+
+  memset(dir, 0, sizeof(SceIoDirent));
+  snprintf(dir->d_name, sizeof(dir->d_name), "%s", ent->d_name);
+
+  char path[2048];
+  snprintf(path, sizeof(path), "%s/%s", dirs[i].path, ent->d_name);
+
+  struct stat st;
+  if (lstat(path, &st) == 0)
+    statToSce(&st, &dir->d_stat);
+
+  return 1;
+}
+
+int sceIoDclose(SceUID fd) {
+  int i = fd - DIR_UID_BASE;
+  if (i < 0 || i >= MAX_DIRS || !dirs[i].dir)
+    return SCE_ERROR_ERRNO(EBADF);
+
+  closedir(dirs[i].dir);
+  dirs[i].dir = NULL;
+
+  return 0;
+}
+
+int sceRtcGetTick(const SceDateTime *time, SceRtcTick *tick) {
+  int64_t days = daysFromCivil(time->year, time->month, time->day);
+  uint64_t seconds = (uint64_t)days * 86400ULL + time->hour * 3600ULL + time->minute * 60ULL + time->second;
+  tick->tick = seconds * TICKS_PER_SECOND + time->microsecond;
+  return 0;
+}
+
+int sceRtcSetTick(SceDateTime *time, const SceRtcTick *tick) {
+  uint64_t days = tick->tick / TICKS_PER_DAY;
+  uint64_t rest = tick->tick % TICKS_PER_DAY;
+
+  civilFromDays((int64_t)days, time);
+  time->hour = rest / (3600ULL * TICKS_PER_SECOND);
+  time->minute = (rest / (60ULL * TICKS_PER_SECOND)) % 60;
+  time->second = (rest / TICKS_PER_SECOND) % 60;
+  time->microsecond = rest % TICKS_PER_SECOND;
+
+  return 0;
+}
+
+int sceRtcGetCurrentTick(SceRtcTick *tick) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  tick->tick = (uint64_t)(ts.tv_sec + UNIX_EPOCH_DAYS * 86400LL) * TICKS_PER_SECOND + ts.tv_nsec / 1000;
+  return 0;
+}
+
+int sceRtcGetCurrentClock(SceDateTime *time, int time_zone) {
+  SceRtcTick tick;
+  sceRtcGetCurrentTick(&tick);
+  tick.tick += (int64_t)time_zone * 60 * TICKS_PER_SECOND;
+  return sceRtcSetTick(time, &tick);
+}
+
+int sceRtcConvertUtcToLocalTime(const SceRtcTick *utc, SceRtcTick *local_time) {
+  local_time->tick = utc->tick;
+  return 0;
+}
+
+int sceRtcConvertLocalTimeToUtc(const SceRtcTick *local_time, SceRtcTick *utc) {
+  utc->tick = local_time->tick;
+  return 0;
+}
+
+SceInt64 sceKernelGetProcessTimeWide(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (SceInt64)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static void *threadStart(void *argp) {
+  ShimThread *thread = argp;
+  return (void *)(intptr_t)thread->entry(thread->arglen, thread->arglen ? thread->args : NULL);
+}
+
+static ShimThread *getThread(SceUID thid) {
+  int i = thid - THREAD_UID_BASE;
+  if (i < 0 || i >= MAX_THREADS || !threads[i].used)
+    return NULL;
+
+  return &threads[i];
+}
+
+SceUID sceKernelCreateThread(const char *name, SceKernelThreadEntry entry, int initPriority,
+                             int stackSize, SceUInt attr, int cpuAffinityMask, const void *option) {
+  pthread_mutex_lock(&uid_mutex);
+
+  int i;
+  for (i = 0; i < MAX_THREADS; i++) {
+    if (!threads[i].used) {
+      memset(&threads[i], 0, sizeof(ShimThread));
+      threads[i].used = 1;
+      threads[i].entry = entry;
+      break;
+    }
+  }
+
+  pthread_mutex_unlock(&uid_mutex);
+
+  return i < MAX_THREADS ? THREAD_UID_BASE + i : SCE_ERROR_ERRNO(EAGAIN);
+}
+
+int sceKernelStartThread(SceUID thid, SceSize arglen, void *argp) {
+  ShimThread *thread = getThread(thid);
+  if (!thread || arglen > MAX_ARGS_SIZE)
+    return SCE_ERROR_ERRNO(EINVAL);
+
+  // Arguments are copied like on the Vita
+  thread->arglen = arglen;
+  if (arglen)
+    memcpy(thread->args, argp, arglen);
+
+  if (pthread_create(&thread->thread, NULL, threadStart, thread) != 0)
+    return SCE_ERROR_ERRNO(EAGAIN);
+
+  return 0;
+}
+
+int sceKernelExitThread(int status) {
+  pthread_exit((void *)(intptr_t)status);
+}
+
+int sceKernelWaitThreadEnd(SceUID thid, int *stat, SceUInt *timeout) {
+  ShimThread *thread = getThread(thid);
+  if (!thread)
+    return SCE_ERROR_ERRNO(EINVAL);
+
+  void *ret;
+  if (pthread_join(thread->thread, &ret) != 0)
+    return SCE_ERROR_ERRNO(EINVAL);
+
+  if (stat)
+    *stat = (int)(intptr_t)ret;
+
+  return 0;
+}
+
+int sceKernelDeleteThread(SceUID thid) {
+  ShimThread *thread = getThread(thid);
+  if (!thread)
+    return SCE_ERROR_ERRNO(EINVAL);
+
+  pthread_mutex_lock(&uid_mutex);
+  thread->used = 0;
+  pthread_mutex_unlock(&uid_mutex);
+
+  return 0;
+}
+
+// The online host cores stand in for the three user cores of the Vita
+int sceKernelGetThreadCpuAffinityMask(SceUID thid) {
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  int mask = 0;
+
+  int i;
+  for (i = 0; i < cores && i < 3; i++)
+    mask |= SCE_KERNEL_CPU_MASK_USER_0 << i;
+
+  return mask ? mask : SCE_KERNEL_CPU_MASK_USER_0;
+}
+
+static ShimSema *getSema(SceUID semaid) {
+  int i = semaid - SEMA_UID_BASE;
+  if (i < 0 || i >= MAX_SEMAS || !semas[i].used)
+    return NULL;
+
+  return &semas[i];
+}
+
+SceUID sceKernelCreateSema(const char *name, SceUInt attr, int initVal, int maxVal, void *option) {
+  pthread_mutex_lock(&uid_mutex);
+
+  int i;
+  for (i = 0; i < MAX_SEMAS; i++) {
+    if (!semas[i].used) {
+      semas[i].used = 1;
+      semas[i].count = initVal;
+      semas[i].max = maxVal;
+      pthread_mutex_init(&semas[i].mutex, NULL);
+      pthread_cond_init(&semas[i].cond, NULL);
+      break;
+    }
+  }
+
+  pthread_mutex_unlock(&uid_mutex);
+
+  return i < MAX_SEMAS ? SEMA_UID_BASE + i : SCE_ERROR_ERRNO(EAGAIN);
+}
+
+int sceKernelDeleteSema(SceUID semaid) {
+  ShimSema *sema = getSema(semaid);
+  if (!sema)
+    return SCE_ERROR_ERRNO(EINVAL);
+
+  pthread_mutex_destroy(&sema->mutex);
+  pthread_cond_destroy(&sema->cond);
+
+  pthread_mutex_lock(&uid_mutex);
+  sema->used = 0;
+  pthread_mutex_unlock(&uid_mutex);
+
+  return 0;
+}
+
+int sceKernelSignalSema(SceUID semaid, int signal) {
+  ShimSema *sema = getSema(semaid);
+  if (!sema)
+    return SCE_ERROR_ERRNO(EINVAL);
+
+  pthread_mutex_lock(&sema->mutex);
+
+  if (sema->count + signal > sema->max) {
+    pthread_mutex_unlock(&sema->mutex);
+    return SCE_ERROR_ERRNO(EOVERFLOW);
+  }
+
+  sema->count += signal;
+  pthread_cond_broadcast(&sema->cond);
+  pthread_mutex_unlock(&sema->mutex);
+
+  return 0;
+}
+
+// Timeouts are not supported
+int sceKernelWaitSema(SceUID semaid, int signal, SceUInt *timeout) {
+  ShimSema *sema = getSema(semaid);
+  if (!sema)
+    return SCE_ERROR_ERRNO(EINVAL);
+
+  pthread_mutex_lock(&sema->mutex);
+
+  while (sema->count < signal)
+    pthread_cond_wait(&sema->cond, &sema->mutex);
+
+  sema->count -= signal;
+  pthread_mutex_unlock(&sema->mutex);
+
+  return 0;
+}
+
+int sceKernelPollSema(SceUID semaid, int signal) {
+  ShimSema *sema = getSema(semaid);
+  if (!sema)
+    return SCE_ERROR_ERRNO(EINVAL);
+
+  pthread_mutex_lock(&sema->mutex);
+
+  int res = SCE_ERROR_ERRNO(EAGAIN);
+  if (sema->count >= signal) {
+    sema->count -= signal;
+    res = 0;
+  }
+
+  pthread_mutex_unlock(&sema->mutex);
+
+  return res;
+}
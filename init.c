@@ -20,6 +20,7 @@
 #include "browser.h"
 #include "init.h"
 #include "file.h"
+#include "archive.h"
 #include "package_installer.h"
 #include "utils.h"
 #include "qr.h"
@@ -309,6 +310,7 @@ void installDefaultFiles() {
   // Make VitaShell folders
   sceIoMkdir("ux0:VitaShell", 0777);
   sceIoMkdir("ux0:VitaShell/internal", 0777);
+  sceIoMkdir(ARCHIVE_CACHE_PATH, 0777);
   sceIoMkdir("ux0:VitaShell/language", 0777);
   sceIoMkdir("ux0:VitaShell/module", 0777);
   sceIoMkdir("ux0:VitaShell/theme", 0777);
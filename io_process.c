@@ -18,24 +18,51 @@
 
 #include "main.h"
 #include "io_process.h"
+#include "makezip.h"
+#include "makepsarc.h"
 #include "archive.h"
 #include "file.h"
 #include "message_dialog.h"
 #include "uncommon_dialog.h"
 #include "language.h"
 #include "utils.h"
+#include "progress.h"
+
+#include "minizip/zip.h"
 
 static uint64_t current_value = 0;
+static uint32_t current_items = 0;
 static char current_file_name[256] = {0};
-static uint64_t start_time = 0;
-static uint64_t last_update_time = 0;
 
+static volatile int update_running = 0;
+static volatile int progress_canceled = 0;
+
+static uint32_t copy_skipped = 0;
+
+// Called from the file loops, must be cheap
 int cancelHandler() {
-  return (updateMessageDialog() != MESSAGE_DIALOG_RESULT_RUNNING);
+  // Without the update thread nobody watches the dialog, ask it directly
+  if (!update_running)
+    return (updateMessageDialog() != MESSAGE_DIALOG_RESULT_RUNNING);
+
+  return progress_canceled;
 }
 
 void SetProgress(uint64_t value, uint64_t max) {
-  current_value = value;
+  progressStore(&current_value, value);
+}
+
+uint32_t getCopySkipped() {
+  return copy_skipped;
+}
+
+void initFileProcessParam(FileProcessParam *param, uint64_t *value, uint64_t max) {
+  memset(param, 0, sizeof(FileProcessParam));
+  param->value = value;
+  param->items = &current_items;
+  param->max = max;
+  param->SetProgress = SetProgress;
+  param->cancelHandler = cancelHandler;
 }
 
 void SetCurrentFile(const char *filename) {
@@ -74,77 +101,52 @@ void SetCurrentFile(const char *filename) {
 }
 
 static int update_thread(SceSize args_size, UpdateArguments *args) {
-  uint64_t previous_value = current_value;
-  SceUInt64 cur_micros = 0, delta_micros = 0, last_micros = 0;
-  double kbs = 0.0;
-  int update_count = 0;
-  
-  // Initialize start time
-  if (start_time == 0) {
-    start_time = sceKernelGetProcessTimeWide();
-    last_update_time = start_time;
-    last_micros = start_time;
-  }
-
-  while (current_value < args->max && isMessageDialogRunning()) {
-    // Always update progress bar - this is critical!
-    if (args->max > 0) {
-      uint32_t progress = (uint32_t)((current_value * 100) / args->max);
-      if (progress <= 100) {
-        sceMsgDialogProgressBarSetValue(SCE_MSG_DIALOG_PROGRESSBAR_TARGET_BAR_DEFAULT, progress);
-      }
+  ProgressSampler sampler;
+  progressSamplerInit(&sampler, 0, 0);
+
+  while (1) {
+    // The dialog has been closed or canceled, let the worker know
+    if (!isMessageDialogRunning() || sceMsgDialogGetStatus() != SCE_COMMON_DIALOG_STATUS_RUNNING) {
+      progress_canceled = 1;
+      break;
     }
-    
-    // Show speed info every 2 seconds to avoid lag
-    if (args->show_kbs && cur_micros >= (last_micros + 2000 * 1000)) {
-      delta_micros = cur_micros - last_micros;
-      last_micros = cur_micros;
-      
-      if (delta_micros > 0 && current_value > previous_value) {
-        kbs = (double)(current_value - previous_value) / 1024.0;
-        previous_value = current_value;
-        
-        char msg[64];
-        if (kbs >= 1024.0) {
-          snprintf(msg, sizeof(msg), "%.1f MB/s", kbs / 1024.0);
-        } else if (kbs > 0.1) {
-          snprintf(msg, sizeof(msg), "%.0f KB/s", kbs);
-        } else {
-          strcpy(msg, "Processing...");
-        }
-        
-        sceMsgDialogProgressBarSetInfo(SCE_MSG_DIALOG_PROGRESSBAR_TARGET_BAR_DEFAULT, (SceChar8 *)msg);
-      }
+
+    uint64_t value = progressLoad(&current_value);
+    if (value >= args->max)
+      break;
+
+    sceMsgDialogProgressBarSetValue(SCE_MSG_DIALOG_PROGRESSBAR_TARGET_BAR_DEFAULT, (uint32_t)((value * 100) / args->max));
+
+    // Speed, file rate and remaining time
+    if (progressSamplerUpdate(&sampler, value, current_items)) {
+      char info[MAX_PROGRESS_STRING_LENGTH];
+      progressSamplerGetString(&sampler, info, sizeof(info), value, args->max, args->show_kbs ? 1 : 0);
+      sceMsgDialogProgressBarSetInfo(SCE_MSG_DIALOG_PROGRESSBAR_TARGET_BAR_DEFAULT, (SceChar8 *)info);
     }
-    update_count++;
-    
-    // Temporarily disabled KB/s for debugging progress
 
     sceKernelDelayThread(COUNTUP_WAIT);
   }
 
+  update_running = 0;
+
   return sceKernelExitDeleteThread(0);
 }
 
 SceUID createStartUpdateThread(uint64_t max, int show_kbs) {
-  return createStartUpdateThreadEx(max, show_kbs, NULL, 0);
-}
-
-SceUID createStartUpdateThreadEx(uint64_t max, int show_kbs, char *current_file, int show_eta) {
   current_value = 0;
-  start_time = 0;
-  last_update_time = 0;
+  current_items = 0;
+  progress_canceled = 0;
   memset(current_file_name, 0, sizeof(current_file_name));
 
+  sceMsgDialogProgressBarSetInfo(SCE_MSG_DIALOG_PROGRESSBAR_TARGET_BAR_DEFAULT, (SceChar8 *)"");
+
   UpdateArguments args;
   args.max = max;
   args.show_kbs = show_kbs;
-  args.current_file = current_file;
-  args.show_eta = show_eta;
 
-  // Create update thread with normal priority
   SceUID thid = sceKernelCreateThread("update_thread", (SceKernelThreadEntry)update_thread, 0xBF, 0x4000, 0, 0, NULL);
   if (thid >= 0) {
+    update_running = 1;
     sceKernelStartThread(thid, sizeof(UpdateArguments), &args);
   }
 
@@ -206,10 +208,7 @@ int delete_thread(SceSize args_size, DeleteArguments *args) {
     snprintf(path, MAX_PATH_LENGTH, "%s%s", args->file_list->path, mark_entry->name);
 
     FileProcessParam param;
-    param.value = &value;
-    param.max = total;
-    param.SetProgress = SetProgress;
-    param.cancelHandler = cancelHandler;
+    initFileProcessParam(&param, &value, total);
     int res = removePath(path, &param);
     if (res <= 0) {
       closeWaitDialog();
@@ -256,6 +255,8 @@ int copy_thread(SceSize args_size, CopyArguments *args) {
   char path[MAX_PATH_LENGTH], src_path[MAX_PATH_LENGTH], dst_path[MAX_PATH_LENGTH];
   FileListEntry *copy_entry = NULL;
 
+  copy_skipped = 0;
+
   // Check if src and dst are in the same partition when moving
   int diff_partition = 0;
 
@@ -352,32 +353,36 @@ int copy_thread(SceSize args_size, CopyArguments *args) {
       goto EXIT;
 
     // Update thread with enhanced progress (show speed and ETA for copy operations)
-    thid = createStartUpdateThreadEx(total, 1, NULL, 1);
+    thid = createStartUpdateThread(total, 1);
 
     // Copy process
     uint64_t value = 0;
 
-    copy_entry = args->copy_list->head;
+    if (args->copy_mode == COPY_MODE_EXTRACT) {
+      // All entries are extracted in one pass over the archive
+      FileProcessParam param;
+      initFileProcessParam(&param, &value, total);
 
-    for (i = 0; i < args->copy_list->length; i++) {
-      snprintf(src_path, MAX_PATH_LENGTH, "%s%s", args->copy_list->path, copy_entry->name);
-      snprintf(dst_path, MAX_PATH_LENGTH, "%s%s", args->file_list->path, copy_entry->name);
+      archiveSetSkipIdentical(vitashell_config.skip_identical ? &copy_skipped : NULL);
+      int res = extractArchiveEntries(args->copy_list, args->file_list->path, &param);
+      archiveSetSkipIdentical(NULL);
 
-      FileProcessParam param;
-      param.value = &value;
-      param.max = total;
-      param.SetProgress = SetProgress;
-      param.cancelHandler = cancelHandler;
+      if (res <= 0) {
+        closeWaitDialog();
+        setDialogStep(DIALOG_STEP_CANCELED);
+        errorDialog(res);
+        goto EXIT;
+      }
+    } else {
+      copy_entry = args->copy_list->head;
+
+      for (i = 0; i < args->copy_list->length; i++) {
+        snprintf(src_path, MAX_PATH_LENGTH, "%s%s", args->copy_list->path, copy_entry->name);
+        snprintf(dst_path, MAX_PATH_LENGTH, "%s%s", args->file_list->path, copy_entry->name);
+
+        FileProcessParam param;
+        initFileProcessParam(&param, &value, total);
 
-      if (args->copy_mode == COPY_MODE_EXTRACT) {
-        int res = extractArchivePath(src_path, dst_path, &param);
-        if (res <= 0) {
-          closeWaitDialog();
-          setDialogStep(DIALOG_STEP_CANCELED);
-          errorDialog(res);
-          goto EXIT;
-        }
-      } else {
         int res = copyPath(src_path, dst_path, &param);
         if (res <= 0) {
           closeWaitDialog();
@@ -385,9 +390,9 @@ int copy_thread(SceSize args_size, CopyArguments *args) {
           errorDialog(res);
           goto EXIT;
         }
-      }
 
-      copy_entry = copy_entry->next;
+        copy_entry = copy_entry->next;
+      }
     }
 
     // Remove src when moving between partitions
@@ -398,10 +403,7 @@ int copy_thread(SceSize args_size, CopyArguments *args) {
         snprintf(path, MAX_PATH_LENGTH, "%s%s", args->copy_list->path, copy_entry->name);
 
         FileProcessParam param;
-        param.value = &value;
-        param.max = total;
-        param.SetProgress = SetProgress;
-        param.cancelHandler = cancelHandler;
+        initFileProcessParam(&param, &value, total);
         int res = removePath(path, &param);
         if (res <= 0) {
           closeWaitDialog();
@@ -442,7 +444,131 @@ EXIT_ARCHIVE_OPEN:
   return sceKernelExitDeleteThread(0);
 }
 
-static int mediaPathHandler(const char *path) {
+int compress_thread(SceSize args_size, CompressArguments *args) {
+  SceUID thid = -1;
+
+  // Lock power timers
+  powerLock();
+
+  // Set progress to 0%
+  sceMsgDialogProgressBarSetValue(SCE_MSG_DIALOG_PROGRESSBAR_TARGET_BAR_DEFAULT, 0);
+  sceKernelDelayThread(DIALOG_WAIT); // Needed to see the percentage
+
+  FileListEntry *file_entry = fileListGetNthEntry(args->file_list, args->index);
+
+  int count = 0;
+  FileListEntry *head = NULL;
+  FileListEntry *mark_entry_one = NULL;
+
+  if (fileListFindEntry(args->mark_list, file_entry->name)) { // On marked entry
+    count = args->mark_list->length;
+    head = args->mark_list->head;
+  } else {
+    count = 1;
+    mark_entry_one = fileListCopyEntry(file_entry);
+    head = mark_entry_one;
+  }
+
+  char path[MAX_PATH_LENGTH];
+  FileListEntry *mark_entry = NULL;
+
+  // Store decisions of the files the estimate sampled
+  ZipSampleList samples;
+  memset(&samples, 0, sizeof(ZipSampleList));
+
+  // Get paths info
+  uint64_t size = 0;
+  uint32_t folders = 0, files = 0;
+
+  mark_entry = head;
+
+  int i;
+  for (i = 0; i < count; i++) {
+    snprintf(path, MAX_PATH_LENGTH, "%s%s", args->file_list->path, mark_entry->name);
+    getPathInfo(path, &size, &folders, &files, NULL);
+    mark_entry = mark_entry->next;
+  }
+
+  // Sample the files first, the bar counts the files
+  thid = createStartUpdateThread(files, 0);
+
+  uint64_t value = 0;
+
+  FileProcessParam param;
+  initFileProcessParam(&param, &value, files);
+
+  uint64_t guessed_size = 0;
+  // PSARC output has no use for the store decisions
+  int is_psarc = isPsarcPath(args->path);
+  int res = estimateZipSizeFromList(args->file_list->path, head, count, args->level,
+                                    is_psarc ? NULL : &samples, &guessed_size, &param);
+
+  // Let the update thread end, the count of files may differ
+  SetProgress(files, files);
+  if (thid >= 0) {
+    sceKernelWaitThreadEnd(thid, NULL, NULL);
+    thid = -1;
+  }
+
+  if (res <= 0) {
+    closeWaitDialog();
+    setDialogStep(DIALOG_STEP_CANCELED);
+    errorDialog(res);
+    goto EXIT;
+  }
+
+  // Check memory card free space, estimated from samples of the files
+  if (checkMemoryCardFreeSpace(args->path, guessed_size))
+    goto EXIT;
+
+  // PSARC files are read again to verify the archive
+  uint64_t max = size + folders + (is_psarc ? size : 0);
+
+  // Update thread
+  thid = createStartUpdateThread(max, 1);
+
+  // Remove process
+  value = 0;
+  initFileProcessParam(&param, &value, max);
+
+  // Both formats are written in one pass over all entries
+  if (is_psarc)
+    res = makePsarcFromList(args->path, args->file_list->path, head, count, args->level, &param);
+  else
+    res = makeZipFromList(args->path, args->file_list->path, head, count, args->level, &samples, &param);
+
+  if (res <= 0) {
+    closeWaitDialog();
+    setDialogStep(DIALOG_STEP_CANCELED);
+    errorDialog(res);
+    goto EXIT;
+  }
+
+  // Set progress to 100%
+  sceMsgDialogProgressBarSetValue(SCE_MSG_DIALOG_PROGRESSBAR_TARGET_BAR_DEFAULT, 100);
+  sceKernelDelayThread(COUNTUP_WAIT);
+
+  // Close
+  sceMsgDialogClose();
+
+  setDialogStep(DIALOG_STEP_COMPRESSED);
+
+EXIT:
+  if (mark_entry_one)
+    free(mark_entry_one);
+
+  zipSampleListFree(&samples);
+
+  if (thid >= 0)
+    sceKernelWaitThreadEnd(thid, NULL, NULL);
+
+  // Unlock power timers
+  powerUnlock();
+
+  return sceKernelExitDeleteThread(0);
+}
+
+int mediaPathHandler(const char *path) {
   // Avoid export-ception
   if (strncasecmp(path, "ux0:music/", 10) == 0 ||
       strncasecmp(path, "ux0:video/", 10) == 0 ||
@@ -680,10 +806,7 @@ int export_thread(SceSize args_size, ExportArguments *args) {
     snprintf(path, MAX_PATH_LENGTH, "%s%s", args->file_list->path, mark_entry->name);
 
     FileProcessParam param;
-    param.value = &value;
-    param.max = size;
-    param.SetProgress = SetProgress;
-    param.cancelHandler = cancelHandler;
+    initFileProcessParam(&param, &value, size);
 
     int res = exportPath(path, &songs, &videos, &pictures, &param);
     if (res <= 0) {
@@ -743,7 +866,22 @@ int hash_thread(SceSize args_size, HashArguments *args) {
   sceMsgDialogProgressBarSetValue(SCE_MSG_DIALOG_PROGRESSBAR_TARGET_BAR_DEFAULT, 0);
   sceKernelDelayThread(DIALOG_WAIT); // Needed to see the percentage
 
-  uint64_t max = (uint64_t)(getFileSize(args->file_path) / TRANSFER_SIZE);
+  uint64_t size = 0;
+
+  // Files inside an archive are streamed out of it
+  int in_archive = archiveHasPath(args->file_path);
+  if (in_archive) {
+    SceIoStat stat;
+    memset(&stat, 0, sizeof(SceIoStat));
+    if (archiveFileGetstat(args->file_path, &stat) >= 0)
+      size = stat.st_size;
+  } else {
+    int file_size = getFileSize(args->file_path);
+    if (file_size > 0)
+      size = file_size;
+  }
+
+  uint64_t max = (uint64_t)(size / TRANSFER_SIZE);
 
   // Hash process
   uint64_t value = 0;
@@ -752,10 +890,7 @@ int hash_thread(SceSize args_size, HashArguments *args) {
   thid = createStartUpdateThread(max, 0);
 
   FileProcessParam param;
-  param.value = &value;
-  param.max = max;
-  param.SetProgress = SetProgress;
-  param.cancelHandler = cancelHandler;
+  initFileProcessParam(&param, &value, max);
 
   int res = 0;
   char hashmsg[128];
@@ -766,7 +901,7 @@ int hash_thread(SceSize args_size, HashArguments *args) {
     case HASH_TYPE_SHA1:
     {
       uint8_t sha1out[20];
-      res = getFileSha1(args->file_path, sha1out, &param);
+      res = getFileSha1(args->file_path, sha1out, in_archive, &param);
       if (res > 0) {
         int i;
         for (i = 0; i < 20; i++) {
@@ -782,7 +917,7 @@ int hash_thread(SceSize args_size, HashArguments *args) {
     case HASH_TYPE_MD5:
     {
       uint8_t md5out[16];
-      res = getFileMd5(args->file_path, md5out, &param);
+      res = getFileMd5(args->file_path, md5out, in_archive, &param);
       if (res > 0) {
         int i;
         for (i = 0; i < 16; i++) {
@@ -798,7 +933,7 @@ int hash_thread(SceSize args_size, HashArguments *args) {
     case HASH_TYPE_SHA256:
     {
       uint8_t sha256out[32];
-      res = getFileSha256(args->file_path, sha256out, &param);
+      res = getFileSha256(args->file_path, sha256out, in_archive, &param);
       if (res > 0) {
         int i;
         for (i = 0; i < 32; i++) {
@@ -841,3 +976,137 @@ EXIT:
   // Kill current thread
   return sceKernelExitDeleteThread(0);
 }
+
+int test_thread(SceSize args_size, TestArguments *args) {
+  SceUID thid = -1;
+
+  // Lock power timers
+  powerLock();
+
+  // Set progress to 0%
+  sceMsgDialogProgressBarSetValue(SCE_MSG_DIALOG_PROGRESSBAR_TARGET_BAR_DEFAULT, 0);
+  sceKernelDelayThread(DIALOG_WAIT); // Needed to see the percentage
+
+  int res = archiveOpen(args->file_path);
+  if (res < 0) {
+    closeWaitDialog();
+    errorDialog(res);
+    goto EXIT_ARCHIVE_OPEN;
+  }
+
+  uint64_t max = getArchiveSize();
+
+  // Update thread with speed, nothing is written
+  thid = createStartUpdateThread(max > 0 ? max : 1, 1);
+
+  // Test process
+  uint64_t value = 0;
+
+  FileProcessParam param;
+  initFileProcessParam(&param, &value, max);
+
+  char failed[MAX_PATH_LENGTH];
+  res = testArchive(failed, &param);
+
+  if (res == 0) {
+    closeWaitDialog();
+    setDialogStep(DIALOG_STEP_CANCELED);
+    goto EXIT;
+  }
+
+  if (res < 0) {
+    closeWaitDialog();
+    setDialogStep(DIALOG_STEP_CANCELED);
+
+    if (failed[0] != '\0')
+      infoDialog(language_container[TEST_ARCHIVE_FAILED], res, failed);
+    else
+      errorDialog(res);
+
+    goto EXIT;
+  }
+
+  // Set progress to 100%
+  sceMsgDialogProgressBarSetValue(SCE_MSG_DIALOG_PROGRESSBAR_TARGET_BAR_DEFAULT, 100);
+  sceKernelDelayThread(COUNTUP_WAIT);
+
+  // Close
+  closeWaitDialog();
+
+  infoDialog(language_container[TEST_ARCHIVE_SUCCESS], current_items);
+
+EXIT:
+  archiveClose();
+
+EXIT_ARCHIVE_OPEN:
+  if (thid >= 0)
+    sceKernelWaitThreadEnd(thid, NULL, NULL);
+
+  // Unlock power timers
+  powerUnlock();
+
+  return sceKernelExitDeleteThread(0);
+}
+
+int convert_thread(SceSize args_size, ConvertArguments *args) {
+  SceUID thid = -1;
+
+  // Lock power timers
+  powerLock();
+
+  // Set progress to 0%
+  sceMsgDialogProgressBarSetValue(SCE_MSG_DIALOG_PROGRESSBAR_TARGET_BAR_DEFAULT, 0);
+  sceKernelDelayThread(DIALOG_WAIT); // Needed to see the percentage
+
+  int res = archiveOpen(args->archive_path);
+  if (res < 0) {
+    closeWaitDialog();
+    setDialogStep(DIALOG_STEP_CANCELED);
+    errorDialog(res);
+    goto EXIT_ARCHIVE_OPEN;
+  }
+
+  uint64_t max = getArchiveSize();
+
+  // Check memory card free space, the zip is at most as big as the files
+  if (checkMemoryCardFreeSpace(args->path, max))
+    goto EXIT;
+
+  // Update thread
+  thid = createStartUpdateThread(max > 0 ? max : 1, 1);
+
+  // Convert process
+  uint64_t value = 0;
+
+  FileProcessParam param;
+  initFileProcessParam(&param, &value, max);
+
+  res = convertArchiveToZip(args->path, args->level, &param);
+  if (res <= 0) {
+    closeWaitDialog();
+    setDialogStep(DIALOG_STEP_CANCELED);
+    errorDialog(res);
+    goto EXIT;
+  }
+
+  // Set progress to 100%
+  sceMsgDialogProgressBarSetValue(SCE_MSG_DIALOG_PROGRESSBAR_TARGET_BAR_DEFAULT, 100);
+  sceKernelDelayThread(COUNTUP_WAIT);
+
+  // Close
+  sceMsgDialogClose();
+
+  setDialogStep(DIALOG_STEP_COMPRESSED);
+
+EXIT:
+  archiveClose();
+
+EXIT_ARCHIVE_OPEN:
+  if (thid >= 0)
+    sceKernelWaitThreadEnd(thid, NULL, NULL);
+
+  // Unlock power timers
+  powerUnlock();
+
+  return sceKernelExitDeleteThread(0);
+}
@@ -39,8 +39,6 @@ enum HashTypes {
 typedef struct {
   uint64_t max;
   int show_kbs;
-  char *current_file;
-  int show_eta;
 } UpdateArguments;
 
 typedef struct {
@@ -62,20 +60,45 @@ typedef struct {
   int index;
 } ExportArguments;
 
+typedef struct {
+  FileList *file_list;
+  FileList *mark_list;
+  int index;
+  int level;
+  char *path;
+} CompressArguments;
+
 typedef struct {
   char *file_path;
   int hash_type;
 } HashArguments;
 
+typedef struct {
+  char *file_path;
+} TestArguments;
+
+typedef struct {
+  char *archive_path;
+  char *path;
+  int level;
+} ConvertArguments;
+
 int cancelHandler();
 void SetProgress(uint64_t value, uint64_t max);
 void SetCurrentFile(const char *filename);
+void initFileProcessParam(FileProcessParam *param, uint64_t *value, uint64_t max);
+uint32_t getCopySkipped();
 SceUID createStartUpdateThread(uint64_t max, int show_kbs);
-SceUID createStartUpdateThreadEx(uint64_t max, int show_kbs, char *current_file, int show_eta);
+
+int mediaPathHandler(const char *path);
+int exportPath(char *path, uint32_t *songs, uint32_t *videos, uint32_t *pictures, FileProcessParam *param);
 
 int delete_thread(SceSize args_size, DeleteArguments *args);
 int copy_thread(SceSize args_size, CopyArguments *args);
+int compress_thread(SceSize args_size, CompressArguments *args);
 int export_thread(SceSize args_size, ExportArguments *args);
 int hash_thread(SceSize args_size, HashArguments *args);
+int test_thread(SceSize args_size, TestArguments *args);
+int convert_thread(SceSize args_size, ConvertArguments *args);
 
 #endif
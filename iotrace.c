@@ -0,0 +1,408 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "main.h"
+#include "iotrace.h"
+
+typedef struct {
+  uint32_t count;
+  uint64_t bytes;
+  uint64_t total_micros;
+  uint32_t max_micros;
+  uint32_t errors;
+  uint32_t buckets[IOTRACE_BUCKETS];
+} IoTraceStat;
+
+typedef struct {
+  char name[MAX_IOTRACE_DEVICE_LENGTH];
+  IoTraceStat stats[IOTRACE_CALLS];
+} IoTraceDevice;
+
+typedef struct {
+  SceUID fd;
+  int device;
+} IoTraceFd;
+
+static char *iotrace_call_names[IOTRACE_CALLS] = {
+  "open",
+  "close",
+  "read",
+  "write",
+  "dopen",
+  "dread",
+  "dclose",
+  "getstat",
+  "devctl",
+};
+
+static SceKernelLwMutexWork iotrace_mutex;
+static int iotrace_ready = 0;
+
+static IoTraceDevice iotrace_devices[MAX_IOTRACE_DEVICES];
+static int iotrace_n_devices = 0;
+
+static IoTraceFd iotrace_fds[MAX_IOTRACE_FDS];
+
+static uint64_t iotrace_start_time = 0;
+
+SceUID __real_sceIoOpen(const char *file, int flags, SceMode mode);
+int __real_sceIoClose(SceUID fd);
+int __real_sceIoRead(SceUID fd, void *data, SceSize size);
+int __real_sceIoWrite(SceUID fd, const void *data, SceSize size);
+SceUID __real_sceIoDopen(const char *dirname);
+int __real_sceIoDread(SceUID fd, SceIoDirent *dir);
+int __real_sceIoDclose(SceUID fd);
+int __real_sceIoGetstat(const char *file, SceIoStat *stat);
+int __real_sceIoDevctl(const char *dev, unsigned int cmd, void *indata, int inlen, void *outdata, int outlen);
+
+void iotraceInit() {
+  memset(iotrace_devices, 0, sizeof(iotrace_devices));
+  iotrace_n_devices = 0;
+
+  int i;
+  for (i = 0; i < MAX_IOTRACE_FDS; i++) {
+    iotrace_fds[i].fd = -1;
+  }
+
+  iotrace_start_time = sceKernelGetProcessTimeWide();
+
+  sceKernelCreateLwMutex(&iotrace_mutex, "iotrace_mutex", 2, 0, NULL);
+  iotrace_ready = 1;
+}
+
+// Must be called with iotrace_mutex held
+static int iotraceGetDevice(const char *path) {
+  char name[MAX_IOTRACE_DEVICE_LENGTH];
+  strcpy(name, "?");
+
+  if (path) {
+    char *p = strchr(path, ':');
+    if (p && (p - path) < MAX_IOTRACE_DEVICE_LENGTH - 1) {
+      strncpy(name, path, p - path + 1);
+      name[p - path + 1] = '\0';
+    }
+  }
+
+  int i;
+  for (i = 0; i < iotrace_n_devices; i++) {
+    if (strcasecmp(iotrace_devices[i].name, name) == 0)
+      return i;
+  }
+
+  // Put everything else into the last device when full
+  if (iotrace_n_devices >= MAX_IOTRACE_DEVICES)
+    return MAX_IOTRACE_DEVICES - 1;
+
+  strcpy(iotrace_devices[iotrace_n_devices].name, name);
+  return iotrace_n_devices++;
+}
+
+// Must be called with iotrace_mutex held
+static int iotraceGetFdDevice(SceUID fd) {
+  int i;
+  for (i = 0; i < MAX_IOTRACE_FDS; i++) {
+    if (iotrace_fds[i].fd == fd)
+      return iotrace_fds[i].device;
+  }
+
+  return iotraceGetDevice(NULL);
+}
+
+// Must be called with iotrace_mutex held
+static void iotraceSetFdDevice(SceUID fd, int device) {
+  int i;
+  for (i = 0; i < MAX_IOTRACE_FDS; i++) {
+    if (iotrace_fds[i].fd < 0) {
+      iotrace_fds[i].fd = fd;
+      iotrace_fds[i].device = device;
+      return;
+    }
+  }
+}
+
+// Must be called with iotrace_mutex held
+static void iotraceRemoveFd(SceUID fd) {
+  int i;
+  for (i = 0; i < MAX_IOTRACE_FDS; i++) {
+    if (iotrace_fds[i].fd == fd)
+      iotrace_fds[i].fd = -1;
+  }
+}
+
+// Must be called with iotrace_mutex held
+static void iotraceRecord(int device, int call, int res, uint64_t start) {
+  uint32_t micros = (uint32_t)(sceKernelGetProcessTimeWide() - start);
+
+  IoTraceStat *stat = &iotrace_devices[device].stats[call];
+  stat->count++;
+  stat->total_micros += micros;
+  if (micros > stat->max_micros)
+    stat->max_micros = micros;
+
+  if (res < 0) {
+    stat->errors++;
+  } else if (call == IOTRACE_READ || call == IOTRACE_WRITE) {
+    stat->bytes += res;
+  }
+
+  int bucket = 0;
+  while (bucket < IOTRACE_BUCKETS - 1 && (micros >> (bucket + 1)) != 0) {
+    bucket++;
+  }
+
+  stat->buckets[bucket]++;
+}
+
+static void iotraceLock() {
+  sceKernelLockLwMutex(&iotrace_mutex, 1, NULL);
+}
+
+static void iotraceUnlock() {
+  sceKernelUnlockLwMutex(&iotrace_mutex, 1);
+}
+
+SceUID __wrap_sceIoOpen(const char *file, int flags, SceMode mode) {
+  uint64_t start = sceKernelGetProcessTimeWide();
+  SceUID res = __real_sceIoOpen(file, flags, mode);
+
+  if (iotrace_ready) {
+    iotraceLock();
+    int device = iotraceGetDevice(file);
+    iotraceRecord(device, IOTRACE_OPEN, res, start);
+    if (res >= 0)
+      iotraceSetFdDevice(res, device);
+    iotraceUnlock();
+  }
+
+  return res;
+}
+
+int __wrap_sceIoClose(SceUID fd) {
+  uint64_t start = sceKernelGetProcessTimeWide();
+  int res = __real_sceIoClose(fd);
+
+  if (iotrace_ready) {
+    iotraceLock();
+    iotraceRecord(iotraceGetFdDevice(fd), IOTRACE_CLOSE, res, start);
+    iotraceRemoveFd(fd);
+    iotraceUnlock();
+  }
+
+  return res;
+}
+
+int __wrap_sceIoRead(SceUID fd, void *data, SceSize size) {
+  uint64_t start = sceKernelGetProcessTimeWide();
+  int res = __real_sceIoRead(fd, data, size);
+
+  if (iotrace_ready) {
+    iotraceLock();
+    iotraceRecord(iotraceGetFdDevice(fd), IOTRACE_READ, res, start);
+    iotraceUnlock();
+  }
+
+  return res;
+}
+
+int __wrap_sceIoWrite(SceUID fd, const void *data, SceSize size) {
+  uint64_t start = sceKernelGetProcessTimeWide();
+  int res = __real_sceIoWrite(fd, data, size);
+
+  if (iotrace_ready) {
+    iotraceLock();
+    iotraceRecord(iotraceGetFdDevice(fd), IOTRACE_WRITE, res, start);
+    iotraceUnlock();
+  }
+
+  return res;
+}
+
+SceUID __wrap_sceIoDopen(const char *dirname) {
+  uint64_t start = sceKernelGetProcessTimeWide();
+  SceUID res = __real_sceIoDopen(dirname);
+
+  if (iotrace_ready) {
+    iotraceLock();
+    int device = iotraceGetDevice(dirname);
+    iotraceRecord(device, IOTRACE_DOPEN, res, start);
+    if (res >= 0)
+      iotraceSetFdDevice(res, device);
+    iotraceUnlock();
+  }
+
+  return res;
+}
+
+int __wrap_sceIoDread(SceUID fd, SceIoDirent *dir) {
+  uint64_t start = sceKernelGetProcessTimeWide();
+  int res = __real_sceIoDread(fd, dir);
+
+  if (iotrace_ready) {
+    iotraceLock();
+    iotraceRecord(iotraceGetFdDevice(fd), IOTRACE_DREAD, res, start);
+    iotraceUnlock();
+  }
+
+  return res;
+}
+
+int __wrap_sceIoDclose(SceUID fd) {
+  uint64_t start = sceKernelGetProcessTimeWide();
+  int res = __real_sceIoDclose(fd);
+
+  if (iotrace_ready) {
+    iotraceLock();
+    iotraceRecord(iotraceGetFdDevice(fd), IOTRACE_DCLOSE, res, start);
+    iotraceRemoveFd(fd);
+    iotraceUnlock();
+  }
+
+  return res;
+}
+
+int __wrap_sceIoGetstat(const char *file, SceIoStat *stat) {
+  uint64_t start = sceKernelGetProcessTimeWide();
+  int res = __real_sceIoGetstat(file, stat);
+
+  if (iotrace_ready) {
+    iotraceLock();
+    iotraceRecord(iotraceGetDevice(file), IOTRACE_GETSTAT, res, start);
+    iotraceUnlock();
+  }
+
+  return res;
+}
+
+int __wrap_sceIoDevctl(const char *dev, unsigned int cmd, void *indata, int inlen, void *outdata, int outlen) {
+  uint64_t start = sceKernelGetProcessTimeWide();
+  int res = __real_sceIoDevctl(dev, cmd, indata, inlen, outdata, outlen);
+
+  if (iotrace_ready) {
+    iotraceLock();
+    iotraceRecord(iotraceGetDevice(dev), IOTRACE_DEVCTL, res, start);
+    iotraceUnlock();
+  }
+
+  return res;
+}
+
+// Upper bound of the bucket containing the given fraction of calls
+static uint32_t iotraceGetPercentile(IoTraceStat *stat, double fraction) {
+  uint32_t target = (uint32_t)((double)stat->count * fraction);
+  uint32_t sum = 0;
+
+  int i;
+  for (i = 0; i < IOTRACE_BUCKETS - 1; i++) {
+    sum += stat->buckets[i];
+    if (sum > target)
+      return 2 << i;
+  }
+
+  return stat->max_micros;
+}
+
+static void iotraceWrite(SceUID fd, const char *string) {
+  __real_sceIoWrite(fd, string, strlen(string));
+}
+
+// Appends the statistics since the last dump to the text and CSV reports, then resets them.
+// The reports are written with the real functions, so they do not show up in the next one
+int iotraceDump(const char *label) {
+  if (!iotrace_ready)
+    return 0;
+
+  char line[256];
+  int i, j, k;
+
+  iotraceLock();
+
+  uint64_t elapsed = sceKernelGetProcessTimeWide() - iotrace_start_time;
+
+  SceIoStat stat;
+  int new_csv = (__real_sceIoGetstat(IOTRACE_CSV_PATH, &stat) < 0);
+
+  SceUID txt_fd = __real_sceIoOpen(IOTRACE_TEXT_PATH, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_APPEND, 0777);
+  SceUID csv_fd = __real_sceIoOpen(IOTRACE_CSV_PATH, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_APPEND, 0777);
+
+  if (txt_fd >= 0) {
+    snprintf(line, sizeof(line), "== %s, %.3f s ==\n", label, (double)elapsed / 1000000.0);
+    iotraceWrite(txt_fd, line);
+    iotraceWrite(txt_fd, "device   call       count     errors  bytes         avg us  p50 us  p99 us  max us\n");
+  }
+
+  if (csv_fd >= 0 && new_csv) {
+    iotraceWrite(csv_fd, "label,device,call,count,errors,bytes,total_us,max_us");
+    for (k = 0; k < IOTRACE_BUCKETS; k++) {
+      snprintf(line, sizeof(line), ",lt%uus", 2u << k);
+      iotraceWrite(csv_fd, line);
+    }
+    iotraceWrite(csv_fd, "\n");
+  }
+
+  for (i = 0; i < iotrace_n_devices; i++) {
+    IoTraceDevice *device = &iotrace_devices[i];
+
+    for (j = 0; j < IOTRACE_CALLS; j++) {
+      IoTraceStat *s = &device->stats[j];
+      if (s->count == 0)
+        continue;
+
+      if (txt_fd >= 0) {
+        snprintf(line, sizeof(line), "%-8s %-8s %8u %8u %14llu %8llu %7u %7u %7u\n",
+                 device->name, iotrace_call_names[j], (unsigned int)s->count, (unsigned int)s->errors,
+                 (unsigned long long)s->bytes, (unsigned long long)(s->total_micros / s->count),
+                 (unsigned int)iotraceGetPercentile(s, 0.5), (unsigned int)iotraceGetPercentile(s, 0.99),
+                 (unsigned int)s->max_micros);
+        iotraceWrite(txt_fd, line);
+      }
+
+      if (csv_fd >= 0) {
+        snprintf(line, sizeof(line), "%s,%s,%s,%u,%u,%llu,%llu,%u", label, device->name, iotrace_call_names[j],
+                 (unsigned int)s->count, (unsigned int)s->errors, (unsigned long long)s->bytes,
+                 (unsigned long long)s->total_micros, (unsigned int)s->max_micros);
+        iotraceWrite(csv_fd, line);
+
+        for (k = 0; k < IOTRACE_BUCKETS; k++) {
+          snprintf(line, sizeof(line), ",%u", (unsigned int)s->buckets[k]);
+          iotraceWrite(csv_fd, line);
+        }
+
+        iotraceWrite(csv_fd, "\n");
+      }
+    }
+  }
+
+  if (txt_fd >= 0) {
+    iotraceWrite(txt_fd, "\n");
+    __real_sceIoClose(txt_fd);
+  }
+
+  if (csv_fd >= 0)
+    __real_sceIoClose(csv_fd);
+
+  // Keep the descriptors that are still open, only clear the statistics
+  for (i = 0; i < iotrace_n_devices; i++) {
+    memset(iotrace_devices[i].stats, 0, sizeof(iotrace_devices[i].stats));
+  }
+
+  iotrace_start_time = sceKernelGetProcessTimeWide();
+
+  iotraceUnlock();
+
+  return (txt_fd < 0) ? txt_fd : 0;
+}
@@ -0,0 +1,64 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __IOTRACE_H__
+#define __IOTRACE_H__
+
+// Optional I/O instrumentation, built with -DENABLE_IOTRACE=ON.
+// The sceIo functions are wrapped at link time with --wrap, so a normal build
+// contains neither the wrappers nor any call to this module.
+
+#define IOTRACE_TEXT_PATH "ux0:VitaShell/iotrace.txt"
+#define IOTRACE_CSV_PATH "ux0:VitaShell/iotrace.csv"
+
+#define MAX_IOTRACE_DEVICES 16
+#define MAX_IOTRACE_FDS 64
+#define MAX_IOTRACE_DEVICE_LENGTH 16
+
+// Latency bucket i counts calls below 2^(i+1) microseconds, the last one everything above
+#define IOTRACE_BUCKETS 20
+
+enum IoTraceCalls {
+  IOTRACE_OPEN,
+  IOTRACE_CLOSE,
+  IOTRACE_READ,
+  IOTRACE_WRITE,
+  IOTRACE_DOPEN,
+  IOTRACE_DREAD,
+  IOTRACE_DCLOSE,
+  IOTRACE_GETSTAT,
+  IOTRACE_DEVCTL,
+  IOTRACE_CALLS,
+};
+
+#ifdef ENABLE_IOTRACE
+
+void iotraceInit();
+int iotraceDump(const char *label);
+
+#define IOTRACE_INIT() iotraceInit()
+#define IOTRACE_DUMP(label) iotraceDump(label)
+
+#else
+
+#define IOTRACE_INIT()
+#define IOTRACE_DUMP(label)
+
+#endif
+
+#endif
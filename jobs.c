@@ -0,0 +1,951 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "main.h"
+#include "jobs.h"
+#include "io_process.h"
+#include "makezip.h"
+#include "makepsarc.h"
+#include "file.h"
+#include "theme.h"
+#include "language.h"
+#include "utils.h"
+#include "progress.h"
+
+#include "minizip/zip.h"
+
+#define JOBS_VIEWER_ENTRIES (MAX_ENTRIES / 2)
+#define JOBS_PROGRESS_BAR_WIDTH 300.0f
+#define JOBS_PROGRESS_BAR_HEIGHT 8.0f
+
+typedef struct {
+  Job *job;
+} JobArguments;
+
+static SceKernelLwMutexWork jobs_mutex;
+
+static Job *jobs[MAX_JOBS];
+static int n_jobs = 0;
+static int n_running = 0;
+
+// Thread ids and jobs of the workers, indexed by worker slot
+static SceUID worker_thids[MAX_JOB_WORKERS];
+static Job *worker_jobs[MAX_JOB_WORKERS];
+
+static volatile int jobs_finished = 0;
+
+static void jobsLock() {
+  sceKernelLockLwMutex(&jobs_mutex, 1, NULL);
+}
+
+static void jobsUnlock() {
+  sceKernelUnlockLwMutex(&jobs_mutex, 1);
+}
+
+void initJobs() {
+  sceKernelCreateLwMutex(&jobs_mutex, "jobs_mutex", 2, 0, NULL);
+
+  int i;
+  for (i = 0; i < MAX_JOB_WORKERS; i++) {
+    worker_thids[i] = -1;
+  }
+}
+
+int jobsCheckFinished() {
+  if (!jobs_finished)
+    return 0;
+
+  jobs_finished = 0;
+  return 1;
+}
+
+static void getDevice(const char *path, char *device) {
+  device[0] = '\0';
+
+  char *p = strchr(path, ':');
+  if (p && (p - path) < MAX_JOB_DEVICE_LENGTH - 1) {
+    strncpy(device, path, p - path + 1);
+    device[p - path + 1] = '\0';
+  }
+}
+
+static void jobAddDevice(Job *job, const char *path) {
+  char device[MAX_JOB_DEVICE_LENGTH];
+  getDevice(path, device);
+
+  if (device[0] == '\0' || job->n_devices >= MAX_JOB_DEVICES)
+    return;
+
+  int i;
+  for (i = 0; i < job->n_devices; i++) {
+    if (strcasecmp(job->devices[i], device) == 0)
+      return;
+  }
+
+  strcpy(job->devices[job->n_devices++], device);
+}
+
+static int jobDevicesBusy(Job *job) {
+  int i;
+  for (i = 0; i < n_jobs; i++) {
+    if (jobs[i] == job || jobs[i]->state != JOB_STATE_RUNNING)
+      continue;
+
+    int j, k;
+    for (j = 0; j < job->n_devices; j++) {
+      for (k = 0; k < jobs[i]->n_devices; k++) {
+        if (strcasecmp(job->devices[j], jobs[i]->devices[k]) == 0)
+          return 1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+// No lock needed, a worker only looks for its own slot which does not change while it runs
+static Job *jobGetCurrent() {
+  SceUID thid = sceKernelGetThreadId();
+
+  int i;
+  for (i = 0; i < MAX_JOB_WORKERS; i++) {
+    if (worker_thids[i] == thid)
+      return worker_jobs[i];
+  }
+
+  return NULL;
+}
+
+// Called from the file loops of a worker. Publishes the progress and blocks while the job is paused
+static int jobCancelHandler() {
+  Job *job = jobGetCurrent();
+  if (!job)
+    return 0;
+
+  progressStore(&job->value, job->work_value);
+
+  while (job->paused && !job->canceled) {
+    sceKernelDelayThread(JOB_PAUSE_WAIT);
+  }
+
+  return job->canceled;
+}
+
+static void jobInitParam(Job *job, FileProcessParam *param) {
+  memset(param, 0, sizeof(FileProcessParam));
+  param->value = &job->work_value;
+  param->items = &job->items;
+  param->max = job->max;
+  param->SetProgress = NULL;
+  param->cancelHandler = jobCancelHandler;
+}
+
+static int jobCheckFreeSpace(const char *path, uint64_t size) {
+  // host0: does not report its free space
+  if (strncmp(path, "host0:", 6) == 0)
+    return 0;
+
+  if (getFreeSpaceShortage(path, size) > 0)
+    return VITASHELL_ERROR_NO_SPACE;
+
+  return 0;
+}
+
+static int jobCopy(Job *job) {
+  char src_path[MAX_PATH_LENGTH], dst_path[MAX_PATH_LENGTH];
+  FileListEntry *entry = NULL;
+  int i, res;
+
+  // Moving in the same partition is just a rename
+  if (job->type == JOB_TYPE_MOVE && job->n_devices == 1) {
+    job->max = job->entries.length;
+    job->unit_size = 0;
+
+    entry = job->entries.head;
+
+    for (i = 0; i < job->entries.length; i++) {
+      snprintf(src_path, MAX_PATH_LENGTH, "%s%s", job->src_path, entry->name);
+      snprintf(dst_path, MAX_PATH_LENGTH, "%s%s", job->dst_path, entry->name);
+
+      res = movePath(src_path, dst_path, MOVE_INTEGRATE | MOVE_REPLACE, NULL);
+      if (res < 0)
+        return res;
+
+      job->work_value = i + 1;
+
+      if (jobCancelHandler())
+        return 0;
+
+      entry = entry->next;
+    }
+
+    return 1;
+  }
+
+  // Get src paths info
+  uint64_t size = 0;
+  uint32_t folders = 0, files = 0;
+
+  entry = job->entries.head;
+
+  for (i = 0; i < job->entries.length; i++) {
+    snprintf(src_path, MAX_PATH_LENGTH, "%s%s", job->src_path, entry->name);
+    getPathInfo(src_path, &size, &folders, &files, NULL);
+    entry = entry->next;
+  }
+
+  res = jobCheckFreeSpace(job->dst_path, size);
+  if (res < 0)
+    return res;
+
+  job->max = size + folders * DIRECTORY_SIZE;
+  if (job->type == JOB_TYPE_MOVE)
+    job->max += files + folders;
+
+  FileProcessParam param;
+  jobInitParam(job, &param);
+
+  // Copy process
+  entry = job->entries.head;
+
+  for (i = 0; i < job->entries.length; i++) {
+    snprintf(src_path, MAX_PATH_LENGTH, "%s%s", job->src_path, entry->name);
+    snprintf(dst_path, MAX_PATH_LENGTH, "%s%s", job->dst_path, entry->name);
+
+    res = copyPath(src_path, dst_path, &param);
+    if (res <= 0)
+      return res;
+
+    entry = entry->next;
+  }
+
+  // Remove src when moving between partitions
+  if (job->type == JOB_TYPE_MOVE) {
+    entry = job->entries.head;
+
+    for (i = 0; i < job->entries.length; i++) {
+      snprintf(src_path, MAX_PATH_LENGTH, "%s%s", job->src_path, entry->name);
+
+      res = removePath(src_path, &param);
+      if (res <= 0)
+        return res;
+
+      entry = entry->next;
+    }
+  }
+
+  return 1;
+}
+
+static int jobDelete(Job *job) {
+  char path[MAX_PATH_LENGTH];
+  uint32_t folders = 0, files = 0;
+  int i, res;
+
+  FileListEntry *entry = job->entries.head;
+
+  for (i = 0; i < job->entries.length; i++) {
+    snprintf(path, MAX_PATH_LENGTH, "%s%s", job->src_path, entry->name);
+    getPathInfo(path, NULL, &folders, &files, NULL);
+    entry = entry->next;
+  }
+
+  job->max = folders + files;
+  job->unit_size = 0;
+
+  FileProcessParam param;
+  jobInitParam(job, &param);
+
+  entry = job->entries.head;
+
+  for (i = 0; i < job->entries.length; i++) {
+    snprintf(path, MAX_PATH_LENGTH, "%s%s", job->src_path, entry->name);
+
+    res = removePath(path, &param);
+    if (res <= 0)
+      return res;
+
+    entry = entry->next;
+  }
+
+  return 1;
+}
+
+static int jobCompress(Job *job) {
+  char path[MAX_PATH_LENGTH];
+  uint64_t size = 0;
+  uint32_t folders = 0, files = 0;
+  int i, res;
+
+  FileListEntry *entry = job->entries.head;
+
+  for (i = 0; i < job->entries.length; i++) {
+    snprintf(path, MAX_PATH_LENGTH, "%s%s", job->src_path, entry->name);
+    getPathInfo(path, &size, &folders, &files, NULL);
+    entry = entry->next;
+  }
+
+  // Sample the files first, counted in files
+  job->max = files;
+  job->unit_size = 0;
+
+  FileProcessParam param;
+  jobInitParam(job, &param);
+
+  // Estimated from samples of the files, which also decide what is stored
+  ZipSampleList samples;
+  memset(&samples, 0, sizeof(ZipSampleList));
+
+  // PSARC output has no use for the store decisions
+  int is_psarc = isPsarcPath(job->dst_path);
+
+  uint64_t guessed_size = 0;
+  res = estimateZipSizeFromList(job->src_path, job->entries.head, job->entries.length, job->level,
+                                is_psarc ? NULL : &samples, &guessed_size, &param);
+  if (res <= 0) {
+    zipSampleListFree(&samples);
+    return res;
+  }
+
+  res = jobCheckFreeSpace(job->dst_path, guessed_size);
+  if (res < 0) {
+    zipSampleListFree(&samples);
+    return res;
+  }
+
+  // PSARC files are read again to verify the archive
+  job->work_value = 0;
+  job->max = size + folders + (is_psarc ? size : 0);
+  job->unit_size = 1;
+
+  jobInitParam(job, &param);
+
+  if (is_psarc)
+    res = makePsarcFromList(job->dst_path, job->src_path, job->entries.head, job->entries.length, job->level, &param);
+  else
+    res = makeZipFromList(job->dst_path, job->src_path, job->entries.head, job->entries.length, job->level, &samples, &param);
+
+  zipSampleListFree(&samples);
+
+  return res;
+}
+
+static int jobExport(Job *job) {
+  char path[MAX_PATH_LENGTH];
+  uint64_t size = 0;
+  uint32_t files = 0;
+  uint32_t songs = 0, videos = 0, pictures = 0;
+  int i, res;
+
+  FileListEntry *entry = job->entries.head;
+
+  for (i = 0; i < job->entries.length; i++) {
+    snprintf(path, MAX_PATH_LENGTH, "%s%s", job->src_path, entry->name);
+    getPathInfo(path, &size, NULL, &files, mediaPathHandler);
+    entry = entry->next;
+  }
+
+  if (size == 0) {
+    snprintf(job->message, MAX_JOB_MESSAGE_LENGTH, "%s", language_container[EXPORT_NO_MEDIA]);
+    return 1;
+  }
+
+  res = jobCheckFreeSpace("ux0:", size);
+  if (res < 0)
+    return res;
+
+  job->max = size;
+
+  FileProcessParam param;
+  jobInitParam(job, &param);
+
+  entry = job->entries.head;
+
+  for (i = 0; i < job->entries.length; i++) {
+    snprintf(path, MAX_PATH_LENGTH, "%s%s", job->src_path, entry->name);
+
+    res = exportPath(path, &songs, &videos, &pictures, &param);
+    if (res <= 0)
+      return res;
+
+    entry = entry->next;
+  }
+
+  if (songs > 0 && videos > 0 && pictures > 0) {
+    snprintf(job->message, MAX_JOB_MESSAGE_LENGTH, language_container[EXPORT_SONGS_VIDEOS_PICTURES_INFO], songs, videos, pictures);
+  } else if (songs > 0 && videos > 0) {
+    snprintf(job->message, MAX_JOB_MESSAGE_LENGTH, language_container[EXPORT_SONGS_VIDEOS_INFO], songs, videos);
+  } else if (songs > 0 && pictures > 0) {
+    snprintf(job->message, MAX_JOB_MESSAGE_LENGTH, language_container[EXPORT_SONGS_PICTURES_INFO], songs, pictures);
+  } else if (videos > 0 && pictures > 0) {
+    snprintf(job->message, MAX_JOB_MESSAGE_LENGTH, language_container[EXPORT_VIDEOS_PICTURES_INFO], videos, pictures);
+  } else if (songs > 0) {
+    snprintf(job->message, MAX_JOB_MESSAGE_LENGTH, language_container[EXPORT_SONGS_INFO], songs);
+  } else if (videos > 0) {
+    snprintf(job->message, MAX_JOB_MESSAGE_LENGTH, language_container[EXPORT_VIDEOS_INFO], videos);
+  } else if (pictures > 0) {
+    snprintf(job->message, MAX_JOB_MESSAGE_LENGTH, language_container[EXPORT_PICTURES_INFO], pictures);
+  }
+
+  return 1;
+}
+
+static int jobHash(Job *job) {
+  char path[MAX_PATH_LENGTH];
+  uint8_t hash[32];
+  int hash_size = 0;
+  int res = 0;
+
+  snprintf(path, MAX_PATH_LENGTH, "%s%s", job->src_path, job->entries.head->name);
+
+  // Hash functions count in blocks of TRANSFER_SIZE
+  job->max = (uint64_t)(getFileSize(path) / TRANSFER_SIZE);
+  job->unit_size = TRANSFER_SIZE;
+
+  FileProcessParam param;
+  jobInitParam(job, &param);
+
+  switch (job->hash_type) {
+    case HASH_TYPE_SHA1:
+      res = getFileSha1(path, hash, 0, &param);
+      hash_size = 20;
+      break;
+
+    case HASH_TYPE_MD5:
+      res = getFileMd5(path, hash, 0, &param);
+      hash_size = 16;
+      break;
+
+    case HASH_TYPE_SHA256:
+      res = getFileSha256(path, hash, 0, &param);
+      hash_size = 32;
+      break;
+  }
+
+  if (res <= 0)
+    return res;
+
+  int i;
+  for (i = 0; i < hash_size && (i * 2 + 2) < MAX_JOB_MESSAGE_LENGTH; i++) {
+    sprintf(job->message + i * 2, "%02X", hash[i]);
+  }
+
+  return 1;
+}
+
+static void jobsSchedule();
+
+static int job_thread(SceSize args_size, JobArguments *args) {
+  Job *job = args->job;
+  int res = 0;
+
+  // Lock power timers
+  powerLock();
+
+  switch (job->type) {
+    case JOB_TYPE_COPY:
+    case JOB_TYPE_MOVE:
+      res = jobCopy(job);
+      break;
+
+    case JOB_TYPE_DELETE:
+      res = jobDelete(job);
+      break;
+
+    case JOB_TYPE_COMPRESS:
+      res = jobCompress(job);
+      break;
+
+    case JOB_TYPE_EXPORT:
+      res = jobExport(job);
+      break;
+
+    case JOB_TYPE_HASH:
+      res = jobHash(job);
+      break;
+  }
+
+  jobsLock();
+
+  job->result = res;
+
+  if (job->canceled) {
+    job->state = JOB_STATE_CANCELED;
+  } else if (res < 0) {
+    snprintf(job->message, MAX_JOB_MESSAGE_LENGTH, language_container[ERROR], res);
+    job->state = JOB_STATE_FAILED;
+  } else {
+    progressStore(&job->value, job->max);
+    job->state = JOB_STATE_FINISHED;
+  }
+
+  int i;
+  for (i = 0; i < MAX_JOB_WORKERS; i++) {
+    if (worker_thids[i] == job->thid)
+      worker_thids[i] = -1;
+  }
+
+  job->thid = -1;
+  n_running--;
+
+  jobs_finished = 1;
+
+  // Start the next jobs waiting for these devices
+  jobsSchedule();
+
+  jobsUnlock();
+
+  // Unlock power timers
+  powerUnlock();
+
+  return sceKernelExitDeleteThread(0);
+}
+
+// Must be called with jobs_mutex held
+static void jobsSchedule() {
+  int i;
+  for (i = 0; i < n_jobs && n_running < MAX_JOB_WORKERS; i++) {
+    Job *job = jobs[i];
+
+    if (job->state != JOB_STATE_QUEUED || job->paused)
+      continue;
+
+    if (jobDevicesBusy(job))
+      continue;
+
+    SceUID thid = sceKernelCreateThread("job_thread", (SceKernelThreadEntry)job_thread, 0x40, 0x100000, 0, 0, NULL);
+    if (thid < 0) {
+      job->result = thid;
+      snprintf(job->message, MAX_JOB_MESSAGE_LENGTH, language_container[ERROR], thid);
+      job->state = JOB_STATE_FAILED;
+      continue;
+    }
+
+    // n_running is below MAX_JOB_WORKERS, so there is a free slot
+    int slot = 0;
+    while (worker_thids[slot] >= 0) {
+      slot++;
+    }
+
+    worker_jobs[slot] = job;
+    worker_thids[slot] = thid;
+
+    job->thid = thid;
+    job->state = JOB_STATE_RUNNING;
+    progressSamplerInit(&job->sampler, 0, 0);
+    n_running++;
+
+    JobArguments args;
+    args.job = job;
+    sceKernelStartThread(thid, sizeof(JobArguments), &args);
+  }
+}
+
+static void jobFree(Job *job) {
+  fileListEmpty(&job->entries);
+  free(job);
+}
+
+// Must be called with jobs_mutex held
+static void jobsRemoveDone() {
+  int i, j = 0;
+  for (i = 0; i < n_jobs; i++) {
+    if (jobs[i]->state == JOB_STATE_QUEUED || jobs[i]->state == JOB_STATE_RUNNING) {
+      jobs[j++] = jobs[i];
+    } else {
+      jobFree(jobs[i]);
+    }
+  }
+
+  n_jobs = j;
+}
+
+static Job *jobCreate(int type, const char *src_path, const char *dst_path) {
+  Job *job = malloc(sizeof(Job));
+  if (!job)
+    return NULL;
+
+  memset(job, 0, sizeof(Job));
+  job->type = type;
+  job->state = JOB_STATE_QUEUED;
+  job->unit_size = 1;
+  job->thid = -1;
+
+  strncpy(job->src_path, src_path, MAX_PATH_LENGTH - 1);
+  strcpy(job->entries.path, job->src_path);
+  jobAddDevice(job, job->src_path);
+
+  if (dst_path) {
+    strncpy(job->dst_path, dst_path, MAX_PATH_LENGTH - 1);
+    jobAddDevice(job, job->dst_path);
+  }
+
+  return job;
+}
+
+// Take the marked entries if focusing on one of them, otherwise the focused entry only
+static int jobAddSelection(Job *job, FileList *file_list, FileList *mark_list, int index) {
+  FileListEntry *file_entry = fileListGetNthEntry(file_list, index);
+  if (!file_entry)
+    return VITASHELL_ERROR_NOT_FOUND;
+
+  if (fileListFindEntry(mark_list, file_entry->name)) { // On marked entry
+    FileListEntry *mark_entry = mark_list->head;
+
+    int i;
+    for (i = 0; i < mark_list->length; i++) {
+      fileListAddEntry(&job->entries, fileListCopyEntry(mark_entry), SORT_NONE);
+      mark_entry = mark_entry->next;
+    }
+  } else {
+    fileListAddEntry(&job->entries, fileListCopyEntry(file_entry), SORT_NONE);
+  }
+
+  return 0;
+}
+
+static int jobSubmit(Job *job) {
+  jobsLock();
+
+  if (n_jobs >= MAX_JOBS)
+    jobsRemoveDone();
+
+  if (n_jobs >= MAX_JOBS) {
+    jobsUnlock();
+    jobFree(job);
+    return VITASHELL_ERROR_ALREADY_RUNNING;
+  }
+
+  jobs[n_jobs++] = job;
+  jobsSchedule();
+
+  jobsUnlock();
+
+  return 0;
+}
+
+int jobAddCopy(FileList *copy_list, const char *dst_path, int copy_mode) {
+  // The archive module keeps a single global state, extraction stays in foreground
+  if (copy_mode == COPY_MODE_EXTRACT)
+    return VITASHELL_ERROR_INVALID_TYPE;
+
+  Job *job = jobCreate(copy_mode == COPY_MODE_MOVE ? JOB_TYPE_MOVE : JOB_TYPE_COPY, copy_list->path, dst_path);
+  if (!job)
+    return VITASHELL_ERROR_NO_MEMORY;
+
+  FileListEntry *copy_entry = copy_list->head;
+
+  int i;
+  for (i = 0; i < copy_list->length; i++) {
+    fileListAddEntry(&job->entries, fileListCopyEntry(copy_entry), SORT_NONE);
+    copy_entry = copy_entry->next;
+  }
+
+  return jobSubmit(job);
+}
+
+int jobAddDelete(FileList *file_list, FileList *mark_list, int index) {
+  Job *job = jobCreate(JOB_TYPE_DELETE, file_list->path, NULL);
+  if (!job)
+    return VITASHELL_ERROR_NO_MEMORY;
+
+  int res = jobAddSelection(job, file_list, mark_list, index);
+  if (res < 0) {
+    jobFree(job);
+    return res;
+  }
+
+  return jobSubmit(job);
+}
+
+int jobAddCompress(FileList *file_list, FileList *mark_list, int index, const char *zip_path, int level) {
+  Job *job = jobCreate(JOB_TYPE_COMPRESS, file_list->path, zip_path);
+  if (!job)
+    return VITASHELL_ERROR_NO_MEMORY;
+
+  job->level = level;
+
+  int res = jobAddSelection(job, file_list, mark_list, index);
+  if (res < 0) {
+    jobFree(job);
+    return res;
+  }
+
+  return jobSubmit(job);
+}
+
+int jobAddExport(FileList *file_list, FileList *mark_list, int index) {
+  // Media is exported to ux0:music, ux0:video and ux0:picture
+  Job *job = jobCreate(JOB_TYPE_EXPORT, file_list->path, "ux0:");
+  if (!job)
+    return VITASHELL_ERROR_NO_MEMORY;
+
+  int res = jobAddSelection(job, file_list, mark_list, index);
+  if (res < 0) {
+    jobFree(job);
+    return res;
+  }
+
+  return jobSubmit(job);
+}
+
+int jobAddHash(FileList *file_list, int index, int hash_type) {
+  FileListEntry *file_entry = fileListGetNthEntry(file_list, index);
+  if (!file_entry)
+    return VITASHELL_ERROR_NOT_FOUND;
+
+  Job *job = jobCreate(JOB_TYPE_HASH, file_list->path, NULL);
+  if (!job)
+    return VITASHELL_ERROR_NO_MEMORY;
+
+  job->hash_type = hash_type;
+  fileListAddEntry(&job->entries, fileListCopyEntry(file_entry), SORT_NONE);
+
+  return jobSubmit(job);
+}
+
+static void jobTogglePause(Job *job) {
+  if (job->state != JOB_STATE_QUEUED && job->state != JOB_STATE_RUNNING)
+    return;
+
+  if (job->paused) {
+    // Do not let the pause drag the average speed down
+    progressSamplerInit(&job->sampler, progressLoad(&job->value), job->items);
+    job->paused = 0;
+  } else {
+    job->paused = 1;
+  }
+}
+
+static void jobCancel(Job *job) {
+  if (job->state == JOB_STATE_QUEUED) {
+    job->state = JOB_STATE_CANCELED;
+  } else if (job->state == JOB_STATE_RUNNING) {
+    job->canceled = 1;
+  }
+}
+
+static void getJobTitle(Job *job, char *title, int size) {
+  int text = COPYING;
+
+  switch (job->type) {
+    case JOB_TYPE_COPY:
+      text = COPYING;
+      break;
+
+    case JOB_TYPE_MOVE:
+      text = MOVING;
+      break;
+
+    case JOB_TYPE_DELETE:
+      text = DELETING;
+      break;
+
+    case JOB_TYPE_COMPRESS:
+      text = COMPRESSING;
+      break;
+
+    case JOB_TYPE_HASH:
+      text = HASHING;
+      break;
+
+    case JOB_TYPE_EXPORT:
+      text = EXPORTING;
+      break;
+  }
+
+  const char *name = job->entries.head ? job->entries.head->name : "";
+
+  if (job->entries.length > 1) {
+    snprintf(title, size, "%s %s (+%d)", language_container[text], name, job->entries.length - 1);
+  } else {
+    snprintf(title, size, "%s %s", language_container[text], name);
+  }
+}
+
+static char *getJobStateString(Job *job) {
+  switch (job->state) {
+    case JOB_STATE_QUEUED:
+      return language_container[job->paused ? JOB_PAUSED : JOB_WAITING];
+
+    case JOB_STATE_RUNNING:
+      return language_container[job->paused ? JOB_PAUSED : JOB_RUNNING];
+
+    case JOB_STATE_FINISHED:
+      return language_container[JOB_FINISHED];
+
+    case JOB_STATE_CANCELED:
+      return language_container[JOB_CANCELED];
+  }
+
+  return language_container[JOB_FAILED];
+}
+
+static void getJobSpeedString(Job *job, uint64_t value, char *string, int size) {
+  string[0] = '\0';
+
+  if (job->state != JOB_STATE_RUNNING || job->paused || job->max == 0)
+    return;
+
+  progressSamplerUpdate(&job->sampler, value, job->items);
+  progressSamplerGetString(&job->sampler, string, size, value, job->max, job->unit_size);
+}
+
+typedef struct {
+  char title[MAX_NAME_LENGTH + 64];
+  char *state;
+  int running;
+  float progress;
+  char speed[MAX_PROGRESS_STRING_LENGTH];
+  char message[MAX_JOB_MESSAGE_LENGTH];
+} JobView;
+
+int jobsViewer() {
+  JobView views[JOBS_VIEWER_ENTRIES];
+  int base_pos = 0, rel_pos = 0;
+
+  while (1) {
+    readPad();
+
+    if (pressed_pad[PAD_CANCEL])
+      break;
+
+    jobsLock();
+
+    // Keep the selection inside the list when jobs are cleared
+    if (base_pos + rel_pos >= n_jobs) {
+      base_pos = MAX(0, n_jobs - JOBS_VIEWER_ENTRIES);
+      rel_pos = MAX(0, n_jobs - 1 - base_pos);
+    }
+
+    int sel = base_pos + rel_pos;
+
+    if (hold_pad[PAD_UP] || hold2_pad[PAD_LEFT_ANALOG_UP]) {
+      if (rel_pos > 0) {
+        rel_pos--;
+      } else if (base_pos > 0) {
+        base_pos--;
+      }
+    } else if (hold_pad[PAD_DOWN] || hold2_pad[PAD_LEFT_ANALOG_DOWN]) {
+      if ((sel + 1) < n_jobs) {
+        if ((rel_pos + 1) < JOBS_VIEWER_ENTRIES) {
+          rel_pos++;
+        } else {
+          base_pos++;
+        }
+      }
+    } else if (sel < n_jobs) {
+      if (pressed_pad[PAD_ENTER]) {
+        jobTogglePause(jobs[sel]);
+        jobsSchedule();
+      } else if (pressed_pad[PAD_SQUARE]) {
+        jobCancel(jobs[sel]);
+      } else if (pressed_pad[PAD_LTRIGGER] && sel > 0) { // Move up in queue
+        Job *job = jobs[sel - 1];
+        jobs[sel - 1] = jobs[sel];
+        jobs[sel] = job;
+
+        if (rel_pos > 0) {
+          rel_pos--;
+        } else {
+          base_pos--;
+        }
+      } else if (pressed_pad[PAD_RTRIGGER] && (sel + 1) < n_jobs) { // Move down in queue
+        Job *job = jobs[sel + 1];
+        jobs[sel + 1] = jobs[sel];
+        jobs[sel] = job;
+
+        if ((rel_pos + 1) < JOBS_VIEWER_ENTRIES) {
+          rel_pos++;
+        } else {
+          base_pos++;
+        }
+      } else if (pressed_pad[PAD_TRIANGLE]) {
+        jobsRemoveDone();
+      }
+    }
+
+    // Take a snapshot of the visible jobs, so workers are not blocked while drawing
+    int n_views = 0;
+    int total = n_jobs;
+
+    while (n_views < JOBS_VIEWER_ENTRIES && (base_pos + n_views) < n_jobs) {
+      Job *job = jobs[base_pos + n_views];
+      JobView *view = &views[n_views];
+
+      getJobTitle(job, view->title, sizeof(view->title));
+      view->state = getJobStateString(job);
+      view->running = (job->state == JOB_STATE_RUNNING);
+      uint64_t value = progressLoad(&job->value);
+      view->progress = job->max ? ((float)MIN(value, job->max) / (float)job->max) : 0.0f;
+      getJobSpeedString(job, value, view->speed, sizeof(view->speed));
+      strcpy(view->message, job->message);
+
+      n_views++;
+    }
+
+    jobsUnlock();
+
+    // Start drawing
+    startDrawing(bg_text_image);
+
+    // Draw shell info
+    drawShellInfo(language_container[JOBS]);
+
+    if (total == 0)
+      pgf_draw_text(SHELL_MARGIN_X, START_Y, TEXT_COLOR, language_container[JOBS_EMPTY]);
+
+    int i;
+    for (i = 0; i < n_views; i++) {
+      JobView *view = &views[i];
+      uint32_t color = (i == rel_pos) ? TEXT_FOCUS_COLOR : TEXT_COLOR;
+      float y = START_Y + (i * 2.0f * FONT_Y_SPACE);
+
+      // Title and state
+      float state_x = ALIGN_RIGHT(SCREEN_WIDTH - SHELL_MARGIN_X, pgf_text_width(view->state));
+
+      vita2d_enable_clipping();
+      vita2d_set_clip_rectangle(SHELL_MARGIN_X, y, state_x - STATUS_BAR_SPACE_X, y + FONT_Y_SPACE);
+      pgf_draw_text(SHELL_MARGIN_X, y, color, view->title);
+      vita2d_disable_clipping();
+
+      pgf_draw_text(state_x, y, color, view->state);
+
+      y += FONT_Y_SPACE;
+
+      // Progress, speed and ETA or result message
+      if (view->running) {
+        vita2d_draw_rectangle(SHELL_MARGIN_X, y + 8.0f, JOBS_PROGRESS_BAR_WIDTH, JOBS_PROGRESS_BAR_HEIGHT, PROGRESS_BAR_BG_COLOR);
+        vita2d_draw_rectangle(SHELL_MARGIN_X, y + 8.0f, view->progress * JOBS_PROGRESS_BAR_WIDTH, JOBS_PROGRESS_BAR_HEIGHT, PROGRESS_BAR_COLOR);
+
+        pgf_draw_textf(SHELL_MARGIN_X + JOBS_PROGRESS_BAR_WIDTH + STATUS_BAR_SPACE_X, y, color, "%d%%", (int)(view->progress * 100.0f));
+        pgf_draw_text(ALIGN_RIGHT(SCREEN_WIDTH - SHELL_MARGIN_X, pgf_text_width(view->speed)), y, color, view->speed);
+      } else if (view->message[0] != '\0') {
+        pgf_draw_text(SHELL_MARGIN_X, y, color, view->message);
+      }
+    }
+
+    // Controls
+    pgf_draw_text(SHELL_MARGIN_X, SCREEN_HEIGHT - SHELL_MARGIN_Y - FONT_Y_SPACE, TEXT_COLOR, language_container[JOBS_CONTROLS]);
+
+    // End drawing
+    endDrawing();
+  }
+
+  return 0;
+}
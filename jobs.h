@@ -0,0 +1,94 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __JOBS_H__
+#define __JOBS_H__
+
+#include "file.h"
+#include "progress.h"
+
+#define MAX_JOBS 32
+#define MAX_JOB_WORKERS 2
+#define MAX_JOB_DEVICES 2
+#define MAX_JOB_DEVICE_LENGTH 16
+#define MAX_JOB_MESSAGE_LENGTH 128
+
+#define JOB_PAUSE_WAIT 100 * 1000
+
+enum JobTypes {
+  JOB_TYPE_COPY,
+  JOB_TYPE_MOVE,
+  JOB_TYPE_DELETE,
+  JOB_TYPE_COMPRESS,
+  JOB_TYPE_HASH,
+  JOB_TYPE_EXPORT,
+};
+
+enum JobStates {
+  JOB_STATE_QUEUED,
+  JOB_STATE_RUNNING,
+  JOB_STATE_FINISHED,
+  JOB_STATE_FAILED,
+  JOB_STATE_CANCELED,
+};
+
+typedef struct {
+  int type;
+  volatile int state;
+  volatile int paused;
+  volatile int canceled;
+  int result;
+
+  // Source folder of the entries, destination folder or zip file
+  char src_path[MAX_PATH_LENGTH];
+  char dst_path[MAX_PATH_LENGTH];
+  FileList entries;
+
+  int level;
+  int hash_type;
+
+  // Devices this job reads from or writes to
+  char devices[MAX_JOB_DEVICES][MAX_JOB_DEVICE_LENGTH];
+  int n_devices;
+
+  // Progress, unit_size is 0 if value counts items instead of bytes.
+  // The worker counts in work_value and publishes it to value
+  uint64_t work_value;
+  uint64_t value;
+  uint32_t items;
+  uint64_t max;
+  uint64_t unit_size;
+  ProgressSampler sampler;
+
+  SceUID thid;
+
+  char message[MAX_JOB_MESSAGE_LENGTH];
+} Job;
+
+void initJobs();
+int jobsCheckFinished();
+
+int jobAddCopy(FileList *copy_list, const char *dst_path, int copy_mode);
+int jobAddDelete(FileList *file_list, FileList *mark_list, int index);
+int jobAddCompress(FileList *file_list, FileList *mark_list, int index, const char *zip_path, int level);
+int jobAddExport(FileList *file_list, FileList *mark_list, int index);
+int jobAddHash(FileList *file_list, int index, int hash_type);
+
+int jobsViewer();
+
+#endif
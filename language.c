@@ -82,7 +82,10 @@ void loadLanguage(int id) {
     LANGUAGE_ENTRY(EXTRACTING),
     LANGUAGE_ENTRY(COMPRESSING),
     LANGUAGE_ENTRY(HASHING),
+    LANGUAGE_ENTRY(TESTING),
+    LANGUAGE_ENTRY(CONVERTING),
     LANGUAGE_ENTRY(REFRESHING),
+    LANGUAGE_ENTRY(BENCHMARKING),
     LANGUAGE_ENTRY(SENDING),
     LANGUAGE_ENTRY(RECEIVING),
 
@@ -138,17 +141,24 @@ void loadLanguage(int id) {
     LANGUAGE_ENTRY(BOOKMARKS_NEW),
     LANGUAGE_ENTRY(RECENT_FILES_SHOW),
     LANGUAGE_ENTRY(COMPRESS),
+    LANGUAGE_ENTRY(COMPRESS_PSARC),
     LANGUAGE_ENTRY(INSTALL_ALL),
     LANGUAGE_ENTRY(INSTALL_FOLDER),
     LANGUAGE_ENTRY(CALCULATE_SHA1),
     LANGUAGE_ENTRY(CALCULATE_MD5),
     LANGUAGE_ENTRY(CALCULATE_SHA256),
+    LANGUAGE_ENTRY(SHOW_CRC32),
     LANGUAGE_ENTRY(OPEN_DECRYPTED),
     LANGUAGE_ENTRY(EXPORT_MEDIA),
+    LANGUAGE_ENTRY(TEST_ARCHIVE),
+    LANGUAGE_ENTRY(CONVERT_ZIP),
     LANGUAGE_ENTRY(CUT),
     LANGUAGE_ENTRY(INSERT_EMPTY_LINE),
     LANGUAGE_ENTRY(SEARCH),
     LANGUAGE_ENTRY(COPY_TO_CLIPBOARD),
+    LANGUAGE_ENTRY(JOBS),
+    LANGUAGE_ENTRY(SAVE_IO_TRACE),
+    LANGUAGE_ENTRY(BENCHMARK_DEVICE),
 
     // File browser properties strings
     LANGUAGE_ENTRY(PROPERTY_NAME),
@@ -186,6 +196,20 @@ void loadLanguage(int id) {
     LANGUAGE_ENTRY(FILE_COPIED_TO_CLIPBOARD),
     LANGUAGE_ENTRY(PROCESSING_FILE),
     LANGUAGE_ENTRY(PROCESSING_DIRECTORY),
+    LANGUAGE_ENTRY(FILES_PER_SECOND),
+    LANGUAGE_ENTRY(IO_TRACE_SAVED),
+    LANGUAGE_ENTRY(BENCHMARK_RESULT),
+
+    // Job strings
+    LANGUAGE_ENTRY(JOBS_EMPTY),
+    LANGUAGE_ENTRY(JOBS_CONTROLS),
+    LANGUAGE_ENTRY(JOB_ADDED),
+    LANGUAGE_ENTRY(JOB_WAITING),
+    LANGUAGE_ENTRY(JOB_RUNNING),
+    LANGUAGE_ENTRY(JOB_PAUSED),
+    LANGUAGE_ENTRY(JOB_FINISHED),
+    LANGUAGE_ENTRY(JOB_FAILED),
+    LANGUAGE_ENTRY(JOB_CANCELED),
 
     // Dialog questions
     LANGUAGE_ENTRY(DELETE_FILE_QUESTION),
@@ -203,6 +227,8 @@ void loadLanguage(int id) {
     LANGUAGE_ENTRY(EXPORT_SONGS_PICTURES_INFO),
     LANGUAGE_ENTRY(EXPORT_VIDEOS_PICTURES_INFO),
     LANGUAGE_ENTRY(EXPORT_SONGS_VIDEOS_PICTURES_INFO),
+    LANGUAGE_ENTRY(EXTRACT_SKIPPED_INFO),
+    LANGUAGE_ENTRY(CRC32_INFO),
     LANGUAGE_ENTRY(INSTALL_ALL_QUESTION),
     LANGUAGE_ENTRY(INSTALL_FOLDER_QUESTION),
     LANGUAGE_ENTRY(INSTALL_QUESTION),
@@ -210,9 +236,13 @@ void loadLanguage(int id) {
     LANGUAGE_ENTRY(INSTALL_BRICK_WARNING),
     LANGUAGE_ENTRY(INSTALL_COMPLETE_SUCCESS),
     LANGUAGE_ENTRY(HASH_FILE_QUESTION),
+    LANGUAGE_ENTRY(TEST_ARCHIVE_QUESTION),
+    LANGUAGE_ENTRY(TEST_ARCHIVE_SUCCESS),
+    LANGUAGE_ENTRY(TEST_ARCHIVE_FAILED),
     LANGUAGE_ENTRY(SAVE_MODIFICATIONS),
     LANGUAGE_ENTRY(REFRESH_LIVEAREA_QUESTION),
     LANGUAGE_ENTRY(REFRESH_LICENSE_DB_QUESTION),
+    LANGUAGE_ENTRY(BENCHMARK_QUESTION),
 
     // HENkaku settings strings
     LANGUAGE_ENTRY(HENKAKU_SETTINGS),
@@ -234,6 +264,8 @@ void loadLanguage(int id) {
     LANGUAGE_ENTRY(VITASHELL_SETTINGS_SELECT_BUTTON),
     LANGUAGE_ENTRY(VITASHELL_SETTINGS_NO_AUTO_UPDATE),
     LANGUAGE_ENTRY(VITASHELL_SETTINGS_WARNING_MESSAGE),
+    LANGUAGE_ENTRY(VITASHELL_SETTINGS_BACKGROUND_JOBS),
+    LANGUAGE_ENTRY(VITASHELL_SETTINGS_SKIP_IDENTICAL),
     LANGUAGE_ENTRY(VITASHELL_SETTINGS_RESTART_SHELL),
     LANGUAGE_ENTRY(VITASHELL_SETTINGS_POWER),
     LANGUAGE_ENTRY(VITASHELL_SETTINGS_REBOOT),
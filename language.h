@@ -41,7 +41,10 @@ enum LanguageContainer {
   EXTRACTING,
   COMPRESSING,
   HASHING,
+  TESTING,
+  CONVERTING,
   REFRESHING,
+  BENCHMARKING,
   SENDING,
   RECEIVING,
 
@@ -97,17 +100,24 @@ enum LanguageContainer {
   BOOKMARKS_NEW,
   RECENT_FILES_SHOW,
   COMPRESS,
+  COMPRESS_PSARC,
   INSTALL_ALL,
   INSTALL_FOLDER,
   CALCULATE_SHA1,
   CALCULATE_MD5,
   CALCULATE_SHA256,
+  SHOW_CRC32,
   OPEN_DECRYPTED,
   EXPORT_MEDIA,
+  TEST_ARCHIVE,
+  CONVERT_ZIP,
   CUT,
   INSERT_EMPTY_LINE,
   SEARCH,
   COPY_TO_CLIPBOARD,
+  JOBS,
+  SAVE_IO_TRACE,
+  BENCHMARK_DEVICE,
 
   // File browser properties strings
   PROPERTY_NAME,
@@ -145,6 +155,20 @@ enum LanguageContainer {
   FILE_COPIED_TO_CLIPBOARD,
   PROCESSING_FILE,
   PROCESSING_DIRECTORY,
+  FILES_PER_SECOND,
+  IO_TRACE_SAVED,
+  BENCHMARK_RESULT,
+
+  // Job strings
+  JOBS_EMPTY,
+  JOBS_CONTROLS,
+  JOB_ADDED,
+  JOB_WAITING,
+  JOB_RUNNING,
+  JOB_PAUSED,
+  JOB_FINISHED,
+  JOB_FAILED,
+  JOB_CANCELED,
 
   // Dialog questions
   DELETE_FILE_QUESTION,
@@ -162,6 +186,8 @@ enum LanguageContainer {
   EXPORT_SONGS_PICTURES_INFO,
   EXPORT_VIDEOS_PICTURES_INFO,
   EXPORT_SONGS_VIDEOS_PICTURES_INFO,
+  EXTRACT_SKIPPED_INFO,
+  CRC32_INFO,
   INSTALL_ALL_QUESTION,
   INSTALL_FOLDER_QUESTION,
   INSTALL_QUESTION,
@@ -169,9 +195,13 @@ enum LanguageContainer {
   INSTALL_BRICK_WARNING,
   INSTALL_COMPLETE_SUCCESS,
   HASH_FILE_QUESTION,
+  TEST_ARCHIVE_QUESTION,
+  TEST_ARCHIVE_SUCCESS,
+  TEST_ARCHIVE_FAILED,
   SAVE_MODIFICATIONS,
   REFRESH_LIVEAREA_QUESTION,
   REFRESH_LICENSE_DB_QUESTION,
+  BENCHMARK_QUESTION,
 
   // HENkaku settings strings
   HENKAKU_SETTINGS,
@@ -193,6 +223,8 @@ enum LanguageContainer {
   VITASHELL_SETTINGS_SELECT_BUTTON,
   VITASHELL_SETTINGS_NO_AUTO_UPDATE,
   VITASHELL_SETTINGS_WARNING_MESSAGE,
+  VITASHELL_SETTINGS_BACKGROUND_JOBS,
+  VITASHELL_SETTINGS_SKIP_IDENTICAL,
   VITASHELL_SETTINGS_RESTART_SHELL,
   VITASHELL_SETTINGS_POWER,
   VITASHELL_SETTINGS_REBOOT,
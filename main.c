@@ -21,6 +21,9 @@
 #include "browser.h"
 #include "init.h"
 #include "io_process.h"
+#include "jobs.h"
+#include "benchmark.h"
+#include "iotrace.h"
 #include "refresh.h"
 #include "makezip.h"
 #include "package_installer.h"
@@ -81,6 +84,9 @@ static volatile int dialog_step = DIALOG_STEP_NONE;
 
 static char install_path[MAX_PATH_LENGTH];
 static char compress_name[MAX_NAME_LENGTH];
+static char convert_path[MAX_PATH_LENGTH];
+
+static int job_result = 0;
 
 static SceUID usbdevice_modid = -1;
 
@@ -304,6 +310,14 @@ void initUsb() {
   }
 }
 
+static void jobAdded(int res) {
+  job_result = res;
+
+  // Close the progress bar, the job list presents the operation now
+  sceMsgDialogClose();
+  setDialogStep(DIALOG_STEP_JOB_ADDED);
+}
+
 int dialogSteps() {
   int refresh = REFRESH_MODE_NONE;
 
@@ -408,7 +422,12 @@ int dialogSteps() {
         }
 
         refresh = REFRESH_MODE_SETFOCUS;
-        setDialogStep(DIALOG_STEP_NONE);
+
+        // Files that were identical have not been extracted
+        if (getCopySkipped() > 0)
+          infoDialog(language_container[EXTRACT_SKIPPED_INFO], getCopySkipped());
+        else
+          setDialogStep(DIALOG_STEP_NONE);
       }
 
       break;
@@ -430,6 +449,31 @@ int dialogSteps() {
       break;
     }
     
+    case DIALOG_STEP_BENCHMARK_QUESTION:
+    {
+      if (msg_result == MESSAGE_DIALOG_RESULT_YES) {
+        FileListEntry *file_entry = fileListGetNthEntry(&file_list, base_pos + rel_pos);
+        if (file_entry) {
+          BenchmarkArguments args;
+          memset(&args, 0, sizeof(BenchmarkArguments));
+          strncpy(args.device, file_entry->name, sizeof(args.device) - 1);
+
+          initMessageDialog(MESSAGE_DIALOG_PROGRESS_BAR, language_container[BENCHMARKING]);
+          setDialogStep(DIALOG_STEP_BENCHMARKING);
+
+          SceUID thid = sceKernelCreateThread("benchmark_thread", (SceKernelThreadEntry)benchmark_thread, 0x40, 0x100000, 0, 0, NULL);
+          if (thid >= 0)
+            sceKernelStartThread(thid, sizeof(BenchmarkArguments), &args);
+        } else {
+          setDialogStep(DIALOG_STEP_NONE);
+        }
+      } else if (msg_result == MESSAGE_DIALOG_RESULT_NO) {
+        setDialogStep(DIALOG_STEP_NONE);
+      }
+
+      break;
+    }
+
     case DIALOG_STEP_REFRESH_LICENSE_DB_QUESTION:
     {
       if (msg_result == MESSAGE_DIALOG_RESULT_YES) {
@@ -561,9 +605,35 @@ int dialogSteps() {
       break;
     }
     
+    case DIALOG_STEP_JOB_ADDED:
+    {
+      if (msg_result == MESSAGE_DIALOG_RESULT_NONE ||
+          msg_result == MESSAGE_DIALOG_RESULT_FINISHED) {
+        if (job_result < 0) {
+          errorDialog(job_result);
+        } else {
+          infoDialog(language_container[JOB_ADDED]);
+        }
+
+        refresh = REFRESH_MODE_NORMAL;
+      }
+
+      break;
+    }
+
     case DIALOG_STEP_PASTE:
     {
       if (msg_result == MESSAGE_DIALOG_RESULT_RUNNING) {
+        if (vitashell_config.background_jobs && copy_mode != COPY_MODE_EXTRACT) {
+          jobAdded(jobAddCopy(&copy_list, file_list.path, copy_mode));
+
+          // Sources are gone after moving
+          if (copy_mode == COPY_MODE_MOVE)
+            fileListEmpty(&copy_list);
+
+          break;
+        }
+
         CopyArguments args;
         args.file_list = &file_list;
         args.copy_list = &copy_list;
@@ -595,6 +665,17 @@ int dialogSteps() {
     case DIALOG_STEP_DELETE_CONFIRMED:
     {
       if (msg_result == MESSAGE_DIALOG_RESULT_RUNNING) {
+        if (vitashell_config.background_jobs) {
+          jobAdded(jobAddDelete(&file_list, &mark_list, base_pos + rel_pos));
+
+          // Empty mark list if on marked entry
+          FileListEntry *file_entry = fileListGetNthEntry(&file_list, base_pos + rel_pos);
+          if (file_entry && fileListFindEntry(&mark_list, file_entry->name))
+            fileListEmpty(&mark_list);
+
+          break;
+        }
+
         DeleteArguments args;
         args.file_list = &file_list;
         args.mark_list = &mark_list;
@@ -625,6 +706,11 @@ int dialogSteps() {
     case DIALOG_STEP_EXPORT_CONFIRMED:
     {
       if (msg_result == MESSAGE_DIALOG_RESULT_RUNNING) {
+        if (vitashell_config.background_jobs) {
+          jobAdded(jobAddExport(&file_list, &mark_list, base_pos + rel_pos));
+          break;
+        }
+
         ExportArguments args;
         args.file_list = &file_list;
         args.mark_list = &mark_list;
@@ -774,6 +860,17 @@ int dialogSteps() {
         } else {
           snprintf(cur_file, MAX_PATH_LENGTH, "%s%s", file_list.path, compress_name);
 
+          if (vitashell_config.background_jobs) {
+            int res = jobAddCompress(&file_list, &mark_list, base_pos + rel_pos, cur_file, atoi(level));
+            if (res < 0) {
+              errorDialog(res);
+            } else {
+              infoDialog(language_container[JOB_ADDED]);
+            }
+
+            break;
+          }
+
           CompressArguments args;
           args.file_list = &file_list;
           args.mark_list = &mark_list;
@@ -819,6 +916,12 @@ int dialogSteps() {
           break;
         }
         
+        // Files inside an archive can only be read while it is open
+        if (vitashell_config.background_jobs && !isInArchive()) {
+          jobAdded(jobAddHash(&file_list, base_pos + rel_pos, HASH_TYPE_SHA1));
+          break;
+        }
+
         // Place the full file path in cur_file
         snprintf(cur_file, MAX_PATH_LENGTH, "%s%s", file_list.path, file_entry->name);
 
@@ -1092,6 +1195,8 @@ int dialogSteps() {
       if (ime_result == IME_DIALOG_RESULT_FINISHED) {
         char *password = (char *)getImeDialogInputTextUTF8();
         if (password[0] == '\0') {
+          // Go back to the parent if it was a nested archive
+          archiveClose();
           setDialogStep(DIALOG_STEP_NONE);
         } else {
           // TODO: verify password
@@ -1099,15 +1204,16 @@ int dialogSteps() {
           
           FileListEntry *file_entry = fileListGetNthEntry(&file_list, base_pos + rel_pos);
           if (!file_entry) {
+            archiveClose();
             setDialogStep(DIALOG_STEP_NONE);
             break;
           }
           
+          snprintf(archive_path, MAX_PATH_LENGTH, "%s%s", file_list.path, file_entry->name);
+
           setInArchive();
           setDirArchiveLevel();
 
-          snprintf(archive_path, MAX_PATH_LENGTH, "%s%s", file_list.path, file_entry->name);
-
           strcat(file_list.path, file_entry->name);
           addEndSlash(file_list.path);
 
@@ -1117,6 +1223,7 @@ int dialogSteps() {
           setDialogStep(DIALOG_STEP_NONE);
         }
       } else if (ime_result == IME_DIALOG_RESULT_CANCELED) {
+        archiveClose();
         setDialogStep(DIALOG_STEP_NONE);
       }
 
@@ -1295,6 +1402,12 @@ int dialogSteps() {
           break;
         }
         
+        // Files inside an archive can only be read while it is open
+        if (vitashell_config.background_jobs && !isInArchive()) {
+          jobAdded(jobAddHash(&file_list, base_pos + rel_pos, HASH_TYPE_MD5));
+          break;
+        }
+
         // Place the full file path in cur_file
         snprintf(cur_file, MAX_PATH_LENGTH, "%s%s", file_list.path, file_entry->name);
 
@@ -1337,6 +1450,12 @@ int dialogSteps() {
           break;
         }
         
+        // Files inside an archive can only be read while it is open
+        if (vitashell_config.background_jobs && !isInArchive()) {
+          jobAdded(jobAddHash(&file_list, base_pos + rel_pos, HASH_TYPE_SHA256));
+          break;
+        }
+
         // Place the full file path in cur_file
         snprintf(cur_file, MAX_PATH_LENGTH, "%s%s", file_list.path, file_entry->name);
 
@@ -1354,7 +1473,93 @@ int dialogSteps() {
 
       break;
     }
+
+    case DIALOG_STEP_TEST_QUESTION:
+    {
+      if (msg_result == MESSAGE_DIALOG_RESULT_YES) {
+        initMessageDialog(MESSAGE_DIALOG_PROGRESS_BAR, language_container[TESTING]);
+        setDialogStep(DIALOG_STEP_TEST_CONFIRMED);
+      } else if (msg_result == MESSAGE_DIALOG_RESULT_NO) {
+        setDialogStep(DIALOG_STEP_NONE);
+      }
+
+      break;
+    }
+
+    case DIALOG_STEP_TEST_CONFIRMED:
+    {
+      if (msg_result == MESSAGE_DIALOG_RESULT_RUNNING) {
+        FileListEntry *file_entry = fileListGetNthEntry(&file_list, base_pos + rel_pos);
+        if (!file_entry) {
+          setDialogStep(DIALOG_STEP_NONE);
+          break;
+        }
+
+        snprintf(cur_file, MAX_PATH_LENGTH, "%s%s", file_list.path, file_entry->name);
+
+        TestArguments args;
+        args.file_path = cur_file;
+
+        setDialogStep(DIALOG_STEP_TESTING);
+
+        SceUID thid = sceKernelCreateThread("test_thread", (SceKernelThreadEntry)test_thread, 0x40, 0x100000, 0, 0, NULL);
+        if (thid >= 0)
+          sceKernelStartThread(thid, sizeof(TestArguments), &args);
+      }
+
+      break;
+    }
     
+    case DIALOG_STEP_CONVERT_NAME:
+    {
+      if (ime_result == IME_DIALOG_RESULT_FINISHED) {
+        char *name = (char *)getImeDialogInputTextUTF8();
+        FileListEntry *file_entry = fileListGetNthEntry(&file_list, base_pos + rel_pos);
+        if (name[0] == '\0' || !file_entry) {
+          setDialogStep(DIALOG_STEP_NONE);
+        } else {
+          strcpy(compress_name, name);
+          snprintf(convert_path, MAX_PATH_LENGTH, "%s%s", file_list.path, file_entry->name);
+
+          // Same level prompt as for compressing
+          initImeDialog(language_container[COMPRESSION_LEVEL], "6", 1, SCE_IME_TYPE_NUMBER, 0, 0);
+          setDialogStep(DIALOG_STEP_CONVERT_LEVEL);
+        }
+      } else if (ime_result == IME_DIALOG_RESULT_CANCELED) {
+        setDialogStep(DIALOG_STEP_NONE);
+      }
+
+      break;
+    }
+
+    case DIALOG_STEP_CONVERT_LEVEL:
+    {
+      if (ime_result == IME_DIALOG_RESULT_FINISHED) {
+        char *level = (char *)getImeDialogInputTextUTF8();
+        if (level[0] == '\0') {
+          setDialogStep(DIALOG_STEP_NONE);
+        } else {
+          snprintf(cur_file, MAX_PATH_LENGTH, "%s%s", file_list.path, compress_name);
+
+          ConvertArguments args;
+          args.archive_path = convert_path;
+          args.path = cur_file;
+          args.level = atoi(level);
+
+          initMessageDialog(MESSAGE_DIALOG_PROGRESS_BAR, language_container[CONVERTING]);
+          setDialogStep(DIALOG_STEP_CONVERTING);
+
+          SceUID thid = sceKernelCreateThread("convert_thread", (SceKernelThreadEntry)convert_thread, 0x40, 0x100000, 0, 0, NULL);
+          if (thid >= 0)
+            sceKernelStartThread(thid, sizeof(ConvertArguments), &args);
+        }
+      } else if (ime_result == IME_DIALOG_RESULT_CANCELED) {
+        setDialogStep(DIALOG_STEP_NONE);
+      }
+
+      break;
+    }
+
     case DIALOG_STEP_ADHOC_SENDING:
     case DIALOG_STEP_ADHOC_RECEIVING:
     {
@@ -1386,6 +1591,12 @@ int main(int argc, const char *argv[]) {
   // Create mutex
   sceKernelCreateLwMutex(&dialog_mutex, "dialog_mutex", 2, 0, NULL);
 
+  // Init background jobs
+  initJobs();
+
+  // Init I/O tracing, does nothing unless built with ENABLE_IOTRACE
+  IOTRACE_INIT();
+
   // Init VitaShell
   initVitaShell();
 
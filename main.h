@@ -173,6 +173,9 @@ enum DialogSteps {
   DIALOG_STEP_REFRESH_LICENSE_DB_QUESTION,
   DIALOG_STEP_REFRESHING,
 
+  DIALOG_STEP_BENCHMARK_QUESTION,
+  DIALOG_STEP_BENCHMARKING,
+
   DIALOG_STEP_USB_ATTACH_WAIT,
 
   DIALOG_STEP_FTP_WAIT,
@@ -229,6 +232,16 @@ enum DialogSteps {
   DIALOG_STEP_HASH_SHA256_CONFIRMED,
   DIALOG_STEP_HASHING_SHA256,
 
+  DIALOG_STEP_TEST_QUESTION,
+  DIALOG_STEP_TEST_CONFIRMED,
+  DIALOG_STEP_TESTING,
+
+  DIALOG_STEP_CONVERT_NAME,
+  DIALOG_STEP_CONVERT_LEVEL,
+  DIALOG_STEP_CONVERTING,
+
+  DIALOG_STEP_JOB_ADDED,
+
   DIALOG_STEP_SETTINGS_AGREEMENT,
   DIALOG_STEP_SETTINGS_STRING,
   
@@ -17,9 +17,13 @@
 */
 
 #include "main.h"
+#include "archive.h"
 #include "browser.h"
 #include "init.h"
 #include "io_process.h"
+#include "jobs.h"
+#include "benchmark.h"
+#include "iotrace.h"
 #include "context_menu.h"
 #include "file.h"
 #include "language.h"
@@ -45,6 +49,11 @@ enum MenuHomeEntrys {
   MENU_HOME_ENTRY_UMOUNT_USB_UX0,
   MENU_HOME_ENTRY_MOUNT_GAMECARD_UX0,
   MENU_HOME_ENTRY_UMOUNT_GAMECARD_UX0,
+  MENU_HOME_ENTRY_JOBS,
+  MENU_HOME_ENTRY_BENCHMARK_DEVICE,
+#ifdef ENABLE_IOTRACE
+  MENU_HOME_ENTRY_SAVE_IO_TRACE,
+#endif
 };
 
 MenuEntry menu_home_entries[] = {
@@ -60,6 +69,11 @@ MenuEntry menu_home_entries[] = {
   { UMOUNT_USB_UX0,      12, 0, CTX_INVISIBLE },
   { MOUNT_GAMECARD_UX0,  14, 0, CTX_INVISIBLE },
   { UMOUNT_GAMECARD_UX0, 15, 0, CTX_INVISIBLE },
+  { JOBS,                17, 0, CTX_INVISIBLE },
+  { BENCHMARK_DEVICE,    18, 0, CTX_INVISIBLE },
+#ifdef ENABLE_IOTRACE
+  { SAVE_IO_TRACE,       19, 0, CTX_INVISIBLE },
+#endif
 };
 
 #define N_MENU_HOME_ENTRIES (sizeof(menu_home_entries) / sizeof(MenuEntry))
@@ -78,6 +92,7 @@ enum MenuMainEntrys {
   MENU_MAIN_ENTRY_MORE,
   MENU_MAIN_ENTRY_ADHOC,
   MENU_MAIN_ENTRY_BOOKMARKS,
+  MENU_MAIN_ENTRY_JOBS,
 };
 
 MenuEntry menu_main_entries[] = {
@@ -94,6 +109,7 @@ MenuEntry menu_main_entries[] = {
   { MORE,           14, CTX_FLAG_MORE, CTX_INVISIBLE },
   { ADHOC_TRANSFER, 16, CTX_FLAG_MORE, CTX_INVISIBLE },
   { BOOKMARKS,      17, CTX_FLAG_MORE, CTX_INVISIBLE },
+  { JOBS,           19, 0, CTX_INVISIBLE },
 };
 
 #define N_MENU_MAIN_ENTRIES (sizeof(menu_main_entries) / sizeof(MenuEntry))
@@ -140,20 +156,28 @@ enum MenuMoreEntrys {
   MENU_MORE_ENTRY_CALCULATE_SHA1,
   MENU_MORE_ENTRY_CALCULATE_MD5,
   MENU_MORE_ENTRY_CALCULATE_SHA256,
+  MENU_MORE_ENTRY_SHOW_CRC32,
   MENU_MORE_ENTRY_COMPRESS,
+  MENU_MORE_ENTRY_COMPRESS_PSARC,
   MENU_MORE_ENTRY_INSTALL_ALL,
   MENU_MORE_ENTRY_INSTALL_FOLDER,
   MENU_MORE_ENTRY_EXPORT_MEDIA,
+  MENU_MORE_ENTRY_TEST_ARCHIVE,
+  MENU_MORE_ENTRY_CONVERT_ZIP,
 };
 
 MenuEntry menu_more_entries[] = {
   { CALCULATE_SHA1,   0, 0, CTX_INVISIBLE },
   { CALCULATE_MD5,    1, 0, CTX_INVISIBLE },
   { CALCULATE_SHA256, 2, 0, CTX_INVISIBLE },
+  { SHOW_CRC32,       3, 0, CTX_INVISIBLE },
   { COMPRESS,         4, 0, CTX_INVISIBLE },
-  { INSTALL_ALL,      5, 0, CTX_INVISIBLE },
-  { INSTALL_FOLDER,   6, 0, CTX_INVISIBLE },
-  { EXPORT_MEDIA,     7, 0, CTX_INVISIBLE },
+  { COMPRESS_PSARC,   5, 0, CTX_INVISIBLE },
+  { INSTALL_ALL,      6, 0, CTX_INVISIBLE },
+  { INSTALL_FOLDER,   7, 0, CTX_INVISIBLE },
+  { EXPORT_MEDIA,     8, 0, CTX_INVISIBLE },
+  { TEST_ARCHIVE,     9, 0, CTX_INVISIBLE },
+  { CONVERT_ZIP,     10, 0, CTX_INVISIBLE },
 };
 
 #define N_MENU_MORE_ENTRIES (sizeof(menu_more_entries) / sizeof(MenuEntry))
@@ -570,7 +594,9 @@ void setContextMenuMoreVisibilities() {
 
   // Invisble entries when on '..'
   if (strcmp(file_entry->name, DIR_UP) == 0) {
+    menu_more_entries[MENU_MORE_ENTRY_SHOW_CRC32].visibility = CTX_INVISIBLE;
     menu_more_entries[MENU_MORE_ENTRY_COMPRESS].visibility = CTX_INVISIBLE;
+    menu_more_entries[MENU_MORE_ENTRY_COMPRESS_PSARC].visibility = CTX_INVISIBLE;
     menu_more_entries[MENU_MORE_ENTRY_INSTALL_ALL].visibility = CTX_INVISIBLE;
     menu_more_entries[MENU_MORE_ENTRY_INSTALL_FOLDER].visibility = CTX_INVISIBLE;
     menu_more_entries[MENU_MORE_ENTRY_EXPORT_MEDIA].visibility = CTX_INVISIBLE;
@@ -582,14 +608,30 @@ void setContextMenuMoreVisibilities() {
   // Invisble operations in archives
   if (isInArchive() || (pfs_mounted_path[0] && strstr(file_list.path, pfs_mounted_path) && read_only)) {
     menu_more_entries[MENU_MORE_ENTRY_COMPRESS].visibility = CTX_INVISIBLE;
+    menu_more_entries[MENU_MORE_ENTRY_COMPRESS_PSARC].visibility = CTX_INVISIBLE;
     menu_more_entries[MENU_MORE_ENTRY_INSTALL_ALL].visibility = CTX_INVISIBLE;
     menu_more_entries[MENU_MORE_ENTRY_INSTALL_FOLDER].visibility = CTX_INVISIBLE;
     menu_more_entries[MENU_MORE_ENTRY_EXPORT_MEDIA].visibility = CTX_INVISIBLE;
+  }
+
+  // Invisible hashes in read-only mounts, files in archives are read through the archive
+  if (!isInArchive() && pfs_mounted_path[0] && strstr(file_list.path, pfs_mounted_path) && read_only) {
     menu_more_entries[MENU_MORE_ENTRY_CALCULATE_SHA1].visibility = CTX_INVISIBLE;
     menu_more_entries[MENU_MORE_ENTRY_CALCULATE_MD5].visibility = CTX_INVISIBLE;
     menu_more_entries[MENU_MORE_ENTRY_CALCULATE_SHA256].visibility = CTX_INVISIBLE;
   }
 
+  // The stored CRC32 is only known for ZIP entries
+  if (!isInArchive() || file_entry->is_folder) {
+    menu_more_entries[MENU_MORE_ENTRY_SHOW_CRC32].visibility = CTX_INVISIBLE;
+  } else {
+    char path[MAX_PATH_LENGTH];
+    uint32_t crc = 0;
+    snprintf(path, MAX_PATH_LENGTH, "%s%s", file_list.path, file_entry->name);
+    if (archiveFileGetCrc32(path, &crc) < 0)
+      menu_more_entries[MENU_MORE_ENTRY_SHOW_CRC32].visibility = CTX_INVISIBLE;
+  }
+
   if (file_entry->is_folder) {
     menu_more_entries[MENU_MORE_ENTRY_CALCULATE_SHA1].visibility = CTX_INVISIBLE;
     menu_more_entries[MENU_MORE_ENTRY_CALCULATE_MD5].visibility = CTX_INVISIBLE;
@@ -624,6 +666,12 @@ void setContextMenuMoreVisibilities() {
     menu_more_entries[MENU_MORE_ENTRY_INSTALL_ALL].visibility = CTX_INVISIBLE;
   }
 
+  // Archives are tested and converted from outside
+  if (isInArchive() || file_entry->is_folder || file_entry->type != FILE_TYPE_ARCHIVE) {
+    menu_more_entries[MENU_MORE_ENTRY_TEST_ARCHIVE].visibility = CTX_INVISIBLE;
+    menu_more_entries[MENU_MORE_ENTRY_CONVERT_ZIP].visibility = CTX_INVISIBLE;
+  }
+
   // Invisible export for non-media files
   if (!file_entry->is_folder &&
     file_entry->type != FILE_TYPE_BMP && file_entry->type != FILE_TYPE_JPEG &&
@@ -836,6 +884,41 @@ static int contextMenuHomeEnterCallback(int sel, void *context) {
       }
       break;
     }
+
+    case MENU_HOME_ENTRY_JOBS:
+    {
+      jobsViewer();
+      refreshFileList();
+      break;
+    }
+
+    case MENU_HOME_ENTRY_BENCHMARK_DEVICE:
+    {
+      FileListEntry *file_entry = fileListGetNthEntry(&file_list, base_pos + rel_pos);
+      if (file_entry) {
+        char size_string[16];
+        getSizeString(size_string, BENCHMARK_NEEDED_SPACE);
+
+        initMessageDialog(SCE_MSG_DIALOG_BUTTON_TYPE_YESNO, language_container[BENCHMARK_QUESTION], file_entry->name, size_string);
+        setDialogStep(DIALOG_STEP_BENCHMARK_QUESTION);
+      }
+
+      break;
+    }
+
+#ifdef ENABLE_IOTRACE
+    case MENU_HOME_ENTRY_SAVE_IO_TRACE:
+    {
+      int res = iotraceDump("manual");
+      if (res < 0) {
+        errorDialog(res);
+      } else {
+        infoDialog(language_container[IO_TRACE_SAVED], IOTRACE_TEXT_PATH);
+      }
+
+      break;
+    }
+#endif
   }
 
   return CONTEXT_MENU_CLOSING;
@@ -1112,6 +1195,13 @@ static int contextMenuMainEnterCallback(int sel, void *context) {
       setContextMenuAdhocVisibilities();
       return CONTEXT_MENU_MORE_OPENING;
     }
+
+    case MENU_MAIN_ENTRY_JOBS:
+    {
+      jobsViewer();
+      refreshFileList();
+      break;
+    }
   }
 
   return CONTEXT_MENU_CLOSING;
@@ -1177,6 +1267,7 @@ static int contextMenuAdhocEnterCallback(int sel, void *context) {
 static int contextMenuMoreEnterCallback(int sel, void *context) {
   switch (sel) {
     case MENU_MORE_ENTRY_COMPRESS:
+    case MENU_MORE_ENTRY_COMPRESS_PSARC:
     {
       FileListEntry *file_entry = fileListGetNthEntry(&file_list, base_pos + rel_pos);
       if (file_entry) {
@@ -1210,8 +1301,8 @@ static int contextMenuMoreEnterCallback(int sel, void *context) {
           path[p - file_entry->name] = '\0';
         }
 
-        // Append .zip extension
-        strcat(path, ".zip");
+        // Append .zip or .psarc extension, the extension selects the format
+        strcat(path, sel == MENU_MORE_ENTRY_COMPRESS_PSARC ? ".psarc" : ".zip");
 
         initImeDialog(language_container[ARCHIVE_NAME], path, MAX_NAME_LENGTH, SCE_IME_TYPE_BASIC_LATIN, 0, 0);
         setDialogStep(DIALOG_STEP_COMPRESS_NAME);
@@ -1304,6 +1395,52 @@ static int contextMenuMoreEnterCallback(int sel, void *context) {
       setDialogStep(DIALOG_STEP_HASH_SHA256_QUESTION);
       break;
     }
+
+    case MENU_MORE_ENTRY_SHOW_CRC32:
+    {
+      FileListEntry *file_entry = fileListGetNthEntry(&file_list, base_pos + rel_pos);
+      if (file_entry) {
+        char path[MAX_PATH_LENGTH];
+        uint32_t crc = 0;
+        snprintf(path, MAX_PATH_LENGTH, "%s%s", file_list.path, file_entry->name);
+
+        int res = archiveFileGetCrc32(path, &crc);
+        if (res < 0)
+          errorDialog(res);
+        else
+          infoDialog(language_container[CRC32_INFO], crc);
+      }
+
+      break;
+    }
+
+    case MENU_MORE_ENTRY_TEST_ARCHIVE:
+    {
+      initMessageDialog(SCE_MSG_DIALOG_BUTTON_TYPE_YESNO, language_container[TEST_ARCHIVE_QUESTION]);
+      setDialogStep(DIALOG_STEP_TEST_QUESTION);
+      break;
+    }
+
+    case MENU_MORE_ENTRY_CONVERT_ZIP:
+    {
+      FileListEntry *file_entry = fileListGetNthEntry(&file_list, base_pos + rel_pos);
+      if (file_entry) {
+        char path[MAX_NAME_LENGTH];
+
+        char *p = strrchr(file_entry->name, '.');
+        if (!p)
+          p = file_entry->name + strlen(file_entry->name);
+
+        strncpy(path, file_entry->name, p - file_entry->name);
+        path[p - file_entry->name] = '\0';
+        strcat(path, ".zip");
+
+        initImeDialog(language_container[ARCHIVE_NAME], path, MAX_NAME_LENGTH, SCE_IME_TYPE_BASIC_LATIN, 0, 0);
+        setDialogStep(DIALOG_STEP_CONVERT_NAME);
+      }
+
+      break;
+    }
   }
 
   return CONTEXT_MENU_CLOSING;
@@ -0,0 +1,620 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <psp2/kernel/threadmgr.h>
+
+#include "core.h"
+#include "makepsarc.h"
+#include "workerpool.h"
+#include "psarcindex.h"
+#include "md5.h"
+
+// The table of contents comes before the data and its size depends on the
+// number of blocks, so the files are collected first. The blocks of all
+// files are numbered in order and compressed round robin by the workers,
+// and the calling thread writes them out in order, like psarcextract.c.
+// The table is written last, once the stored block sizes are known.
+
+typedef struct {
+  char *path; // NULL for the manifest
+  const char *name;
+  uint64_t size;
+  uint64_t offset;
+  uint32_t block_index;
+} PsarcCompressEntry;
+
+typedef struct {
+  PsarcCompressEntry *entries;
+  int count;
+  int max;
+  int filename_start;
+  char *manifest;
+  uint32_t n_blocks;
+} PsarcCompressList;
+
+typedef struct {
+  uint32_t block;
+  int size; // Stored size of the block, < 0 on error
+  uint8_t *buffer;
+} PsarcCompressSlot;
+
+typedef struct {
+  WorkerRing ring;
+  PsarcCompressList *list;
+  int level;
+  uint32_t first;
+  uint32_t step;
+  PsarcCompressSlot slots[PSARC_COMPRESS_SLOTS];
+} PsarcCompressWorker;
+
+int isPsarcPath(const char *path) {
+  const char *ext = strrchr(path, '.');
+  return ext && strcasecmp(ext, ".psarc") == 0;
+}
+
+static void writeBe(uint8_t *p, uint64_t value, int size) {
+  while (size-- > 0) {
+    p[size] = value & 0xFF;
+    value >>= 8;
+  }
+}
+
+static uint32_t getPsarcEntryBlocks(PsarcCompressEntry *entry) {
+  return (entry->size + PSARC_COMPRESS_BLOCK_SIZE - 1) / PSARC_COMPRESS_BLOCK_SIZE;
+}
+
+static int addPsarcEntry(PsarcCompressList *list, const char *path, uint64_t size) {
+  if (list->count == list->max) {
+    int max = list->max ? list->max * 2 : 64;
+    PsarcCompressEntry *entries = realloc(list->entries, max * sizeof(PsarcCompressEntry));
+    if (!entries)
+      return VITASHELL_ERROR_NO_MEMORY;
+
+    list->entries = entries;
+    list->max = max;
+  }
+
+  PsarcCompressEntry *entry = &list->entries[list->count];
+  memset(entry, 0, sizeof(PsarcCompressEntry));
+
+  if (path) {
+    entry->path = malloc(strlen(path) + 1);
+    if (!entry->path)
+      return VITASHELL_ERROR_NO_MEMORY;
+
+    strcpy(entry->path, path);
+    entry->name = entry->path + list->filename_start;
+  } else {
+    entry->name = "";
+  }
+
+  entry->size = size;
+  list->count++;
+
+  return 1;
+}
+
+static int addPsarcPath(PsarcCompressList *list, const char *path, FileProcessParam *param) {
+  SceUID dfd = sceIoDopen(path);
+  if (dfd >= 0) {
+    // Folders are implied by the paths of their files, but are counted
+    // in the progress like with makeZip
+    if (param) {
+      if (param->value)
+        (*param->value)++;
+
+      if (param->SetProgress)
+        param->SetProgress(param->value ? *param->value : 0, param->max);
+
+      if (param->cancelHandler && param->cancelHandler()) {
+        sceIoDclose(dfd);
+        return 0;
+      }
+    }
+
+    int res = 0;
+
+    do {
+      SceIoDirent dir;
+      memset(&dir, 0, sizeof(SceIoDirent));
+
+      res = sceIoDread(dfd, &dir);
+      if (res > 0) {
+        char *new_path = malloc(strlen(path) + strlen(dir.d_name) + 2);
+        snprintf(new_path, MAX_PATH_LENGTH, "%s%s%s", path, hasEndSlash(path) ? "" : "/", dir.d_name);
+
+        int ret = 0;
+
+        if (SCE_S_ISDIR(dir.d_stat.st_mode)) {
+          ret = addPsarcPath(list, new_path, param);
+        } else {
+          ret = addPsarcEntry(list, new_path, dir.d_stat.st_size);
+        }
+
+        free(new_path);
+
+        // Some folders are protected and return 0x80010001. Bypass them
+        if (ret <= 0 && ret != 0x80010001) {
+          sceIoDclose(dfd);
+          return ret;
+        }
+      }
+    } while (res > 0);
+
+    sceIoDclose(dfd);
+  } else {
+    SceIoStat stat;
+    memset(&stat, 0, sizeof(SceIoStat));
+    int res = sceIoGetstat(path, &stat);
+    if (res < 0)
+      return res;
+
+    return addPsarcEntry(list, path, stat.st_size);
+  }
+
+  return 1;
+}
+
+static void freePsarcList(PsarcCompressList *list) {
+  int i;
+  for (i = 0; i < list->count; i++) {
+    if (list->entries[i].path)
+      free(list->entries[i].path);
+  }
+
+  if (list->entries)
+    free(list->entries);
+  if (list->manifest)
+    free(list->manifest);
+
+  memset(list, 0, sizeof(PsarcCompressList));
+}
+
+// Join the names into the manifest, entry 0, and number the blocks
+static int finishPsarcList(PsarcCompressList *list) {
+  int i;
+  uint64_t size = 0;
+  for (i = 1; i < list->count; i++)
+    size += strlen(list->entries[i].name) + 1;
+
+  list->manifest = malloc(size + 1);
+  if (!list->manifest)
+    return VITASHELL_ERROR_NO_MEMORY;
+
+  char *p = list->manifest;
+  for (i = 1; i < list->count; i++)
+    p += sprintf(p, "%s%s", i > 1 ? "\n" : "", list->entries[i].name);
+
+  list->entries[0].size = p - list->manifest;
+
+  uint64_t n_blocks = 0;
+  for (i = 0; i < list->count; i++) {
+    list->entries[i].block_index = n_blocks;
+    n_blocks += getPsarcEntryBlocks(&list->entries[i]);
+  }
+
+  if (PSARC_HEADER_SIZE + (uint64_t)list->count * PSARC_TOC_ENTRY_SIZE + n_blocks * 2 > 0x7FFFFFFF)
+    return VITASHELL_ERROR_INVALID_ARGUMENT;
+
+  list->n_blocks = n_blocks;
+  return 0;
+}
+
+// Blocks that do not get smaller are stored
+static int compressPsarcBlock(PsarcCompressList *list, PsarcCompressEntry *entry, SceUID fd, uint32_t block,
+                              int level, uint8_t *data, uint8_t *out) {
+  uint64_t offset = (uint64_t)block * PSARC_COMPRESS_BLOCK_SIZE;
+  int length = entry->size - offset < PSARC_COMPRESS_BLOCK_SIZE ? (int)(entry->size - offset) : PSARC_COMPRESS_BLOCK_SIZE;
+
+  if (entry->path) {
+    if (sceIoLseek(fd, offset, SCE_SEEK_SET) < 0)
+      return VITASHELL_ERROR_INTERNAL;
+
+    int read = sceIoRead(fd, data, length);
+    if (read != length)
+      return read < 0 ? read : VITASHELL_ERROR_INTERNAL;
+  } else {
+    memcpy(data, list->manifest + offset, length);
+  }
+
+  if (level > 0) {
+    uLongf size = compressBound(PSARC_COMPRESS_BLOCK_SIZE);
+    if (compress2(out, &size, data, length, level) == Z_OK && size < length)
+      return size;
+  }
+
+  memcpy(out, data, length);
+  return length;
+}
+
+static int psarcCompressWorkerThread(SceSize args, void *argp) {
+  PsarcCompressWorker *worker = *(PsarcCompressWorker **)argp;
+  PsarcCompressList *list = worker->list;
+
+  uint8_t *data = memalign(4096, PSARC_COMPRESS_BLOCK_SIZE);
+  int res = data ? 0 : VITASHELL_ERROR_NO_MEMORY;
+
+  SceUID fd = -1;
+  int fd_entry = -1;
+
+  uint32_t number = 0;
+
+  int i;
+  for (i = 0; i < list->count; i++) {
+    PsarcCompressEntry *entry = &list->entries[i];
+    uint32_t n_blocks = getPsarcEntryBlocks(entry);
+
+    uint32_t block;
+    for (block = 0; block < n_blocks; block++, number++) {
+      if (number % worker->step != worker->first)
+        continue;
+
+      if (res >= 0 && entry->path && fd_entry != i) {
+        if (fd >= 0)
+          sceIoClose(fd);
+
+        fd = sceIoOpen(entry->path, SCE_O_RDONLY, 0);
+        fd_entry = i;
+        if (fd < 0)
+          res = fd;
+      }
+
+      int n = workerRingNextFree(&worker->ring);
+      if (n < 0)
+        goto exit;
+
+      PsarcCompressSlot *slot = &worker->slots[n];
+
+      slot->block = number;
+      slot->size = res < 0 ? res : compressPsarcBlock(list, entry, fd, block, worker->level, data, slot->buffer);
+
+      workerRingPut(&worker->ring);
+
+      if (slot->size < 0)
+        goto exit;
+    }
+  }
+
+exit:
+  if (fd >= 0)
+    sceIoClose(fd);
+  if (data)
+    free(data);
+
+  return sceKernelExitThread(0);
+}
+
+static int writePsarcBlocks(SceUID fd, PsarcCompressList *list, PsarcCompressWorker *workers, int n_workers,
+                            uint8_t *table, FileProcessParam *param) {
+  uint64_t offset = sceIoLseek(fd, 0, SCE_SEEK_CUR);
+  uint32_t number = 0;
+
+  int i;
+  for (i = 0; i < list->count; i++) {
+    PsarcCompressEntry *entry = &list->entries[i];
+    uint32_t n_blocks = getPsarcEntryBlocks(entry);
+    entry->offset = offset;
+
+    uint32_t block;
+    for (block = 0; block < n_blocks; block++, number++) {
+      PsarcCompressWorker *worker = &workers[number % n_workers];
+
+      PsarcCompressSlot *slot = &worker->slots[workerRingNextFull(&worker->ring)];
+
+      int size = slot->block == number ? slot->size : VITASHELL_ERROR_INTERNAL;
+      int written = size > 0 ? sceIoWrite(fd, slot->buffer, size) : 0;
+
+      workerRingRelease(&worker->ring);
+
+      if (size < 0)
+        return size;
+
+      if (written != size)
+        return written < 0 ? written : VITASHELL_ERROR_NO_SPACE;
+
+      // A full block that is stored has size 0 in the table
+      writeBe(table + number * 2, size == PSARC_COMPRESS_BLOCK_SIZE ? 0 : size, 2);
+      offset += size;
+
+      if (param && entry->path) {
+        uint64_t length = entry->size - (uint64_t)block * PSARC_COMPRESS_BLOCK_SIZE;
+
+        if (param->value)
+          (*param->value) += length < PSARC_COMPRESS_BLOCK_SIZE ? length : PSARC_COMPRESS_BLOCK_SIZE;
+
+        if (param->SetProgress)
+          param->SetProgress(param->value ? *param->value : 0, param->max);
+
+        if (param->cancelHandler && param->cancelHandler())
+          return 0;
+      }
+    }
+
+    if (param && param->items && entry->path)
+      (*param->items)++;
+  }
+
+  return 1;
+}
+
+static int writePsarcBlocksThreaded(SceUID fd, PsarcCompressList *list, int level, int n_workers,
+                                    uint8_t *table, FileProcessParam *param) {
+  if (n_workers > PSARC_COMPRESS_MAX_WORKERS)
+    n_workers = PSARC_COMPRESS_MAX_WORKERS;
+  if (n_workers < 1)
+    n_workers = 1;
+
+  int slot_size = compressBound(PSARC_COMPRESS_BLOCK_SIZE);
+  uint8_t *buffers = memalign(4096, n_workers * PSARC_COMPRESS_SLOTS * slot_size);
+  if (!buffers)
+    return VITASHELL_ERROR_NO_MEMORY;
+
+  PsarcCompressWorker workers[PSARC_COMPRESS_MAX_WORKERS];
+  int i, j;
+
+  for (i = 0; i < n_workers; i++) {
+    PsarcCompressWorker *worker = &workers[i];
+    memset(worker, 0, sizeof(PsarcCompressWorker));
+
+    worker->list = list;
+    worker->level = level;
+    worker->first = i;
+    worker->step = n_workers;
+
+    for (j = 0; j < PSARC_COMPRESS_SLOTS; j++)
+      worker->slots[j].buffer = buffers + (i * PSARC_COMPRESS_SLOTS + j) * slot_size;
+  }
+
+  WorkerPool pool;
+  int res = workerPoolStart(&pool, "psarc_compress", (SceKernelThreadEntry)psarcCompressWorkerThread,
+                            workers, sizeof(PsarcCompressWorker), n_workers, PSARC_COMPRESS_SLOTS);
+  if (res >= 0)
+    res = writePsarcBlocks(fd, list, workers, n_workers, table, param);
+
+  workerPoolStop(&pool);
+
+  free(buffers);
+
+  return res;
+}
+
+static void writePsarcToc(uint8_t *toc, uint32_t toc_length, PsarcCompressList *list) {
+  writeBe(toc, PSARC_MAGIC, 4);
+  writeBe(toc + 4, 1, 2);
+  writeBe(toc + 6, 4, 2);
+  writeBe(toc + 8, PSARC_COMPRESSION_ZLIB, 4);
+  writeBe(toc + 12, toc_length, 4);
+  writeBe(toc + 16, PSARC_TOC_ENTRY_SIZE, 4);
+  writeBe(toc + 20, list->count, 4);
+  writeBe(toc + 24, PSARC_COMPRESS_BLOCK_SIZE, 4);
+  writeBe(toc + 28, 0, 4);
+
+  int i;
+  for (i = 0; i < list->count; i++) {
+    PsarcCompressEntry *entry = &list->entries[i];
+    uint8_t *p = toc + PSARC_HEADER_SIZE + i * PSARC_TOC_ENTRY_SIZE;
+
+    // The manifest has an empty digest
+    memset(p, 0, MD5_BLOCK_SIZE);
+    if (entry->path) {
+      MD5_CTX ctx;
+      md5_init(&ctx);
+      md5_update(&ctx, (const uint8_t *)entry->name, strlen(entry->name));
+      md5_final(&ctx, p);
+    }
+
+    writeBe(p + 16, entry->block_index, 4);
+    writeBe(p + 20, entry->size, 5);
+    writeBe(p + 25, entry->offset, 5);
+  }
+}
+
+// Reads an entry back through the index reader psarc.c uses for open
+// archives and compares it with the source file
+static int verifyPsarcEntry(PsarcIndex *index, PsarcIndexEntry *entry, const char *path,
+                            uint8_t *buf, uint8_t *src_buf, FileProcessParam *param) {
+  SceUID fd = sceIoOpen(path, SCE_O_RDONLY, 0);
+  if (fd < 0)
+    return fd;
+
+  PsarcIndexFile file;
+  int res = psarcIndexFileOpen(index, &file, entry);
+  if (res < 0) {
+    sceIoClose(fd);
+    return res;
+  }
+
+  res = 1;
+
+  while (1) {
+    int read = psarcIndexFileRead(&file, buf, TRANSFER_SIZE);
+    if (read < 0) {
+      res = read;
+      break;
+    }
+
+    int src_read = sceIoRead(fd, src_buf, TRANSFER_SIZE);
+    if (src_read < 0) {
+      res = src_read;
+      break;
+    }
+
+    if (read != src_read || memcmp(buf, src_buf, read) != 0) {
+      res = VITASHELL_ERROR_CRC_MISMATCH;
+      break;
+    }
+
+    if (read == 0)
+      break;
+
+    if (param) {
+      if (param->value)
+        (*param->value) += read;
+
+      if (param->SetProgress)
+        param->SetProgress(param->value ? *param->value : 0, param->max);
+
+      if (param->cancelHandler && param->cancelHandler()) {
+        res = 0;
+        break;
+      }
+    }
+  }
+
+  psarcIndexFileClose(&file);
+  sceIoClose(fd);
+
+  return res;
+}
+
+// Opens the written archive like psarc.c does and compares the data of
+// every entry with its source file
+static int verifyPsarc(const char *psarc_file, PsarcCompressList *list, FileProcessParam *param) {
+  uint8_t *buf = memalign(4096, 2 * TRANSFER_SIZE);
+  if (!buf)
+    return VITASHELL_ERROR_NO_MEMORY;
+
+  PsarcIndex index;
+  int res = psarcIndexOpen(&index, psarc_file);
+  if (res < 0) {
+    free(buf);
+    return res;
+  }
+
+  res = 1;
+
+  if (index.count != list->count - 1)
+    res = VITASHELL_ERROR_INVALID_MAGIC;
+
+  int i;
+  for (i = 1; i < list->count && res > 0; i++) {
+    PsarcCompressEntry *src = &list->entries[i];
+    PsarcIndexEntry *entry = psarcIndexFind(&index, src->name);
+    if (!entry || entry->size != src->size)
+      res = VITASHELL_ERROR_INVALID_MAGIC;
+    else
+      res = verifyPsarcEntry(&index, entry, src->path, buf, buf + TRANSFER_SIZE, param);
+  }
+
+  psarcIndexClose(&index);
+  free(buf);
+
+  return res;
+}
+
+int makePsarc(const char *psarc_file, char **src_paths, int count, int filename_start, int level,
+              int n_workers, FileProcessParam *param) {
+  PsarcCompressList list;
+  memset(&list, 0, sizeof(PsarcCompressList));
+  list.filename_start = filename_start;
+
+  int res = addPsarcEntry(&list, NULL, 0);
+
+  int i;
+  for (i = 0; i < count && res > 0; i++)
+    res = addPsarcPath(&list, src_paths[i], param);
+
+  if (res > 0 && list.count == 1)
+    res = VITASHELL_ERROR_NOT_FOUND;
+
+  if (res > 0 && (res = finishPsarcList(&list)) >= 0)
+    res = 1;
+
+  if (res <= 0) {
+    freePsarcList(&list);
+    return res;
+  }
+
+  uint32_t toc_length = PSARC_HEADER_SIZE + list.count * PSARC_TOC_ENTRY_SIZE + list.n_blocks * 2;
+  uint8_t *toc = calloc(1, toc_length);
+  if (!toc) {
+    freePsarcList(&list);
+    return VITASHELL_ERROR_NO_MEMORY;
+  }
+
+  SceUID fd = sceIoOpen(psarc_file, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0777);
+  if (fd < 0) {
+    free(toc);
+    freePsarcList(&list);
+    return fd;
+  }
+
+  // Reserve the table, it is filled in at the end
+  res = sceIoWrite(fd, toc, toc_length);
+  if (res >= 0) {
+    uint8_t *table = toc + PSARC_HEADER_SIZE + list.count * PSARC_TOC_ENTRY_SIZE;
+    res = writePsarcBlocksThreaded(fd, &list, level, n_workers, table, param);
+  }
+
+  if (res > 0) {
+    writePsarcToc(toc, toc_length, &list);
+
+    sceIoLseek(fd, 0, SCE_SEEK_SET);
+    int written = sceIoWrite(fd, toc, toc_length);
+    if (written != toc_length)
+      res = written < 0 ? written : VITASHELL_ERROR_NO_SPACE;
+  }
+
+  sceIoClose(fd);
+
+  if (res > 0) {
+    int ret = verifyPsarc(psarc_file, &list, param);
+    if (ret <= 0)
+      res = ret;
+  }
+
+  if (res <= 0)
+    sceIoRemove(psarc_file);
+
+  free(toc);
+  freePsarcList(&list);
+
+  return res;
+}
+
+// Compress count entries of a file list in the folder src_path
+int makePsarcFromList(const char *psarc_file, const char *src_path, FileListEntry *head, int count,
+                      int level, FileProcessParam *param) {
+  char **paths = malloc(count * sizeof(char *));
+  if (!paths)
+    return VITASHELL_ERROR_NO_MEMORY;
+
+  int res = 1;
+  int n_paths = 0;
+
+  FileListEntry *entry = head;
+  while (entry && n_paths < count) {
+    paths[n_paths] = malloc(MAX_PATH_LENGTH);
+    if (!paths[n_paths]) {
+      res = VITASHELL_ERROR_NO_MEMORY;
+      break;
+    }
+
+    snprintf(paths[n_paths++], MAX_PATH_LENGTH, "%s%s", src_path, entry->name);
+    entry = entry->next;
+  }
+
+  if (res > 0)
+    res = makePsarc(psarc_file, paths, n_paths, strlen(src_path), level, PSARC_COMPRESS_WORKERS, param);
+
+  while (n_paths > 0)
+    free(paths[--n_paths]);
+  free(paths);
+
+  return res;
+}
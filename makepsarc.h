@@ -0,0 +1,38 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __MAKEPSARC_H__
+#define __MAKEPSARC_H__
+
+#include "file.h"
+
+#define PSARC_COMPRESS_WORKERS 3
+#define PSARC_COMPRESS_MAX_WORKERS 4
+#define PSARC_COMPRESS_SLOTS 4
+#define PSARC_COMPRESS_BLOCK_SIZE (64 * 1024)
+
+int isPsarcPath(const char *path);
+
+// The files are read twice, once to compress and once to verify the
+// archive. Progress counts both, plus one for every folder
+int makePsarc(const char *psarc_file, char **src_paths, int count, int filename_start, int level,
+              int n_workers, FileProcessParam *param);
+int makePsarcFromList(const char *psarc_file, const char *src_path, FileListEntry *head, int count,
+                      int level, FileProcessParam *param);
+
+#endif
@@ -16,15 +16,389 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include "main.h"
-#include "io_process.h"
+#include <psp2/kernel/threadmgr.h>
+
+#include "core.h"
 #include "makezip.h"
-#include "file.h"
-#include "utils.h"
+#include "workerpool.h"
 
 #include "minizip/zip.h"
+#include "minizip/ioapi.h"
+
+// Large files are split into blocks that the workers deflate on their own,
+// like pigz does. Each block is primed with the last 32 KiB of the block
+// before it, and all but the last one end with a sync flush, so the blocks
+// joined in order are one raw deflate stream. The calling thread writes
+// them to the entry in order and joins their CRCs.
+
+typedef struct {
+  uint32_t block;
+  int size; // Compressed size of the block, < 0 on error
+  int length;
+  uint32_t crc;
+  uint8_t *buffer;
+} ZipCompressSlot;
+
+typedef struct {
+  WorkerRing ring;
+  const char *path;
+  uint64_t size;
+  int level;
+  uint32_t first;
+  uint32_t step;
+  ZipCompressSlot slots[ZIP_COMPRESS_SLOTS];
+} ZipCompressWorker;
+
+// The zip is written through a buffer, so the many small writes of minizip
+// and its Z_BUFSIZE chunks reach the memory card as few large writes. The
+// position is kept here, so telling does not need a syscall.
+
+typedef struct {
+  SceUID fd;
+  int error;
+  uint64_t position; // Position of the buffer in the file
+  int length;
+  uint8_t *buffer;
+} ZipWriteFile;
+
+static int flushZipWriteFile(ZipWriteFile *file) {
+  if (file->length == 0)
+    return 0;
+
+  int written = sceIoWrite(file->fd, file->buffer, file->length);
+  if (written != file->length) {
+    file->error = written < 0 ? written : VITASHELL_ERROR_NO_SPACE;
+    return file->error;
+  }
+
+  file->position += file->length;
+  file->length = 0;
+
+  return 0;
+}
+
+static voidpf ZCALLBACK openZipWriteFile(voidpf opaque, const void *filename, int mode) {
+  int flags = 0;
+  if ((mode & ZLIB_FILEFUNC_MODE_READWRITEFILTER) == ZLIB_FILEFUNC_MODE_READ)
+    flags = SCE_O_RDONLY;
+  else if (mode & ZLIB_FILEFUNC_MODE_EXISTING)
+    flags = SCE_O_RDWR;
+  else if (mode & ZLIB_FILEFUNC_MODE_CREATE)
+    flags = SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC;
+
+  if (!filename || flags == 0)
+    return NULL;
+
+  ZipWriteFile *file = malloc(sizeof(ZipWriteFile));
+  if (!file)
+    return NULL;
+
+  memset(file, 0, sizeof(ZipWriteFile));
+
+  file->buffer = memalign(4096, ZIP_WRITE_BUFFER_SIZE);
+  file->fd = file->buffer ? sceIoOpen(filename, flags, 0777) : -1;
+  if (file->fd < 0) {
+    if (file->buffer)
+      free(file->buffer);
+    free(file);
+    return NULL;
+  }
+
+  return file;
+}
+
+static uLong ZCALLBACK readZipWriteFile(voidpf opaque, voidpf stream, void *buf, uLong size) {
+  ZipWriteFile *file = (ZipWriteFile *)stream;
+  if (flushZipWriteFile(file) < 0)
+    return 0;
+
+  int read = sceIoRead(file->fd, buf, size);
+  if (read < 0) {
+    file->error = read;
+    return 0;
+  }
+
+  file->position += read;
+  return read;
+}
+
+static uLong ZCALLBACK writeZipWriteFile(voidpf opaque, voidpf stream, const void *buf, uLong size) {
+  ZipWriteFile *file = (ZipWriteFile *)stream;
+
+  if (file->length + size > ZIP_WRITE_BUFFER_SIZE && flushZipWriteFile(file) < 0)
+    return 0;
+
+  // Large writes go straight through
+  if (size >= ZIP_WRITE_BUFFER_SIZE) {
+    int written = sceIoWrite(file->fd, buf, size);
+    if (written != size) {
+      file->error = written < 0 ? written : VITASHELL_ERROR_NO_SPACE;
+      return 0;
+    }
+
+    file->position += size;
+    return size;
+  }
+
+  memcpy(file->buffer + file->length, buf, size);
+  file->length += size;
+
+  return size;
+}
+
+static ZPOS64_T ZCALLBACK tellZipWriteFile(voidpf opaque, voidpf stream) {
+  ZipWriteFile *file = (ZipWriteFile *)stream;
+  return file->position + file->length;
+}
+
+static long ZCALLBACK seekZipWriteFile(voidpf opaque, voidpf stream, ZPOS64_T offset, int origin) {
+  ZipWriteFile *file = (ZipWriteFile *)stream;
+
+  int whence;
+  switch (origin) {
+    case ZLIB_FILEFUNC_SEEK_CUR:
+      // The buffered data is part of the current position
+      offset += file->position + file->length;
+      whence = SCE_SEEK_SET;
+      break;
+    case ZLIB_FILEFUNC_SEEK_END:
+      whence = SCE_SEEK_END;
+      break;
+    case ZLIB_FILEFUNC_SEEK_SET:
+      whence = SCE_SEEK_SET;
+      break;
+    default:
+      return -1;
+  }
+
+  if (flushZipWriteFile(file) < 0)
+    return -1;
+
+  SceOff position = sceIoLseek(file->fd, offset, whence);
+  if (position < 0)
+    return -1;
+
+  file->position = position;
+  return 0;
+}
+
+static int ZCALLBACK closeZipWriteFile(voidpf opaque, voidpf stream) {
+  ZipWriteFile *file = (ZipWriteFile *)stream;
+
+  int res = flushZipWriteFile(file);
+  sceIoClose(file->fd);
+
+  free(file->buffer);
+  free(file);
+
+  return res < 0 ? -1 : 0;
+}
+
+static int ZCALLBACK errorZipWriteFile(voidpf opaque, voidpf stream) {
+  ZipWriteFile *file = (ZipWriteFile *)stream;
+  return file->error;
+}
+
+zipFile zipOpenBuffered(const char *zip_file, int append) {
+  zlib_filefunc64_def filefunc;
+  memset(&filefunc, 0, sizeof(zlib_filefunc64_def));
+
+  filefunc.zopen64_file = openZipWriteFile;
+  filefunc.zread_file = readZipWriteFile;
+  filefunc.zwrite_file = writeZipWriteFile;
+  filefunc.ztell64_file = tellZipWriteFile;
+  filefunc.zseek64_file = seekZipWriteFile;
+  filefunc.zclose_file = closeZipWriteFile;
+  filefunc.zerror_file = errorZipWriteFile;
+
+  return zipOpen2_64(zip_file, append, NULL, &filefunc);
+}
 
-static void convertToZipTime(SceDateTime *time, tm_zip *tmzip) {
+// Files to add are read ahead by a thread while they are compressed.
+// Small ones are read directly, as the thread would not pay off
+
+typedef struct {
+  ReadAhead ra;
+  int read_ahead;
+  SceUID fd;
+  uint8_t *buffer;
+} ZipSourceFile;
+
+static int openZipSourceFile(ZipSourceFile *file, const char *path, uint64_t size) {
+  memset(file, 0, sizeof(ZipSourceFile));
+  file->fd = -1;
+
+  if (size >= ZIP_READ_AHEAD_MIN_SIZE) {
+    int res = readAheadOpen(&file->ra, path);
+    if (res >= 0) {
+      file->read_ahead = 1;
+      return res;
+    }
+  }
+
+  file->fd = sceIoOpen(path, SCE_O_RDONLY, 0);
+  if (file->fd < 0)
+    return file->fd;
+
+  file->buffer = memalign(4096, TRANSFER_SIZE);
+  if (!file->buffer) {
+    sceIoClose(file->fd);
+    return VITASHELL_ERROR_NO_MEMORY;
+  }
+
+  return 0;
+}
+
+static int readZipSourceFile(ZipSourceFile *file, const void **data) {
+  if (file->read_ahead)
+    return readAheadRead(&file->ra, data);
+
+  *data = file->buffer;
+  return sceIoRead(file->fd, file->buffer, TRANSFER_SIZE);
+}
+
+static void closeZipSourceFile(ZipSourceFile *file) {
+  if (file->read_ahead) {
+    readAheadClose(&file->ra);
+  } else {
+    free(file->buffer);
+    sceIoClose(file->fd);
+  }
+}
+
+// Formats that are compressed already and would not get smaller
+static char *stored_extensions[] = {
+  ".7Z", ".AT9", ".BZ2", ".CSO", ".GIF", ".GZ", ".JPEG", ".JPG", ".LZ4", ".LZMA",
+  ".M4A", ".MKV", ".MP3", ".MP4", ".OGG", ".PNG", ".PSARC", ".RAR", ".TBZ", ".TBZ2",
+  ".TGZ", ".TXZ", ".VPK", ".WEBM", ".XZ", ".ZIP", ".ZST",
+};
+
+static int isStoredExtension(const char *path) {
+  char *p = strrchr(path, '.');
+  if (p) {
+    int i;
+    for (i = 0; i < (sizeof(stored_extensions) / sizeof(char *)); i++) {
+      if (strcasecmp(p, stored_extensions[i]) == 0)
+        return 1;
+    }
+  }
+
+  return 0;
+}
+
+// Deflates a few samples spread over the file at level 1 and returns their
+// compressed size in percent. Small files are not worth the extra reads
+static int getZipSampleRatio(const char *path, uint64_t size) {
+  if (isStoredExtension(path))
+    return 100;
+
+  if (size < ZIP_SAMPLE_MIN_SIZE)
+    return ZIP_DEFAULT_RATIO;
+
+  SceUID fd = sceIoOpen(path, SCE_O_RDONLY, 0);
+  if (fd < 0)
+    return ZIP_DEFAULT_RATIO;
+
+  int out_size = compressBound(ZIP_SAMPLE_SIZE);
+  uint8_t *data = malloc(ZIP_SAMPLE_SIZE + out_size);
+
+  z_stream stream;
+  memset(&stream, 0, sizeof(z_stream));
+
+  if (!data || deflateInit2(&stream, 1, Z_DEFLATED, -MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK) {
+    if (data)
+      free(data);
+    sceIoClose(fd);
+    return ZIP_DEFAULT_RATIO;
+  }
+
+  uint64_t sampled = 0, compressed = 0;
+
+  int i;
+  for (i = 0; i < ZIP_SAMPLE_COUNT; i++) {
+    uint64_t offset = (size - ZIP_SAMPLE_SIZE) / (ZIP_SAMPLE_COUNT - 1) * i;
+
+    if (sceIoLseek(fd, offset, SCE_SEEK_SET) < 0)
+      break;
+
+    int read = sceIoRead(fd, data, ZIP_SAMPLE_SIZE);
+    if (read <= 0)
+      break;
+
+    deflateReset(&stream);
+    stream.next_in = data;
+    stream.avail_in = read;
+    stream.next_out = data + ZIP_SAMPLE_SIZE;
+    stream.avail_out = out_size;
+
+    if (deflate(&stream, Z_FINISH) != Z_STREAM_END)
+      break;
+
+    sampled += read;
+    compressed += out_size - stream.avail_out;
+  }
+
+  deflateEnd(&stream);
+  free(data);
+  sceIoClose(fd);
+
+  if (sampled == 0)
+    return ZIP_DEFAULT_RATIO;
+
+  return (int)(compressed * 100 / sampled);
+}
+
+static int addZipSample(ZipSampleList *list, const char *name, int store) {
+  if (list->count == list->max) {
+    int max = list->max ? list->max * 2 : 64;
+    ZipSample *samples = realloc(list->samples, max * sizeof(ZipSample));
+    if (!samples)
+      return VITASHELL_ERROR_NO_MEMORY;
+
+    list->samples = samples;
+    list->max = max;
+  }
+
+  char *sample_name = malloc(strlen(name) + 1);
+  if (!sample_name)
+    return VITASHELL_ERROR_NO_MEMORY;
+
+  strcpy(sample_name, name);
+
+  list->samples[list->count].name = sample_name;
+  list->samples[list->count].store = store;
+  list->count++;
+
+  return 0;
+}
+
+void zipSampleListFree(ZipSampleList *list) {
+  int i;
+  for (i = 0; i < list->count; i++)
+    free(list->samples[i].name);
+
+  free(list->samples);
+  memset(list, 0, sizeof(ZipSampleList));
+}
+
+// Whether deflate would not pay off. The estimate walks the folders in the
+// same order, so a sampled file is the next one of the list. Files that are
+// not, because the folder changed in between, are sampled here
+static int isZipStoredFile(const char *path, const char *name, uint64_t size, ZipSampleList *samples) {
+  if (isStoredExtension(path))
+    return 1;
+
+  if (size < ZIP_SAMPLE_MIN_SIZE)
+    return 0;
+
+  if (samples && samples->next < samples->count &&
+      strcmp(samples->samples[samples->next].name, name) == 0)
+    return samples->samples[samples->next++].store;
+
+  return getZipSampleRatio(path, size) >= ZIP_STORE_RATIO;
+}
+
+void convertToZipTime(SceDateTime *time, tm_zip *tmzip) {
   SceDateTime time_local;
   convertUtcToLocalTime(&time_local, time);
 
@@ -36,7 +410,199 @@ static void convertToZipTime(SceDateTime *time, tm_zip *tmzip) {
   tmzip->tm_year = time_local.year;
 }
 
-static int zipAddFile(zipFile zf, const char *path, int filename_start, int level, FileProcessParam *param) {
+static uint32_t getZipBlocks(uint64_t size) {
+  return (size + ZIP_COMPRESS_BLOCK_SIZE - 1) / ZIP_COMPRESS_BLOCK_SIZE;
+}
+
+static int getZipSlotSize() {
+  return compressBound(ZIP_COMPRESS_BLOCK_SIZE) + 16;
+}
+
+static int compressZipBlock(z_stream *stream, ZipCompressWorker *worker, SceUID fd, uint32_t block,
+                            uint8_t *data, ZipCompressSlot *slot) {
+  uint64_t offset = (uint64_t)block * ZIP_COMPRESS_BLOCK_SIZE;
+  int length = worker->size - offset < ZIP_COMPRESS_BLOCK_SIZE ? (int)(worker->size - offset) : ZIP_COMPRESS_BLOCK_SIZE;
+  int dict = block > 0 ? ZIP_COMPRESS_DICT_SIZE : 0;
+  int last = block == getZipBlocks(worker->size) - 1;
+
+  if (sceIoLseek(fd, offset - dict, SCE_SEEK_SET) < 0)
+    return VITASHELL_ERROR_INTERNAL;
+
+  // The file may have changed since its size was taken
+  int read = sceIoRead(fd, data, dict + length);
+  if (read != dict + length)
+    return read < 0 ? read : VITASHELL_ERROR_INTERNAL;
+
+  deflateReset(stream);
+  if (dict > 0)
+    deflateSetDictionary(stream, data, dict);
+
+  stream->next_in = data + dict;
+  stream->avail_in = length;
+  stream->next_out = slot->buffer;
+  stream->avail_out = getZipSlotSize();
+
+  int res = deflate(stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+  if (res != (last ? Z_STREAM_END : Z_OK) || stream->avail_in != 0 || stream->avail_out == 0)
+    return VITASHELL_ERROR_INTERNAL;
+
+  slot->length = length;
+  slot->crc = crc32(0, data + dict, length);
+
+  return getZipSlotSize() - stream->avail_out;
+}
+
+static int zipCompressWorkerThread(SceSize args, void *argp) {
+  ZipCompressWorker *worker = *(ZipCompressWorker **)argp;
+
+  z_stream stream;
+  memset(&stream, 0, sizeof(z_stream));
+
+  uint8_t *data = memalign(4096, ZIP_COMPRESS_DICT_SIZE + ZIP_COMPRESS_BLOCK_SIZE);
+  int res = data ? 0 : VITASHELL_ERROR_NO_MEMORY;
+
+  if (res >= 0 && deflateInit2(&stream, worker->level, Z_DEFLATED, -MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK)
+    res = VITASHELL_ERROR_NO_MEMORY;
+  int initialised = res >= 0;
+
+  SceUID fd = res >= 0 ? sceIoOpen(worker->path, SCE_O_RDONLY, 0) : -1;
+  if (res >= 0 && fd < 0)
+    res = fd;
+
+  uint32_t n_blocks = getZipBlocks(worker->size);
+
+  uint32_t block;
+  for (block = worker->first; block < n_blocks; block += worker->step) {
+    int n = workerRingNextFree(&worker->ring);
+    if (n < 0)
+      break;
+
+    ZipCompressSlot *slot = &worker->slots[n];
+
+    slot->block = block;
+    slot->size = res < 0 ? res : compressZipBlock(&stream, worker, fd, block, data, slot);
+
+    workerRingPut(&worker->ring);
+
+    if (slot->size < 0)
+      break;
+  }
+
+  if (fd >= 0)
+    sceIoClose(fd);
+  if (initialised)
+    deflateEnd(&stream);
+  if (data)
+    free(data);
+
+  return sceKernelExitThread(0);
+}
+
+// Closes the raw entry with the data that was actually written. An
+// unfinished stream ends after a sync flush, so an empty final block
+// completes it and the entry stays consistent
+static void closeZipBlocks(zipFile zf, uint64_t size, uint64_t written, uint32_t crc) {
+  static const uint8_t final_block[] = { 0x03, 0x00 };
+
+  if (written < size)
+    zipWriteInFileInZip(zf, final_block, sizeof(final_block));
+
+  zipCloseFileInZipRaw64(zf, written, crc);
+}
+
+static int writeZipBlocks(zipFile zf, ZipCompressWorker *workers, int n_workers, uint64_t size,
+                          uint64_t *written, uint32_t *crc, FileProcessParam *param) {
+  uint32_t n_blocks = getZipBlocks(size);
+
+  uint32_t block;
+  for (block = 0; block < n_blocks; block++) {
+    ZipCompressWorker *worker = &workers[block % n_workers];
+
+    ZipCompressSlot *slot = &worker->slots[workerRingNextFull(&worker->ring)];
+
+    int res = slot->block == block ? slot->size : VITASHELL_ERROR_INTERNAL;
+    if (res > 0)
+      res = zipWriteInFileInZip(zf, slot->buffer, res);
+    int length = slot->length;
+
+    if (res >= 0) {
+      *crc = crc32_combine(*crc, slot->crc, length);
+      *written += length;
+    }
+
+    workerRingRelease(&worker->ring);
+
+    if (res < 0)
+      return res;
+
+    if (param) {
+      if (param->value)
+        (*param->value) += length;
+
+      if (param->SetProgress)
+        param->SetProgress(param->value ? *param->value : 0, param->max);
+
+      if (param->cancelHandler && param->cancelHandler())
+        return 0;
+    }
+  }
+
+  return 1;
+}
+
+// Deflates the file in blocks on several threads into the open raw entry
+static int zipAddFileThreaded(zipFile zf, const char *path, uint64_t size, int level, int n_workers,
+                              FileProcessParam *param) {
+  if (n_workers > ZIP_COMPRESS_MAX_WORKERS)
+    n_workers = ZIP_COMPRESS_MAX_WORKERS;
+
+  int slot_size = getZipSlotSize();
+  uint8_t *buffers = memalign(4096, n_workers * ZIP_COMPRESS_SLOTS * slot_size);
+  if (!buffers) {
+    closeZipBlocks(zf, size, 0, 0);
+    return VITASHELL_ERROR_NO_MEMORY;
+  }
+
+  ZipCompressWorker workers[ZIP_COMPRESS_MAX_WORKERS];
+  int i, j;
+
+  for (i = 0; i < n_workers; i++) {
+    ZipCompressWorker *worker = &workers[i];
+    memset(worker, 0, sizeof(ZipCompressWorker));
+
+    worker->path = path;
+    worker->size = size;
+    worker->level = level;
+    worker->first = i;
+    worker->step = n_workers;
+
+    for (j = 0; j < ZIP_COMPRESS_SLOTS; j++)
+      worker->slots[j].buffer = buffers + (i * ZIP_COMPRESS_SLOTS + j) * slot_size;
+  }
+
+  uint64_t written = 0;
+  uint32_t crc = 0;
+
+  WorkerPool pool;
+  int res = workerPoolStart(&pool, "zip_compress", (SceKernelThreadEntry)zipCompressWorkerThread,
+                            workers, sizeof(ZipCompressWorker), n_workers, ZIP_COMPRESS_SLOTS);
+  if (res >= 0)
+    res = writeZipBlocks(zf, workers, n_workers, size, &written, &crc, param);
+
+  workerPoolStop(&pool);
+
+  free(buffers);
+
+  closeZipBlocks(zf, size, written, crc);
+
+  if (res > 0 && param && param->items)
+    (*param->items)++;
+
+  return res;
+}
+
+static int zipAddFile(zipFile zf, const char *path, int filename_start, int level, int n_workers,
+                      ZipSampleList *samples, FileProcessParam *param) {
   int res;
 
   // Get file stat
@@ -54,6 +620,13 @@ static int zipAddFile(zipFile zf, const char *path, int filename_start, int leve
   // Large file?
   int use_zip64 = (stat.st_size >= 0xFFFFFFFF);
 
+  // Store the file if deflate would not pay off
+  if (level > 0 && isZipStoredFile(path, path + filename_start, stat.st_size, samples))
+    level = 0;
+
+  // Only files of several blocks are worth the threads
+  int threaded = level > 0 && n_workers > 1 && stat.st_size >= ZIP_COMPRESS_MIN_SIZE;
+
   // Open new file in zip
   char filename[MAX_PATH_LENGTH];
   strcpy(filename, path+filename_start);
@@ -61,32 +634,31 @@ static int zipAddFile(zipFile zf, const char *path, int filename_start, int leve
   res = zipOpenNewFileInZip3_64(zf, filename, &zi,
                                 NULL, 0, NULL, 0, NULL,
                                 (level != 0) ? Z_DEFLATED : 0,
-                                level, 0,
+                                level, threaded,
                                 -MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY,
                                 NULL, 0, use_zip64);
 
   if (res < 0)
     return res;
 
+  if (threaded)
+    return zipAddFileThreaded(zf, path, stat.st_size, level, n_workers, param);
+
   // Open file to add
-  SceUID fd = sceIoOpen(path, SCE_O_RDONLY, 0);
-  if (fd < 0) {
+  ZipSourceFile file;
+  res = openZipSourceFile(&file, path, stat.st_size);
+  if (res < 0) {
     zipCloseFileInZip(zf);
-    return fd;
+    return res;
   }
 
   // Add file to zip
-  void *buf = memalign(4096, TRANSFER_SIZE);
-
-  uint64_t seek = 0;
-
   while (1) {
-    int read = sceIoRead(fd, buf, TRANSFER_SIZE);
+    const void *data;
+    int read = readZipSourceFile(&file, &data);
 
     if (read < 0) {
-      free(buf);
-
-      sceIoClose(fd);
+      closeZipSourceFile(&file);
       zipCloseFileInZip(zf);
 
       return read;
@@ -95,18 +667,14 @@ static int zipAddFile(zipFile zf, const char *path, int filename_start, int leve
     if (read == 0)
       break;
 
-    int written = zipWriteInFileInZip(zf, buf, read);
+    int written = zipWriteInFileInZip(zf, data, read);
     if (written < 0) {
-      free(buf);
-
-      sceIoClose(fd);
+      closeZipSourceFile(&file);
       zipCloseFileInZip(zf);
 
       return written;
     }
 
-    seek += written;
-
     if (param) {
       if (param->value)
         (*param->value) += read;
@@ -115,9 +683,7 @@ static int zipAddFile(zipFile zf, const char *path, int filename_start, int leve
         param->SetProgress(param->value ? *param->value : 0, param->max);
 
       if (param->cancelHandler && param->cancelHandler()) {
-        free(buf);
-
-        sceIoClose(fd);
+        closeZipSourceFile(&file);
         zipCloseFileInZip(zf);
 
         return 0;
@@ -125,11 +691,12 @@ static int zipAddFile(zipFile zf, const char *path, int filename_start, int leve
     }
   }
 
-  free(buf);
-
-  sceIoClose(fd);
+  closeZipSourceFile(&file);
   zipCloseFileInZip(zf);
 
+  if (param && param->items)
+    (*param->items)++;
+
   return 1;
 }
 
@@ -181,7 +748,8 @@ static int zipAddFolder(zipFile zf, const char *path, int filename_start, int le
   return 1;
 }
 
-static int zipAddPath(zipFile zf, const char *path, int filename_start, int level, FileProcessParam *param) {
+static int zipAddPath(zipFile zf, const char *path, int filename_start, int level, int n_workers,
+                      ZipSampleList *samples, FileProcessParam *param) {
   SceUID dfd = sceIoDopen(path);
   if (dfd >= 0) {
     int ret = zipAddFolder(zf, path, filename_start, level, param);
@@ -202,9 +770,9 @@ static int zipAddPath(zipFile zf, const char *path, int filename_start, int leve
         int ret = 0;
 
         if (SCE_S_ISDIR(dir.d_stat.st_mode)) {
-          ret = zipAddPath(zf, new_path, filename_start, level, param);
+          ret = zipAddPath(zf, new_path, filename_start, level, n_workers, samples, param);
         } else {
-          ret = zipAddFile(zf, new_path, filename_start, level, param);
+          ret = zipAddFile(zf, new_path, filename_start, level, n_workers, samples, param);
         }
 
         free(new_path);
@@ -219,116 +787,154 @@ static int zipAddPath(zipFile zf, const char *path, int filename_start, int leve
 
     sceIoDclose(dfd);
   } else {
-    return zipAddFile(zf, path, filename_start, level, param);
+    return zipAddFile(zf, path, filename_start, level, n_workers, samples, param);
   }
 
   return 1;
 }
 
-int makeZip(const char *zip_file, const char *src_path, int filename_start, int level, int append, FileProcessParam *param) {
-  zipFile zf = zipOpen64(zip_file, append);
+// On a single core the block workers only add copies and thread switches,
+// so there is at most one worker per core the caller may use
+static int getZipCompressWorkers(int n_workers) {
+  int cores = workerPoolCores();
+  return n_workers < cores ? n_workers : cores;
+}
+
+int makeZip(const char *zip_file, const char *src_path, int filename_start, int level, int append,
+            int n_workers, FileProcessParam *param) {
+  zipFile zf = zipOpenBuffered(zip_file, append);
   if (zf == NULL)
     return VITASHELL_ERROR_NO_MEMORY;
 
-  int res = zipAddPath(zf, src_path, filename_start, level, param);
+  int res = zipAddPath(zf, src_path, filename_start, level, getZipCompressWorkers(n_workers), NULL, param);
 
   zipClose(zf, NULL);
 
   return res;
 }
 
-int compress_thread(SceSize args_size, CompressArguments *args) {
-  SceUID thid = -1;
-
-  // Lock power timers
-  powerLock();
+// All entries go into one session, so the central directory is written once.
+// samples comes from estimateZipSizeFromList, or NULL to sample the files here
+int makeZipFromList(const char *zip_file, const char *src_path, FileListEntry *head, int count,
+                    int level, ZipSampleList *samples, FileProcessParam *param) {
+  zipFile zf = zipOpenBuffered(zip_file, APPEND_STATUS_CREATE);
+  if (zf == NULL)
+    return VITASHELL_ERROR_NO_MEMORY;
 
-  // Set progress to 0%
-  sceMsgDialogProgressBarSetValue(SCE_MSG_DIALOG_PROGRESSBAR_TARGET_BAR_DEFAULT, 0);
-  sceKernelDelayThread(DIALOG_WAIT); // Needed to see the percentage
+  char *path = malloc(MAX_PATH_LENGTH);
+  if (!path) {
+    zipClose(zf, NULL);
+    return VITASHELL_ERROR_NO_MEMORY;
+  }
 
-  FileListEntry *file_entry = fileListGetNthEntry(args->file_list, args->index);
+  if (samples)
+    samples->next = 0;
 
-  int count = 0;
-  FileListEntry *head = NULL;
-  FileListEntry *mark_entry_one = NULL;
+  int n_workers = getZipCompressWorkers(ZIP_COMPRESS_WORKERS);
+  int res = 1;
 
-  if (fileListFindEntry(args->mark_list, file_entry->name)) { // On marked entry
-    count = args->mark_list->length;
-    head = args->mark_list->head;
-  } else {
-    count = 1;
-    mark_entry_one = fileListCopyEntry(file_entry);
-    head = mark_entry_one;
+  FileListEntry *entry = head;
+  int i;
+  for (i = 0; i < count && entry && res > 0; i++) {
+    snprintf(path, MAX_PATH_LENGTH, "%s%s", src_path, entry->name);
+    res = zipAddPath(zf, path, strlen(src_path), level, n_workers, samples, param);
+    entry = entry->next;
   }
 
-  char path[MAX_PATH_LENGTH];
-  FileListEntry *mark_entry = NULL;
-
-  // Get paths info
-  uint64_t size = 0;
-  uint32_t folders = 0, files = 0;
+  free(path);
+  zipClose(zf, NULL);
 
-  mark_entry = head;
+  return res;
+}
 
-  int i;
-  for (i = 0; i < count; i++) {
-    snprintf(path, MAX_PATH_LENGTH, "%s%s", args->file_list->path, mark_entry->name);
-    getPathInfo(path, &size, &folders, &files, NULL);
-    mark_entry = mark_entry->next;
-  }
+// Counts one per file into param
+static int estimateZipPath(const char *path, int filename_start, int level, ZipSampleList *samples,
+                           uint64_t *size, FileProcessParam *param) {
+  *size += ZIP_ENTRY_OVERHEAD + 2 * strlen(path);
 
-  // Check memory card free space
-  double guessed_size = (double)size * 0.7;
-  if (checkMemoryCardFreeSpace(args->path, (uint64_t)guessed_size))
-    goto EXIT;
+  SceUID dfd = sceIoDopen(path);
+  if (dfd >= 0) {
+    int res = 0;
 
-  // Update thread
-  thid = createStartUpdateThread(size+folders, 1);
+    do {
+      SceIoDirent dir;
+      memset(&dir, 0, sizeof(SceIoDirent));
 
-  // Remove process
-  uint64_t value = 0;
+      res = sceIoDread(dfd, &dir);
+      if (res > 0) {
+        char *new_path = malloc(strlen(path) + strlen(dir.d_name) + 2);
+        snprintf(new_path, MAX_PATH_LENGTH, "%s%s%s", path, hasEndSlash(path) ? "" : "/", dir.d_name);
 
-  mark_entry = head;
+        int ret = estimateZipPath(new_path, filename_start, level, samples, size, param);
 
-  for (i = 0; i < count; i++) {
-    snprintf(path, MAX_PATH_LENGTH, "%s%s", args->file_list->path, mark_entry->name);
+        free(new_path);
 
-    FileProcessParam param;
-    param.value = &value;
-    param.max = size;
-    param.SetProgress = SetProgress;
-    param.cancelHandler = cancelHandler;
+        if (ret <= 0) {
+          sceIoDclose(dfd);
+          return ret;
+        }
+      }
+    } while (res > 0);
 
-    int res = makeZip(args->path, path, strlen(args->file_list->path), args->level, i == 0 ? APPEND_STATUS_CREATE : APPEND_STATUS_ADDINZIP, &param);
-    if (res <= 0) {
-      closeWaitDialog();
-      setDialogStep(DIALOG_STEP_CANCELED);
-      errorDialog(res);
-      goto EXIT;
+    sceIoDclose(dfd);
+  } else {
+    SceIoStat stat;
+    memset(&stat, 0, sizeof(SceIoStat));
+    if (sceIoGetstat(path, &stat) < 0)
+      return 1;
+
+    // Level 1 is sampled, so higher levels come out a little smaller
+    int ratio = level > 0 ? getZipSampleRatio(path, stat.st_size) : 100;
+    if (ratio > 100)
+      ratio = 100;
+
+    *size += stat.st_size * ratio / 100;
+
+    // Remember the decision for files that had to be read for it
+    if (samples && level > 0 && stat.st_size >= ZIP_SAMPLE_MIN_SIZE && !isStoredExtension(path)) {
+      int res = addZipSample(samples, path + filename_start, ratio >= ZIP_STORE_RATIO);
+      if (res < 0)
+        return res;
     }
 
-    mark_entry = mark_entry->next;
+    if (param) {
+      if (param->value)
+        (*param->value)++;
+
+      if (param->SetProgress)
+        param->SetProgress(param->value ? *param->value : 0, param->max);
+
+      if (param->cancelHandler && param->cancelHandler())
+        return 0;
+    }
   }
 
-  // Set progress to 100%
-  sceMsgDialogProgressBarSetValue(SCE_MSG_DIALOG_PROGRESSBAR_TARGET_BAR_DEFAULT, 100);
-  sceKernelDelayThread(COUNTUP_WAIT);
+  return 1;
+}
 
-  // Close
-  sceMsgDialogClose();
+// Expected size of the zip, from the same samples that decide whether
+// files are stored. The decisions are added to samples, which is passed on
+// to makeZipFromList so that the files are not sampled again. Progress is
+// counted in files. Returns 0 if canceled
+int estimateZipSizeFromList(const char *src_path, FileListEntry *head, int count, int level,
+                            ZipSampleList *samples, uint64_t *size, FileProcessParam *param) {
+  char *path = malloc(MAX_PATH_LENGTH);
+  if (!path)
+    return VITASHELL_ERROR_NO_MEMORY;
 
-  setDialogStep(DIALOG_STEP_COMPRESSED);
+  *size = 0;
 
-EXIT:
-  if (mark_entry_one)
-    free(mark_entry_one);
+  int res = 1;
 
-  if (thid >= 0)
-    sceKernelWaitThreadEnd(thid, NULL, NULL);
+  FileListEntry *entry = head;
+  int i;
+  for (i = 0; i < count && entry && res > 0; i++) {
+    snprintf(path, MAX_PATH_LENGTH, "%s%s", src_path, entry->name);
+    res = estimateZipPath(path, strlen(src_path), level, samples, size, param);
+    entry = entry->next;
+  }
 
-  // Unlock power timers
-  powerUnlock();
+  free(path);
 
-  return sceKernelExitDeleteThread(0);
+  return res;
 }
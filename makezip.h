@@ -19,14 +19,50 @@
 #ifndef __MAKEZIP_H__
 #define __MAKEZIP_H__
 
+#include "file.h"
+#include "readahead.h"
+#include "minizip/zip.h"
+
+#define ZIP_WRITE_BUFFER_SIZE (1 * 1024 * 1024)
+#define ZIP_READ_AHEAD_MIN_SIZE (2 * READ_AHEAD_BUFFER_SIZE)
+
+#define ZIP_COMPRESS_WORKERS 3
+#define ZIP_COMPRESS_MAX_WORKERS 4
+#define ZIP_COMPRESS_SLOTS 4
+#define ZIP_COMPRESS_BLOCK_SIZE (128 * 1024)
+#define ZIP_COMPRESS_DICT_SIZE (32 * 1024)
+#define ZIP_COMPRESS_MIN_SIZE (4 * ZIP_COMPRESS_BLOCK_SIZE)
+
+// Files whose samples do not get below ZIP_STORE_RATIO percent are stored.
+// Smaller files are assumed to get to ZIP_DEFAULT_RATIO percent
+#define ZIP_SAMPLE_SIZE (16 * 1024)
+#define ZIP_SAMPLE_COUNT 4
+#define ZIP_SAMPLE_MIN_SIZE (ZIP_SAMPLE_COUNT * ZIP_SAMPLE_SIZE)
+#define ZIP_STORE_RATIO 95
+#define ZIP_DEFAULT_RATIO 70
+#define ZIP_ENTRY_OVERHEAD 128
+
+// Store decisions of sampled files, in the order the folders are walked
 typedef struct {
-  FileList *file_list;
-  FileList *mark_list;
-  int index;
-  int level;
-  char *path;
-} CompressArguments;
-
-int compress_thread(SceSize args_size, CompressArguments *args);
+  char *name; // Name of the zip entry
+  int store;
+} ZipSample;
+
+typedef struct {
+  ZipSample *samples;
+  int count;
+  int max;
+  int next; // Next sample expected by makeZipFromList
+} ZipSampleList;
+
+void convertToZipTime(SceDateTime *time, tm_zip *tmzip);
+zipFile zipOpenBuffered(const char *zip_file, int append);
+int makeZip(const char *zip_file, const char *src_path, int filename_start, int level, int append,
+            int n_workers, FileProcessParam *param);
+int makeZipFromList(const char *zip_file, const char *src_path, FileListEntry *head, int count,
+                    int level, ZipSampleList *samples, FileProcessParam *param);
+int estimateZipSizeFromList(const char *src_path, FileListEntry *head, int count, int level,
+                            ZipSampleList *samples, uint64_t *size, FileProcessParam *param);
+void zipSampleListFree(ZipSampleList *list);
 
 #endif
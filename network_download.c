@@ -289,10 +289,7 @@ int downloadFileProcess(const char *url, const char *dest, int successStep) {
   uint64_t value = 0;
   
   FileProcessParam param;
-  param.value = &value;
-  param.max = size;
-  param.SetProgress = SetProgress;
-  param.cancelHandler = cancelHandler;
+  initFileProcessParam(&param, &value, size);
 
   int res = downloadFile(url, dest, &param);
   if (res < 0) {
@@ -45,6 +45,7 @@ int network_update_thread(SceSize args, void *argp) {
   
     FileProcessParam param;
     param.value = &value;
+    param.items = NULL;
     param.max = size;
     param.SetProgress = NULL;
     param.cancelHandler = NULL;
@@ -154,10 +155,7 @@ int update_extract_thread(SceSize args, void *argp) {
   uint64_t value = 0;
 
   FileProcessParam param;
-  param.value = &value;
-  param.max = size + folders * DIRECTORY_SIZE;
-  param.SetProgress = SetProgress;
-  param.cancelHandler = cancelHandler;
+  initFileProcessParam(&param, &value, size + folders * DIRECTORY_SIZE);
 
   res = extractArchivePath(src_path, PACKAGE_DIR "/", &param);
   if (res <= 0) {
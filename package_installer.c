@@ -341,9 +341,43 @@ int installPackage(const char *file) {
   return 0;
 }
 
+static SceUID install_update_thid = -1;
+static uint64_t install_update_max = 0;
+
+// Team molecule's request: Full permission access warning.
+// Called by the extraction as soon as an unsafe module was written.
+static int installUnsafeHandler(int unsafe) {
+  closeWaitDialog();
+
+  // The update thread stops with the progress dialog
+  if (install_update_thid >= 0) {
+    sceKernelWaitThreadEnd(install_update_thid, NULL, NULL);
+    install_update_thid = -1;
+  }
+
+  initMessageDialog(SCE_MSG_DIALOG_BUTTON_TYPE_YESNO, language_container[unsafe == 2 ? INSTALL_BRICK_WARNING : INSTALL_WARNING]);
+  setDialogStep(DIALOG_STEP_INSTALL_WARNING);
+
+  // Wait for response
+  while (getDialogStep() == DIALOG_STEP_INSTALL_WARNING) {
+    sceKernelDelayThread(10 * 1000);
+  }
+
+  // Canceled
+  if (getDialogStep() == DIALOG_STEP_CANCELED)
+    return 0;
+
+  // Init again
+  initMessageDialog(MESSAGE_DIALOG_PROGRESS_BAR, language_container[INSTALLING]);
+  setDialogStep(DIALOG_STEP_INSTALLING);
+
+  install_update_thid = createStartUpdateThread(install_update_max, 1);
+
+  return 1;
+}
+
 int install_thread(SceSize args_size, InstallArguments *args) {
   int res;
-  SceUID thid = -1;
   char path[MAX_PATH_LENGTH];
   SceIoStat stat;
   int isFolder = 0;
@@ -445,30 +479,6 @@ int install_thread(SceSize args_size, InstallArguments *args) {
       goto EXIT;
     }
 
-    // Team molecule's request: Full permission access warning
-    int unsafe = archiveCheckFilesForUnsafeFself(); // 0: Safe, 1: Unsafe, 2: Dangerous
-    if (!vitashell_config.disable_warning && unsafe) {
-      closeWaitDialog();
-
-      initMessageDialog(SCE_MSG_DIALOG_BUTTON_TYPE_YESNO, language_container[unsafe == 2 ? INSTALL_BRICK_WARNING : INSTALL_WARNING]);
-      setDialogStep(DIALOG_STEP_INSTALL_WARNING);
-
-      // Wait for response
-      while (getDialogStep() == DIALOG_STEP_INSTALL_WARNING) {
-        sceKernelDelayThread(10 * 1000);
-      }
-
-      // Canceled
-      if (getDialogStep() == DIALOG_STEP_CANCELED) {
-        closeWaitDialog();
-        goto EXIT;
-      }
-
-      // Init again
-      initMessageDialog(MESSAGE_DIALOG_PROGRESS_BAR, language_container[INSTALLING]);
-      setDialogStep(DIALOG_STEP_INSTALLING);
-    }
-
     // Src path
     char src_path[MAX_PATH_LENGTH];
     strcpy(src_path, args->file);
@@ -484,18 +494,19 @@ int install_thread(SceSize args_size, InstallArguments *args) {
       goto EXIT;
 
     // Update thread
-    thid = createStartUpdateThread(size + folders*DIRECTORY_SIZE, 1);
+    install_update_max = size + folders * DIRECTORY_SIZE;
+    install_update_thid = createStartUpdateThread(install_update_max, 1);
 
-    // Extract process
+    // Extract process, modules are checked for unsafe imports on the way
     uint64_t value = 0;
 
     FileProcessParam param;
-    param.value = &value;
-    param.max = size + folders * DIRECTORY_SIZE;
-    param.SetProgress = SetProgress;
-    param.cancelHandler = cancelHandler;
+    initFileProcessParam(&param, &value, size + folders * DIRECTORY_SIZE);
 
+    archiveSetUnsafeHandler(vitashell_config.disable_warning ? NULL : installUnsafeHandler);
     res = extractArchivePath(src_path, PACKAGE_DIR "/", &param);
+    archiveSetUnsafeHandler(NULL);
+
     if (res <= 0) {
       closeWaitDialog();
       setDialogStep(DIALOG_STEP_CANCELED);
@@ -542,8 +553,10 @@ int install_thread(SceSize args_size, InstallArguments *args) {
   setDialogStep(DIALOG_STEP_INSTALLED);
 
 EXIT:
-  if (thid >= 0)
-    sceKernelWaitThreadEnd(thid, NULL, NULL);
+  if (install_update_thid >= 0) {
+    sceKernelWaitThreadEnd(install_update_thid, NULL, NULL);
+    install_update_thid = -1;
+  }
 
   // Recursively clean up package_temp directory
   removePath(PACKAGE_DIR, NULL);
@@ -0,0 +1,107 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "main.h"
+#include "progress.h"
+#include "language.h"
+#include "utils.h"
+
+// 64bit counters are written by the worker and read by the UI thread,
+// a plain access could be torn into two 32bit halves
+void progressStore(uint64_t *counter, uint64_t value) {
+  __atomic_store_n(counter, value, __ATOMIC_RELAXED);
+}
+
+uint64_t progressLoad(uint64_t *counter) {
+  return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+void progressSamplerInit(ProgressSampler *sampler, uint64_t value, uint32_t items) {
+  memset(sampler, 0, sizeof(ProgressSampler));
+  sampler->last_time = sceKernelGetProcessTimeWide();
+  sampler->last_value = value;
+  sampler->last_items = items;
+}
+
+// Returns 1 if a new sample has been taken
+int progressSamplerUpdate(ProgressSampler *sampler, uint64_t value, uint32_t items) {
+  uint64_t now = sceKernelGetProcessTimeWide();
+  uint64_t delta_micros = now - sampler->last_time;
+  if (delta_micros < PROGRESS_SAMPLE_INTERVAL)
+    return 0;
+
+  double seconds = (double)delta_micros / 1000000.0;
+  double rate = (double)(value >= sampler->last_value ? value - sampler->last_value : 0) / seconds;
+  double item_rate = (double)(items >= sampler->last_items ? items - sampler->last_items : 0) / seconds;
+
+  // Exponentially weighted moving average, the first sample is taken as is
+  if (sampler->samples == 0) {
+    sampler->rate = rate;
+    sampler->item_rate = item_rate;
+  } else {
+    sampler->rate += PROGRESS_EWMA_WEIGHT * (rate - sampler->rate);
+    sampler->item_rate += PROGRESS_EWMA_WEIGHT * (item_rate - sampler->item_rate);
+  }
+
+  sampler->samples++;
+  sampler->last_time = now;
+  sampler->last_value = value;
+  sampler->last_items = items;
+
+  return 1;
+}
+
+// Returns the remaining seconds or -1 if unknown
+int progressSamplerGetEta(ProgressSampler *sampler, uint64_t value, uint64_t max) {
+  if (sampler->samples == 0 || sampler->rate < 1.0)
+    return -1;
+
+  if (value >= max)
+    return 0;
+
+  return (int)((double)(max - value) / sampler->rate);
+}
+
+void progressSamplerGetString(ProgressSampler *sampler, char *string, int size, uint64_t value, uint64_t max, uint64_t unit_size) {
+  string[0] = '\0';
+
+  if (sampler->samples == 0)
+    return;
+
+  // unit_size is 0 if value counts items
+  char speed_string[32];
+  if (unit_size == 0) {
+    snprintf(speed_string, sizeof(speed_string), "%.0f/s", sampler->rate);
+  } else {
+    getSizeString(speed_string, (uint64_t)(sampler->rate * (double)unit_size));
+    strcat(speed_string, "/s");
+  }
+
+  // Byte rates are meaningless for many small files, show the file rate as well
+  int len = 0;
+  if (unit_size != 0 && sampler->item_rate >= 1.0) {
+    len = snprintf(string, size, "%s, %.0f %s", speed_string, sampler->item_rate, language_container[FILES_PER_SECOND]);
+  } else {
+    len = snprintf(string, size, "%s", speed_string);
+  }
+
+  int eta = progressSamplerGetEta(sampler, value, max);
+  if (eta >= 0 && len < size) {
+    snprintf(string + len, size - len, ", %02d:%02d:%02d", eta / 3600, (eta / 60) % 60, eta % 60);
+  }
+}
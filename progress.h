@@ -0,0 +1,47 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __PROGRESS_H__
+#define __PROGRESS_H__
+
+#include <stdint.h>
+
+#define PROGRESS_SAMPLE_INTERVAL 500 * 1000
+#define PROGRESS_EWMA_WEIGHT 0.3
+
+#define MAX_PROGRESS_STRING_LENGTH 64
+
+// Smoothed throughput of a counter. Only the UI thread owns a sampler
+typedef struct {
+  uint64_t last_time;
+  uint64_t last_value;
+  uint32_t last_items;
+  double rate;
+  double item_rate;
+  int samples;
+} ProgressSampler;
+
+void progressStore(uint64_t *counter, uint64_t value);
+uint64_t progressLoad(uint64_t *counter);
+
+void progressSamplerInit(ProgressSampler *sampler, uint64_t value, uint32_t items);
+int progressSamplerUpdate(ProgressSampler *sampler, uint64_t value, uint32_t items);
+int progressSamplerGetEta(ProgressSampler *sampler, uint64_t value, uint64_t max);
+void progressSamplerGetString(ProgressSampler *sampler, char *string, int size, uint64_t value, uint64_t max, uint64_t unit_size);
+
+#endif
@@ -18,7 +18,10 @@
 
 #include "main.h"
 #include "browser.h"
+#include "archive.h"
 #include "psarc.h"
+#include "psarcindex.h"
+#include "psarcextract.h"
 #include "file.h"
 #include "utils.h"
 
@@ -145,8 +148,63 @@ int g_ArchiveIndex = 0;
 SceFiosBuffer g_MountBuffer = SCE_FIOS_BUFFER_INITIALIZER;
 SceFiosFH g_ArchiveFH = -1;
 
+// Archives are parsed natively when possible. SceFios is the fallback for
+// those the parser does not handle, like ones with an encrypted TOC
+static PsarcIndex psarc_index;
+static PsarcIndexFile psarc_index_file = { .fd = -1 };
+static SceIoStat psarc_stat;
+static int psarc_native = 0;
+static int psarc_path_start = 0;
+
+// Path inside the archive, without leading slash
+static const char *getPsarcIndexName(const char *path) {
+  if (strlen(path) < psarc_path_start)
+    return "";
+
+  path += psarc_path_start;
+  while (*path == '/')
+    path++;
+
+  return path;
+}
+
+// Folder prefix of the entries below a path, "" for the root
+static void getPsarcIndexFolder(const char *path, char *folder) {
+  snprintf(folder, MAX_PATH_LENGTH - 1, "%s", getPsarcIndexName(path));
+  if (folder[0] != '\0')
+    addEndSlash(folder);
+}
+
+// The first folder below the first len characters of name that prev is not in.
+// Returns a pointer to its end slash, or NULL if there is none
+static const char *getPsarcIndexNewFolder(const char *name, const char *prev, int len) {
+  int common = 0;
+  if (prev) {
+    while (name[common] && name[common] == prev[common])
+      common++;
+  }
+
+  const char *slash = strchr(name + len, '/');
+  while (slash && slash - name < common)
+    slash = strchr(slash + 1, '/');
+
+  return slash;
+}
+
 int psarcOpen(const char *file) {
   int res;
+
+  psarcIndexClose(&psarc_index);
+  psarc_native = 0;
+
+  if (psarcIndexOpen(&psarc_index, file) >= 0) {
+    memset(&psarc_stat, 0, sizeof(SceIoStat));
+    sceIoGetstat(file, &psarc_stat);
+
+    psarc_path_start = strlen(file);
+    psarc_native = 1;
+    return 0;
+  }
   
   SceFiosParams params = SCE_FIOS_PARAMS_INITIALIZER;
   params.opStorage.pPtr = g_OpStorage;
@@ -199,6 +257,15 @@ ERROR_INITIALIZE:
 }
 
 int psarcClose() {
+  if (psarc_native) {
+    if (psarc_index_file.fd >= 0)
+      psarcIndexFileClose(&psarc_index_file);
+
+    psarcIndexClose(&psarc_index);
+    psarc_native = 0;
+    return 0;
+  }
+
   sceFiosArchiveUnmountSync(NULL, g_ArchiveFH);
   free(g_MountBuffer.pPtr);
   sceFiosIOFilterRemove(g_ArchiveIndex);
@@ -207,28 +274,100 @@ int psarcClose() {
   return 0;
 }
 
+static void addPsarcDirUpEntry(FileList *list, int sort) {
+  FileListEntry *entry = malloc(sizeof(FileListEntry));
+  if (entry) {
+    entry->name_length = strlen(DIR_UP);
+    entry->name = malloc(entry->name_length + 1);
+    strcpy(entry->name, DIR_UP);
+    entry->is_folder = 1;
+    entry->is_symlink = 0;
+    entry->type = FILE_TYPE_UNKNOWN;
+    fileListAddEntry(list, entry, sort);
+  }
+}
+
+static int fileListGetPsarcIndexEntries(FileList *list, const char *path, int sort) {
+  char folder[MAX_PATH_LENGTH];
+  getPsarcIndexFolder(path, folder);
+  int len = strlen(folder);
+
+  int first = 0;
+  int count = psarcIndexFindFolder(&psarc_index, folder, &first);
+  if (count == 0 && len > 0)
+    return VITASHELL_ERROR_NOT_FOUND;
+
+  addPsarcDirUpEntry(list, sort);
+
+  const char *last_folder = NULL;
+  int last_folder_length = 0;
+
+  int i;
+  for (i = first; i < first + count; i++) {
+    PsarcIndexEntry *index_entry = &psarc_index.entries[i];
+    const char *name = index_entry->name + len;
+    const char *slash = strchr(name, '/');
+    int name_length = slash ? (int)(slash - name) : (int)strlen(name);
+
+    // Entries of the same subfolder follow each other
+    if (slash && last_folder && last_folder_length == name_length &&
+        strncmp(last_folder, name, name_length) == 0)
+      continue;
+
+    FileListEntry *entry = malloc(sizeof(FileListEntry));
+    if (!entry)
+      continue;
+
+    entry->is_symlink = 0;
+    entry->is_folder = slash != NULL;
+    if (entry->is_folder) {
+      entry->name_length = name_length + 1;
+      entry->name = malloc(entry->name_length + 1);
+      memcpy(entry->name, name, name_length);
+      entry->name[name_length] = '\0';
+      addEndSlash(entry->name);
+      entry->type = FILE_TYPE_UNKNOWN;
+      entry->size = 0;
+      list->folders++;
+
+      last_folder = name;
+      last_folder_length = name_length;
+    } else {
+      entry->name_length = name_length;
+      entry->name = malloc(entry->name_length + 1);
+      strcpy(entry->name, name);
+      entry->type = getFileType(entry->name);
+      entry->size = index_entry->size;
+      list->files++;
+    }
+
+    // PSARC has no timestamps, use the ones of the archive
+    memcpy(&entry->ctime, (SceDateTime *)&psarc_stat.st_ctime, sizeof(SceDateTime));
+    memcpy(&entry->mtime, (SceDateTime *)&psarc_stat.st_mtime, sizeof(SceDateTime));
+    memcpy(&entry->atime, (SceDateTime *)&psarc_stat.st_atime, sizeof(SceDateTime));
+
+    fileListAddEntry(list, entry, sort);
+  }
+
+  return 0;
+}
+
 int fileListGetPsarcEntries(FileList *list, const char *path, int sort) {
   int res;
   
   if (!list)
     return VITASHELL_ERROR_ILLEGAL_ADDR;
 
+  if (psarc_native)
+    return fileListGetPsarcIndexEntries(list, path, sort);
+
   SceFiosDH dh = -1;
   SceFiosBuffer buf = SCE_FIOS_BUFFER_INITIALIZER;
   res = sceFiosDHOpenSync(NULL, &dh, path, buf);
   if (res < 0)
     return res;
 
-  FileListEntry *entry = malloc(sizeof(FileListEntry));
-  if (entry) {
-    entry->name_length = strlen(DIR_UP);
-    entry->name = malloc(entry->name_length + 1);
-    strcpy(entry->name, DIR_UP);
-    entry->is_folder = 1;
-    entry->is_symlink = 0;
-    entry->type = FILE_TYPE_UNKNOWN;
-    fileListAddEntry(list, entry, sort);
-  }
+  addPsarcDirUpEntry(list, sort);
 
   do {
     SceFiosDirEntry dir;
@@ -286,7 +425,84 @@ int fileListGetPsarcEntries(FileList *list, const char *path, int sort) {
   return 0;
 }
 
+static int getPsarcIndexPathInfo(const char *path, uint64_t *size, uint32_t *folders, uint32_t *files, int (* handler)(const char *path)) {
+  PsarcIndexEntry *entry = psarcIndexFind(&psarc_index, getPsarcIndexName(path));
+  if (entry) {
+    if (handler && handler(path))
+      return 1;
+
+    if (size)
+      (*size) += entry->size;
+
+    if (files)
+      (*files)++;
+
+    return 1;
+  }
+
+  char folder[MAX_PATH_LENGTH];
+  getPsarcIndexFolder(path, folder);
+  int len = strlen(folder);
+
+  int first = 0;
+  int count = psarcIndexFindFolder(&psarc_index, folder, &first);
+  if (count == 0 && len > 0)
+    return VITASHELL_ERROR_NOT_FOUND;
+
+  if (folders)
+    (*folders)++;
+
+  char new_path[MAX_PATH_LENGTH];
+  const char *prev = NULL;
+
+  int i;
+  for (i = first; i < first + count; i++) {
+    const char *name = psarc_index.entries[i].name;
+    int skip = 0;
+
+    // Count the subfolders on their first entry
+    const char *slash = getPsarcIndexNewFolder(name, prev, len);
+    while (slash) {
+      snprintf(new_path, MAX_PATH_LENGTH, "%s/%.*s", psarc_index.file, (int)(slash - name), name);
+      if (handler && handler(new_path)) {
+        // Skip the whole subfolder
+        char subfolder[MAX_PATH_LENGTH];
+        snprintf(subfolder, MAX_PATH_LENGTH, "%.*s", (int)(slash - name + 1), name);
+        int sub_first = 0;
+        int sub_count = psarcIndexFindFolder(&psarc_index, subfolder, &sub_first);
+        i = sub_first + sub_count - 1;
+        skip = 1;
+        break;
+      }
+
+      if (folders)
+        (*folders)++;
+
+      slash = strchr(slash + 1, '/');
+    }
+
+    prev = psarc_index.entries[i].name;
+    if (skip)
+      continue;
+
+    snprintf(new_path, MAX_PATH_LENGTH, "%s/%s", psarc_index.file, name);
+    if (handler && handler(new_path))
+      continue;
+
+    if (size)
+      (*size) += psarc_index.entries[i].size;
+
+    if (files)
+      (*files)++;
+  }
+
+  return 1;
+}
+
 int getPsarcPathInfo(const char *path, uint64_t *size, uint32_t *folders, uint32_t *files, int (* handler)(const char *path)) {
+  if (psarc_native)
+    return getPsarcIndexPathInfo(path, size, folders, files, handler);
+
   SceFiosDH dh = -1;
   SceFiosBuffer buf = SCE_FIOS_BUFFER_INITIALIZER;
   if (sceFiosDHOpenSync(NULL, &dh, path, buf) >= 0) {
@@ -421,10 +637,114 @@ int extractPsarcFile(const char *src_path, const char *dst_path, FileProcessPara
   sceIoClose(fddst);
   psarcFileClose(fdsrc);
 
+  if (param && param->items)
+    (*param->items)++;
+
+  return 1;
+}
+
+typedef struct {
+  const char *dst_path;
+  int src_length;
+} PsarcIndexExtractPath;
+
+static int getPsarcIndexExtractPath(PsarcIndexEntry *entry, char *dst_path, void *argp) {
+  PsarcIndexExtractPath *extract = (PsarcIndexExtractPath *)argp;
+  snprintf(dst_path, MAX_PATH_LENGTH, "%s%s", extract->dst_path, entry->name + extract->src_length);
+  return 0;
+}
+
+static int makePsarcIndexFolder(const char *path, FileProcessParam *param) {
+  int ret = sceIoMkdir(path, 0777);
+  if (ret < 0 && ret != SCE_ERROR_ERRNO_EEXIST)
+    return ret;
+
+  if (param) {
+    if (param->value)
+      (*param->value) += DIRECTORY_SIZE;
+
+    if (param->SetProgress)
+      param->SetProgress(param->value ? *param->value : 0, param->max);
+
+    if (param->cancelHandler && param->cancelHandler())
+      return 0;
+  }
+
   return 1;
 }
 
+static int extractPsarcIndexPath(const char *src_path, const char *dst_path, FileProcessParam *param) {
+  PsarcExtractHandler handler;
+  PsarcIndexExtractPath extract;
+  handler.getPath = getPsarcIndexExtractPath;
+  handler.argp = &extract;
+
+  PsarcIndexEntry *entry = psarcIndexFind(&psarc_index, getPsarcIndexName(src_path));
+  if (entry) {
+    extract.dst_path = dst_path;
+    extract.src_length = strlen(entry->name);
+    return psarcExtractEntries(&psarc_index, &entry, 1, PSARC_EXTRACT_WORKERS, &handler, param);
+  }
+
+  char folder[MAX_PATH_LENGTH];
+  getPsarcIndexFolder(src_path, folder);
+  int len = strlen(folder);
+
+  int first = 0;
+  int count = psarcIndexFindFolder(&psarc_index, folder, &first);
+  if (count == 0 && len > 0)
+    return VITASHELL_ERROR_NOT_FOUND;
+
+  int res = makePsarcIndexFolder(dst_path, param);
+  if (res <= 0)
+    return res;
+
+  char path[MAX_PATH_LENGTH];
+  snprintf(path, MAX_PATH_LENGTH - 1, "%s", dst_path);
+  addEndSlash(path);
+  int path_length = strlen(path);
+
+  PsarcIndexEntry **entries = malloc(count * sizeof(PsarcIndexEntry *));
+  if (!entries)
+    return VITASHELL_ERROR_NO_MEMORY;
+
+  // Create the subfolders before the files are written in parallel
+  const char *prev = NULL;
+
+  int i;
+  for (i = 0; i < count; i++) {
+    const char *name = psarc_index.entries[first + i].name;
+    entries[i] = &psarc_index.entries[first + i];
+
+    const char *slash = getPsarcIndexNewFolder(name, prev, len);
+    while (slash) {
+      snprintf(path + path_length, MAX_PATH_LENGTH - path_length, "%.*s", (int)(slash - name - len), name + len);
+      res = makePsarcIndexFolder(path, param);
+      if (res <= 0) {
+        free(entries);
+        return res;
+      }
+
+      slash = strchr(slash + 1, '/');
+    }
+
+    prev = name;
+  }
+
+  path[path_length] = '\0';
+  extract.dst_path = path;
+  extract.src_length = len;
+
+  res = psarcExtractEntries(&psarc_index, entries, count, PSARC_EXTRACT_WORKERS, &handler, param);
+
+  free(entries);
+  return res;
+}
+
 int extractPsarcPath(const char *src_path, const char *dst_path, FileProcessParam *param) {
+  if (psarc_native)
+    return extractPsarcIndexPath(src_path, dst_path, param);
+
   SceFiosDH dh = -1;
   SceFiosBuffer buf = SCE_FIOS_BUFFER_INITIALIZER;
   if (sceFiosDHOpenSync(NULL, &dh, src_path, buf) >= 0) {
@@ -489,7 +809,75 @@ int extractPsarcPath(const char *src_path, const char *dst_path, FileProcessPara
   return 1;
 }
 
+static int getPsarcTestPath(PsarcIndexEntry *entry, char *dst_path, void *argp) {
+  snprintf((char *)argp, MAX_PATH_LENGTH, "%s", entry->name);
+  dst_path[0] = '\0';
+  return 0;
+}
+
+uint64_t getPsarcSize() {
+  uint64_t size = 0;
+
+  int i;
+  for (i = 0; i < psarc_index.count; i++)
+    size += psarc_index.entries[i].size;
+
+  return size;
+}
+
+// Decodes all files without writing them, failed gets the name of the
+// file that is being decoded. Only archives that are read natively can be tested
+int testPsarc(char *failed, FileProcessParam *param) {
+  if (!psarc_native)
+    return VITASHELL_ERROR_INVALID_TYPE;
+
+  if (psarc_index.count == 0)
+    return 1;
+
+  PsarcIndexEntry **entries = malloc(psarc_index.count * sizeof(PsarcIndexEntry *));
+  if (!entries)
+    return VITASHELL_ERROR_NO_MEMORY;
+
+  int i;
+  for (i = 0; i < psarc_index.count; i++)
+    entries[i] = &psarc_index.entries[i];
+
+  PsarcExtractHandler handler;
+  handler.getPath = getPsarcTestPath;
+  handler.argp = failed;
+
+  int res = psarcExtractEntries(&psarc_index, entries, psarc_index.count, PSARC_EXTRACT_WORKERS, &handler, param);
+
+  free(entries);
+  return res;
+}
+
+static int psarcIndexFileGetstat(const char *file, SceIoStat *stat) {
+  const char *name = getPsarcIndexName(file);
+  PsarcIndexEntry *entry = psarcIndexFind(&psarc_index, name);
+
+  if (!entry && name[0] != '\0') {
+    char folder[MAX_PATH_LENGTH];
+    getPsarcIndexFolder(file, folder);
+
+    int first = 0;
+    if (psarcIndexFindFolder(&psarc_index, folder, &first) == 0)
+      return VITASHELL_ERROR_NOT_FOUND;
+  }
+
+  if (stat) {
+    memcpy(stat, &psarc_stat, sizeof(SceIoStat));
+    stat->st_mode = entry ? SCE_S_IFREG : SCE_S_IFDIR;
+    stat->st_size = entry ? entry->size : 0;
+  }
+
+  return 0;
+}
+
 int psarcFileGetstat(const char *file, SceIoStat *stat) {
+  if (psarc_native)
+    return psarcIndexFileGetstat(file, stat);
+
   SceFiosStat fios_stat;
   memset(&fios_stat, 0, sizeof(SceFiosStat));
   int res = sceFiosStatSync(NULL, file, &fios_stat);
@@ -516,6 +904,22 @@ int psarcFileGetstat(const char *file, SceIoStat *stat) {
 }
 
 int psarcFileOpen(const char *file, int flags, SceMode mode) {
+  if (psarc_native) {
+    // A file is already open
+    if (psarc_index_file.fd >= 0)
+      return VITASHELL_ERROR_ALREADY_RUNNING;
+
+    PsarcIndexEntry *entry = psarcIndexFind(&psarc_index, getPsarcIndexName(file));
+    if (!entry)
+      return VITASHELL_ERROR_NOT_FOUND;
+
+    int res = psarcIndexFileOpen(&psarc_index, &psarc_index_file, entry);
+    if (res < 0)
+      return res;
+
+    return ARCHIVE_FD;
+  }
+
   SceFiosFH fh = -1;
   
   int res = sceFiosFHOpenSync(NULL, &fh, file, NULL);
@@ -526,9 +930,15 @@ int psarcFileOpen(const char *file, int flags, SceMode mode) {
 }
 
 int psarcFileRead(SceUID fd, void *data, SceSize size) {
+  if (psarc_native)
+    return fd == ARCHIVE_FD ? psarcIndexFileRead(&psarc_index_file, data, size) : VITASHELL_ERROR_INVALID_ARGUMENT;
+
   return (int)sceFiosFHReadSync(NULL, fd, data, (SceFiosSize)size);
 }
 
 int psarcFileClose(SceUID fd) {
+  if (psarc_native)
+    return fd == ARCHIVE_FD ? psarcIndexFileClose(&psarc_index_file) : VITASHELL_ERROR_INVALID_ARGUMENT;
+
   return sceFiosFHCloseSync(NULL, fd);
 }
@@ -26,6 +26,9 @@ int fileListGetPsarcEntries(FileList *list, const char *path, int sort);
 int getPsarcPathInfo(const char *path, uint64_t *size, uint32_t *folders, uint32_t *files, int (* handler)(const char *path));
 int extractPsarcPath(const char *src_path, const char *dst_path, FileProcessParam *param);
 
+uint64_t getPsarcSize();
+int testPsarc(char *failed, FileProcessParam *param);
+
 int psarcFileGetstat(const char *file, SceIoStat *stat);
 int psarcFileOpen(const char *file, int flags, SceMode mode);
 int psarcFileRead(SceUID fd, void *data, SceSize size);
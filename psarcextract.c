@@ -0,0 +1,211 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <psp2/kernel/threadmgr.h>
+
+#include "core.h"
+#include "psarcextract.h"
+#include "workerpool.h"
+
+// The blocks of all entries are numbered in list order and handed to the
+// workers round robin, so that even a single large entry is decoded on
+// every worker. Each worker decodes its blocks into its own ring of slots
+// and the calling thread writes them out in order.
+
+typedef struct {
+  uint32_t block;
+  int size; // Length of the decoded block, < 0 on error
+  uint8_t *buffer;
+} PsarcExtractSlot;
+
+typedef struct {
+  WorkerRing ring;
+  PsarcIndex *index;
+  PsarcIndexEntry **entries;
+  int count;
+  uint32_t first;
+  uint32_t step;
+  PsarcExtractSlot slots[PSARC_EXTRACT_SLOTS];
+} PsarcExtractWorker;
+
+static int psarcExtractWorkerThread(SceSize args, void *argp) {
+  PsarcExtractWorker *worker = *(PsarcExtractWorker **)argp;
+  PsarcIndex *index = worker->index;
+
+  PsarcDecoder decoder;
+  memset(&decoder, 0, sizeof(PsarcDecoder));
+
+  SceUID fd = sceIoOpen(index->file, SCE_O_RDONLY, 0);
+  int res = fd < 0 ? fd : psarcDecoderInit(&decoder, index);
+
+  uint32_t number = 0;
+
+  int i;
+  for (i = 0; i < worker->count; i++) {
+    PsarcIndexEntry *entry = worker->entries[i];
+    uint32_t n_blocks = psarcIndexEntryBlocks(index, entry);
+    uint64_t offset = entry->offset;
+
+    uint32_t block;
+    for (block = 0; block < n_blocks; block++, number++) {
+      if (number % worker->step == worker->first) {
+        int n = workerRingNextFree(&worker->ring);
+        if (n < 0)
+          goto exit;
+
+        PsarcExtractSlot *slot = &worker->slots[n];
+
+        slot->block = number;
+        slot->size = res < 0 ? res : psarcDecodeBlock(&decoder, index, fd, entry, block, offset, slot->buffer);
+
+        workerRingPut(&worker->ring);
+
+        if (slot->size < 0)
+          goto exit;
+      }
+
+      offset += psarcIndexBlockStoredSize(index, entry, block);
+    }
+  }
+
+exit:
+  psarcDecoderEnd(&decoder);
+  if (fd >= 0)
+    sceIoClose(fd);
+
+  return sceKernelExitThread(0);
+}
+
+static int psarcExtractWriteEntry(PsarcExtractWorker *workers, int n_workers, uint32_t *number,
+                                  PsarcIndexEntry *entry, const char *dst_path, FileProcessParam *param) {
+  // Without a path the data is only decoded and checked
+  SceUID fddst = -1;
+  if (dst_path[0] != '\0') {
+    fddst = sceIoOpen(dst_path, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0777);
+    if (fddst < 0)
+      return fddst;
+  }
+
+  uint32_t n_blocks = psarcIndexEntryBlocks(workers[0].index, entry);
+  int res = 1;
+
+  uint32_t block;
+  for (block = 0; block < n_blocks; block++) {
+    PsarcExtractWorker *worker = &workers[*number % n_workers];
+
+    PsarcExtractSlot *slot = &worker->slots[workerRingNextFull(&worker->ring)];
+
+    int size = slot->block == *number ? slot->size : VITASHELL_ERROR_INTERNAL;
+    int written = (size > 0 && fddst >= 0) ? sceIoWrite(fddst, slot->buffer, size) : 0;
+
+    workerRingRelease(&worker->ring);
+
+    (*number)++;
+
+    if (size < 0 || written < 0) {
+      res = size < 0 ? size : written;
+      break;
+    }
+
+    if (param) {
+      if (param->value)
+        (*param->value) += size;
+
+      if (param->SetProgress)
+        param->SetProgress(param->value ? *param->value : 0, param->max);
+
+      if (param->cancelHandler && param->cancelHandler()) {
+        res = 0;
+        break;
+      }
+    }
+  }
+
+  if (fddst >= 0) {
+    sceIoClose(fddst);
+
+    if (res <= 0)
+      sceIoRemove(dst_path);
+  }
+
+  if (res <= 0)
+    return res;
+
+  if (param && param->items)
+    (*param->items)++;
+
+  return 1;
+}
+
+int psarcExtractEntries(PsarcIndex *index, PsarcIndexEntry **entries, int count, int n_workers,
+                        PsarcExtractHandler *handler, FileProcessParam *param) {
+  if (count <= 0)
+    return 1;
+
+  if (n_workers > PSARC_EXTRACT_MAX_WORKERS)
+    n_workers = PSARC_EXTRACT_MAX_WORKERS;
+  if (n_workers < 1)
+    n_workers = 1;
+
+  uint8_t *buffers = memalign(4096, n_workers * PSARC_EXTRACT_SLOTS * index->block_size);
+  if (!buffers)
+    return VITASHELL_ERROR_NO_MEMORY;
+
+  PsarcExtractWorker workers[PSARC_EXTRACT_MAX_WORKERS];
+  int i, j;
+
+  for (i = 0; i < n_workers; i++) {
+    PsarcExtractWorker *worker = &workers[i];
+    memset(worker, 0, sizeof(PsarcExtractWorker));
+
+    worker->index = index;
+    worker->entries = entries;
+    worker->count = count;
+    worker->first = i;
+    worker->step = n_workers;
+
+    for (j = 0; j < PSARC_EXTRACT_SLOTS; j++)
+      worker->slots[j].buffer = buffers + (i * PSARC_EXTRACT_SLOTS + j) * index->block_size;
+  }
+
+  WorkerPool pool;
+  int res = workerPoolStart(&pool, "psarc_extract", (SceKernelThreadEntry)psarcExtractWorkerThread,
+                            workers, sizeof(PsarcExtractWorker), n_workers, PSARC_EXTRACT_SLOTS);
+  if (res >= 0)
+    res = 1;
+
+  // Write the entries in list order
+  char dst_path[MAX_PATH_LENGTH];
+  uint32_t number = 0;
+
+  for (i = 0; i < count && res > 0; i++) {
+    int ret = handler->getPath(entries[i], dst_path, handler->argp);
+    if (ret < 0) {
+      res = ret;
+      break;
+    }
+
+    res = psarcExtractWriteEntry(workers, n_workers, &number, entries[i], dst_path, param);
+  }
+
+  workerPoolStop(&pool);
+
+  free(buffers);
+
+  return res;
+}
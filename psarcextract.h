@@ -0,0 +1,39 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __PSARCEXTRACT_H__
+#define __PSARCEXTRACT_H__
+
+#include "file.h"
+#include "psarcindex.h"
+
+#define PSARC_EXTRACT_WORKERS 3
+#define PSARC_EXTRACT_MAX_WORKERS 4
+#define PSARC_EXTRACT_SLOTS 4
+
+typedef struct {
+  // Gives the destination path of an entry, returns < 0 to abort. An
+  // empty path tests the entry, its data is decoded but not written
+  int (* getPath)(PsarcIndexEntry *entry, char *dst_path, void *argp);
+  void *argp;
+} PsarcExtractHandler;
+
+int psarcExtractEntries(PsarcIndex *index, PsarcIndexEntry **entries, int count, int n_workers,
+                        PsarcExtractHandler *handler, FileProcessParam *param);
+
+#endif
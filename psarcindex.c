@@ -0,0 +1,538 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "core.h"
+#include "psarcindex.h"
+
+// PSARC is big endian: a 32 byte header, then the table of contents and the
+// table of the stored block sizes. Files are split in blocks of block_size
+// bytes which are compressed separately, so every block can be decoded on
+// its own. The first entry is the manifest with the paths of the others.
+
+static uint16_t readBe16(const uint8_t *p) {
+  return (p[0] << 8) | p[1];
+}
+
+static uint32_t readBe32(const uint8_t *p) {
+  return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static uint64_t readBe40(const uint8_t *p) {
+  return ((uint64_t)p[0] << 32) | readBe32(p + 1);
+}
+
+static int readAt(SceUID fd, uint64_t offset, void *data, int size) {
+  if (sceIoLseek(fd, offset, SCE_SEEK_SET) < 0)
+    return VITASHELL_ERROR_INTERNAL;
+
+  int read = sceIoRead(fd, data, size);
+  if (read < 0)
+    return read;
+
+  return read == size ? 0 : VITASHELL_ERROR_INVALID_MAGIC;
+}
+
+static int compareEntries(const void *a, const void *b) {
+  return strcmp(((PsarcIndexEntry *)a)->name, ((PsarcIndexEntry *)b)->name);
+}
+
+static int compareEntriesIgnoreCase(const void *a, const void *b) {
+  return strcasecmp(((PsarcIndexEntry *)a)->name, ((PsarcIndexEntry *)b)->name);
+}
+
+// Names of archives made with PSARC_FLAG_IGNORE_CASE are sorted and
+// looked up without case
+static int compareNames(PsarcIndex *index, const char *a, const char *b, int len) {
+  if (index->flags & PSARC_FLAG_IGNORE_CASE)
+    return len < 0 ? strcasecmp(a, b) : strncasecmp(a, b, len);
+
+  return len < 0 ? strcmp(a, b) : strncmp(a, b, len);
+}
+
+// Split the manifest into the names of the entries after it
+static int readManifest(PsarcIndex *index, PsarcIndexEntry *manifest) {
+  if (manifest->size >= 0x7FFFFFFF)
+    return VITASHELL_ERROR_INVALID_MAGIC;
+
+  int size = (int)manifest->size;
+
+  index->names = malloc(size + 1);
+  if (!index->names)
+    return VITASHELL_ERROR_NO_MEMORY;
+
+  PsarcIndexFile file;
+  int res = psarcIndexFileOpen(index, &file, manifest);
+  if (res < 0)
+    return res;
+
+  int read = psarcIndexFileRead(&file, index->names, size);
+  psarcIndexFileClose(&file);
+
+  if (read != size)
+    return read < 0 ? read : VITASHELL_ERROR_INVALID_MAGIC;
+
+  index->names[size] = '\0';
+
+  char *p = index->names;
+  int i;
+  for (i = 1; i < index->count; i++) {
+    if (*p == '\0')
+      return VITASHELL_ERROR_INVALID_MAGIC;
+
+    char *next = strchr(p, '\n');
+    if (next)
+      *next++ = '\0';
+    else
+      next = p + strlen(p);
+
+    int len = strlen(p);
+    if (len > 0 && p[len - 1] == '\r')
+      p[len - 1] = '\0';
+
+    // Archives with absolute paths have a leading slash
+    while (*p == '/')
+      p++;
+
+    index->entries[i].name = p;
+    p = next;
+  }
+
+  return 0;
+}
+
+int psarcIndexOpen(PsarcIndex *index, const char *file) {
+  memset(index, 0, sizeof(PsarcIndex));
+
+  SceUID fd = sceIoOpen(file, SCE_O_RDONLY, 0);
+  if (fd < 0)
+    return fd;
+
+  uint8_t header[PSARC_HEADER_SIZE];
+  int res = readAt(fd, 0, header, sizeof(header));
+  if (res < 0) {
+    sceIoClose(fd);
+    return res;
+  }
+
+  uint32_t toc_length = readBe32(header + 12);
+  uint32_t toc_entry_size = readBe32(header + 16);
+  uint32_t toc_entries = readBe32(header + 20);
+  index->compression = readBe32(header + 8);
+  index->block_size = readBe32(header + 24);
+  index->flags = readBe32(header + 28);
+
+  if (readBe32(header) != PSARC_MAGIC || readBe16(header + 4) != 1 ||
+      toc_entry_size < PSARC_TOC_ENTRY_SIZE || toc_entries == 0 || toc_entries > 0x1000000 ||
+      index->block_size == 0 || index->block_size > PSARC_MAX_BLOCK_SIZE ||
+      toc_length < PSARC_HEADER_SIZE + (uint64_t)toc_entries * toc_entry_size) {
+    sceIoClose(fd);
+    return VITASHELL_ERROR_INVALID_MAGIC;
+  }
+
+  // Encrypted tables of contents are left to SceFios
+  if ((index->flags & PSARC_FLAG_ENCRYPTED) ||
+      (index->compression != PSARC_COMPRESSION_ZLIB && index->compression != PSARC_COMPRESSION_LZMA)) {
+    sceIoClose(fd);
+    return VITASHELL_ERROR_INVALID_TYPE;
+  }
+
+  uint8_t *toc = malloc(toc_length - PSARC_HEADER_SIZE);
+  if (!toc) {
+    sceIoClose(fd);
+    return VITASHELL_ERROR_NO_MEMORY;
+  }
+
+  res = readAt(fd, PSARC_HEADER_SIZE, toc, toc_length - PSARC_HEADER_SIZE);
+  sceIoClose(fd);
+
+  if (res < 0) {
+    free(toc);
+    return res;
+  }
+
+  // Block sizes take as many bytes as needed to hold block_size - 1
+  int size_bytes = 1;
+  while (size_bytes < 4 && (index->block_size - 1) >> (8 * size_bytes))
+    size_bytes++;
+
+  uint32_t table_size = toc_length - PSARC_HEADER_SIZE - toc_entries * toc_entry_size;
+  index->n_blocks = table_size / size_bytes;
+  index->count = toc_entries;
+
+  index->entries = malloc(toc_entries * sizeof(PsarcIndexEntry));
+  index->blocks = malloc((index->n_blocks + 1) * sizeof(uint32_t));
+
+  if (!index->entries || !index->blocks) {
+    free(toc);
+    psarcIndexClose(index);
+    return VITASHELL_ERROR_NO_MEMORY;
+  }
+
+  uint8_t *p = toc + toc_entries * toc_entry_size;
+  uint32_t i;
+  for (i = 0; i < index->n_blocks; i++) {
+    uint32_t size = 0;
+    int j;
+    for (j = 0; j < size_bytes; j++)
+      size = (size << 8) | *p++;
+    index->blocks[i] = size;
+  }
+
+  res = 0;
+
+  // Skip the name digest, names come from the manifest
+  for (i = 0; i < toc_entries; i++) {
+    PsarcIndexEntry *entry = &index->entries[i];
+    p = toc + i * toc_entry_size;
+
+    entry->name = "";
+    entry->block_index = readBe32(p + 16);
+    entry->size = readBe40(p + 20);
+    entry->offset = readBe40(p + 25);
+
+    if (entry->block_index > index->n_blocks ||
+        psarcIndexEntryBlocks(index, entry) > index->n_blocks - entry->block_index)
+      res = VITASHELL_ERROR_INVALID_MAGIC;
+  }
+
+  free(toc);
+
+  strncpy(index->file, file, MAX_PATH_LENGTH - 1);
+  index->file[MAX_PATH_LENGTH - 1] = '\0';
+
+  if (res >= 0)
+    res = readManifest(index, &index->entries[0]);
+
+  if (res < 0) {
+    psarcIndexClose(index);
+    return res;
+  }
+
+  // Drop the manifest and sort by name for lookups and folder listings
+  index->count--;
+  memmove(index->entries, index->entries + 1, index->count * sizeof(PsarcIndexEntry));
+  qsort(index->entries, index->count, sizeof(PsarcIndexEntry),
+        (index->flags & PSARC_FLAG_IGNORE_CASE) ? compareEntriesIgnoreCase : compareEntries);
+
+  return 0;
+}
+
+void psarcIndexClose(PsarcIndex *index) {
+  if (index->entries)
+    free(index->entries);
+  if (index->blocks)
+    free(index->blocks);
+  if (index->names)
+    free(index->names);
+
+  memset(index, 0, sizeof(PsarcIndex));
+}
+
+PsarcIndexEntry *psarcIndexFind(PsarcIndex *index, const char *name) {
+  int low = 0, high = index->count;
+
+  while (low < high) {
+    int mid = (low + high) / 2;
+    int cmp = compareNames(index, index->entries[mid].name, name, -1);
+    if (cmp == 0)
+      return &index->entries[mid];
+
+    if (cmp < 0)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  return NULL;
+}
+
+// Entries below a folder ("" or ending with a slash) are next to each
+// other in the sorted list. Returns their number
+int psarcIndexFindFolder(PsarcIndex *index, const char *folder, int *first) {
+  int len = strlen(folder);
+  int low = 0, high = index->count;
+
+  while (low < high) {
+    int mid = (low + high) / 2;
+    if (compareNames(index, index->entries[mid].name, folder, -1) < 0)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  *first = low;
+  high = index->count;
+
+  while (low < high) {
+    int mid = (low + high) / 2;
+    if (compareNames(index, index->entries[mid].name, folder, len) <= 0)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  return low - *first;
+}
+
+uint32_t psarcIndexEntryBlocks(PsarcIndex *index, PsarcIndexEntry *entry) {
+  uint64_t n_blocks = (entry->size + index->block_size - 1) / index->block_size;
+  return n_blocks > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)n_blocks;
+}
+
+uint32_t psarcIndexBlockLength(PsarcIndex *index, PsarcIndexEntry *entry, uint32_t block) {
+  uint64_t start = (uint64_t)block * index->block_size;
+  if (start >= entry->size)
+    return 0;
+
+  uint64_t remaining = entry->size - start;
+  return remaining < index->block_size ? (uint32_t)remaining : index->block_size;
+}
+
+uint32_t psarcIndexBlockStoredSize(PsarcIndex *index, PsarcIndexEntry *entry, uint32_t block) {
+  uint32_t size = index->blocks[entry->block_index + block];
+  return size ? size : index->block_size;
+}
+
+int psarcDecoderInit(PsarcDecoder *decoder, PsarcIndex *index) {
+  memset(decoder, 0, sizeof(PsarcDecoder));
+
+  decoder->buffer = memalign(64, index->block_size);
+  if (!decoder->buffer)
+    return VITASHELL_ERROR_NO_MEMORY;
+
+  if (index->compression == PSARC_COMPRESSION_ZLIB) {
+    if (inflateInit(&decoder->zstream) != Z_OK) {
+      free(decoder->buffer);
+      decoder->buffer = NULL;
+      return VITASHELL_ERROR_NO_MEMORY;
+    }
+  } else {
+    lzma_stream init = LZMA_STREAM_INIT;
+    decoder->lstream = init;
+  }
+
+  return 0;
+}
+
+void psarcDecoderEnd(PsarcDecoder *decoder) {
+  if (!decoder->buffer)
+    return;
+
+  // Both are no-ops on a stream that was not used
+  if (decoder->zstream.state)
+    inflateEnd(&decoder->zstream);
+  lzma_end(&decoder->lstream);
+
+  free(decoder->buffer);
+  memset(decoder, 0, sizeof(PsarcDecoder));
+}
+
+// Decode a block of an entry stored at offset. Blocks that would not get
+// smaller are stored as they are, their stored size is their length
+int psarcDecodeBlock(PsarcDecoder *decoder, PsarcIndex *index, SceUID fd, PsarcIndexEntry *entry,
+                     uint32_t block, uint64_t offset, uint8_t *data) {
+  uint32_t length = psarcIndexBlockLength(index, entry, block);
+  uint32_t stored_size = psarcIndexBlockStoredSize(index, entry, block);
+
+  if (stored_size == length || index->blocks[entry->block_index + block] == 0) {
+    int res = readAt(fd, offset, data, length);
+    return res < 0 ? res : (int)length;
+  }
+
+  if (stored_size > index->block_size)
+    return VITASHELL_ERROR_INVALID_MAGIC;
+
+  int res = readAt(fd, offset, decoder->buffer, stored_size);
+  if (res < 0)
+    return res;
+
+  uint32_t decoded = 0;
+
+  if (index->compression == PSARC_COMPRESSION_ZLIB) {
+    z_stream *stream = &decoder->zstream;
+    if (inflateReset(stream) != Z_OK)
+      return VITASHELL_ERROR_INTERNAL;
+
+    stream->next_in = decoder->buffer;
+    stream->avail_in = stored_size;
+    stream->next_out = data;
+    stream->avail_out = length;
+
+    int ret = inflate(stream, Z_FINISH);
+    if (ret != Z_STREAM_END && ret != Z_OK && ret != Z_BUF_ERROR)
+      return VITASHELL_ERROR_INVALID_MAGIC;
+
+    decoded = length - stream->avail_out;
+  } else {
+    // Every block is a complete .lzma stream
+    lzma_stream *stream = &decoder->lstream;
+    if (lzma_alone_decoder(stream, UINT64_MAX) != LZMA_OK)
+      return VITASHELL_ERROR_NO_MEMORY;
+
+    stream->next_in = decoder->buffer;
+    stream->avail_in = stored_size;
+    stream->next_out = data;
+    stream->avail_out = length;
+
+    lzma_ret ret = lzma_code(stream, LZMA_FINISH);
+    if (ret != LZMA_STREAM_END && ret != LZMA_OK)
+      return VITASHELL_ERROR_INVALID_MAGIC;
+
+    decoded = length - stream->avail_out;
+  }
+
+  return decoded == length ? (int)length : VITASHELL_ERROR_INVALID_MAGIC;
+}
+
+int psarcIndexFileOpen(PsarcIndex *index, PsarcIndexFile *file, PsarcIndexEntry *entry) {
+  memset(file, 0, sizeof(PsarcIndexFile));
+  file->fd = -1;
+
+  SceUID fd = sceIoOpen(index->file, SCE_O_RDONLY, 0);
+  if (fd < 0)
+    return fd;
+
+  file->data = memalign(4096, index->block_size);
+  int res = file->data ? psarcDecoderInit(&file->decoder, index) : VITASHELL_ERROR_NO_MEMORY;
+  if (res < 0) {
+    if (file->data)
+      free(file->data);
+    sceIoClose(fd);
+    memset(file, 0, sizeof(PsarcIndexFile));
+    file->fd = -1;
+    return res;
+  }
+
+  file->fd = fd;
+  file->index = index;
+  file->entry = entry;
+  file->block = -1;
+  file->next_offset = entry->offset;
+
+  return 0;
+}
+
+// Archive offset of a block, summed up from the last decoded block or from
+// the start of the entry when seeking backwards
+static uint64_t psarcIndexFileBlockOffset(PsarcIndexFile *file, uint32_t block) {
+  if (block < file->next_block) {
+    file->next_block = 0;
+    file->next_offset = file->entry->offset;
+  }
+
+  while (file->next_block < block) {
+    file->next_offset += psarcIndexBlockStoredSize(file->index, file->entry, file->next_block);
+    file->next_block++;
+  }
+
+  return file->next_offset;
+}
+
+static int psarcIndexFileDecode(PsarcIndexFile *file, uint32_t block, uint8_t *data) {
+  uint64_t offset = psarcIndexFileBlockOffset(file, block);
+
+  int res = psarcDecodeBlock(&file->decoder, file->index, file->fd, file->entry, block, offset, data);
+  if (res < 0)
+    return res;
+
+  file->next_block = block + 1;
+  file->next_offset = offset + psarcIndexBlockStoredSize(file->index, file->entry, block);
+
+  return res;
+}
+
+int psarcIndexFileRead(PsarcIndexFile *file, void *data, SceSize size) {
+  if (file->fd < 0 || !file->entry)
+    return VITASHELL_ERROR_NOT_RUNNING;
+
+  if (file->position >= file->entry->size)
+    return 0;
+
+  if (size > file->entry->size - file->position)
+    size = file->entry->size - file->position;
+
+  uint32_t block_size = file->index->block_size;
+  uint8_t *p = data;
+  SceSize read = 0;
+
+  while (read < size) {
+    uint32_t block = file->position / block_size;
+    uint32_t start = file->position % block_size;
+    uint32_t length = psarcIndexBlockLength(file->index, file->entry, block);
+    uint32_t count = length - start;
+    if (count > size - read)
+      count = size - read;
+
+    if (block != file->block) {
+      // Whole blocks go straight to the caller
+      if (start == 0 && count == length) {
+        int res = psarcIndexFileDecode(file, block, p + read);
+        if (res < 0)
+          return res;
+
+        file->position += count;
+        read += count;
+        continue;
+      }
+
+      int res = psarcIndexFileDecode(file, block, file->data);
+      if (res < 0) {
+        file->block = -1;
+        return res;
+      }
+
+      file->block = block;
+    }
+
+    memcpy(p + read, file->data + start, count);
+    file->position += count;
+    read += count;
+  }
+
+  return read;
+}
+
+SceOff psarcIndexFileSeek(PsarcIndexFile *file, SceOff offset, int whence) {
+  if (file->fd < 0 || !file->entry)
+    return VITASHELL_ERROR_NOT_RUNNING;
+
+  if (whence == SCE_SEEK_CUR)
+    offset += file->position;
+  else if (whence == SCE_SEEK_END)
+    offset += file->entry->size;
+
+  if (offset < 0)
+    return VITASHELL_ERROR_INVALID_ARGUMENT;
+
+  file->position = offset;
+  return offset;
+}
+
+int psarcIndexFileClose(PsarcIndexFile *file) {
+  if (file->fd < 0)
+    return VITASHELL_ERROR_NOT_RUNNING;
+
+  psarcDecoderEnd(&file->decoder);
+  free(file->data);
+  sceIoClose(file->fd);
+
+  memset(file, 0, sizeof(PsarcIndexFile));
+  file->fd = -1;
+
+  return 0;
+}
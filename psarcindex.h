@@ -0,0 +1,100 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __PSARCINDEX_H__
+#define __PSARCINDEX_H__
+
+#include <zlib.h>
+#include <lzma.h>
+
+#include "file.h"
+
+#define PSARC_MAGIC 0x50534152 // "PSAR", big endian
+#define PSARC_HEADER_SIZE 32
+#define PSARC_TOC_ENTRY_SIZE 30
+
+#define PSARC_COMPRESSION_ZLIB 0x7A6C6962 // "zlib"
+#define PSARC_COMPRESSION_LZMA 0x6C7A6D61 // "lzma"
+
+#define PSARC_FLAG_IGNORE_CASE 0x1
+#define PSARC_FLAG_ENCRYPTED   0x4
+
+#define PSARC_MAX_BLOCK_SIZE (1 * 1024 * 1024)
+
+typedef struct {
+  char *name; // Path from the manifest, without leading slash
+  uint64_t size;
+  uint64_t offset;
+  uint32_t block_index;
+} PsarcIndexEntry;
+
+typedef struct {
+  char file[MAX_PATH_LENGTH];
+  uint32_t compression;
+  uint32_t block_size;
+  uint32_t flags;
+  PsarcIndexEntry *entries; // Sorted by name, without the manifest
+  int count;
+  uint32_t *blocks; // Stored size of every block, 0 for a full stored block
+  uint32_t n_blocks;
+  char *names;
+} PsarcIndex;
+
+typedef struct {
+  z_stream zstream;
+  lzma_stream lstream;
+  uint8_t *buffer;
+} PsarcDecoder;
+
+typedef struct {
+  SceUID fd;
+  PsarcIndex *index;
+  PsarcIndexEntry *entry;
+  uint64_t position;
+
+  // Block that is decoded in data, -1 if none
+  int64_t block;
+  uint8_t *data;
+
+  // Archive offset of the block after the last one that was decoded
+  uint32_t next_block;
+  uint64_t next_offset;
+
+  PsarcDecoder decoder;
+} PsarcIndexFile;
+
+int psarcIndexOpen(PsarcIndex *index, const char *file);
+void psarcIndexClose(PsarcIndex *index);
+PsarcIndexEntry *psarcIndexFind(PsarcIndex *index, const char *name);
+int psarcIndexFindFolder(PsarcIndex *index, const char *folder, int *first);
+
+uint32_t psarcIndexEntryBlocks(PsarcIndex *index, PsarcIndexEntry *entry);
+uint32_t psarcIndexBlockLength(PsarcIndex *index, PsarcIndexEntry *entry, uint32_t block);
+uint32_t psarcIndexBlockStoredSize(PsarcIndex *index, PsarcIndexEntry *entry, uint32_t block);
+
+int psarcDecoderInit(PsarcDecoder *decoder, PsarcIndex *index);
+void psarcDecoderEnd(PsarcDecoder *decoder);
+int psarcDecodeBlock(PsarcDecoder *decoder, PsarcIndex *index, SceUID fd, PsarcIndexEntry *entry,
+                     uint32_t block, uint64_t offset, uint8_t *data);
+
+int psarcIndexFileOpen(PsarcIndex *index, PsarcIndexFile *file, PsarcIndexEntry *entry);
+int psarcIndexFileRead(PsarcIndexFile *file, void *data, SceSize size);
+SceOff psarcIndexFileSeek(PsarcIndexFile *file, SceOff offset, int whence);
+int psarcIndexFileClose(PsarcIndexFile *file);
+
+#endif
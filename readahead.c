@@ -0,0 +1,257 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <psp2/kernel/threadmgr.h>
+
+#include "core.h"
+#include "readahead.h"
+
+// A thread reads the file in order into a ring of buffers, so that the
+// next data is ready while the caller decompresses the current one. The
+// caller owns a buffer from one read until the next. Seeking stops the
+// thread, drops the queue and starts again at the new position.
+
+static int readAheadThread(SceSize args, void *argp) {
+  ReadAhead *ra = *(ReadAhead **)argp;
+
+  while (1) {
+    sceKernelWaitSema(ra->free_sema, 1, NULL);
+    if (ra->stop)
+      break;
+
+    ReadAheadBuffer *buffer = &ra->buffers[ra->n_write];
+    ra->n_write = (ra->n_write + 1) % READ_AHEAD_BUFFERS;
+
+    buffer->size = sceIoRead(ra->fd, buffer->data, READ_AHEAD_BUFFER_SIZE);
+    if (buffer->size <= 0)
+      ra->finished = 1;
+
+    sceKernelSignalSema(ra->full_sema, 1);
+
+    if (buffer->size <= 0)
+      break;
+  }
+
+  return sceKernelExitThread(0);
+}
+
+static void readAheadStop(ReadAhead *ra) {
+  ra->stop = 1;
+
+  if (ra->thid >= 0) {
+    sceKernelSignalSema(ra->free_sema, READ_AHEAD_BUFFERS);
+    sceKernelWaitThreadEnd(ra->thid, NULL, NULL);
+    sceKernelDeleteThread(ra->thid);
+    ra->thid = -1;
+  }
+
+  if (ra->free_sema >= 0)
+    sceKernelDeleteSema(ra->free_sema);
+  if (ra->full_sema >= 0)
+    sceKernelDeleteSema(ra->full_sema);
+
+  ra->free_sema = -1;
+  ra->full_sema = -1;
+}
+
+static int readAheadStart(ReadAhead *ra) {
+  ra->stop = 0;
+  ra->finished = 0;
+  ra->n_read = 0;
+  ra->n_write = 0;
+  ra->held = -1;
+  ra->ready = -1;
+  ra->skip = 0;
+  ra->end = 1;
+
+  // The free semaphore gets extra signals to wake up the thread on stop
+  ra->free_sema = sceKernelCreateSema("read_ahead_free", 0, READ_AHEAD_BUFFERS, 2 * READ_AHEAD_BUFFERS, NULL);
+  ra->full_sema = sceKernelCreateSema("read_ahead_full", 0, 0, READ_AHEAD_BUFFERS, NULL);
+  if (ra->free_sema < 0 || ra->full_sema < 0) {
+    int res = ra->free_sema < 0 ? ra->free_sema : ra->full_sema;
+    readAheadStop(ra);
+    return res;
+  }
+
+  ra->thid = sceKernelCreateThread("read_ahead_thread", (SceKernelThreadEntry)readAheadThread,
+                                   0x10000100, 0x4000, 0, 0, NULL);
+  if (ra->thid < 0) {
+    int res = ra->thid;
+    readAheadStop(ra);
+    return res;
+  }
+
+  ReadAhead *arg = ra;
+  sceKernelStartThread(ra->thid, sizeof(ReadAhead *), &arg);
+
+  return 0;
+}
+
+int readAheadOpen(ReadAhead *ra, const char *file) {
+  memset(ra, 0, sizeof(ReadAhead));
+  ra->thid = -1;
+  ra->free_sema = -1;
+  ra->full_sema = -1;
+
+  ra->fd = sceIoOpen(file, SCE_O_RDONLY, 0);
+  if (ra->fd < 0)
+    return ra->fd;
+
+  ra->data = memalign(4096, READ_AHEAD_BUFFERS * READ_AHEAD_BUFFER_SIZE);
+  if (!ra->data) {
+    sceIoClose(ra->fd);
+    ra->fd = -1;
+    return VITASHELL_ERROR_NO_MEMORY;
+  }
+
+  int i;
+  for (i = 0; i < READ_AHEAD_BUFFERS; i++)
+    ra->buffers[i].data = ra->data + i * READ_AHEAD_BUFFER_SIZE;
+
+  int res = readAheadStart(ra);
+  if (res < 0) {
+    readAheadClose(ra);
+    return res;
+  }
+
+  return 0;
+}
+
+// Give a buffer back to the thread
+static void readAheadRelease(ReadAhead *ra, int *index) {
+  if (*index >= 0) {
+    sceKernelSignalSema(ra->free_sema, 1);
+    *index = -1;
+  }
+}
+
+// Take the next filled buffer from the queue. Returns 1 if there is one,
+// 0 if it would have to wait and wait is not set, or the end result
+static int readAheadTake(ReadAhead *ra, int wait) {
+  if (ra->ready < 0) {
+    if (wait)
+      sceKernelWaitSema(ra->full_sema, 1, NULL);
+    else if (sceKernelPollSema(ra->full_sema, 1) < 0)
+      return 0;
+
+    ra->ready = ra->n_read;
+    ra->n_read = (ra->n_read + 1) % READ_AHEAD_BUFFERS;
+    ra->skip = 0;
+  }
+
+  ReadAheadBuffer *buffer = &ra->buffers[ra->ready];
+  if (buffer->size <= 0) {
+    ra->end = buffer->size;
+    readAheadRelease(ra, &ra->ready);
+    return ra->end;
+  }
+
+  return 1;
+}
+
+int readAheadRead(ReadAhead *ra, const void **data) {
+  readAheadRelease(ra, &ra->held);
+
+  if (ra->end <= 0)
+    return ra->end;
+
+  int res = readAheadTake(ra, 1);
+  if (res <= 0)
+    return res;
+
+  ReadAheadBuffer *buffer = &ra->buffers[ra->ready];
+  int size = buffer->size - ra->skip;
+  *data = buffer->data + ra->skip;
+
+  ra->held = ra->ready;
+  ra->ready = -1;
+  ra->position += size;
+
+  return size;
+}
+
+// Skip data that was already read ahead, and seek past the rest
+int64_t readAheadSkip(ReadAhead *ra, int64_t request) {
+  readAheadRelease(ra, &ra->held);
+
+  int64_t skipped = 0;
+
+  while (request > 0 && ra->end > 0 && readAheadTake(ra, 0) > 0) {
+    ReadAheadBuffer *buffer = &ra->buffers[ra->ready];
+    int available = buffer->size - ra->skip;
+
+    if (request < available) {
+      ra->skip += request;
+      skipped += request;
+      request = 0;
+      break;
+    }
+
+    skipped += available;
+    request -= available;
+    readAheadRelease(ra, &ra->ready);
+  }
+
+  ra->position += skipped;
+
+  if (request > 0 && ra->end > 0) {
+    int64_t res = readAheadSeek(ra, ra->position + request, SCE_SEEK_SET);
+    if (res < 0)
+      return skipped > 0 ? skipped : res;
+
+    skipped += request;
+  }
+
+  return skipped;
+}
+
+int64_t readAheadSeek(ReadAhead *ra, int64_t offset, int whence) {
+  readAheadStop(ra);
+
+  if (whence == SCE_SEEK_CUR) {
+    offset += ra->position;
+    whence = SCE_SEEK_SET;
+  }
+
+  int64_t res = sceIoLseek(ra->fd, offset, whence);
+  if (res >= 0)
+    ra->position = res;
+  else
+    sceIoLseek(ra->fd, ra->position, SCE_SEEK_SET);
+
+  // Without the thread there is nothing left to read, later reads fail
+  int ret = readAheadStart(ra);
+  if (ret < 0) {
+    ra->end = ret;
+    return ret;
+  }
+
+  return res;
+}
+
+void readAheadClose(ReadAhead *ra) {
+  readAheadStop(ra);
+
+  if (ra->fd >= 0)
+    sceIoClose(ra->fd);
+  if (ra->data)
+    free(ra->data);
+
+  ra->fd = -1;
+  ra->data = NULL;
+}
@@ -0,0 +1,58 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __READAHEAD_H__
+#define __READAHEAD_H__
+
+#include "file.h"
+
+#define READ_AHEAD_BUFFERS 4
+#define READ_AHEAD_BUFFER_SIZE (256 * 1024)
+
+typedef struct {
+  uint8_t *data;
+  int size; // Bytes read, 0 at the end of the file, < 0 on error
+} ReadAheadBuffer;
+
+typedef struct {
+  SceUID fd;
+  SceUID thid;
+  SceUID free_sema;
+  SceUID full_sema;
+  volatile int stop;
+  volatile int finished; // The thread has queued the end of the file
+
+  uint8_t *data;
+  ReadAheadBuffer buffers[READ_AHEAD_BUFFERS];
+  int n_read;
+  int n_write;
+
+  int held;  // Buffer handed out by the last read, -1 if none
+  int ready; // Filled buffer taken from the queue but not handed out, -1 if none
+  int skip;  // Bytes of the ready buffer that were skipped
+  int end;   // 1 until the end of the file or an error was read
+  uint64_t position;
+} ReadAhead;
+
+int readAheadOpen(ReadAhead *ra, const char *file);
+int readAheadRead(ReadAhead *ra, const void **data);
+int64_t readAheadSkip(ReadAhead *ra, int64_t request);
+int64_t readAheadSeek(ReadAhead *ra, int64_t offset, int whence);
+void readAheadClose(ReadAhead *ra);
+
+#endif
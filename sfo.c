@@ -28,80 +28,6 @@
 #include "utils.h"
 #include "sfo.h"
 
-int getSfoValue(void *buffer, const char *name, uint32_t *value) {
-  SfoHeader *header = (SfoHeader *)buffer;
-  SfoEntry *entries = (SfoEntry *)((uint32_t)buffer + sizeof(SfoHeader));
-
-  if (header->magic != SFO_MAGIC)
-    return VITASHELL_ERROR_INVALID_MAGIC;
-
-  int i;
-  for (i = 0; i < header->count; i++) {
-    if (strcmp(buffer + header->keyofs + entries[i].nameofs, name) == 0) {
-      *value = *(uint32_t *)(buffer + header->valofs + entries[i].dataofs);
-      return 0;
-    }
-  }
-
-  return VITASHELL_ERROR_NOT_FOUND;
-}
-
-int getSfoString(void *buffer, const char *name, char *string, int length) {
-  SfoHeader *header = (SfoHeader *)buffer;
-  SfoEntry *entries = (SfoEntry *)((uint32_t)buffer + sizeof(SfoHeader));
-
-  if (header->magic != SFO_MAGIC)
-    return VITASHELL_ERROR_INVALID_MAGIC;
-
-  int i;
-  for (i = 0; i < header->count; i++) {
-    if (strcmp(buffer + header->keyofs + entries[i].nameofs, name) == 0) {
-      memset(string, 0, length);
-      strncpy(string, buffer + header->valofs + entries[i].dataofs, length);
-      string[length - 1] = '\0';
-      return 0;
-    }
-  }
-
-  return VITASHELL_ERROR_NOT_FOUND;
-}
-
-int setSfoValue(void *buffer, const char *name, uint32_t value) {
-  SfoHeader *header = (SfoHeader *)buffer;
-  SfoEntry *entries = (SfoEntry *)((uint32_t)buffer + sizeof(SfoHeader));
-
-  if (header->magic != SFO_MAGIC)
-    return VITASHELL_ERROR_INVALID_MAGIC;
-
-  int i;
-  for (i = 0; i < header->count; i++) {
-    if (strcmp(buffer + header->keyofs + entries[i].nameofs, name) == 0) {
-      *(uint32_t *)(buffer + header->valofs + entries[i].dataofs) = value;
-      return 0;
-    }
-  }
-
-  return VITASHELL_ERROR_NOT_FOUND;
-}
-
-int setSfoString(void *buffer, const char *name, const char *string) {
-  SfoHeader *header = (SfoHeader *)buffer;
-  SfoEntry *entries = (SfoEntry *)((uint32_t)buffer + sizeof(SfoHeader));
-
-  if (header->magic != SFO_MAGIC)
-    return VITASHELL_ERROR_INVALID_MAGIC;
-
-  int i;
-  for (i = 0; i < header->count; i++) {
-    if (strcmp(buffer + header->keyofs + entries[i].nameofs, name) == 0) {
-      strcpy(buffer + header->valofs + entries[i].dataofs, string);
-      return 0;
-    }
-  }
-
-  return VITASHELL_ERROR_NOT_FOUND;
-}
-
 int SFOReader(const char *file) {
   uint8_t *buffer = memalign(4096, BIG_BUFFER_SIZE);
   if (!buffer)
@@ -25,6 +25,7 @@
 #include "language.h"
 #include "utils.h"
 #include "bm.h"
+#include "iotrace.h"
 
 SceCtrlData pad;
 Pad old_pad, current_pad, pressed_pad, released_pad, hold_pad, hold2_pad;
@@ -88,7 +89,7 @@ void infoDialog(const char *msg, ...) {
   setDialogStep(DIALOG_STEP_INFO);
 }
 
-int checkMemoryCardFreeSpace(const char *path, uint64_t size) {
+uint64_t getFreeSpaceShortage(const char *path, uint64_t size) {
   char device[8];
   uint64_t free_size = 0, max_size = 0, extra_space = 0;
   
@@ -112,11 +113,20 @@ int checkMemoryCardFreeSpace(const char *path, uint64_t size) {
     max_size = info.max_size;
   }
 
-  if (size >= (free_size + extra_space)) {
+  if (size >= (free_size + extra_space))
+    return MAX(size - (free_size + extra_space), 1);
+
+  return 0;
+}
+
+int checkMemoryCardFreeSpace(const char *path, uint64_t size) {
+  uint64_t shortage = getFreeSpaceShortage(path, size);
+
+  if (shortage > 0) {
     closeWaitDialog();
 
     char size_string[16];
-    getSizeString(size_string, size - (free_size + extra_space));
+    getSizeString(size_string, shortage);
     infoDialog(language_container[NO_SPACE_ERROR], size_string);
 
     return 1;
@@ -196,6 +206,10 @@ void powerUnlock() {
   lock_power--;
   if (lock_power < 0)
     lock_power = 0;
+
+  // All operations have ended
+  if (lock_power == 0)
+    IOTRACE_DUMP("operation");
 }
 
 void readPad() {
@@ -329,34 +343,6 @@ int holdButtons(SceCtrlData *pad, uint32_t buttons, uint64_t time) {
   return 0;
 }
 
-int hasEndSlash(const char *path) {
-  return path[strlen(path) - 1] == '/';
-}
-
-int removeEndSlash(char *path) {
-  int len = strlen(path);
-
-  if (path[len - 1] == '/') {
-    path[len - 1] = '\0';
-    return 1;
-  }
-
-  return 0;
-}
-
-int addEndSlash(char *path) {
-  int len = strlen(path);
-  if (len < MAX_PATH_LENGTH - 2) {
-    if (path[len - 1] != '/') {
-      path[len] = '/';
-      path[len + 1] = '\0';
-      return 1;
-    }
-  }
-
-  return 0;
-}
-
 void getSizeString(char string[16], uint64_t size) {
   double double_size = (double)size;
 
@@ -370,36 +356,6 @@ void getSizeString(char string[16], uint64_t size) {
   snprintf(string, 16, "%.*f %s", (i == 0) ? 0 : 2, double_size, units[i]);
 }
 
-void convertUtcToLocalTime(SceDateTime *time_local, SceDateTime *time_utc) {
-  // sceRtcGetTick and other sceRtc functions fails with year > 9999
-  int year_utc = time_utc->year;
-  int year_delta = year_utc < 9999 ? 0 : year_utc - 9998;
-  time_utc->year -= year_delta;
-
-  SceRtcTick tick;
-  sceRtcGetTick(time_utc, &tick);
-  time_utc->year = year_utc;
-
-  sceRtcConvertUtcToLocalTime(&tick, &tick);
-  sceRtcSetTick(time_local, &tick);  
-  time_local->year += year_delta;
-}
-
-void convertLocalTimeToUtc(SceDateTime *time_utc, SceDateTime *time_local) {
-  // sceRtcGetTick and other sceRtc functions fails with year > 9999
-  int year_local = time_local->year;
-  int year_delta = year_local < 9999 ? 0 : year_local - 9998;
-  time_local->year -= year_delta;
-
-  SceRtcTick tick;
-  sceRtcGetTick(time_local, &tick);
-  time_local->year = year_local;
-
-  sceRtcConvertLocalTimeToUtc(&tick, &tick);
-  sceRtcSetTick(time_utc, &tick);  
-  time_utc->year += year_delta;
-}
-
 void getDateString(char string[24], int date_format, SceDateTime *time) {
   SceDateTime time_local;
   convertUtcToLocalTime(&time_local, time);
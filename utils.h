@@ -26,6 +26,7 @@
 #include <vita2d.h>          // vita2d_texture
 
 #include "main.h"
+#include "core.h"
 
 // Alignment helpers for UI rendering
 #define ALIGN_CENTER(a, b)  (((a) - (b)) / 2)
@@ -84,6 +85,7 @@ void errorDialog(int error);
 void infoDialog(const char *msg, ...);
 
 // Storage helpers
+uint64_t getFreeSpaceShortage(const char *path, uint64_t size);
 int checkMemoryCardFreeSpace(const char *path, uint64_t size);
 int getPartitionFreeSpace(const char *device, uint64_t *free_size, uint64_t *max_size);
 uint32_t getFreeSpaceColor(uint64_t free_size, uint64_t max_size);
@@ -98,17 +100,10 @@ void setEnterButton(int circle);
 void readPad(void);
 int holdButtons(SceCtrlData *data, uint32_t buttons, uint64_t time);
 
-// Path helpers
-int hasEndSlash(const char *path);
-int removeEndSlash(char *path);
-int addEndSlash(char *path);
-
 // File size formatting
 void getSizeString(char string[20], uint64_t size);
 
 // Time conversion and formatting
-void convertUtcToLocalTime(SceDateTime *time_local, SceDateTime *time_utc);
-void convertLocalTimeToUtc(SceDateTime *time_utc, SceDateTime *time_local);
 void getDateString(char string[24], int date_format, SceDateTime *time);
 void getTimeString(char string[16], int time_format, SceDateTime *time);
 
@@ -36,6 +36,8 @@ typedef struct {
   int select_button;
   int disable_autoupdate;
   int disable_warning;
+  int background_jobs;
+  int skip_identical;
 } VitaShellConfig;
 
 #endif
@@ -29,6 +29,8 @@ enum VitaShellErrors {
   VITASHELL_ERROR_ILLEGAL_ADDR            = 0xF0010006,
   VITASHELL_ERROR_ALREADY_RUNNING         = 0xF0010007,
   VITASHELL_ERROR_NOT_RUNNING             = 0xF0010008,
+  VITASHELL_ERROR_NO_SPACE                = 0xF0010009,
+  VITASHELL_ERROR_CRC_MISMATCH            = 0xF001000A,
 
   VITASHELL_ERROR_SRC_AND_DST_IDENTICAL   = 0xF0020000,
   VITASHELL_ERROR_DST_IS_SUBFOLDER_OF_SRC = 0xF0020001,
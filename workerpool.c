@@ -0,0 +1,140 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "core.h"
+#include "workerpool.h"
+
+// Each worker thread fills its own ring of slots in order, and the calling
+// thread drains the rings in the same order. The free semaphore counts the
+// slots the worker may fill, the full semaphore the slots the caller may
+// drain. Stopping the pool gives the free semaphore extra signals, so that
+// a worker waiting for a free slot wakes up and sees the stop flag.
+
+static WorkerRing *getWorkerRing(WorkerPool *pool, int i) {
+  return (WorkerRing *)(pool->workers + i * pool->worker_size);
+}
+
+// The module fields of the workers have to be set up before, since the
+// threads start right away. On error the workers started so far keep
+// running until workerPoolStop().
+int workerPoolStart(WorkerPool *pool, const char *name, SceKernelThreadEntry entry,
+                    void *workers, int worker_size, int n_workers, int n_slots) {
+  char object_name[32];
+  int i;
+
+  pool->stop = 0;
+  pool->workers = (uint8_t *)workers;
+  pool->worker_size = worker_size;
+  pool->n_workers = n_workers;
+
+  for (i = 0; i < n_workers; i++) {
+    WorkerRing *ring = getWorkerRing(pool, i);
+
+    ring->stop = &pool->stop;
+    ring->n_slots = n_slots;
+    ring->n_write = 0;
+    ring->n_read = 0;
+    ring->thid = -1;
+
+    snprintf(object_name, sizeof(object_name), "%s_free", name);
+    ring->free_sema = sceKernelCreateSema(object_name, 0, n_slots, 2 * n_slots, NULL);
+    snprintf(object_name, sizeof(object_name), "%s_full", name);
+    ring->full_sema = sceKernelCreateSema(object_name, 0, 0, n_slots, NULL);
+
+    if (ring->free_sema < 0 || ring->full_sema < 0) {
+      pool->n_workers = i + 1;
+      return ring->free_sema < 0 ? ring->free_sema : ring->full_sema;
+    }
+
+    snprintf(object_name, sizeof(object_name), "%s_thread", name);
+    ring->thid = sceKernelCreateThread(object_name, entry, 0x10000100, 0x10000, 0, 0, NULL);
+    if (ring->thid < 0) {
+      pool->n_workers = i + 1;
+      return ring->thid;
+    }
+
+    sceKernelStartThread(ring->thid, sizeof(WorkerRing *), &ring);
+  }
+
+  return 0;
+}
+
+void workerPoolStop(WorkerPool *pool) {
+  pool->stop = 1;
+
+  int i;
+  for (i = 0; i < pool->n_workers; i++) {
+    WorkerRing *ring = getWorkerRing(pool, i);
+
+    if (ring->thid >= 0) {
+      sceKernelSignalSema(ring->free_sema, ring->n_slots);
+      sceKernelWaitThreadEnd(ring->thid, NULL, NULL);
+      sceKernelDeleteThread(ring->thid);
+    }
+
+    if (ring->free_sema >= 0)
+      sceKernelDeleteSema(ring->free_sema);
+    if (ring->full_sema >= 0)
+      sceKernelDeleteSema(ring->full_sema);
+  }
+}
+
+// Number of user cores the calling thread may run on. The workers are
+// created without an affinity mask and share these cores
+int workerPoolCores(void) {
+  int mask = sceKernelGetThreadCpuAffinityMask(0);
+  if (mask <= 0)
+    mask = SCE_KERNEL_CPU_MASK_USER_ALL;
+
+  int cores = 0;
+  mask &= SCE_KERNEL_CPU_MASK_USER_ALL;
+  while (mask) {
+    cores += mask & 1;
+    mask >>= 1;
+  }
+
+  return cores > 0 ? cores : 1;
+}
+
+// Worker side: waits for a free slot, -1 if the pool is stopping
+int workerRingNextFree(WorkerRing *ring) {
+  sceKernelWaitSema(ring->free_sema, 1, NULL);
+  if (*ring->stop)
+    return -1;
+
+  int slot = ring->n_write;
+  ring->n_write = (ring->n_write + 1) % ring->n_slots;
+  return slot;
+}
+
+void workerRingPut(WorkerRing *ring) {
+  sceKernelSignalSema(ring->full_sema, 1);
+}
+
+// Caller side: waits for the next filled slot
+int workerRingNextFull(WorkerRing *ring) {
+  sceKernelWaitSema(ring->full_sema, 1, NULL);
+
+  int slot = ring->n_read;
+  ring->n_read = (ring->n_read + 1) % ring->n_slots;
+  return slot;
+}
+
+void workerRingRelease(WorkerRing *ring) {
+  sceKernelSignalSema(ring->free_sema, 1);
+}
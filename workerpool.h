@@ -0,0 +1,53 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __WORKERPOOL_H__
+#define __WORKERPOOL_H__
+
+#include <psp2/kernel/threadmgr.h>
+
+// Every worker struct starts with a WorkerRing
+typedef struct {
+  volatile int *stop;
+  int n_slots;
+  int n_write; // Next slot filled by the worker
+  int n_read;  // Next slot drained by the calling thread
+  SceUID free_sema;
+  SceUID full_sema;
+  SceUID thid;
+} WorkerRing;
+
+typedef struct {
+  volatile int stop;
+  uint8_t *workers;
+  int worker_size;
+  int n_workers;
+} WorkerPool;
+
+int workerPoolStart(WorkerPool *pool, const char *name, SceKernelThreadEntry entry,
+                    void *workers, int worker_size, int n_workers, int n_slots);
+void workerPoolStop(WorkerPool *pool);
+
+int workerPoolCores(void);
+
+int workerRingNextFree(WorkerRing *ring);
+void workerRingPut(WorkerRing *ring);
+int workerRingNextFull(WorkerRing *ring);
+void workerRingRelease(WorkerRing *ring);
+
+#endif
@@ -0,0 +1,219 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <psp2/kernel/threadmgr.h>
+
+#include "core.h"
+#include "zipextract.h"
+#include "workerpool.h"
+
+// Entries are handed to the workers round robin. Every worker inflates its
+// entries one after another into its own ring of slots, and the calling
+// thread writes the slots out in list order. Since the writer always drains
+// the worker of the entry it is waiting for, a full ring can not block it.
+
+typedef struct {
+  int entry;
+  int size; // Size of the data, 0 at the end of the entry, < 0 on error
+  uint8_t *buffer;
+} ZipExtractSlot;
+
+typedef struct {
+  WorkerRing ring;
+  ZipIndex *index;
+  ZipIndexEntry **entries;
+  int count;
+  int first;
+  int step;
+  ZipExtractSlot slots[ZIP_EXTRACT_SLOTS];
+} ZipExtractWorker;
+
+static int zipExtractWorkerThread(SceSize args, void *argp) {
+  ZipExtractWorker *worker = *(ZipExtractWorker **)argp;
+
+  ZipIndexFile file;
+  memset(&file, 0, sizeof(ZipIndexFile));
+  file.fd = -1;
+
+  int i;
+  for (i = worker->first; i < worker->count; i += worker->step) {
+    int res;
+    if (file.fd < 0)
+      res = zipIndexFileOpen(worker->index, &file, worker->entries[i]);
+    else
+      res = zipIndexFileReopen(&file, worker->entries[i]);
+
+    while (1) {
+      int n = workerRingNextFree(&worker->ring);
+      if (n < 0)
+        goto exit;
+
+      ZipExtractSlot *slot = &worker->slots[n];
+
+      int size = res < 0 ? res : zipIndexFileRead(&file, slot->buffer, TRANSFER_SIZE);
+      slot->entry = i;
+      slot->size = size;
+
+      workerRingPut(&worker->ring);
+
+      if (size <= 0)
+        break;
+    }
+  }
+
+exit:
+  if (file.fd >= 0)
+    zipIndexFileClose(&file);
+
+  return sceKernelExitThread(0);
+}
+
+static int zipExtractWriteEntry(ZipExtractWorker *worker, int entry, const char *dst_path,
+                                ZipExtractHandler *handler, FileProcessParam *param) {
+  // Without a path the data is only decoded and checked
+  SceUID fddst = -1;
+  if (dst_path[0] != '\0') {
+    fddst = sceIoOpen(dst_path, SCE_O_WRONLY | SCE_O_CREAT | SCE_O_TRUNC, 0777);
+    if (fddst < 0)
+      return fddst;
+  }
+
+  uint64_t offset = 0;
+  int res = 1;
+
+  while (1) {
+    ZipExtractSlot *slot = &worker->slots[workerRingNextFull(&worker->ring)];
+
+    int size = slot->entry == entry ? slot->size : VITASHELL_ERROR_INTERNAL;
+
+    int ret = 1;
+    if (size >= 0 && handler->checkData)
+      ret = handler->checkData(worker->entries[entry], offset, slot->buffer, size, handler->argp);
+
+    int written = (size > 0 && ret > 0 && fddst >= 0) ? sceIoWrite(fddst, slot->buffer, size) : 0;
+
+    workerRingRelease(&worker->ring);
+
+    if (size < 0) {
+      res = size;
+      break;
+    }
+
+    if (ret <= 0) {
+      res = ret;
+      break;
+    }
+
+    if (size == 0)
+      break;
+
+    if (written < 0) {
+      res = written;
+      break;
+    }
+
+    offset += size;
+
+    if (param) {
+      if (param->value)
+        (*param->value) += size;
+
+      if (param->SetProgress)
+        param->SetProgress(param->value ? *param->value : 0, param->max);
+
+      if (param->cancelHandler && param->cancelHandler()) {
+        res = 0;
+        break;
+      }
+    }
+  }
+
+  if (fddst >= 0) {
+    sceIoClose(fddst);
+
+    if (res <= 0)
+      sceIoRemove(dst_path);
+  }
+
+  if (res <= 0)
+    return res;
+
+  if (param && param->items)
+    (*param->items)++;
+
+  return 1;
+}
+
+int zipExtractEntries(ZipIndex *index, ZipIndexEntry **entries, int count, int n_workers,
+                      ZipExtractHandler *handler, FileProcessParam *param) {
+  if (count <= 0)
+    return 1;
+
+  if (n_workers > ZIP_EXTRACT_MAX_WORKERS)
+    n_workers = ZIP_EXTRACT_MAX_WORKERS;
+  if (n_workers > count)
+    n_workers = count;
+  if (n_workers < 1)
+    n_workers = 1;
+
+  uint8_t *buffers = memalign(4096, n_workers * ZIP_EXTRACT_SLOTS * TRANSFER_SIZE);
+  if (!buffers)
+    return VITASHELL_ERROR_NO_MEMORY;
+
+  ZipExtractWorker workers[ZIP_EXTRACT_MAX_WORKERS];
+  int i, j;
+
+  for (i = 0; i < n_workers; i++) {
+    ZipExtractWorker *worker = &workers[i];
+    memset(worker, 0, sizeof(ZipExtractWorker));
+
+    worker->index = index;
+    worker->entries = entries;
+    worker->count = count;
+    worker->first = i;
+    worker->step = n_workers;
+
+    for (j = 0; j < ZIP_EXTRACT_SLOTS; j++)
+      worker->slots[j].buffer = buffers + (i * ZIP_EXTRACT_SLOTS + j) * TRANSFER_SIZE;
+  }
+
+  WorkerPool pool;
+  int res = workerPoolStart(&pool, "zip_extract", (SceKernelThreadEntry)zipExtractWorkerThread,
+                            workers, sizeof(ZipExtractWorker), n_workers, ZIP_EXTRACT_SLOTS);
+  if (res >= 0)
+    res = 1;
+
+  // Write the entries in list order
+  char dst_path[MAX_PATH_LENGTH];
+
+  for (i = 0; i < count && res > 0; i++) {
+    int ret = handler->getPath(entries[i], dst_path, handler->argp);
+    if (ret < 0) {
+      res = ret;
+      break;
+    }
+
+    res = zipExtractWriteEntry(&workers[i % n_workers], i, dst_path, handler, param);
+  }
+
+  workerPoolStop(&pool);
+
+  free(buffers);
+
+  return res;
+}
@@ -0,0 +1,559 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <limits.h>
+#include <stdint.h>
+
+#include "core.h"
+#include "zipindex.h"
+
+#define ZIP_END_SIZE 22
+#define ZIP_END_SEARCH_SIZE (ZIP_END_SIZE + 0xFFFF)
+#define ZIP64_END_LOCATOR_SIZE 20
+#define ZIP64_END_SIZE 56
+#define ZIP_CENTRAL_HEADER_SIZE 46
+#define ZIP_LOCAL_HEADER_SIZE 30
+#define ZIP64_EXTRA_ID 0x0001
+#define ZIP_INDEX_MAX_BUCKETS (1 << 20)
+
+static uint16_t readLe16(const uint8_t *p) {
+  return p[0] | (p[1] << 8);
+}
+
+static uint32_t readLe32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t readLe64(const uint8_t *p) {
+  return readLe32(p) | ((uint64_t)readLe32(p + 4) << 32);
+}
+
+static uint32_t hashName(const char *name) {
+  uint32_t hash = 2166136261u;
+
+  while (*name) {
+    char c = *name++;
+    if (c >= 'A' && c <= 'Z')
+      c += 'a' - 'A';
+
+    hash = (hash ^ (uint8_t)c) * 16777619u;
+  }
+
+  return hash;
+}
+
+static int readAt(SceUID fd, uint64_t offset, void *data, int size) {
+  if (sceIoLseek(fd, offset, SCE_SEEK_SET) < 0)
+    return VITASHELL_ERROR_INTERNAL;
+
+  int read = sceIoRead(fd, data, size);
+  if (read < 0)
+    return read;
+
+  return read == size ? 0 : VITASHELL_ERROR_INVALID_MAGIC;
+}
+
+// The values come from the file and are used for allocations, so they
+// must fit in it before anything is read
+static int checkCentralDirectory(uint64_t file_size, uint64_t cd_offset, uint64_t cd_size, uint64_t count) {
+  if (cd_offset > file_size || cd_size > file_size - cd_offset || cd_size > INT_MAX)
+    return VITASHELL_ERROR_INVALID_MAGIC;
+
+  if (count == 0 || count > cd_size / ZIP_CENTRAL_HEADER_SIZE)
+    return VITASHELL_ERROR_INVALID_MAGIC;
+
+  return 0;
+}
+
+// Locate the central directory through the (zip64) end of central directory record
+static int findCentralDirectory(SceUID fd, uint64_t *cd_offset, uint64_t *cd_size, uint64_t *count) {
+  SceOff file_size = sceIoLseek(fd, 0, SCE_SEEK_END);
+  if (file_size < ZIP_END_SIZE)
+    return VITASHELL_ERROR_INVALID_MAGIC;
+
+  int size = file_size < ZIP_END_SEARCH_SIZE ? (int)file_size : ZIP_END_SEARCH_SIZE;
+  uint64_t start = file_size - size;
+
+  uint8_t *buf = malloc(size);
+  if (!buf)
+    return VITASHELL_ERROR_NO_MEMORY;
+
+  int res = readAt(fd, start, buf, size);
+  if (res < 0) {
+    free(buf);
+    return res;
+  }
+
+  // The comment is at most 64 KiB, search backwards for the signature
+  int pos;
+  for (pos = size - ZIP_END_SIZE; pos >= 0; pos--) {
+    if (readLe32(buf + pos) == ZIP_END_MAGIC)
+      break;
+  }
+
+  if (pos < 0) {
+    free(buf);
+    return VITASHELL_ERROR_INVALID_MAGIC;
+  }
+
+  uint8_t *end = buf + pos;
+
+  // Multi volume archives are left to libarchive
+  if (readLe16(end + 4) != 0 || readLe16(end + 6) != 0) {
+    free(buf);
+    return VITASHELL_ERROR_INVALID_TYPE;
+  }
+
+  *count = readLe16(end + 10);
+  *cd_size = readLe32(end + 12);
+  *cd_offset = readLe32(end + 16);
+
+  uint64_t end_offset = start + pos;
+
+  free(buf);
+
+  if (*count != 0xFFFF && *cd_size != 0xFFFFFFFF && *cd_offset != 0xFFFFFFFF)
+    return checkCentralDirectory(file_size, *cd_offset, *cd_size, *count);
+
+  // Zip64
+  if (end_offset < ZIP64_END_LOCATOR_SIZE)
+    return VITASHELL_ERROR_INVALID_MAGIC;
+
+  uint8_t locator[ZIP64_END_LOCATOR_SIZE];
+  res = readAt(fd, end_offset - ZIP64_END_LOCATOR_SIZE, locator, sizeof(locator));
+  if (res < 0)
+    return res;
+
+  if (readLe32(locator) != ZIP64_END_LOCATOR_MAGIC)
+    return VITASHELL_ERROR_INVALID_MAGIC;
+
+  uint8_t end64[ZIP64_END_SIZE];
+  res = readAt(fd, readLe64(locator + 8), end64, sizeof(end64));
+  if (res < 0)
+    return res;
+
+  if (readLe32(end64) != ZIP64_END_MAGIC)
+    return VITASHELL_ERROR_INVALID_MAGIC;
+
+  *count = readLe64(end64 + 32);
+  *cd_size = readLe64(end64 + 40);
+  *cd_offset = readLe64(end64 + 48);
+
+  return checkCentralDirectory(file_size, *cd_offset, *cd_size, *count);
+}
+
+static void parseZip64Extra(ZipIndexEntry *entry, const uint8_t *extra, int extra_length) {
+  while (extra_length >= 4) {
+    uint16_t id = readLe16(extra);
+    uint16_t size = readLe16(extra + 2);
+
+    if (size > extra_length - 4)
+      break;
+
+    if (id == ZIP64_EXTRA_ID) {
+      const uint8_t *p = extra + 4;
+      const uint8_t *p_end = p + size;
+
+      // Only the fields that overflowed are present, in this order
+      if (entry->uncompressed_size == 0xFFFFFFFF && p + 8 <= p_end) {
+        entry->uncompressed_size = readLe64(p);
+        p += 8;
+      }
+
+      if (entry->compressed_size == 0xFFFFFFFF && p + 8 <= p_end) {
+        entry->compressed_size = readLe64(p);
+        p += 8;
+      }
+
+      if (entry->local_offset == 0xFFFFFFFF && p + 8 <= p_end)
+        entry->local_offset = readLe64(p);
+
+      return;
+    }
+
+    extra += 4 + size;
+    extra_length -= 4 + size;
+  }
+}
+
+int zipIndexOpen(ZipIndex *index, const char *file) {
+  memset(index, 0, sizeof(ZipIndex));
+
+  SceUID fd = sceIoOpen(file, SCE_O_RDONLY, 0);
+  if (fd < 0)
+    return fd;
+
+  uint64_t cd_offset = 0, cd_size = 0, count = 0;
+  int res = findCentralDirectory(fd, &cd_offset, &cd_size, &count);
+  if (res < 0) {
+    sceIoClose(fd);
+    return res;
+  }
+
+  if (count > SIZE_MAX / sizeof(ZipIndexEntry)) {
+    sceIoClose(fd);
+    return VITASHELL_ERROR_NO_MEMORY;
+  }
+
+  // Read the whole central directory at once
+  uint8_t *cd = malloc(cd_size);
+  if (!cd) {
+    sceIoClose(fd);
+    return VITASHELL_ERROR_NO_MEMORY;
+  }
+
+  res = readAt(fd, cd_offset, cd, cd_size);
+  sceIoClose(fd);
+
+  if (res < 0) {
+    free(cd);
+    return res;
+  }
+
+  index->entries = malloc(count * sizeof(ZipIndexEntry));
+  index->names = malloc(cd_size);
+  index->n_buckets = 1;
+  while (index->n_buckets < count && index->n_buckets < ZIP_INDEX_MAX_BUCKETS)
+    index->n_buckets <<= 1;
+  index->buckets = malloc(index->n_buckets * sizeof(ZipIndexEntry *));
+
+  if (!index->entries || !index->names || !index->buckets) {
+    free(cd);
+    zipIndexClose(index);
+    return VITASHELL_ERROR_NO_MEMORY;
+  }
+
+  memset(index->buckets, 0, index->n_buckets * sizeof(ZipIndexEntry *));
+
+  uint8_t *p = cd;
+  uint8_t *p_end = cd + cd_size;
+  char *names = index->names;
+
+  uint64_t i;
+  for (i = 0; i < count; i++) {
+    if (p + ZIP_CENTRAL_HEADER_SIZE > p_end || readLe32(p) != ZIP_CENTRAL_HEADER_MAGIC) {
+      free(cd);
+      zipIndexClose(index);
+      return VITASHELL_ERROR_INVALID_MAGIC;
+    }
+
+    uint16_t name_length = readLe16(p + 28);
+    uint16_t extra_length = readLe16(p + 30);
+    uint16_t comment_length = readLe16(p + 32);
+
+    uint8_t *next = p + ZIP_CENTRAL_HEADER_SIZE + name_length + extra_length + comment_length;
+    if (next > p_end) {
+      free(cd);
+      zipIndexClose(index);
+      return VITASHELL_ERROR_INVALID_MAGIC;
+    }
+
+    // Folders can not be opened
+    if (name_length > 0 && p[ZIP_CENTRAL_HEADER_SIZE + name_length - 1] != '/') {
+      ZipIndexEntry *entry = &index->entries[index->count++];
+      entry->flags = readLe16(p + 8);
+      entry->method = readLe16(p + 10);
+      entry->crc = readLe32(p + 16);
+      entry->compressed_size = readLe32(p + 20);
+      entry->uncompressed_size = readLe32(p + 24);
+      entry->local_offset = readLe32(p + 42);
+      parseZip64Extra(entry, p + ZIP_CENTRAL_HEADER_SIZE + name_length, extra_length);
+
+      entry->name = names;
+      memcpy(names, p + ZIP_CENTRAL_HEADER_SIZE, name_length);
+      names[name_length] = '\0';
+      names += name_length + 1;
+    }
+
+    p = next;
+  }
+
+  free(cd);
+
+  // Link backwards, so that the first of duplicate names is found, like
+  // with a linear header scan
+  int j;
+  for (j = index->count - 1; j >= 0; j--) {
+    ZipIndexEntry *entry = &index->entries[j];
+    uint32_t bucket = hashName(entry->name) & (index->n_buckets - 1);
+    entry->next = index->buckets[bucket];
+    index->buckets[bucket] = entry;
+  }
+
+  strncpy(index->file, file, MAX_PATH_LENGTH - 1);
+  index->file[MAX_PATH_LENGTH - 1] = '\0';
+
+  return 0;
+}
+
+void zipIndexClose(ZipIndex *index) {
+  if (index->entries)
+    free(index->entries);
+  if (index->names)
+    free(index->names);
+  if (index->buckets)
+    free(index->buckets);
+
+  memset(index, 0, sizeof(ZipIndex));
+}
+
+ZipIndexEntry *zipIndexFind(ZipIndex *index, const char *name) {
+  if (!index->buckets)
+    return NULL;
+
+  ZipIndexEntry *entry = index->buckets[hashName(name) & (index->n_buckets - 1)];
+
+  while (entry) {
+    if (strcasecmp(entry->name, name) == 0)
+      return entry;
+
+    entry = entry->next;
+  }
+
+  return NULL;
+}
+
+int zipIndexEntrySupported(ZipIndexEntry *entry) {
+  if (entry->flags & ZIP_FLAG_ENCRYPTED)
+    return 0;
+
+  return entry->method == ZIP_METHOD_STORE || entry->method == ZIP_METHOD_DEFLATE;
+}
+
+// Position the file at the data of an entry and reset the decompressor
+static int zipIndexFileStart(ZipIndexFile *file, ZipIndexEntry *entry) {
+  // The local header may have a different extra field than the central one
+  uint8_t header[ZIP_LOCAL_HEADER_SIZE];
+  int res = readAt(file->fd, entry->local_offset, header, sizeof(header));
+  if (res < 0 || readLe32(header) != ZIP_LOCAL_HEADER_MAGIC)
+    return res < 0 ? res : VITASHELL_ERROR_INVALID_MAGIC;
+
+  uint64_t data_offset = entry->local_offset + ZIP_LOCAL_HEADER_SIZE + readLe16(header + 26) + readLe16(header + 28);
+  if (sceIoLseek(file->fd, data_offset, SCE_SEEK_SET) < 0)
+    return VITASHELL_ERROR_INTERNAL;
+
+  if (entry->method == ZIP_METHOD_DEFLATE) {
+    memset(&file->stream, 0, sizeof(z_stream));
+    if (inflateInit2(&file->stream, -MAX_WBITS) != Z_OK)
+      return VITASHELL_ERROR_NO_MEMORY;
+  }
+
+  file->entry = entry;
+  file->in_remaining = entry->compressed_size;
+  file->out_remaining = entry->uncompressed_size;
+  file->crc = crc32(0L, Z_NULL, 0);
+  file->check_crc = 1;
+  file->data_offset = data_offset;
+
+  return 0;
+}
+
+int zipIndexFileOpen(ZipIndex *index, ZipIndexFile *file, ZipIndexEntry *entry) {
+  memset(file, 0, sizeof(ZipIndexFile));
+  file->fd = -1;
+
+  if (!zipIndexEntrySupported(entry))
+    return VITASHELL_ERROR_INVALID_TYPE;
+
+  SceUID fd = sceIoOpen(index->file, SCE_O_RDONLY, 0);
+  if (fd < 0)
+    return fd;
+
+  file->buffer = memalign(4096, TRANSFER_SIZE);
+  if (!file->buffer) {
+    sceIoClose(fd);
+    return VITASHELL_ERROR_NO_MEMORY;
+  }
+
+  file->fd = fd;
+
+  int res = zipIndexFileStart(file, entry);
+  if (res < 0) {
+    free(file->buffer);
+    sceIoClose(fd);
+    memset(file, 0, sizeof(ZipIndexFile));
+    file->fd = -1;
+    return res;
+  }
+
+  return 0;
+}
+
+// Switch an open file to another entry of the same archive, keeping the
+// file handle and buffer
+int zipIndexFileReopen(ZipIndexFile *file, ZipIndexEntry *entry) {
+  if (file->fd < 0)
+    return VITASHELL_ERROR_NOT_RUNNING;
+
+  if (!zipIndexEntrySupported(entry))
+    return VITASHELL_ERROR_INVALID_TYPE;
+
+  if (file->entry && file->entry->method == ZIP_METHOD_DEFLATE)
+    inflateEnd(&file->stream);
+  file->entry = NULL;
+
+  return zipIndexFileStart(file, entry);
+}
+
+static int zipIndexFileFill(ZipIndexFile *file) {
+  int size = file->in_remaining < TRANSFER_SIZE ? (int)file->in_remaining : TRANSFER_SIZE;
+  if (size == 0)
+    return 0;
+
+  int read = sceIoRead(file->fd, file->buffer, size);
+  if (read <= 0)
+    return read < 0 ? read : VITASHELL_ERROR_INVALID_MAGIC;
+
+  file->in_remaining -= read;
+  file->stream.next_in = file->buffer;
+  file->stream.avail_in = read;
+
+  return read;
+}
+
+int zipIndexFileRead(ZipIndexFile *file, void *data, SceSize size) {
+  if (file->fd < 0 || !file->entry)
+    return VITASHELL_ERROR_NOT_RUNNING;
+
+  if (size > file->out_remaining)
+    size = file->out_remaining;
+
+  if (size == 0) {
+    // Everything was read, check the data
+    if (file->check_crc && file->crc != file->entry->crc)
+      return VITASHELL_ERROR_CRC_MISMATCH;
+
+    return 0;
+  }
+
+  int read = 0;
+
+  if (file->entry->method == ZIP_METHOD_STORE) {
+    read = sceIoRead(file->fd, data, size);
+    if (read < 0)
+      return read;
+
+    if (read == 0)
+      return VITASHELL_ERROR_INVALID_MAGIC;
+
+    file->in_remaining -= read;
+  } else {
+    file->stream.next_out = data;
+    file->stream.avail_out = size;
+
+    while (file->stream.avail_out > 0) {
+      if (file->stream.avail_in == 0) {
+        int res = zipIndexFileFill(file);
+        if (res < 0)
+          return res;
+      }
+
+      int res = inflate(&file->stream, Z_NO_FLUSH);
+      if (res == Z_STREAM_END)
+        break;
+
+      if (res != Z_OK)
+        return VITASHELL_ERROR_INVALID_MAGIC;
+    }
+
+    read = size - file->stream.avail_out;
+    if (read == 0)
+      return VITASHELL_ERROR_INVALID_MAGIC;
+  }
+
+  file->out_remaining -= read;
+  file->crc = crc32(file->crc, data, read);
+
+  return read;
+}
+
+// Stored data is seeked to directly, which leaves the CRC unchecked.
+// Deflated data is inflated up to the offset, from the start of the entry
+// if the offset is behind
+int64_t zipIndexFileSeek(ZipIndexFile *file, uint64_t offset) {
+  if (file->fd < 0 || !file->entry)
+    return VITASHELL_ERROR_NOT_RUNNING;
+
+  ZipIndexEntry *entry = file->entry;
+
+  if (offset > entry->uncompressed_size)
+    offset = entry->uncompressed_size;
+
+  uint64_t position = entry->uncompressed_size - file->out_remaining;
+  if (offset == position)
+    return offset;
+
+  // Reading from the start can still be checked
+  if (offset == 0 || (offset < position && entry->method == ZIP_METHOD_DEFLATE)) {
+    if (entry->method == ZIP_METHOD_DEFLATE)
+      inflateEnd(&file->stream);
+    file->entry = NULL;
+
+    int res = zipIndexFileStart(file, entry);
+    if (res < 0)
+      return res;
+
+    position = 0;
+  } else if (entry->method == ZIP_METHOD_STORE) {
+    if (sceIoLseek(file->fd, file->data_offset + offset, SCE_SEEK_SET) < 0)
+      return VITASHELL_ERROR_INTERNAL;
+
+    file->in_remaining = entry->compressed_size - offset;
+    file->out_remaining = entry->uncompressed_size - offset;
+    file->check_crc = 0;
+    return offset;
+  }
+
+  if (position == offset)
+    return offset;
+
+  void *buffer = malloc(TRANSFER_SIZE);
+  if (!buffer)
+    return VITASHELL_ERROR_NO_MEMORY;
+
+  while (position < offset) {
+    int size = offset - position < TRANSFER_SIZE ? (int)(offset - position) : TRANSFER_SIZE;
+
+    int read = zipIndexFileRead(file, buffer, size);
+    if (read <= 0) {
+      free(buffer);
+      return read < 0 ? read : VITASHELL_ERROR_INVALID_MAGIC;
+    }
+
+    position += read;
+  }
+
+  free(buffer);
+  return offset;
+}
+
+int zipIndexFileClose(ZipIndexFile *file) {
+  if (file->fd < 0)
+    return VITASHELL_ERROR_NOT_RUNNING;
+
+  if (file->entry && file->entry->method == ZIP_METHOD_DEFLATE)
+    inflateEnd(&file->stream);
+
+  free(file->buffer);
+  sceIoClose(file->fd);
+
+  memset(file, 0, sizeof(ZipIndexFile));
+  file->fd = -1;
+
+  return 0;
+}
@@ -0,0 +1,80 @@
+/*
+  VitaShell
+  Copyright (C) 2015-2018, TheFloW
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __ZIPINDEX_H__
+#define __ZIPINDEX_H__
+
+#include <zlib.h>
+
+#include "file.h"
+
+#define ZIP_LOCAL_HEADER_MAGIC    0x04034B50
+#define ZIP_CENTRAL_HEADER_MAGIC  0x02014B50
+#define ZIP_END_MAGIC             0x06054B50
+#define ZIP64_END_MAGIC           0x06064B50
+#define ZIP64_END_LOCATOR_MAGIC   0x07064B50
+
+#define ZIP_METHOD_STORE   0
+#define ZIP_METHOD_DEFLATE 8
+
+#define ZIP_FLAG_ENCRYPTED 0x1
+
+typedef struct ZipIndexEntry {
+  struct ZipIndexEntry *next; // Next entry in the same hash bucket
+  char *name;
+  uint64_t local_offset;
+  uint64_t compressed_size;
+  uint64_t uncompressed_size;
+  uint32_t crc;
+  uint16_t method;
+  uint16_t flags;
+} ZipIndexEntry;
+
+typedef struct {
+  char file[MAX_PATH_LENGTH];
+  ZipIndexEntry *entries;
+  ZipIndexEntry **buckets;
+  char *names;
+  int count;
+  int n_buckets;
+} ZipIndex;
+
+typedef struct {
+  SceUID fd;
+  ZipIndexEntry *entry;
+  uint64_t in_remaining;
+  uint64_t out_remaining;
+  uint32_t crc;
+  int check_crc; // Cleared by a seek, the CRC covers only the data read
+  uint64_t data_offset;
+  uint8_t *buffer;
+  z_stream stream;
+} ZipIndexFile;
+
+int zipIndexOpen(ZipIndex *index, const char *file);
+void zipIndexClose(ZipIndex *index);
+ZipIndexEntry *zipIndexFind(ZipIndex *index, const char *name);
+int zipIndexEntrySupported(ZipIndexEntry *entry);
+
+int zipIndexFileOpen(ZipIndex *index, ZipIndexFile *file, ZipIndexEntry *entry);
+int zipIndexFileReopen(ZipIndexFile *file, ZipIndexEntry *entry);
+int zipIndexFileRead(ZipIndexFile *file, void *data, SceSize size);
+int64_t zipIndexFileSeek(ZipIndexFile *file, uint64_t offset);
+int zipIndexFileClose(ZipIndexFile *file);
+
+#endif